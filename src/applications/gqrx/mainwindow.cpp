@@ -21,6 +21,9 @@
  * the Free Software Foundation, Inc., 51 Franklin Street,
  * Boston, MA 02110-1301, USA.
  */
+#include <algorithm>
+#include <climits>
+#include <limits>
 #include <string>
 #include <vector>
 #include <volk/volk.h>
@@ -30,6 +33,7 @@
 #include <QDateTime>
 #include <QDesktopServices>
 #include <QDialogButtonBox>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QGroupBox>
 #include <QJsonDocument>
@@ -38,6 +42,7 @@
 #include <QMessageBox>
 #include <QPushButton>
 #include <QResource>
+#include <QSaveFile>
 #include <QShortcut>
 #include <QString>
 #include <QTextBrowser>
@@ -46,6 +51,7 @@
 #include <QtGlobal>
 #include <QTimer>
 #include <QVBoxLayout>
+#include <QWindow>
 #include <QSvgWidget>
 #include "qtgui/ioconfig.h"
 #include "mainwindow.h"
@@ -57,6 +63,7 @@
 
 /* DSP */
 #include "receiver.h"
+#include "dsp/fft_plan_cache.h"
 #include "remote_control_settings.h"
 
 #include "qtgui/bookmarkstaglist.h"
@@ -91,6 +98,9 @@ MainWindow::MainWindow(const QString& cfgfile, bool edit_conf, QWidget *parent)
         m_cfg_dir = QString("%1/gqrx").arg(xdg_dir.data());
     }
 
+    /* Keep FFTW wisdom with the configuration so that FFTs plan quickly */
+    fft_plan_cache::Get().set_wisdom_file(QString("%1/fftw_wisdom").arg(m_cfg_dir).toStdString());
+
     setWindowTitle(QString("Gqrx %1").arg(VERSION));
 
     // Set fixed widths for labels so they don't move around when set
@@ -123,12 +133,27 @@ MainWindow::MainWindow(const QString& cfgfile, bool edit_conf, QWidget *parent)
 
     /* FFT timer & data */
     d_iqFftData.resize(receiver::DEFAULT_FFT_SIZE);
+    d_fftReduce = true;
+    d_sweeping = false;
+    d_sweepGeneration = 0;
+    d_sweepNpts = -1;
+    d_sweepStartBin = 0.0;
+    d_sweepBinsPerPoint = 0.0;
     iq_fft_timer = new QTimer(this);
     iq_fft_timer->setTimerType(Qt::PreciseTimer);
     connect(iq_fft_timer, SIGNAL(timeout()), this, SLOT(iqFftTimeout()));
     d_last_fft_ms = 0;
     d_avg_fft_rate = 0.0;
     d_frame_drop = false;
+    d_adaptive_rate = false;
+    d_adaptive_fps = 0;
+    d_fft_cost = 0.f;
+    d_adaptive_ms = 0;
+    d_plotter_hidden = false;
+    d_hidden_wf_ms = 0;
+    d_history_format = IQ_FORMAT_CF32;
+    d_fft_threads_pending = false;
+    d_saving_history = false;
 
     d_audioFftData.resize(receiver::DEFAULT_FFT_SIZE);
     audio_fft_timer = new QTimer(this);
@@ -141,6 +166,8 @@ MainWindow::MainWindow(const QString& cfgfile, bool edit_conf, QWidget *parent)
     // create I/Q tool widget
     iq_tool = new CIqTool(this);
 
+    wf_recorder = new CWaterfallRecorder();
+
     // create DXC Objects
     dxc_options = new DXCOptions(this);
 
@@ -150,10 +177,12 @@ MainWindow::MainWindow(const QString& cfgfile, bool edit_conf, QWidget *parent)
     uiDockAudio = new DockAudio();
     uiDockInputCtl = new DockInputCtl();
     uiDockFft = new DockFft();
+    uiDockSweep = new DockSweep();
     BandPlan::Get().setConfigDir(m_cfg_dir);
     Bookmarks::Get().setConfigDir(m_cfg_dir);
     BandPlan::Get().load();
     uiDockBookmarks = new DockBookmarks(this);
+    uiDockSignals = new DockSignals();
 
     // setup some toggle view shortcuts
     uiDockInputCtl->toggleViewAction()->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_J));
@@ -191,7 +220,9 @@ MainWindow::MainWindow(const QString& cfgfile, bool edit_conf, QWidget *parent)
     addDockWidget(Qt::RightDockWidgetArea, uiDockRxOpt);
     addDockWidget(Qt::RightDockWidgetArea, uiDockFft);
     tabifyDockWidget(uiDockInputCtl, uiDockRxOpt);
+    addDockWidget(Qt::RightDockWidgetArea, uiDockSweep);
     tabifyDockWidget(uiDockRxOpt, uiDockFft);
+    tabifyDockWidget(uiDockFft, uiDockSweep);
     uiDockRxOpt->raise();
 
     addDockWidget(Qt::RightDockWidgetArea, uiDockAudio);
@@ -200,10 +231,14 @@ MainWindow::MainWindow(const QString& cfgfile, bool edit_conf, QWidget *parent)
     uiDockAudio->raise();
 
     addDockWidget(Qt::BottomDockWidgetArea, uiDockBookmarks);
+    addDockWidget(Qt::BottomDockWidgetArea, uiDockSignals);
+    tabifyDockWidget(uiDockBookmarks, uiDockSignals);
 
     /* hide docks that we don't want to show initially */
     uiDockBookmarks->hide();
     uiDockRDS->hide();
+    uiDockSignals->hide();
+    uiDockSweep->hide();
 
     /* Add dock widget actions to View menu. By doing it this way all signal/slot
        connections will be established automagially.
@@ -213,7 +248,9 @@ MainWindow::MainWindow(const QString& cfgfile, bool edit_conf, QWidget *parent)
     ui->menu_View->addAction(uiDockRDS->toggleViewAction());
     ui->menu_View->addAction(uiDockAudio->toggleViewAction());
     ui->menu_View->addAction(uiDockFft->toggleViewAction());
+    ui->menu_View->addAction(uiDockSweep->toggleViewAction());
     ui->menu_View->addAction(uiDockBookmarks->toggleViewAction());
+    ui->menu_View->addAction(uiDockSignals->toggleViewAction());
     ui->menu_View->addSeparator();
     ui->menu_View->addAction(ui->mainToolBar->toggleViewAction());
     ui->menu_View->addSeparator();
@@ -261,8 +298,10 @@ MainWindow::MainWindow(const QString& cfgfile, bool edit_conf, QWidget *parent)
     connect(uiDockAudio, SIGNAL(audioGainChanged(float)), remote, SLOT(setAudioGain(float)));
     connect(uiDockAudio, SIGNAL(audioStreamingStarted(QString,int,bool)), this, SLOT(startAudioStream(QString,int,bool)));
     connect(uiDockAudio, SIGNAL(audioStreamingStopped()), this, SLOT(stopAudioStreaming()));
-    connect(uiDockAudio, SIGNAL(audioRecStarted(QString)), this, SLOT(startAudioRec(QString)));
-    connect(uiDockAudio, SIGNAL(audioRecStarted(QString)), remote, SLOT(startAudioRecorder(QString)));
+    connect(uiDockAudio, SIGNAL(audioRecStarted(QString,int)), this, SLOT(startAudioRec(QString,int)));
+    connect(uiDockAudio, SIGNAL(audioRecStarted(QString,int)), remote, SLOT(startAudioRecorder(QString)));
+    connect(uiDockAudio, SIGNAL(audioSqlRecStarted(QString,double,double,QString)), this, SLOT(startSqlAudioRec(QString,double,double,QString)));
+    connect(uiDockAudio, SIGNAL(audioSqlRecStarted(QString,double,double,QString)), remote, SLOT(startAudioRecorder(QString)));
     connect(uiDockAudio, SIGNAL(audioRecStopped()), this, SLOT(stopAudioRec()));
     connect(uiDockAudio, SIGNAL(audioRecStopped()), remote, SLOT(stopAudioRecorder()));
     connect(uiDockAudio, SIGNAL(audioPlayStarted(QString)), this, SLOT(startAudioPlayback(QString)));
@@ -297,8 +336,13 @@ MainWindow::MainWindow(const QString& cfgfile, bool edit_conf, QWidget *parent)
     connect(uiDockFft, SIGNAL(fftFillToggled(bool)), this, SLOT(enableFftFill(bool)));
     connect(uiDockFft, SIGNAL(fftMaxHoldToggled(bool)), ui->plotter, SLOT(enableMaxHold(bool)));
     connect(uiDockFft, SIGNAL(fftMinHoldToggled(bool)), ui->plotter, SLOT(enableMinHold(bool)));
+    connect(uiDockFft, SIGNAL(fftReduceToggled(bool)), this, SLOT(setIqFftReduce(bool)));
+    connect(uiDockFft, SIGNAL(fftAdaptiveRateToggled(bool)), this, SLOT(setIqFftAdaptiveRate(bool)));
+    connect(uiDockFft, SIGNAL(wfRecordToggled(bool,QString,bool)), this, SLOT(setWaterfallRecording(bool,QString,bool)));
+    connect(uiDockFft, SIGNAL(fftThreadsChanged(int)), this, SLOT(setIqFftThreads(int)));
     connect(uiDockFft, SIGNAL(peakDetectToggled(bool)), ui->plotter, SLOT(enablePeakDetect(bool)));
     connect(uiDockRDS, SIGNAL(rdsDecoderToggled(bool)), this, SLOT(setRdsDecoder(bool)));
+    connect(uiDockSweep, SIGNAL(sweepToggled(bool)), this, SLOT(setSweep(bool)));
 
     // Plotter
     connect(ui->plotter, SIGNAL(pandapterRangeChanged(float,float)),
@@ -312,19 +356,31 @@ MainWindow::MainWindow(const QString& cfgfile, bool edit_conf, QWidget *parent)
     // Bookmarks
     connect(uiDockBookmarks, SIGNAL(newBookmarkActivated(qint64, QString, int)), this, SLOT(onBookmarkActivated(qint64, QString, int)));
     connect(uiDockBookmarks->actionAddBookmark, SIGNAL(triggered()), this, SLOT(on_actionAddBookmark_triggered()));
-    connect(&Bookmarks::Get(), SIGNAL(BookmarksChanged()), ui->plotter, SLOT(updateOverlay()));
+    connect(&Bookmarks::Get(), SIGNAL(BookmarksChanged()), ui->plotter, SLOT(updateTags()));
+
+    // Signal detector
+    connect(uiDockSignals, SIGNAL(detectorToggled(bool)), this, SLOT(setDetector(bool)));
+    connect(uiDockSignals, SIGNAL(thresholdChanged(float)), this, SLOT(setDetectorThreshold(float)));
+    connect(uiDockSignals, SIGNAL(hysteresisChanged(float)), this, SLOT(setDetectorHysteresis(float)));
+    connect(uiDockSignals, SIGNAL(holdTimeChanged(double)), this, SLOT(setDetectorHoldTime(double)));
+    connect(uiDockSignals, SIGNAL(signalActivated(qint64)), this, SLOT(setNewFrequency(qint64)));
 
     //DXC Spots
     connect(&DXCSpots::Get(), SIGNAL(dxcSpotsUpdated()), this, SLOT(updateClusterSpots()));
 
     // I/Q playback
-    connect(iq_tool, SIGNAL(startRecording(QString, QString)), this, SLOT(startIqRecording(QString, QString)));
-    connect(iq_tool, SIGNAL(startRecording(QString, QString)), remote, SLOT(startIqRecorder(QString, QString)));
+    connect(iq_tool, SIGNAL(startRecording(QString, QString, QString, int, int)), this, SLOT(startIqRecording(QString, QString, QString, int, int)));
+    connect(iq_tool, SIGNAL(startRecording(QString, QString, QString, int, int)), remote, SLOT(startIqRecorder(QString, QString)));
     connect(iq_tool, SIGNAL(stopRecording()), this, SLOT(stopIqRecording()));
     connect(iq_tool, SIGNAL(stopRecording()), remote, SLOT(stopIqRecorder()));
-    connect(iq_tool, SIGNAL(startPlayback(QString,float,qint64)), this, SLOT(startIqPlayback(QString,float,qint64)));
+    connect(iq_tool, SIGNAL(startPlayback(QString,float,qint64,QString)), this, SLOT(startIqPlayback(QString,float,qint64,QString)));
     connect(iq_tool, SIGNAL(stopPlayback()), this, SLOT(stopIqPlayback()));
     connect(iq_tool, SIGNAL(seek(qint64)), this,SLOT(seekIqFile(qint64)));
+    connect(iq_tool, SIGNAL(speedChanged(double)), this, SLOT(setIqPlaybackSpeed(double)));
+    connect(iq_tool, SIGNAL(loopChanged(qint64, qint64)), this, SLOT(setIqPlaybackLoop(qint64, qint64)));
+    connect(iq_tool, SIGNAL(historyChanged(int, QString)), this, SLOT(setIqHistory(int, QString)));
+    connect(iq_tool, SIGNAL(startHistorySave(QString)), this, SLOT(startIqHistorySave(QString)));
+    connect(iq_tool, SIGNAL(stopHistorySave()), this, SLOT(stopIqHistorySave()));
 
     // remote control
     connect(remote, SIGNAL(newRDSmode(bool)), uiDockRDS, SLOT(setRDSmode(bool)));
@@ -342,6 +398,8 @@ MainWindow::MainWindow(const QString& cfgfile, bool edit_conf, QWidget *parent)
     connect(remote, SIGNAL(startAudioRecorderEvent()), uiDockAudio, SLOT(startAudioRecorder()));
     connect(remote, SIGNAL(stopAudioRecorderEvent()), uiDockAudio, SLOT(stopAudioRecorder()));
     connect(remote, SIGNAL(startIqRecorderEvent()), iq_tool, SLOT(startIqRecorder()));
+    connect(remote, SIGNAL(startIqHistoryEvent()), iq_tool, SLOT(startIqHistorySave()));
+    connect(remote, SIGNAL(stopIqHistoryEvent()), iq_tool, SLOT(stopIqHistorySave()));
     connect(remote, SIGNAL(stopIqRecorderEvent()), iq_tool, SLOT(stopIqRecorder()));
     connect(ui->plotter, SIGNAL(newFilterFreq(int, int)), remote, SLOT(setPassband(int, int)));
     connect(remote, SIGNAL(newPassband(int)), this, SLOT(setPassband(int)));
@@ -352,10 +410,14 @@ MainWindow::MainWindow(const QString& cfgfile, bool edit_conf, QWidget *parent)
     connect(uiDockRDS, SIGNAL(radiotextChanged(QString)), remote, SLOT(setRdsRadiotext(QString)));
     connect(remote, SIGNAL(newAudioMuted(bool)), uiDockAudio, SLOT(setAudioMuted(bool)));
     connect(uiDockAudio, SIGNAL(audioMuted(bool)), remote, SLOT(setAudioMuted(bool)));
+    connect(remote, SIGNAL(newDetectorMode(bool)), uiDockSignals, SLOT(setDetectorEnabled(bool)));
 
     rds_timer = new QTimer(this);
     connect(rds_timer, SIGNAL(timeout()), this, SLOT(rdsTimeout()));
 
+    det_timer = new QTimer(this);
+    connect(det_timer, SIGNAL(timeout()), this, SLOT(detectorTimeout()));
+
     // enable frequency tooltips on FFT plot
     ui->plotter->setTooltipsEnabled(true);
 
@@ -397,12 +459,18 @@ MainWindow::MainWindow(const QString& cfgfile, bool edit_conf, QWidget *parent)
     }
 
     qsvg_dummy = new QSvgWidget();
+
+    preplanIqFft(uiDockFft->fftSize(), uiDockFft->fftThreads());
 }
 
 MainWindow::~MainWindow()
 {
     on_actionDSP_triggered(false);
 
+    // Do not wait for a plan in progress, its wisdom is saved next time
+    fft_plan_cache::Get().stop_preplan();
+    fft_plan_cache::Get().save_wisdom(false);
+
     /* stop and delete timers */
     dec_timer->stop();
     delete dec_timer;
@@ -416,6 +484,13 @@ MainWindow::~MainWindow()
     audio_fft_timer->stop();
     delete audio_fft_timer;
 
+    det_timer->stop();
+    delete det_timer;
+
+    // finish the waterfall recording
+    ui->plotter->setWaterfallRecorder(nullptr);
+    delete wf_recorder;
+
     if (m_settings)
     {
         m_settings->setValue("configversion", 4);
@@ -448,6 +523,8 @@ MainWindow::~MainWindow()
     delete uiDockFft;
     delete uiDockInputCtl;
     delete uiDockRDS;
+    delete uiDockSignals;
+    delete uiDockSweep;
     delete rx;
     delete remote;
     delete qsvg_dummy;
@@ -667,6 +744,8 @@ bool MainWindow::loadConfig(const QString& cfgfile, bool check_crash,
     uiDockRxOpt->readSettings(m_settings);
     uiDockFft->readSettings(m_settings);
     uiDockAudio->readSettings(m_settings);
+    uiDockSignals->readSettings(m_settings);
+    uiDockSweep->readSettings(m_settings);
     dxc_options->readSettings(m_settings);
 
     {
@@ -793,6 +872,8 @@ void MainWindow::storeSession()
         uiDockRxOpt->saveSettings(m_settings);
         uiDockFft->saveSettings(m_settings);
         uiDockAudio->saveSettings(m_settings);
+        uiDockSignals->saveSettings(m_settings);
+        uiDockSweep->saveSettings(m_settings);
 
         remote->saveSettings(m_settings);
         iq_tool->saveSettings(m_settings);
@@ -914,7 +995,8 @@ void MainWindow::setNewFrequency(qint64 rx_freq)
     rx->set_rf_freq(hw_freq);
 
     // update widgets
-    ui->plotter->setCenterFreq(center_freq);
+    if (!d_sweeping)
+        ui->plotter->setCenterFreq(center_freq);
     uiDockRxOpt->setHwFreq(d_hw_freq);
     ui->freqCtrl->setFrequency(rx_freq);
     uiDockBookmarks->setNewFrequency(rx_freq);
@@ -1475,6 +1557,57 @@ void MainWindow::meterTimeout()
     level = rx->get_signal_pwr();
     ui->sMeter->setLevel(level);
     remote->setSignalLevel(level);
+
+    bool sql_open = rx->is_sql_open() && uiDockRxOpt->currentSquelchLevel() > -150.0;
+
+    if (rx->is_recording_iq())
+    {
+        iq_tool->setRecordingStats(rx->get_iq_recording_fill(),
+                                   rx->get_iq_recording_dropped());
+        if (d_iq_rec.sigmf)
+            annotateIqSquelch(sql_open);
+        updateIqRecordingMeta();
+    }
+
+    // The I/Q history stops saving by itself on write errors
+    if (d_saving_history && !rx->is_saving_iq_history())
+    {
+        ui->statusBar->showMessage(tr("Error saving I/Q history"));
+        iq_tool->cancelHistorySave();
+        remote->setIqHistoryStatus(false);
+        d_saving_history = false;
+    }
+    iq_tool->setHistoryLength(rx->get_iq_history_length());
+
+    qint64 playback_pos = rx->get_iq_file_position();
+    if (playback_pos >= 0)
+        iq_tool->setPlaybackPosition(playback_pos);
+    iq_tool->setSquelchOpen(sql_open);
+
+    // Stop playback at the end of the file like the stop button does
+    if (rx->is_iq_file_at_end())
+    {
+        iq_tool->cancelPlayback();
+        stopIqPlayback();
+    }
+}
+
+/* Waterfall line interval while the plotter can not be seen. */
+#define HIDDEN_WF_INTERVAL_MS   1000
+
+/**
+ * Whether a widget can be seen.
+ *
+ * False when the widget is hidden, or its window is minimized or, where the
+ * platform reports it, completely covered by other windows.
+ */
+static bool isWidgetShown(const QWidget *widget)
+{
+    if (!widget->isVisible() || widget->visibleRegion().isEmpty())
+        return false;
+
+    const QWindow *window = widget->window()->windowHandle();
+    return window == nullptr || window->isExposed();
 }
 
 /** Baseband FFT plot timeout. */
@@ -1488,31 +1621,209 @@ void MainWindow::iqFftTimeout()
         return;
     }
 
+    if (d_sweeping && !rx->is_sweeping())
+    {
+        // Stopped by the receiver, e.g. because the sample rate changed
+        setSweep(false);
+        uiDockSweep->setSweepRunning(false);
+        return;
+    }
+
+    const quint64 now_ms = QDateTime::currentMSecsSinceEpoch();
+
+    // Nobody needs spectra while the plotter can not be seen, except the
+    // waterfall and the signal detector. The waterfall gets lines at a
+    // background rate. Lines carry their time, so the time axis stays right
+    // when the plotter is shown again.
+    const bool shown = isWidgetShown(ui->plotter);
+    if (!shown)
+    {
+        d_plotter_hidden = true;
+
+        // A waterfall recording gets every line
+        quint64 wf_interval = ui->plotter->getWfTimeRes();
+        if (!wf_recorder->isRunning())
+            wf_interval = std::max(wf_interval, (quint64)HIDDEN_WF_INTERVAL_MS);
+        if (!ui->plotter->hasWaterfall() || now_ms < d_hidden_wf_ms + wf_interval)
+        {
+            // The detector runs on FFT frames
+            if (!d_sweeping && rx->is_detector_enabled())
+                rx->get_iq_fft_data(d_iqFftData.data());
+            return;
+        }
+        d_hidden_wf_ms = now_ms;
+    }
+    else if (d_plotter_hidden)
+    {
+        // Frames were skipped on purpose
+        d_plotter_hidden = false;
+        d_avg_fft_rate = 0.0;
+    }
+
     // Track the frame rate and warn if not keeping up. Since the interval is ms, the timer can
     // not be set exactly to all rates.
-    const quint64 now_ms = QDateTime::currentMSecsSinceEpoch();
-    const float expected_rate = 1000.0f / (float)iq_fft_timer->interval();
-    const float last_fft_rate = 1000.0f / (float)(now_ms - d_last_fft_ms);
-    const float alpha = std::pow(expected_rate, -0.75f);
-    if (d_avg_fft_rate == 0.0f)
-        d_avg_fft_rate = expected_rate;
-    else
-        d_avg_fft_rate = (1.0f - alpha) * d_avg_fft_rate + alpha * last_fft_rate;
+    if (shown)
+    {
+        const float expected_rate = 1000.0f / (float)iq_fft_timer->interval();
+        const float last_fft_rate = 1000.0f / (float)(now_ms - d_last_fft_ms);
+        const float alpha = std::pow(expected_rate, -0.75f);
+        if (d_avg_fft_rate == 0.0f)
+            d_avg_fft_rate = expected_rate;
+        else
+            d_avg_fft_rate = (1.0f - alpha) * d_avg_fft_rate + alpha * last_fft_rate;
 
-    const bool drop = d_avg_fft_rate < expected_rate * 0.95f;
-    if (drop != d_frame_drop) {
-        if (drop) {
-            uiDockFft->setActualFrameRate(d_avg_fft_rate, true);
+        const bool drop = d_avg_fft_rate < expected_rate * 0.95f;
+        if (drop != d_frame_drop) {
+            if (drop) {
+                uiDockFft->setActualFrameRate(d_avg_fft_rate, true);
+            }
+            else {
+                uiDockFft->setActualFrameRate(d_avg_fft_rate, false);
+            }
+            d_frame_drop = drop;
+        }
+        d_last_fft_ms = now_ms;
+    }
+
+    QElapsedTimer cost;
+    cost.start();
+
+    double start_bin;
+    double bins_per_point;
+    int npts;
+
+    if (d_sweeping)
+    {
+        // The sweep spectrum only changes when a step is done, so it is read
+        // and reduced again only then or when the plotter geometry changes.
+        const int size = (int)rx->get_sweep_size();
+        if (d_fftReduce && ui->plotter->getReducedFftGeometry(size, &start_bin,
+                                                              &bins_per_point, &npts))
+        {
+            if (npts != d_sweepNpts || start_bin != d_sweepStartBin ||
+                bins_per_point != d_sweepBinsPerPoint)
+            {
+                d_sweepGeneration = 0;
+                d_sweepNpts = npts;
+                d_sweepStartBin = start_bin;
+                d_sweepBinsPerPoint = bins_per_point;
+                if ((int)d_iqFftMax.size() < npts)
+                {
+                    d_iqFftMax.resize(npts);
+                    d_iqFftAvg.resize(npts);
+                }
+            }
+            if (rx->get_sweep_data_reduced(d_iqFftMax.data(), d_iqFftAvg.data(), start_bin,
+                                           bins_per_point, npts, &d_sweepGeneration) >= 0)
+                ui->plotter->setNewReducedFftData(d_iqFftMax.data(), d_iqFftAvg.data(),
+                                                  npts, size);
         }
-        else {
-            uiDockFft->setActualFrameRate(d_avg_fft_rate, false);
+        else
+        {
+            if (d_sweepNpts != 0)
+            {
+                d_sweepGeneration = 0;
+                d_sweepNpts = 0;
+            }
+            if (rx->get_sweep_data(d_sweepData, &d_sweepGeneration) >= 0)
+                ui->plotter->setNewFftData(d_sweepData.data(), (int)d_sweepData.size());
         }
-        d_frame_drop = drop;
+        uiDockSweep->setSweepRate(rx->get_sweep_rate());
+        return;
     }
-    d_last_fft_ms = now_ms;
 
-    if (rx->get_iq_fft_data(d_iqFftData.data()) >= 0)
+    // Let the DSP reduce the spectrum to one max/avg pair per pixel column
+    // when the plotter can use it; only hand over every bin when needed.
+    if (d_fftReduce && ui->plotter->getReducedFftGeometry(fftsize, &start_bin,
+                                                          &bins_per_point, &npts))
+    {
+        if ((int)d_iqFftMax.size() < npts)
+        {
+            d_iqFftMax.resize(npts);
+            d_iqFftAvg.resize(npts);
+        }
+        if (rx->get_iq_fft_data_reduced(d_iqFftMax.data(), d_iqFftAvg.data(),
+                                        start_bin, bins_per_point, npts) >= 0)
+            ui->plotter->setNewReducedFftData(d_iqFftMax.data(), d_iqFftAvg.data(),
+                                              npts, fftsize);
+    }
+    else if (rx->get_iq_fft_data(d_iqFftData.data()) >= 0)
+    {
         ui->plotter->setNewFftData(d_iqFftData.data(), fftsize);
+    }
+
+    if (shown)
+        adaptIqFftRate(now_ms, cost.nsecsElapsed() * 1e-6f);
+}
+
+/* Adaptive FFT rate: share of the frame interval frames may take. */
+#define ADAPTIVE_BUDGET_HIGH    0.5f
+#define ADAPTIVE_BUDGET_LOW     0.3f
+#define ADAPTIVE_HOLD_MS        1000
+#define ADAPTIVE_MIN_FPS        5
+
+/**
+ * Lower the FFT rate when frames take too long, and restore it when there
+ * is room again.
+ * @param now_ms Current time.
+ * @param cost_ms Time spent on this frame in iqFftTimeout().
+ *
+ * The cost of a frame is the larger of the GUI thread work (FFT, plotter
+ * hand-off and painting) and the plotter render thread work. The rate is
+ * lowered when the cost exceeds ADAPTIVE_BUDGET_HIGH of the frame interval
+ * or frames are dropped. It is raised when the cost at the higher rate would
+ * stay below ADAPTIVE_BUDGET_LOW. Averaging and the waterfall follow the
+ * rate in time, see CPlotter::setFftRate().
+ */
+void MainWindow::adaptIqFftRate(quint64 now_ms, float cost_ms)
+{
+    if (d_fft_cost > 0.f)
+        d_fft_cost += 0.1f * (cost_ms - d_fft_cost);
+    else
+        d_fft_cost = cost_ms;
+
+    if (!d_adaptive_rate || d_fps <= 0 || now_ms < d_adaptive_ms + ADAPTIVE_HOLD_MS)
+        return;
+
+    const float frame_ms = std::max(d_fft_cost + ui->plotter->getPaintCost(),
+                                    ui->plotter->getRenderCost());
+    const int max_fps = (int)d_fps;
+    const int min_fps = std::min(ADAPTIVE_MIN_FPS, max_fps);
+    int fps = d_adaptive_fps;
+
+    if (frame_ms * (float)fps / 1000.0f > ADAPTIVE_BUDGET_HIGH || d_frame_drop)
+    {
+        fps = std::max(min_fps, fps * 3 / 4);
+    }
+    else if (fps < max_fps)
+    {
+        const int up = std::min(max_fps, fps * 5 / 4 + 1);
+        if (frame_ms * (float)up / 1000.0f < ADAPTIVE_BUDGET_LOW)
+            fps = up;
+    }
+
+    if (fps != d_adaptive_fps)
+    {
+        qDebug() << "Adaptive FFT rate" << fps << "fps, frame cost" << frame_ms << "ms";
+        setAdaptiveFftRate(fps);
+    }
+}
+
+/** Change the FFT rate in use, keeping the rate selected by the user. */
+void MainWindow::setAdaptiveFftRate(int fps)
+{
+    d_adaptive_fps = fps;
+    d_adaptive_ms = QDateTime::currentMSecsSinceEpoch();
+
+    ui->plotter->setFftRate(fps);
+    if (1000 / fps > 1 && iq_fft_timer->isActive())
+        iq_fft_timer->setInterval(1000 / fps);
+
+    uiDockFft->setWfResolution(ui->plotter->getWfTimeRes());
+    uiDockFft->setEffectiveFrameRate(fps);
+
+    // Invalidate average frame rate
+    d_avg_fft_rate = 0.0;
 }
 
 /** Audio FFT plot timeout. */
@@ -1527,7 +1838,7 @@ void MainWindow::audioFftTimeout()
         return;
     }
 
-    if (!d_have_audio || !uiDockAudio->isVisible())
+    if (!d_have_audio || !isWidgetShown(uiDockAudio))
         return;
 
     if (rx->get_audio_fft_data(d_audioFftData.data()) >= 0)
@@ -1547,12 +1858,42 @@ void MainWindow::rdsTimeout()
     }
 }
 
+/** Get the active signals from the detector and show them. */
+void MainWindow::detectorTimeout()
+{
+    std::vector<signal_detector::signal> sigs = rx->get_detected_signals();
+
+    if (rx->is_recording_iq() && d_iq_rec.sigmf)
+        annotateIqCarriers(sigs);
+
+    for (auto &sig : sigs)
+        sig.freq += (double)d_lnb_lo;
+
+    uiDockSignals->setSignals(sigs);
+    remote->setDetectedSignals(sigs);
+}
+
 /**
  * @brief Start audio recorder.
  * @param filename The file name into which audio should be recorded.
+ * @param split_seconds Continue in a new file after this time, 0 for one file.
  */
-void MainWindow::startAudioRec(const QString& filename)
-{
+void MainWindow::startAudioRec(const QString& filename, int split_seconds)
+{
+    // Later files are named like the first one, after the time of their first sample.
+    // WAV recordings also continue in a new file at the 4 GiB limit of the format.
+    QFileInfo info(filename);
+    auto start = QDateTime::currentDateTimeUtc();
+    auto dir = info.path();
+    auto ext = info.suffix();
+    auto rest = info.completeBaseName().mid(QString("gqrx_yyyyMMdd_hhmmss").size());
+    double rate = rx->get_audio_rate();
+    std::function<std::string(uint64_t)> segment_name = [=](uint64_t first_frame) {
+        auto time = start.addMSecs(qRound64(first_frame * 1000.0 / rate));
+        return QString("%1/%2%3.%4").arg(dir, time.toString("gqrx_yyyyMMdd_hhmmss"),
+                                         rest, ext).toStdString();
+    };
+
     if (!d_have_audio)
     {
         QMessageBox msg_box;
@@ -1563,7 +1904,7 @@ void MainWindow::startAudioRec(const QString& filename)
         msg_box.exec();
         uiDockAudio->setAudioRecButtonState(false);
     }
-    else if (rx->start_audio_recording(filename.toStdString()))
+    else if (rx->start_audio_recording(filename.toStdString(), split_seconds, segment_name))
     {
         ui->statusBar->showMessage(tr("Error starting audio recorder"));
 
@@ -1576,6 +1917,40 @@ void MainWindow::startAudioRec(const QString& filename)
     }
 }
 
+/**
+ * @brief Start squelch triggered audio recorder.
+ * @param dir The directory where a file is created for each transmission.
+ * @param preroll Seconds of audio to record from before the squelch opens.
+ * @param hang Seconds the squelch must stay closed before a file is finished.
+ * @param format The file format, "wav" or "flac".
+ */
+void MainWindow::startSqlAudioRec(const QString& dir, double preroll, double hang,
+                                  const QString& format)
+{
+    if (!d_have_audio)
+    {
+        QMessageBox msg_box;
+        msg_box.setIcon(QMessageBox::Critical);
+        msg_box.setText(tr("Recording audio requires a demodulator.\n"
+                           "Currently, demodulation is switched off "
+                           "(Mode->Demod Off)."));
+        msg_box.exec();
+        uiDockAudio->setAudioRecButtonState(false);
+    }
+    else if (rx->start_sql_audio_recording(dir.toStdString(), preroll, hang,
+                                           audio_file_format_from_name(format.toStdString())))
+    {
+        ui->statusBar->showMessage(tr("Error starting audio recorder"));
+
+        /* reset state of record button */
+        uiDockAudio->setAudioRecButtonState(false);
+    }
+    else
+    {
+        ui->statusBar->showMessage(tr("Recording transmissions to %1").arg(dir));
+    }
+}
+
 /** Stop audio recorder. */
 void MainWindow::stopAudioRec()
 {
@@ -1637,54 +2012,314 @@ void MainWindow::stopAudioStreaming()
     rx->stop_udp_streaming();
 }
 
-/** Start I/Q recording. */
-void MainWindow::startIqRecording(const QString& recdir, const QString& format)
+/**
+ * Create the contents of a SigMF meta file for one capture.
+ * @param fmt The sample format of the data file.
+ * @param sample_rate The sample rate.
+ * @param freq The center frequency.
+ * @param start Time of the first sample.
+ * @param annotations The annotations of the recording.
+ * @param global_index Index of the first sample in a split recording, -1 if not split.
+ */
+QByteArray MainWindow::sigmfMeta(iq_format fmt, qint64 sample_rate, qint64 freq,
+                                 const QDateTime &start, const QJsonArray &annotations,
+                                 qint64 global_index)
+{
+    QJsonObject capture {
+        {"core:sample_start", 0},
+        {"core:frequency", freq},
+        {"core:datetime", start.toString(Qt::ISODateWithMs)},
+    };
+    // Position of a split recording's file in the whole recording
+    if (global_index >= 0)
+        capture.insert("core:global_index", global_index);
+
+    return QJsonDocument { QJsonObject {
+        {"global", QJsonObject {
+            {"core:datatype", QString::fromStdString(iq_format_sigmf_datatype(fmt))},
+            {"core:sample_rate", sample_rate},
+            {"core:version", "1.0.0"},
+            {"core:recorder", "Gqrx " VERSION},
+            {"core:hw", QString("OsmoSDR: ") + m_settings->value("input/device", "").toString()},
+        }}, {"captures", QJsonArray { capture }},
+        {"annotations", annotations},
+    }}.toJson();
+}
+
+/**
+ * Write the SigMF meta file of the I/Q history being saved.
+ * @param dropped Samples dropped while saving.
+ * @param gap Sample in the file after the first drop.
+ *
+ * The trigger is marked by an annotation. If samples were dropped, the file
+ * is not gapless and the first gap is marked as well.
+ */
+bool MainWindow::writeIqHistoryMeta(quint64 dropped, quint64 gap)
+{
+    QJsonArray annotations {
+        QJsonObject {
+            {"core:sample_start", (qint64)d_history_save.pre},
+            {"core:label", "trigger"},
+        },
+    };
+    if (dropped > 0)
+    {
+        annotations.append(QJsonObject {
+            {"core:sample_start", (qint64)gap},
+            {"core:label", "gap"},
+            {"core:comment", QString("%1 samples dropped from here on, the recording is not gapless")
+                             .arg(dropped)},
+        });
+    }
+
+    auto meta = sigmfMeta(d_history_save.fmt, d_history_save.rate, d_history_save.freq,
+                          d_history_save.start, annotations);
+
+    QSaveFile metaFile(d_history_save.meta);
+    return metaFile.open(QIODevice::WriteOnly) && metaFile.write(meta) == meta.size()
+           && metaFile.commit();
+}
+
+/** Name of the file of an I/Q recording starting with the given sample. */
+QString MainWindow::iqRecordingName(const iq_recording &rec, quint64 first_sample,
+                                    const QString &ext)
+{
+    auto start = rec.start.addMSecs((qint64)(first_sample * 1000 / (quint64)rec.rate));
+
+    return start.toString("%1/gqrx_yyyyMMdd_hhmmss_%2_%3_%4.%5")
+            .arg(rec.dir).arg(rec.freq).arg(rec.rate).arg(rec.tag).arg(ext);
+}
+
+/**
+ * Write the SigMF meta file of one file of the current I/Q recording.
+ *
+ * The annotations seen so far that overlap the file are included, the
+ * ones still open up to the last sample they were seen at. The file is
+ * replaced in one step so readers never see a partly written one.
+ */
+bool MainWindow::writeIqRecordingMeta(quint64 segment)
+{
+    const quint64 first = segment * d_iq_rec.segment_samples;
+    const quint64 last = (d_iq_rec.segment_samples > 0) ? first + d_iq_rec.segment_samples
+                                                        : std::numeric_limits<quint64>::max();
+    auto start = d_iq_rec.start.addMSecs((qint64)(first * 1000 / (quint64)d_iq_rec.rate));
+
+    QVector<iq_annotation> all = d_iq_rec.annotations;
+    if (d_iq_rec.sql_open)
+        all.append(d_iq_rec.sql);
+    for (const auto &carrier : d_iq_rec.carriers)
+        all.append(carrier);
+
+    // SigMF wants annotations sorted by their first sample
+    std::stable_sort(all.begin(), all.end(),
+                     [](const iq_annotation &a, const iq_annotation &b) {
+                         return a.start < b.start;
+                     });
+
+    QJsonArray annotations;
+    for (const auto &a : all)
+    {
+        const quint64 from = std::max(a.start, first);
+        const quint64 to = std::min(a.end, last);
+        if (from >= to)
+            continue;
+
+        annotations.append(QJsonObject {
+            {"core:sample_start", (qint64)(from - first)},
+            {"core:sample_count", (qint64)(to - from)},
+            {"core:freq_lower_edge", a.lower},
+            {"core:freq_upper_edge", a.upper},
+            {"core:label", a.label},
+        });
+    }
+
+    auto meta = sigmfMeta(d_iq_rec.fmt, d_iq_rec.rate, d_iq_rec.freq, start, annotations,
+                          d_iq_rec.segment_samples > 0 ? (qint64)first : -1);
+
+    QSaveFile metaFile(iqRecordingName(d_iq_rec, first, "sigmf-meta"));
+    return metaFile.open(QIODevice::WriteOnly) && metaFile.write(meta) == meta.size() &&
+           metaFile.commit();
+}
+
+/**
+ * Write the meta files of a split SigMF recording when it starts a new file.
+ *
+ * The file that was finished gets its final annotations.
+ */
+void MainWindow::updateIqRecordingMeta()
+{
+    if (!d_iq_rec.sigmf)
+        return;
+
+    const quint64 segment = rx->get_iq_recording_segment();
+    while (d_iq_rec.segment < segment)
+    {
+        bool ok = writeIqRecordingMeta(d_iq_rec.segment);
+        ok = writeIqRecordingMeta(++d_iq_rec.segment) && ok;
+        if (!ok)
+            ui->statusBar->showMessage(tr("Error writing SigMF meta file"));
+
+        // Annotations that ended in finished files are no longer needed
+        const quint64 first = d_iq_rec.segment * d_iq_rec.segment_samples;
+        d_iq_rec.annotations.erase(std::remove_if(d_iq_rec.annotations.begin(),
+                                                  d_iq_rec.annotations.end(),
+                                                  [first](const iq_annotation &a) {
+                                                      return a.end <= first;
+                                                  }),
+                                   d_iq_rec.annotations.end());
+    }
+}
+
+/** Close the open annotations of a stopped SigMF recording and write them. */
+void MainWindow::finishIqRecordingMeta()
+{
+    if (!d_iq_rec.sigmf)
+        return;
+
+    annotateIqSquelch(false);
+    annotateIqCarriers(std::vector<signal_detector::signal>());
+
+    // The last samples may have started a new file
+    updateIqRecordingMeta();
+    if (!writeIqRecordingMeta(d_iq_rec.segment))
+        ui->statusBar->showMessage(tr("Error writing SigMF meta file"));
+}
+
+/**
+ * Annotate the time the squelch is open in a SigMF recording.
+ * @param open Whether the squelch is open now.
+ */
+void MainWindow::annotateIqSquelch(bool open)
+{
+    const quint64 pos = rx->get_iq_recording_samples();
+
+    if (open && !d_iq_rec.sql_open)
+    {
+        // The demodulator's channel
+        int lo, hi;
+        ui->plotter->getHiLowCutFrequencies(&lo, &hi);
+        const double center = rx->get_rf_freq() + rx->get_filter_offset();
+
+        d_iq_rec.sql = iq_annotation { pos, pos, center + lo, center + hi, "squelch open" };
+        d_iq_rec.sql_open = true;
+    }
+    else if (d_iq_rec.sql_open)
+    {
+        d_iq_rec.sql.end = pos;
+        if (!open)
+        {
+            d_iq_rec.annotations.append(d_iq_rec.sql);
+            d_iq_rec.sql_open = false;
+        }
+    }
+}
+
+/**
+ * Annotate the carriers found by the signal detector in a SigMF recording.
+ * @param sigs The signals the detector reports now.
+ *
+ * A carrier is annotated from the time it was first seen to the time it was
+ * last seen, over all frequencies it occupied. It ends when the detector no
+ * longer reports it.
+ */
+void MainWindow::annotateIqCarriers(const std::vector<signal_detector::signal> &sigs)
+{
+    const quint64 pos = rx->get_iq_recording_samples();
+    const double now = QDateTime::currentMSecsSinceEpoch() / 1000.0;
+
+    // Position in the recording of a detector time stamp
+    auto sample = [&](double time) {
+        const double back = std::max(now - time, 0.0) * (double)d_iq_rec.rate;
+        return (back < (double)pos) ? pos - (quint64)back : (quint64)0;
+    };
+
+    QHash<unsigned int, iq_annotation> carriers;
+    for (const auto &sig : sigs)
+    {
+        const double lower = sig.freq - sig.bandwidth / 2.0;
+        const double upper = sig.freq + sig.bandwidth / 2.0;
+        iq_annotation a = d_iq_rec.carriers.value(sig.id, iq_annotation {
+            sample(sig.first_seen), 0, lower, upper, "carrier"
+        });
+
+        a.end = std::max(sample(sig.last_seen), a.start);
+        a.lower = std::min(a.lower, lower);
+        a.upper = std::max(a.upper, upper);
+        carriers.insert(sig.id, a);
+    }
+
+    for (auto it = d_iq_rec.carriers.cbegin(); it != d_iq_rec.carriers.cend(); ++it)
+    {
+        if (!carriers.contains(it.key()))
+            d_iq_rec.annotations.append(it.value());
+    }
+    d_iq_rec.carriers = carriers;
+}
+
+/**
+ * @brief Start I/Q recording.
+ * @param recdir The directory where to record.
+ * @param format The file format, "Raw" or "SigMF".
+ * @param sample_format The sample format, e.g. "cs16".
+ * @param split_seconds Continue in a new file after this time, 0 for no limit.
+ * @param split_mb Continue in a new file after this size, 0 for no limit.
+ */
+void MainWindow::startIqRecording(const QString& recdir, const QString& format,
+                                  const QString& sample_format, int split_seconds,
+                                  int split_mb)
 {
     qDebug() << __func__;
-    // generate file name using date, time, rf freq in kHz and BW in Hz
+    // generate file name using date, time, rf freq in kHz, BW in Hz and
+    // sample format
     // gqrx_iq_yyyymmdd_hhmmss_freq_bw_fc.raw
-    auto freq = qRound64(rx->get_rf_freq());
     auto sr = qRound64(rx->get_input_rate());
     auto dec = (quint32)(rx->get_input_decim());
-    auto currentDate = QDateTime::currentDateTimeUtc();
-    auto filenameTemplate = currentDate.toString("%1/gqrx_yyyyMMdd_hhmmss_%2_%3_fc.%4").arg(recdir).arg(freq).arg(sr/dec);
-    bool sigmf = (format == "SigMF");
-    auto lastRec = filenameTemplate.arg(sigmf ? "sigmf-data" : "raw");
-
-    QFile metaFile(filenameTemplate.arg("sigmf-meta"));
-    bool ok = true;
-    if (sigmf) {
-        auto meta = QJsonDocument { QJsonObject {
-            {"global", QJsonObject {
-#if Q_BYTE_ORDER == Q_BIG_ENDIAN
-                {"core:datatype", "cf32_be"},
-#else
-                {"core:datatype", "cf32_le"},
-#endif
-                {"core:sample_rate", sr/dec},
-                {"core:version", "1.0.0"},
-                {"core:recorder", "Gqrx " VERSION},
-                {"core:hw", QString("OsmoSDR: ") + m_settings->value("input/device", "").toString()},
-            }}, {"captures", QJsonArray {
-                QJsonObject {
-                    {"core:sample_start", 0},
-                    {"core:frequency", freq},
-                    {"core:datetime", currentDate.toString(Qt::ISODateWithMs)},
-                },
-            }}, {"annotations", QJsonArray {}},
-        }}.toJson();
-
-        if (!metaFile.open(QIODevice::WriteOnly) || metaFile.write(meta) != meta.size()) {
-            ok = false;
-        }
-    }
+    d_iq_rec.dir = recdir;
+    d_iq_rec.freq = qRound64(rx->get_rf_freq());
+    d_iq_rec.rate = sr / dec;
+    d_iq_rec.fmt = iq_format_from_name(sample_format.toStdString());
+    d_iq_rec.tag = (d_iq_rec.fmt == IQ_FORMAT_CF32) ? QString("fc") : sample_format;
+    d_iq_rec.sigmf = (format == "SigMF");
+    d_iq_rec.start = QDateTime::currentDateTimeUtc();
+    d_iq_rec.segment_samples = 0;
+    d_iq_rec.segment = 0;
+    d_iq_rec.annotations.clear();
+    d_iq_rec.sql_open = false;
+    d_iq_rec.carriers.clear();
+    // Direct I/O helps some fast disks, but is slower on others
+    bool direct_io = m_settings->value("baseband/rec_direct_io", false).toBool();
+    auto lastRec = iqRecordingName(d_iq_rec, 0, d_iq_rec.sigmf ? "sigmf-data" : "raw");
+
+    // Split at whichever limit comes first, but not within a second since
+    // file names only have a resolution of one second
+    const quint64 sample_size = iq_format_item_size(d_iq_rec.fmt);
+    quint64 segment_bytes = 0;
+    if (split_seconds > 0)
+        segment_bytes = (quint64)split_seconds * d_iq_rec.rate * sample_size;
+    if (split_mb > 0 && (segment_bytes == 0 || (quint64)split_mb * 1000000 < segment_bytes))
+        segment_bytes = (quint64)split_mb * 1000000;
+    if (segment_bytes > 0)
+        segment_bytes = std::max(segment_bytes, (quint64)d_iq_rec.rate * sample_size);
+
+    std::function<std::string(uint64_t)> segment_name;
+    if (segment_bytes > 0)
+    {
+        // Called on the writer thread, so it works on a copy
+        const iq_recording rec = d_iq_rec;
+        segment_name = [rec](uint64_t first_sample) {
+            return iqRecordingName(rec, first_sample, rec.sigmf ? "sigmf-data" : "raw").toStdString();
+        };
+    }
+
+    bool ok = !d_iq_rec.sigmf || writeIqRecordingMeta(0);
 
     // start recorder; fails if recording already in progress
-    if (!ok || rx->start_iq_recording(lastRec.toStdString()))
+    if (!ok || rx->start_iq_recording(lastRec.toStdString(), d_iq_rec.fmt, direct_io,
+                                      segment_bytes, segment_name))
     {
-        // remove metadata file if we managed to open it
-        if (sigmf && metaFile.isOpen())
-            metaFile.remove();
+        // remove metadata file if we managed to write it
+        if (d_iq_rec.sigmf)
+            QFile::remove(iqRecordingName(d_iq_rec, 0, "sigmf-meta"));
 
         // reset action status
         ui->statusBar->showMessage(tr("Error starting I/Q recoder"));
@@ -1699,23 +2334,58 @@ void MainWindow::startIqRecording(const QString& recdir, const QString& format)
     }
     else
     {
+        d_iq_rec.segment_samples = rx->get_iq_recording_segment_samples();
         ui->statusBar->showMessage(tr("Recording I/Q data to: %1").arg(lastRec),
                                    5000);
     }
 }
 
-/** Stop current I/Q recording. */
+/**
+ * Stop current I/Q recording.
+ *
+ * The buffered samples are written in the background, the recording is
+ * finished by finishIqRecording() when they have been written.
+ */
 void MainWindow::stopIqRecording()
 {
     qDebug() << __func__;
 
     if (rx->stop_iq_recording())
+    {
         ui->statusBar->showMessage(tr("Error stopping I/Q recoder"));
+        iq_tool->finishRecording();
+        return;
+    }
+
+    ui->statusBar->showMessage(tr("Writing buffered I/Q data"));
+    finishIqRecording();
+}
+
+/** Finish a stopped I/Q recording once its buffer has been written. */
+void MainWindow::finishIqRecording()
+{
+    auto dropped = rx->get_iq_recording_dropped();
+    if (rx->is_writing_iq())
+    {
+        // Check again later, this does not depend on the DSP running
+        iq_tool->setRecordingStats(rx->get_iq_recording_fill(), dropped);
+        updateIqRecordingMeta();
+        QTimer::singleShot(100, this, SLOT(finishIqRecording()));
+        return;
+    }
+
+    finishIqRecordingMeta();
+    iq_tool->finishRecording();
+
+    if (dropped > 0)
+        ui->statusBar->showMessage(tr("I/Q data recoding stopped, %1 samples dropped")
+                                   .arg(dropped));
     else
         ui->statusBar->showMessage(tr("I/Q data recoding stopped"), 5000);
 }
 
-void MainWindow::startIqPlayback(const QString& filename, float samprate, qint64 center_freq)
+void MainWindow::startIqPlayback(const QString& filename, float samprate, qint64 center_freq,
+                                 const QString& sample_format)
 {
     if (ui->actionDSP->isChecked())
     {
@@ -1728,13 +2398,15 @@ void MainWindow::startIqPlayback(const QString& filename, float samprate, qint64
     auto sri = (int)samprate;
     auto cf  = center_freq;
     double current_offset = rx->get_filter_offset();
-    QString escapedFilename = receiver::escape_filename(filename.toStdString()).c_str();
-    auto devstr = QString("file=%1,rate=%2,freq=%3,throttle=true,repeat=false")
-            .arg(escapedFilename).arg(sri).arg(cf);
-
-    qDebug() << __func__ << ":" << devstr;
-
-    rx->set_input_device(devstr.toStdString());
+    auto fmt = iq_format_from_name(sample_format.toStdString());
+    qDebug() << __func__ << ":" << filename << sample_format;
+    if (rx->set_input_file(filename.toStdString(), fmt, sri, cf) != receiver::STATUS_OK)
+    {
+        ui->statusBar->showMessage(tr("Error opening %1").arg(filename));
+        iq_tool->cancelPlayback();
+        on_actionDSP_triggered(true);
+        return;
+    }
     updateHWFrequencyRange(false);
 
     // sample rate
@@ -1813,13 +2485,114 @@ void MainWindow::stopIqPlayback()
 
 /**
  * Go to a specific offset in the IQ file.
- * @param seek_pos The byte offset from the beginning of the file.
+ * @param seek_pos The sample number from the beginning of the file.
  */
 void MainWindow::seekIqFile(qint64 seek_pos)
 {
     rx->seek_iq_file((long)seek_pos);
 }
 
+/**
+ * Set the I/Q playback speed.
+ * @param speed Speed relative to real time, 0 for as fast as possible.
+ */
+void MainWindow::setIqPlaybackSpeed(double speed)
+{
+    rx->set_iq_file_speed(speed);
+}
+
+/**
+ * Loop a region of the I/Q file.
+ * @param start First sample of the region.
+ * @param end Sample after the region, equal to start to stop looping.
+ */
+void MainWindow::setIqPlaybackLoop(qint64 start, qint64 end)
+{
+    rx->set_iq_file_loop((uint64_t)start, (uint64_t)end);
+}
+
+/**
+ * Set the length of the I/Q history.
+ * @param seconds Length of the history, 0 to disable it.
+ * @param sample_format Sample format used for the history.
+ */
+void MainWindow::setIqHistory(int seconds, const QString& sample_format)
+{
+    d_history_format = iq_format_from_name(sample_format.toStdString());
+    rx->set_iq_history(seconds, d_history_format);
+
+    if (seconds > 0)
+    {
+        double mb = seconds * rx->get_input_rate() / rx->get_input_decim()
+                  * iq_format_item_size(d_history_format) / 1.0e6;
+        ui->statusBar->showMessage(tr("I/Q history of %1 s uses %2 MB")
+                                   .arg(seconds).arg(qRound(mb)), 5000);
+    }
+}
+
+/**
+ * Save the I/Q history and the data that follows to a SigMF recording.
+ * @param recdir The directory of the recording.
+ *
+ * The capture starts with the oldest sample in the history, the trigger
+ * is marked by an annotation.
+ */
+void MainWindow::startIqHistorySave(const QString& recdir)
+{
+    auto freq = qRound64(rx->get_rf_freq());
+    auto sr = qRound64(rx->get_input_rate()) / (quint32)(rx->get_input_decim());
+    auto tag = (d_history_format == IQ_FORMAT_CF32) ? QString("fc")
+             : QString::fromStdString(iq_format_name(d_history_format));
+    auto trigger = QDateTime::currentDateTimeUtc();
+    auto filenameTemplate = trigger.toString("%1/gqrx_yyyyMMdd_hhmmss_%2_%3_%4.%5")
+            .arg(recdir).arg(freq).arg(sr).arg(tag);
+    auto dataName = filenameTemplate.arg("sigmf-data");
+
+    uint64_t pre = 0;
+    if (rx->start_iq_history_save(dataName.toStdString(), 0.0, pre))
+    {
+        ui->statusBar->showMessage(tr("Error saving I/Q history"));
+        iq_tool->cancelHistorySave();
+        return;
+    }
+
+    d_history_save.meta = filenameTemplate.arg("sigmf-meta");
+    d_history_save.fmt = d_history_format;
+    d_history_save.rate = sr;
+    d_history_save.freq = freq;
+    d_history_save.start = trigger.addMSecs(-qRound64(pre * 1000.0 / sr));
+    d_history_save.pre = pre;
+
+    if (!writeIqHistoryMeta(0, 0))
+        ui->statusBar->showMessage(tr("Error writing %1").arg(d_history_save.meta));
+    else
+        ui->statusBar->showMessage(tr("Saving I/Q history to: %1").arg(dataName), 5000);
+
+    d_saving_history = true;
+    remote->setIqHistoryStatus(true);
+}
+
+void MainWindow::stopIqHistorySave()
+{
+    d_saving_history = false;
+    remote->setIqHistoryStatus(false);
+
+    if (rx->stop_iq_history_save())
+        return;
+
+    // No samples are dropped once the end of the file is set
+    auto dropped = rx->get_iq_history_dropped();
+    if (dropped > 0)
+    {
+        if (!writeIqHistoryMeta(dropped, rx->get_iq_history_gap()))
+            ui->statusBar->showMessage(tr("Error writing %1").arg(d_history_save.meta));
+        else
+            ui->statusBar->showMessage(tr("I/Q history saved, %1 samples dropped").arg(dropped));
+    }
+    else
+        ui->statusBar->showMessage(tr("I/Q history saved"), 5000);
+}
+
 /** FFT size has changed. */
 void MainWindow::setIqFftSize(int size)
 {
@@ -1827,6 +2600,150 @@ void MainWindow::setIqFftSize(int size)
     d_iqFftData.resize(size);
     d_iqFftData.shrink_to_fit();
     rx->set_iq_fft_size(size);
+    preplanIqFft(size, uiDockFft->fftThreads(), d_fft_threads_pending);
+}
+
+/**
+ * Plan the FFT sizes next to the current one in the background, so that
+ * stepping the FFT size up or down is fast. The current size is planned too
+ * when requested, e.g. for another number of threads.
+ */
+void MainWindow::preplanIqFft(int size, int nthreads, bool current)
+{
+    QList<int> sizes = uiDockFft->fftSizes();
+    int idx = sizes.indexOf(size);
+    std::vector<unsigned int> fft_sizes;
+
+    if (current)
+        fft_sizes.push_back((unsigned int)size);
+    if (idx > 0)
+        fft_sizes.push_back((unsigned int)sizes[idx - 1]);
+    if (idx >= 0 && idx + 1 < sizes.size())
+        fft_sizes.push_back((unsigned int)sizes[idx + 1]);
+
+    fft_plan_cache::Get().preplan(fft_sizes, nthreads);
+}
+
+/** Enable or disable spectrum reduction in the DSP. */
+void MainWindow::setIqFftReduce(bool enable)
+{
+    d_fftReduce = enable;
+}
+
+/** Enable or disable the adaptive FFT rate. */
+void MainWindow::setIqFftAdaptiveRate(bool enable)
+{
+    d_adaptive_rate = enable;
+
+    // Back to the selected rate
+    if (!enable && d_fps > 0 && d_adaptive_fps != (int)d_fps)
+        setAdaptiveFftRate((int)d_fps);
+}
+
+/** Start or stop recording the waterfall. */
+void MainWindow::setWaterfallRecording(bool enable, const QString &dir, bool colors)
+{
+    ui->plotter->setWaterfallRecorder(nullptr);
+    wf_recorder->stop();
+
+    if (!enable)
+        return;
+
+    if (!wf_recorder->start(dir, colors))
+    {
+        uiDockFft->setWfRecording(false);
+        QMessageBox::warning(this, tr("Waterfall recording"),
+                             tr("Can not record the waterfall in %1").arg(dir));
+        return;
+    }
+    ui->plotter->setWaterfallRecorder(wf_recorder);
+}
+
+/** Number of threads for large baseband FFTs has changed. */
+void MainWindow::setIqFftThreads(int nthreads)
+{
+    qDebug() << "Using" << nthreads << "threads for large baseband FFTs";
+
+    // The plan for the new number of threads is made in the background and
+    // the FFT is switched once it is ready
+    d_fft_threads_pending = true;
+    preplanIqFft(d_iqFftData.size(), nthreads, true);
+    applyIqFftThreads();
+}
+
+/** Switch the baseband FFT to the selected number of threads once planned. */
+void MainWindow::applyIqFftThreads()
+{
+    unsigned int size = d_iqFftData.size();
+    int nthreads = uiDockFft->fftThreads();
+
+    if (!d_fft_threads_pending)
+        return;
+
+    if (size >= FFT_THREADS_MIN_SIZE && !fft_plan_cache::Get().has_plan(size, nthreads))
+    {
+        QTimer::singleShot(100, this, SLOT(applyIqFftThreads()));
+        return;
+    }
+
+    d_fft_threads_pending = false;
+    rx->set_iq_fft_threads(nthreads);
+}
+
+/**
+ * @brief Start or stop the wideband sweep.
+ *
+ * While sweeping the plotter and waterfall show the stitched spectrum of the
+ * whole sweep range instead of the baseband spectrum.
+ */
+void MainWindow::setSweep(bool enable)
+{
+    if (enable)
+    {
+        double start = (double)(uiDockSweep->startFreq() - d_lnb_lo);
+        double stop = (double)(uiDockSweep->stopFreq() - d_lnb_lo);
+
+        if (rx->start_sweep(start, stop, uiDockSweep->fftSize(), uiDockSweep->averages(),
+                            uiDockSweep->settleTime(), uiDockSweep->trim()) != receiver::STATUS_OK)
+        {
+            uiDockSweep->setSweepRunning(false);
+            ui->statusBar->showMessage(tr("Invalid sweep range"), 5000);
+            return;
+        }
+
+        rx->get_sweep_range(&start, &stop);
+        const double span = stop - start;
+        if (span >= (double)INT_MAX)
+        {
+            rx->stop_sweep();
+            uiDockSweep->setSweepRunning(false);
+            ui->statusBar->showMessage(tr("Sweep range is too wide"), 5000);
+            return;
+        }
+
+        qDebug() << "Sweeping" << start + d_lnb_lo << "to" << stop + d_lnb_lo << "Hz";
+
+        d_sweeping = true;
+        d_sweepGeneration = 0;
+        d_sweepNpts = -1;
+        ui->plotter->setSampleRate(span);
+        ui->plotter->setSpanFreq((quint32)span);
+        ui->plotter->setFftCenterFreq(0);
+        ui->plotter->setCenterFreq(d_lnb_lo + (qint64)((start + stop) / 2.0));
+        ui->plotter->clearWaterfall();
+    }
+    else if (d_sweeping)
+    {
+        rx->stop_sweep();
+        d_sweeping = false;
+
+        const double rate = rx->get_input_rate() / (double)rx->get_input_decim();
+        ui->plotter->setSampleRate(rate);
+        ui->plotter->setSpanFreq((quint32)rate);
+        ui->plotter->setFftCenterFreq(0);
+        ui->plotter->setCenterFreq(d_lnb_lo + d_hw_freq);
+        ui->plotter->clearWaterfall();
+    }
 }
 
 /** Baseband FFT rate has changed. */
@@ -1835,6 +2752,9 @@ void MainWindow::setIqFftRate(int fps)
     int interval;
 
     d_fps = fps;
+    d_adaptive_fps = fps;
+    d_adaptive_ms = QDateTime::currentMSecsSinceEpoch();
+    uiDockFft->setEffectiveFrameRate(fps);
 
     if (fps == 0)
     {
@@ -1953,6 +2873,10 @@ void MainWindow::on_actionDSP_triggered(bool checked)
         {
             iq_fft_timer->start(1000/uiDockFft->fftRate());
             ui->plotter->setRunningState(true);
+
+            // Start over from the selected rate
+            if (d_adaptive_fps != (int)d_fps)
+                setAdaptiveFftRate((int)d_fps);
         }
         else
         {
@@ -2272,6 +3196,41 @@ void MainWindow::setRdsDecoder(bool checked)
     remote->setRDSstatus(checked);
 }
 
+void MainWindow::setDetector(bool enabled)
+{
+    rx->set_detector_enabled(enabled);
+    remote->setDetectorStatus(enabled);
+
+    if (enabled)
+    {
+        det_timer->start(500);
+    }
+    else
+    {
+        det_timer->stop();
+        uiDockSignals->setSignals(std::vector<signal_detector::signal>());
+
+        // Carriers in an I/Q recording end here
+        if (rx->is_recording_iq() && d_iq_rec.sigmf)
+            annotateIqCarriers(std::vector<signal_detector::signal>());
+    }
+}
+
+void MainWindow::setDetectorThreshold(float snr_db)
+{
+    rx->set_detector_threshold(snr_db);
+}
+
+void MainWindow::setDetectorHysteresis(float db)
+{
+    rx->set_detector_hysteresis(db);
+}
+
+void MainWindow::setDetectorHoldTime(double seconds)
+{
+    rx->set_detector_hold_time(seconds);
+}
+
 void MainWindow::onBookmarkActivated(qint64 freq, const QString& demod, int bandwidth)
 {
     setNewFrequency(freq);
@@ -2535,7 +3494,7 @@ void MainWindow::on_actionAddBookmark_triggered()
 
 void MainWindow::updateClusterSpots()
 {
-    ui->plotter->updateOverlay();
+    ui->plotter->updateTags();
 }
 
 void MainWindow::frequencyFocusShortcut()
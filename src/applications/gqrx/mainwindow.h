@@ -24,11 +24,15 @@
 #define MAINWINDOW_H
 
 #include <QColor>
+#include <QDateTime>
+#include <QHash>
+#include <QJsonArray>
 #include <QMainWindow>
 #include <QPointer>
 #include <QSettings>
 #include <QString>
 #include <QTimer>
+#include <QVector>
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QSvgWidget>
@@ -39,8 +43,11 @@
 #include "qtgui/dockfft.h"
 #include "qtgui/dockbookmarks.h"
 #include "qtgui/dockrds.h"
+#include "qtgui/docksignals.h"
+#include "qtgui/docksweep.h"
 #include "qtgui/afsk1200win.h"
 #include "qtgui/iq_tool.h"
+#include "qtgui/waterfall_recorder.h"
 #include "qtgui/dxc_options.h"
 
 #include "applications/gqrx/recentconfig.h"
@@ -89,6 +96,15 @@ private:
 
     enum receiver::filter_shape d_filter_shape;
     std::vector<float> d_iqFftData;
+    std::vector<float> d_iqFftMax;   /*!< Max per pixel when reduced in the DSP. */
+    std::vector<float> d_iqFftAvg;   /*!< Average per pixel when reduced in the DSP. */
+    bool            d_fftReduce;     /*!< Reduce spectrum to screen resolution in the DSP. */
+    std::vector<float> d_sweepData;  /*!< Stitched spectrum of the sweep range. */
+    unsigned int    d_sweepGeneration; /*!< Generation of the sweep spectrum shown, 0 if none. */
+    int             d_sweepNpts;     /*!< Points of the reduced sweep spectrum, 0 if not reduced. */
+    double          d_sweepStartBin; /*!< First bin of the reduced sweep spectrum. */
+    double          d_sweepBinsPerPoint;
+    bool            d_sweeping;      /*!< Plotter shows the sweep range. */
     float           d_fftAvg;      /*!< FFT averaging parameter set by user (not the true gain). */
     float           d_fps;
     int             d_fftWindowType;
@@ -104,8 +120,11 @@ private:
     DockFft        *uiDockFft;
     DockBookmarks  *uiDockBookmarks;
     DockRDS        *uiDockRDS;
+    DockSignals    *uiDockSignals;
+    DockSweep      *uiDockSweep;
 
     CIqTool        *iq_tool;
+    CWaterfallRecorder *wf_recorder;
     DXCOptions     *dxc_options;
 
 
@@ -118,9 +137,57 @@ private:
     QTimer   *iq_fft_timer;
     QTimer   *audio_fft_timer;
     QTimer   *rds_timer;
+    QTimer   *det_timer;
     quint64  d_last_fft_ms;
     float    d_avg_fft_rate;
     bool     d_frame_drop;
+    bool     d_adaptive_rate;   /*!< Lower the FFT rate when frames take too long. */
+    int      d_adaptive_fps;    /*!< FFT rate in use, at most d_fps. */
+    float    d_fft_cost;        /*!< Average time spent in iqFftTimeout(), ms. */
+    quint64  d_adaptive_ms;     /*!< Time of the last FFT rate change. */
+    bool     d_plotter_hidden;  /*!< Plotter could not be seen at the last FFT timeout. */
+    quint64  d_hidden_wf_ms;    /*!< Time of the last waterfall frame while hidden. */
+    iq_format d_history_format; /*!< Sample format of the I/Q history. */
+    bool     d_fft_threads_pending; /*!< Waiting for the plan before changing FFT threads. */
+
+    /*! \brief Activity seen during an I/Q recording. */
+    struct iq_annotation {
+        quint64     start;            /*!< First sample in the whole recording. */
+        quint64     end;              /*!< Sample after the last one. */
+        double      lower;            /*!< Lower frequency edge in Hz. */
+        double      upper;            /*!< Upper frequency edge in Hz. */
+        QString     label;
+    };
+
+    /*! \brief An I/Q recording, possibly split into several files. */
+    struct iq_recording {
+        QString     dir;
+        QString     tag;              /*!< Sample format in file names. */
+        bool        sigmf;
+        iq_format   fmt;
+        qint64      rate;
+        qint64      freq;
+        QDateTime   start;            /*!< Time of the first sample. */
+        quint64     segment_samples;  /*!< Samples per file, 0 for one file. */
+        quint64     segment;          /*!< Last file with a meta file. */
+        QVector<iq_annotation> annotations;  /*!< Finished annotations. */
+        bool        sql_open;         /*!< The squelch annotation is open. */
+        iq_annotation sql;
+        QHash<unsigned int, iq_annotation> carriers;  /*!< Open carriers by detector ID. */
+    };
+    iq_recording d_iq_rec;
+    bool     d_saving_history;  /*!< The I/Q history is being saved. */
+
+    /*! \brief The I/Q history being saved, for its SigMF meta file. */
+    struct iq_history_save {
+        QString     meta;             /*!< Name of the meta file. */
+        iq_format   fmt;
+        qint64      rate;
+        qint64      freq;
+        QDateTime   start;            /*!< Time of the first sample. */
+        quint64     pre;              /*!< Samples from the history. */
+    };
+    iq_history_save d_history_save;
 
     receiver *rx;
 
@@ -138,8 +205,22 @@ private:
     void updateFrequencyRange();
     void updateDeltaAndCenter();
     void updateGainStages(bool read_from_device);
+    void adaptIqFftRate(quint64 now_ms, float cost_ms);
+    void setAdaptiveFftRate(int fps);
+    void preplanIqFft(int size, int nthreads, bool current = false);
     void showSimpleTextFile(const QString &resource_path,
                             const QString &window_title);
+    QByteArray sigmfMeta(iq_format fmt, qint64 sample_rate, qint64 freq,
+                         const QDateTime &start, const QJsonArray &annotations,
+                         qint64 global_index = -1);
+    static QString iqRecordingName(const iq_recording &rec, quint64 first_sample,
+                                   const QString &ext);
+    bool writeIqHistoryMeta(quint64 dropped, quint64 gap);
+    bool writeIqRecordingMeta(quint64 segment);
+    void updateIqRecordingMeta();
+    void finishIqRecordingMeta();
+    void annotateIqSquelch(bool open);
+    void annotateIqCarriers(const std::vector<signal_detector::signal> &sigs);
     /* key shortcuts */
     void frequencyFocusShortcut();
     void rxOffsetZeroShortcut();
@@ -186,7 +267,9 @@ private slots:
     void setPassband(int bandwidth);
 
     /* audio recording and playback */
-    void startAudioRec(const QString& filename);
+    void startAudioRec(const QString& filename, int split_seconds);
+    void startSqlAudioRec(const QString& dir, double preroll, double hang,
+                          const QString& format);
     void stopAudioRec();
     void startAudioPlayback(const QString& filename);
     void stopAudioPlayback();
@@ -195,16 +278,30 @@ private slots:
     void stopAudioStreaming();
 
     /* I/Q playback and recording*/
-    void startIqRecording(const QString& recdir, const QString& format);
+    void startIqRecording(const QString& recdir, const QString& format,
+                          const QString& sample_format, int split_seconds, int split_mb);
     void stopIqRecording();
-    void startIqPlayback(const QString& filename, float samprate, qint64 center_freq);
+    void finishIqRecording();
+    void startIqPlayback(const QString& filename, float samprate, qint64 center_freq,
+                         const QString& sample_format);
     void stopIqPlayback();
     void seekIqFile(qint64 seek_pos);
+    void setIqPlaybackSpeed(double speed);
+    void setIqPlaybackLoop(qint64 start, qint64 end);
+    void setIqHistory(int seconds, const QString& sample_format);
+    void startIqHistorySave(const QString& recdir);
+    void stopIqHistorySave();
 
     /* FFT settings */
     void setIqFftSize(int size);
     void setIqFftRate(int fps);
     void setIqFftWindow(int type);
+    void setIqFftReduce(bool enable);
+    void setIqFftAdaptiveRate(bool enable);
+    void setWaterfallRecording(bool enable, const QString &dir, bool colors);
+    void setIqFftThreads(int nthreads);
+    void applyIqFftThreads();
+    void setSweep(bool enable);
     void plotScaleChanged(int type, bool perHz);
     void setIqFftSplit(int pct_wf);
     void setAudioFftRate(int fps);
@@ -220,6 +317,12 @@ private slots:
     /* RDS */
     void setRdsDecoder(bool checked);
 
+    /* Signal detector */
+    void setDetector(bool enabled);
+    void setDetectorThreshold(float snr_db);
+    void setDetectorHysteresis(float db);
+    void setDetectorHoldTime(double seconds);
+
     /* Bookmarks */
     void onBookmarkActivated(qint64 freq, const QString& demod, int bandwidth);
 
@@ -261,6 +364,7 @@ private slots:
     void iqFftTimeout();
     void audioFftTimeout();
     void rdsTimeout();
+    void detectorTimeout();
 };
 
 #endif // MAINWINDOW_H
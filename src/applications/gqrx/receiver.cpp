@@ -50,6 +50,14 @@
 #define WAV_FILE_GAIN 0.5
 #define TARGET_QUAD_RATE 1e6
 
+/* Seconds of I/Q data buffered while recording, and the limits in bytes */
+#define IQ_REC_BUFFER_SECONDS 4
+#define IQ_REC_BUFFER_MIN (16 << 20)
+#define IQ_REC_BUFFER_MAX (1024 << 20)
+
+/* Memory limit of the I/Q history */
+#define IQ_HISTORY_MAX_BYTES ((size_t)2 << 30)
+
 /**
  * @brief Public constructor.
  * @param input_device Input device specifier.
@@ -67,6 +75,8 @@ receiver::receiver(const std::string input_device,
       d_filter_offset(0.0),
       d_cw_offset(0.0),
       d_recording_iq(false),
+      d_iq_segment(0),
+      d_iq_samples(0),
       d_recording_wav(false),
       d_sniffer_active(false),
       d_iq_rev(false),
@@ -117,6 +127,15 @@ receiver::receiver(const std::string input_device,
     iq_swap = make_iq_swap_cc(false);
     dc_corr = make_dc_corr_cc(d_decim_rate, 1.0);
     iq_fft = make_rx_fft_c(DEFAULT_FFT_SIZE, d_decim_rate, gr::fft::window::WIN_HANN);
+    detector = std::make_shared<signal_detector>();
+    detector->set_center_freq(d_rf_freq);
+    iq_fft->set_detector(detector);
+    sweep = std::make_shared<sweeper>();
+    sweep->set_retune_func([this](double freq) {
+        std::lock_guard<std::mutex> lock(d_src_mutex);
+        src->set_center_freq(freq);
+    });
+    iq_fft->set_sweeper(sweep);
 
     audio_fft = make_rx_fft_f(DEFAULT_FFT_SIZE, d_audio_rate, gr::fft::window::WIN_HANN);
     audio_gain0 = gr::blocks::multiply_const_ff::make(0);
@@ -192,6 +211,8 @@ void receiver::set_input_device(const std::string device)
 
     input_devstr = device;
 
+    stop_sweep();
+
     // tb->lock() can hang occasionally
     if (d_running)
     {
@@ -199,15 +220,8 @@ void receiver::set_input_device(const std::string device)
         tb->wait();
     }
 
-    if (d_decim >= 2)
-    {
-        tb->disconnect(src, 0, input_decim, 0);
-        tb->disconnect(input_decim, 0, iq_swap, 0);
-    }
-    else
-    {
-        tb->disconnect(src, 0, iq_swap, 0);
-    }
+    disconnect_input();
+    file_src.reset();
 
 #if GNURADIO_VERSION < 0x030802
     //Work around GNU Radio bug #3184
@@ -235,15 +249,7 @@ void receiver::set_input_device(const std::string device)
     if(src->get_sample_rate() != 0)
         set_input_rate(src->get_sample_rate());
 
-    if (d_decim >= 2)
-    {
-        tb->connect(src, 0, input_decim, 0);
-        tb->connect(input_decim, 0, iq_swap, 0);
-    }
-    else
-    {
-        tb->connect(src, 0, iq_swap, 0);
-    }
+    connect_input();
 
     if (d_running)
         tb->start();
@@ -255,6 +261,55 @@ void receiver::set_input_device(const std::string device)
 }
 
 
+/**
+ * @brief Play an I/Q file from a memory mapped file source.
+ * @param filename The file to play.
+ * @param fmt The sample format of the file.
+ * @param samprate The sample rate of the file.
+ * @param center_freq The center frequency of the file.
+ *
+ * An osmosdr file source on the zero file stays the input device, so the
+ * frequency, rate and gain calls keep working while the samples come from
+ * the file.
+ */
+receiver::status receiver::set_input_file(const std::string filename, iq_format fmt,
+                                          double samprate, double center_freq)
+{
+    iq_file_source_sptr file;
+
+    try
+    {
+        file = make_iq_file_source(filename, fmt, samprate);
+    }
+    catch (std::runtime_error &e)
+    {
+        std::cout << "Error opening " << filename << ": " << e.what() << std::endl;
+        return STATUS_ERROR;
+    }
+
+    std::ostringstream devstr;
+    devstr << std::fixed << std::setprecision(0)
+           << "file=" << escape_filename(get_zero_file())
+           << ",freq=" << center_freq << ",rate=" << samprate
+           << ",repeat=true,throttle=true";
+    set_input_device(devstr.str());
+
+    if (d_running)
+    {
+        tb->stop();
+        tb->wait();
+    }
+
+    disconnect_input();
+    file_src = file;
+    connect_input();
+
+    if (d_running)
+        tb->start();
+
+    return STATUS_OK;
+}
+
 /**
  * @brief Select new audio output device.
  * @param device
@@ -311,6 +366,7 @@ void receiver::set_antenna(const std::string &antenna)
 {
     if (!antenna.empty())
     {
+        std::lock_guard<std::mutex> lock(d_src_mutex);
         src->set_antenna(antenna);
     }
 }
@@ -331,6 +387,10 @@ double receiver::set_input_rate(double rate)
             std::abs(rate - current_rate) < std::abs(std::min(rate, current_rate))
             * std::numeric_limits<double>::epsilon());
 
+    // The sweep plan depends on the sample rate, and the sweep must not
+    // retune while the rate is changed
+    stop_sweep();
+
     tb->lock();
     try
     {
@@ -363,8 +423,14 @@ double receiver::set_input_rate(double rate)
     ddc->set_decim_and_samp_rate(d_ddc_decim, d_decim_rate);
     rx->set_quad_rate(d_quad_rate);
     iq_fft->set_quad_rate(d_decim_rate);
+    if (file_src)
+        file_src->set_sample_rate(d_input_rate);
     tb->unlock();
 
+    // A new buffer is allocated outside the lock
+    if (iq_history && iq_history->sample_rate() != d_decim_rate)
+        set_iq_history(iq_history->seconds(), iq_history->format());
+
     return d_input_rate;
 }
 
@@ -380,15 +446,9 @@ unsigned int receiver::set_input_decim(unsigned int decim)
         tb->wait();
     }
 
-    if (d_decim >= 2)
-    {
-        tb->disconnect(src, 0, input_decim, 0);
-        tb->disconnect(input_decim, 0, iq_swap, 0);
-    }
-    else
-    {
-        tb->disconnect(src, 0, iq_swap, 0);
-    }
+    disconnect_input();
+
+    stop_sweep();
 
     input_decim.reset();
     d_decim = decim;
@@ -420,16 +480,10 @@ unsigned int receiver::set_input_decim(unsigned int decim)
     ddc->set_decim_and_samp_rate(d_ddc_decim, d_decim_rate);
     rx->set_quad_rate(d_quad_rate);
     iq_fft->set_quad_rate(d_decim_rate);
+    if (iq_history)
+        iq_history->set_sample_rate(d_decim_rate);
 
-    if (d_decim >= 2)
-    {
-        tb->connect(src, 0, input_decim, 0);
-        tb->connect(input_decim, 0, iq_swap, 0);
-    }
-    else
-    {
-        tb->connect(src, 0, iq_swap, 0);
-    }
+    connect_input();
 
 #ifdef CUSTOM_AIRSPY_KERNELS
     if (input_devstr.find("airspy") != std::string::npos)
@@ -449,6 +503,7 @@ unsigned int receiver::set_input_decim(unsigned int decim)
  */
 double receiver::set_analog_bandwidth(double bw)
 {
+    std::lock_guard<std::mutex> lock(d_src_mutex);
     return src->set_bandwidth(bw);
 }
 
@@ -515,6 +570,7 @@ void receiver::set_iq_balance(bool enable)
 
     d_iq_balance = enable;
 
+    std::lock_guard<std::mutex> lock(d_src_mutex);
     src->set_iq_balance_mode(enable ? 2 : 0);
 }
 
@@ -538,7 +594,15 @@ receiver::status receiver::set_rf_freq(double freq_hz)
 {
     d_rf_freq = freq_hz;
 
-    src->set_center_freq(d_rf_freq);
+    // While sweeping the new frequency is used when the sweep stops
+    if (!sweep->is_running())
+    {
+        std::lock_guard<std::mutex> lock(d_src_mutex);
+        src->set_center_freq(d_rf_freq);
+    }
+    detector->set_center_freq(d_rf_freq);
+    if (sql_wav)
+        sql_wav->set_frequency((int64_t)(d_rf_freq + d_filter_offset));
     // FIXME: read back frequency?
 
     return STATUS_OK;
@@ -551,6 +615,11 @@ receiver::status receiver::set_rf_freq(double freq_hz)
  */
 double receiver::get_rf_freq(void)
 {
+    // While sweeping the device is tuned to the sweep steps
+    if (sweep->is_running())
+        return d_rf_freq;
+
+    std::lock_guard<std::mutex> lock(d_src_mutex);
     d_rf_freq = src->get_center_freq();
 
     return d_rf_freq;
@@ -615,6 +684,7 @@ receiver::status receiver::get_gain_range(std::string &name, double *start,
 
 receiver::status receiver::set_gain(std::string name, double value)
 {
+    std::lock_guard<std::mutex> lock(d_src_mutex);
     src->set_gain(value, name);
 
     return STATUS_OK;
@@ -622,6 +692,7 @@ receiver::status receiver::set_gain(std::string name, double value)
 
 double receiver::get_gain(std::string name) const
 {
+    std::lock_guard<std::mutex> lock(d_src_mutex);
     return src->get_gain(name);
 }
 
@@ -633,6 +704,7 @@ double receiver::get_gain(std::string name) const
  */
 receiver::status receiver::set_auto_gain(bool automatic)
 {
+    std::lock_guard<std::mutex> lock(d_src_mutex);
     src->set_gain_mode(automatic);
 
     return STATUS_OK;
@@ -656,6 +728,8 @@ receiver::status receiver::set_filter_offset(double offset_hz)
 {
     d_filter_offset = offset_hz;
     ddc->set_center_freq(d_filter_offset - d_cw_offset);
+    if (sql_wav)
+        sql_wav->set_frequency((int64_t)(d_rf_freq + d_filter_offset));
 
     return STATUS_OK;
 }
@@ -716,6 +790,7 @@ receiver::status receiver::set_filter(double low, double high, filter_shape shap
 
 receiver::status receiver::set_freq_corr(double ppm)
 {
+    std::lock_guard<std::mutex> lock(d_src_mutex);
     src->set_freq_corr(ppm);
 
     return STATUS_OK;
@@ -745,6 +820,12 @@ unsigned int receiver::iq_fft_size() const
     return iq_fft->fft_size();
 }
 
+/** Set number of threads used for large baseband FFTs. */
+void receiver::set_iq_fft_threads(int nthreads)
+{
+    iq_fft->set_fft_threads(nthreads);
+}
+
 void receiver::set_iq_fft_window(int window_type, bool normalize_energy)
 {
     iq_fft->set_window_type(window_type, normalize_energy);
@@ -756,6 +837,15 @@ int receiver::get_iq_fft_data(float* fftPoints)
     return iq_fft->get_fft_data(fftPoints);
 }
 
+/** Get latest baseband FFT data reduced to npts max/avg points. */
+int receiver::get_iq_fft_data_reduced(float *maxPoints, float *avgPoints,
+                                      double start_bin, double bins_per_point,
+                                      int npts)
+{
+    return iq_fft->get_fft_data_reduced(maxPoints, avgPoints, start_bin,
+                                        bins_per_point, npts);
+}
+
 unsigned int receiver::audio_fft_size() const
 {
     return audio_fft->fft_size();
@@ -804,6 +894,12 @@ receiver::status receiver::set_sql_alpha(double alpha)
     return STATUS_OK; // FIXME
 }
 
+/** Whether the squelch lets the signal through. */
+bool receiver::is_sql_open() const
+{
+    return d_demod != RX_DEMOD_OFF && rx->is_sql_open();
+}
+
 /**
  * @brief Enable/disable receiver AGC.
  *
@@ -996,15 +1092,20 @@ receiver::status receiver::set_af_gain(float gain_db)
 
 
 /**
- * @brief Start WAV file recorder.
- * @param filename The filename where to record.
+ * @brief Start WAV or FLAC file recorder.
+ * @param filename The filename where to record, FLAC if it ends in ".flac".
+ * @param segment_seconds Continue in a new file after this time, 0 for one file up
+ *                        to the size limit of the format.
+ * @param segment_name Name of the file starting with the given audio frame.
  *
  * A new recorder object is created every time we start recording and deleted every time
  * we stop recording. The idea of creating one object and starting/stopping using different
  * file names does not work with WAV files (the initial /tmp/gqrx.wav will not be stopped
  * because the wav file can not be empty). See https://github.com/gqrx-sdr/gqrx/issues/36
  */
-receiver::status receiver::start_audio_recording(const std::string filename)
+receiver::status receiver::start_audio_recording(const std::string filename,
+                                                 double segment_seconds,
+                                                 std::function<std::string(uint64_t)> segment_name)
 {
     if (d_recording_wav)
     {
@@ -1026,15 +1127,10 @@ receiver::status receiver::start_audio_recording(const std::string filename)
 
     // if this fails, we don't want to go and crash now, do we
     try {
-#if GNURADIO_VERSION < 0x030900
-        wav_sink = gr::blocks::wavfile_sink::make(filename.c_str(), 2,
-                                                  (unsigned int) d_audio_rate,
-                                                  16);
-#else
-        wav_sink = gr::blocks::wavfile_sink::make(filename.c_str(), 2,
-                                                  (unsigned int) d_audio_rate,
-                                                  gr::blocks::FORMAT_WAV, gr::blocks::FORMAT_PCM_16);
-#endif
+        wav_sink = make_audio_file_sink(filename, (unsigned int) d_audio_rate,
+                                        audio_file_format_from_name(filename),
+                                        (uint64_t)(segment_seconds * d_audio_rate),
+                                        segment_name);
     }
     catch (std::runtime_error &e) {
         std::cout << "Error opening " << filename << ": " << e.what() << std::endl;
@@ -1054,6 +1150,53 @@ receiver::status receiver::start_audio_recording(const std::string filename)
     return STATUS_OK;
 }
 
+/**
+ * @brief Start squelch triggered audio recorder.
+ * @param dir The directory where to record.
+ * @param preroll Seconds of audio to include from before the squelch opens.
+ * @param hang Seconds the squelch must stay closed before a file is finished.
+ * @param fmt File format of the recordings.
+ *
+ * Each transmission is written to a new file named after the channel frequency and
+ * the time of its first sample. Stopped using stop_audio_recording().
+ */
+receiver::status receiver::start_sql_audio_recording(const std::string dir, double preroll,
+                                                     double hang, audio_file_format fmt)
+{
+    if (d_recording_wav)
+    {
+        /* error - we are already recording */
+        std::cout << "ERROR: Can not start audio recorder (already recording)" << std::endl;
+
+        return STATUS_ERROR;
+    }
+    if (!d_running)
+    {
+        /* receiver is not running */
+        std::cout << "Can not start audio recorder (receiver not running)" << std::endl;
+
+        return STATUS_ERROR;
+    }
+
+    wav_gain0 = gr::blocks::multiply_const_ff::make(WAV_FILE_GAIN);
+    wav_gain1 = gr::blocks::multiply_const_ff::make(WAV_FILE_GAIN);
+    sql_wav = make_sql_wav_sink(dir, (unsigned int) d_audio_rate, preroll, hang, fmt,
+                                [this]() { return is_sql_open(); });
+    sql_wav->set_frequency((int64_t)(d_rf_freq + d_filter_offset));
+
+    tb->lock();
+    tb->connect(rx, 0, wav_gain0, 0);
+    tb->connect(rx, 1, wav_gain1, 0);
+    tb->connect(wav_gain0, 0, sql_wav, 0);
+    tb->connect(wav_gain1, 0, sql_wav, 1);
+    tb->unlock();
+    d_recording_wav = true;
+
+    std::cout << "Recording transmissions to " << dir << std::endl;
+
+    return STATUS_OK;
+}
+
 /** Stop WAV file recorder. */
 receiver::status receiver::stop_audio_recording()
 {
@@ -1071,13 +1214,14 @@ receiver::status receiver::stop_audio_recording()
         return STATUS_ERROR;
     }
 
+    gr::basic_block_sptr rec_sink = audio_rec_sink();
+
     // not strictly necessary to lock but I think it is safer
     tb->lock();
-    wav_sink->close();
     tb->disconnect(rx, 0, wav_gain0, 0);
     tb->disconnect(rx, 1, wav_gain1, 0);
-    tb->disconnect(wav_gain0, 0, wav_sink, 0);
-    tb->disconnect(wav_gain1, 0, wav_sink, 1);
+    tb->disconnect(wav_gain0, 0, rec_sink, 0);
+    tb->disconnect(wav_gain1, 0, rec_sink, 1);
 
     // Temporary workaround for https://github.com/gnuradio/gnuradio/issues/5436
     tb->disconnect(ddc, 0, rx, 0);
@@ -1085,9 +1229,17 @@ receiver::status receiver::stop_audio_recording()
     // End temporary workaround
 
     tb->unlock();
+
+    // Writes the buffered audio, the blocks are no longer running
+    if (wav_sink)
+        wav_sink->close();
+    if (sql_wav)
+        sql_wav->close();
+
     wav_gain0.reset();
     wav_gain1.reset();
     wav_sink.reset();
+    sql_wav.reset();
     d_recording_wav = false;
 
     std::cout << "Audio recorder stopped" << std::endl;
@@ -1197,8 +1349,19 @@ receiver::status receiver::stop_udp_streaming()
 /**
  * @brief Start I/Q data recorder.
  * @param filename The filename where to record.
+ * @param fmt The sample format of the file.
+ * @param direct_io Bypass the page cache when writing.
+ * @param segment_bytes Continue in a new file after this many bytes, 0 for one file.
+ * @param segment_name Name of the file starting with the given sample.
+ *
+ * Samples are written by a separate thread. A few seconds of data are
+ * buffered, a disk that falls further behind causes dropped samples
+ * rather than an overflow at the source.
  */
-receiver::status receiver::start_iq_recording(const std::string filename)
+receiver::status receiver::start_iq_recording(const std::string filename,
+                                               iq_format fmt, bool direct_io,
+                                               uint64_t segment_bytes,
+                                               std::function<std::string(uint64_t)> segment_name)
 {
     receiver::status status = STATUS_OK;
 
@@ -1206,10 +1369,17 @@ receiver::status receiver::start_iq_recording(const std::string filename)
         std::cout << __func__ << ": already recording" << std::endl;
         return STATUS_ERROR;
     }
+    if (is_writing_iq()) {
+        std::cout << __func__ << ": still writing the last recording" << std::endl;
+        return STATUS_ERROR;
+    }
 
     try
     {
-        iq_sink = gr::blocks::file_sink::make(sizeof(gr_complex), filename.c_str(), true);
+        double bytes = d_decim_rate * iq_format_item_size(fmt) * IQ_REC_BUFFER_SECONDS;
+        bytes = std::min(std::max(bytes, (double)IQ_REC_BUFFER_MIN), (double)IQ_REC_BUFFER_MAX);
+        iq_sink = make_iq_file_sink(filename, fmt, (size_t)bytes, direct_io,
+                                    segment_bytes, segment_name);
     }
     catch (std::runtime_error &e)
     {
@@ -1221,8 +1391,10 @@ receiver::status receiver::start_iq_recording(const std::string filename)
     if (d_decim >= 2)
         tb->connect(input_decim, 0, iq_sink, 0);
     else
-        tb->connect(src, 0, iq_sink, 0);
+        tb->connect(input_source(), 0, iq_sink, 0);
     d_recording_iq = true;
+    d_iq_segment = 0;
+    d_iq_samples = 0;
     tb->unlock();
 
     return status;
@@ -1237,26 +1409,185 @@ receiver::status receiver::stop_iq_recording()
     }
 
     tb->lock();
-    iq_sink->close();
 
     if (d_decim >= 2)
         tb->disconnect(input_decim, 0, iq_sink, 0);
     else
-        tb->disconnect(src, 0, iq_sink, 0);
+        tb->disconnect(input_source(), 0, iq_sink, 0);
 
     tb->unlock();
-    iq_sink.reset();
+
+    // The buffered samples are written in the background, without holding
+    // up the flow graph or the caller
+    iq_sink->close();
     d_recording_iq = false;
 
     return STATUS_OK;
 }
 
+/**
+ * @brief Whether a stopped I/Q recording is still writing buffered samples.
+ *
+ * The recorder is released once it has closed its files.
+ */
+bool receiver::is_writing_iq(void)
+{
+    if (d_recording_iq || !iq_sink)
+        return false;
+
+    if (!iq_sink->finished())
+        return true;
+
+    d_iq_segment = iq_sink->segment();
+    d_iq_samples = iq_sink->samples();
+    iq_sink.reset();
+
+    return false;
+}
+
+/** Fill level of the I/Q recording buffer, 0 to 1. */
+float receiver::get_iq_recording_fill(void) const
+{
+    return iq_sink ? iq_sink->fill_level() : 0.0f;
+}
+
+/** Number of samples dropped since the I/Q recording started. */
+uint64_t receiver::get_iq_recording_dropped(void) const
+{
+    return iq_sink ? iq_sink->dropped() : 0;
+}
+
+/**
+ * @brief Segment of a split I/Q recording being written.
+ *
+ * After the recording has finished this is the last segment it wrote.
+ */
+uint64_t receiver::get_iq_recording_segment(void) const
+{
+    return iq_sink ? iq_sink->segment() : d_iq_segment;
+}
+
+/**
+ * @brief Samples written to the I/Q recording so far.
+ *
+ * Dropped samples are not counted, so this is the position in the
+ * recording of the next sample. After the recording has stopped this
+ * is the length of the recording.
+ */
+uint64_t receiver::get_iq_recording_samples(void) const
+{
+    return iq_sink ? iq_sink->samples() : d_iq_samples;
+}
+
+/** Samples in each file of a split I/Q recording, 0 if it is not split. */
+uint64_t receiver::get_iq_recording_segment_samples(void) const
+{
+    return iq_sink ? iq_sink->segment_samples() : 0;
+}
+
+/**
+ * @brief Keep a history of I/Q data that can be saved later.
+ * @param seconds Length of the history, 0 to disable it.
+ * @param fmt Sample format used for the history.
+ *
+ * The history taps the same point as the I/Q recorder. Any previous
+ * history is cleared, and one being saved is completed first.
+ *
+ * The flow graph is only locked to connect and disconnect the history.
+ * Allocating a new buffer and completing a save take a while, the source
+ * would overflow if the flow graph was stopped for them.
+ */
+void receiver::set_iq_history(double seconds, iq_format fmt)
+{
+    if (iq_history)
+    {
+        tb->lock();
+        tb->disconnect(iq_tap(), 0, iq_history, 0);
+        tb->unlock();
+
+        // Released before a new one is allocated, they can be large
+        iq_history.reset();
+    }
+
+    if (seconds > 0.0)
+    {
+        auto history = make_iq_history_sink(fmt, seconds, d_decim_rate, IQ_HISTORY_MAX_BYTES);
+
+        tb->lock();
+        tb->connect(iq_tap(), 0, history, 0);
+        tb->unlock();
+
+        iq_history = history;
+    }
+}
+
+/**
+ * @brief Save the I/Q history and the data that follows to a file.
+ * @param filename The file to write.
+ * @param post_seconds Seconds to save after the history, 0 to save until
+ *                     stop_iq_history_save() is called.
+ * @param pre_samples Filled in with the number of samples from the history.
+ */
+receiver::status receiver::start_iq_history_save(const std::string filename,
+                                                  double post_seconds,
+                                                  uint64_t &pre_samples)
+{
+    if (!iq_history)
+        return STATUS_ERROR;
+
+    // The history must not move while it is handed over to the writer
+    tb->lock();
+    bool ok = iq_history->save(filename, (uint64_t)(post_seconds * d_decim_rate),
+                               &pre_samples);
+    tb->unlock();
+
+    return ok ? STATUS_OK : STATUS_ERROR;
+}
+
+/** Stop saving the I/Q history, the file is completed in the background. */
+receiver::status receiver::stop_iq_history_save()
+{
+    if (!iq_history || !iq_history->is_saving())
+        return STATUS_ERROR;
+
+    iq_history->stop_save();
+    return STATUS_OK;
+}
+
+bool receiver::is_saving_iq_history(void) const
+{
+    return iq_history && iq_history->is_saving();
+}
+
+/** Seconds of data in the I/Q history. */
+double receiver::get_iq_history_length(void) const
+{
+    return iq_history ? iq_history->length() : 0.0;
+}
+
+/** Samples dropped while saving the I/Q history. */
+uint64_t receiver::get_iq_history_dropped(void) const
+{
+    return iq_history ? iq_history->dropped() : 0;
+}
+
+/** Sample in the I/Q history file after the first drop, UINT64_MAX if none. */
+uint64_t receiver::get_iq_history_gap(void) const
+{
+    return iq_history ? iq_history->gap() : UINT64_MAX;
+}
+
 /**
  * @brief Seek to position in IQ file source.
- * @param pos Byte offset from the beginning of the file.
+ * @param pos Sample number from the beginning of the file.
+ *
+ * The memory mapped file source seeks without locking the flow graph.
  */
 receiver::status receiver::seek_iq_file(long pos)
 {
+    if (file_src)
+        return file_src->seek((uint64_t)pos) ? STATUS_OK : STATUS_ERROR;
+
     receiver::status status = STATUS_OK;
 
     tb->lock();
@@ -1275,6 +1606,39 @@ receiver::status receiver::seek_iq_file(long pos)
     return status;
 }
 
+/**
+ * @brief Set the I/Q file playback speed.
+ * @param speed Speed relative to real time, 0 for as fast as possible.
+ */
+void receiver::set_iq_file_speed(double speed)
+{
+    if (file_src)
+        file_src->set_speed(speed);
+}
+
+/**
+ * @brief Loop a region of the I/Q file being played.
+ * @param start First sample of the region.
+ * @param end Sample after the region, equal to start to stop looping.
+ */
+void receiver::set_iq_file_loop(uint64_t start, uint64_t end)
+{
+    if (file_src)
+        file_src->set_loop(start, end);
+}
+
+/** @brief The sample being played from the I/Q file, -1 if none. */
+int64_t receiver::get_iq_file_position(void) const
+{
+    return file_src ? (int64_t)file_src->position() : -1;
+}
+
+/** @brief Whether the I/Q file has been played to the end. */
+bool receiver::is_iq_file_at_end(void) const
+{
+    return file_src && file_src->at_end();
+}
+
 /**
  * @brief Start data sniffer.
  * @param buffsize The buffer that should be used in the sniffer.
@@ -1332,13 +1696,63 @@ void receiver::get_sniffer_data(float * outbuff, unsigned int &num)
     sniffer->get_samples(outbuff, num);
 }
 
+/** The block producing the input samples, the file during file playback. */
+gr::basic_block_sptr receiver::input_source() const
+{
+    if (file_src)
+        return file_src;
+    return src;
+}
+
+/** The point where I/Q is recorded, after the input decimator. */
+gr::basic_block_sptr receiver::iq_tap() const
+{
+    if (d_decim >= 2)
+        return input_decim;
+    return input_source();
+}
+
+/** The sink of the current audio recording. */
+gr::basic_block_sptr receiver::audio_rec_sink() const
+{
+    if (sql_wav)
+        return sql_wav;
+    return wav_sink;
+}
+
+/** Disconnect the input source and decimator, and the I/Q recorders. */
+void receiver::disconnect_input()
+{
+    if (d_decim >= 2)
+        tb->disconnect(input_source(), 0, input_decim, 0);
+    tb->disconnect(iq_tap(), 0, iq_swap, 0);
+
+    if (d_recording_iq)
+        tb->disconnect(iq_tap(), 0, iq_sink, 0);
+    if (iq_history)
+        tb->disconnect(iq_tap(), 0, iq_history, 0);
+}
+
+/** Connect the input source and decimator, and the I/Q recorders. */
+void receiver::connect_input()
+{
+    if (d_decim >= 2)
+        tb->connect(input_source(), 0, input_decim, 0);
+    tb->connect(iq_tap(), 0, iq_swap, 0);
+
+    if (d_recording_iq)
+        tb->connect(iq_tap(), 0, iq_sink, 0);
+    if (iq_history)
+        tb->connect(iq_tap(), 0, iq_history, 0);
+}
+
 /** Convenience function to connect all blocks. */
 void receiver::connect_all(rx_chain type)
 {
     gr::basic_block_sptr b;
 
     // Setup source
-    b = src;
+    b = input_source();
 
     // Pre-processing
     if (d_decim >= 2)
@@ -1353,6 +1767,9 @@ void receiver::connect_all(rx_chain type)
         tb->connect(b, 0, iq_sink, 0);
     }
 
+    if (iq_history)
+        tb->connect(b, 0, iq_history, 0);
+
     tb->connect(b, 0, iq_swap, 0);
     b = iq_swap;
 
@@ -1407,8 +1824,8 @@ void receiver::connect_all(rx_chain type)
     {
         tb->connect(rx, 0, wav_gain0, 0);
         tb->connect(rx, 1, wav_gain1, 0);
-        tb->connect(wav_gain0, 0, wav_sink, 0);
-        tb->connect(wav_gain1, 0, wav_sink, 1);
+        tb->connect(wav_gain0, 0, audio_rec_sink(), 0);
+        tb->connect(wav_gain1, 0, audio_rec_sink(), 1);
     }
 
     if (d_sniffer_active)
@@ -1461,6 +1878,130 @@ void receiver::reset_rds_parser(void)
     rx->reset_rds_parser();
 }
 
+/**
+ * @brief Enable or disable the signal detector.
+ *
+ * The detector runs on the baseband FFT frames, so it only produces results
+ * while baseband FFT data is being requested.
+ */
+void receiver::set_detector_enabled(bool enabled)
+{
+    detector->set_enabled(enabled);
+}
+
+bool receiver::is_detector_enabled(void) const
+{
+    return detector->is_enabled();
+}
+
+/** Set signal detector threshold in dB above the local noise floor. */
+void receiver::set_detector_threshold(float snr_db)
+{
+    detector->set_threshold(snr_db);
+}
+
+/** Set signal detector hysteresis in dB. */
+void receiver::set_detector_hysteresis(float db)
+{
+    detector->set_hysteresis(db);
+}
+
+/** Set how long lost signals are kept in the detector list. */
+void receiver::set_detector_hold_time(double seconds)
+{
+    detector->set_hold_time(seconds);
+}
+
+/**
+ * @brief Get the signals found by the detector.
+ * @return List of signals sorted by frequency. Frequencies are RF
+ *         frequencies, i.e. without LNB LO.
+ */
+std::vector<signal_detector::signal> receiver::get_detected_signals(void) const
+{
+    return detector->get_signals();
+}
+
+/**
+ * @brief Start a wideband sweep.
+ * @param start_freq Lower edge of the sweep range (RF frequency in Hz).
+ * @param stop_freq Upper edge of the sweep range (RF frequency in Hz).
+ * @param fftsize FFT size used at each step.
+ * @param averages Number of FFT frames averaged at each step.
+ * @param settle_time Time in seconds to discard after each retune.
+ * @param trim Fraction of the spectrum to discard at the edges of each step.
+ *
+ * The receiver hops across the range while sweeping and returns to the
+ * current RF frequency when the sweep is stopped.
+ */
+receiver::status receiver::start_sweep(double start_freq, double stop_freq,
+                                       unsigned int fftsize, unsigned int averages,
+                                       double settle_time, double trim)
+{
+    if (!sweep->start(start_freq, stop_freq, d_decim_rate, fftsize, averages,
+                      settle_time, trim))
+        return STATUS_ERROR;
+
+    return STATUS_OK;
+}
+
+/** Stop the wideband sweep and tune back to the RF frequency. */
+void receiver::stop_sweep(void)
+{
+    if (!sweep->is_running())
+        return;
+
+    // Waits for a retune in progress
+    sweep->stop();
+
+    std::lock_guard<std::mutex> lock(d_src_mutex);
+    src->set_center_freq(d_rf_freq);
+}
+
+bool receiver::is_sweeping(void) const
+{
+    return sweep->is_running();
+}
+
+/**
+ * @brief Get the stitched sweep spectrum.
+ * @param data Receives the power spectrum of the sweep range.
+ * @param generation Generation of the spectrum in data, 0 if none.
+ * @return 1 if data was updated, 0 if it is still current, -1 if no sweep
+ *         data is available.
+ */
+int receiver::get_sweep_data(std::vector<float> &data, unsigned int *generation)
+{
+    return sweep->get_panorama(data, generation);
+}
+
+/** Get the stitched sweep spectrum reduced to npts max/avg points. */
+int receiver::get_sweep_data_reduced(float *maxPoints, float *avgPoints,
+                                     double start_bin, double bins_per_point,
+                                     int npts, unsigned int *generation)
+{
+    return sweep->get_panorama_reduced(maxPoints, avgPoints, start_bin,
+                                       bins_per_point, npts, generation);
+}
+
+/** Get the number of bins in the sweep spectrum. */
+unsigned int receiver::get_sweep_size(void) const
+{
+    return sweep->get_panorama_size();
+}
+
+/** Get the RF frequency range covered by the sweep spectrum. */
+void receiver::get_sweep_range(double *start_freq, double *stop_freq) const
+{
+    sweep->get_range(start_freq, stop_freq);
+}
+
+/** Get the sweep rate in MHz/s. */
+double receiver::get_sweep_rate(void) const
+{
+    return sweep->get_sweep_rate();
+}
+
 std::string receiver::escape_filename(std::string filename)
 {
     std::stringstream ss1;
@@ -23,13 +23,12 @@
 #ifndef RECEIVER_H
 #define RECEIVER_H
 
-#include <gnuradio/blocks/file_sink.h>
 #include <gnuradio/blocks/multiply_const.h>
 #include <gnuradio/blocks/null_sink.h>
-#include <gnuradio/blocks/wavfile_sink.h>
 #include <gnuradio/blocks/wavfile_source.h>
 #include <gnuradio/top_block.h>
 #include <osmosdr/source.h>
+#include <mutex>
 #include <string>
 
 #include "dsp/correct_iq_cc.h"
@@ -42,8 +41,15 @@
 #include "dsp/rx_demod_fm.h"
 #include "dsp/rx_demod_am.h"
 #include "dsp/rx_fft.h"
+#include "dsp/signal_detector.h"
 #include "dsp/sniffer_f.h"
+#include "dsp/sweeper.h"
 #include "dsp/resampler_xx.h"
+#include "interfaces/iq_file_sink.h"
+#include "interfaces/iq_file_source.h"
+#include "interfaces/audio_file_sink.h"
+#include "interfaces/iq_history_sink.h"
+#include "interfaces/sql_wav_sink.h"
 #include "interfaces/udp_sink_f.h"
 #include "receivers/receiver_base.h"
 
@@ -115,6 +121,8 @@ public:
     void        start();
     void        stop();
     void        set_input_device(const std::string device);
+    status      set_input_file(const std::string filename, iq_format fmt,
+                               double samprate, double center_freq);
     void        set_output_device(const std::string device);
 
     std::vector<std::string> get_antennas(void) const;
@@ -162,8 +170,12 @@ public:
     float       get_signal_pwr() const;
     void        set_iq_fft_size(int newsize);
     unsigned int iq_fft_size(void) const;
+    void        set_iq_fft_threads(int nthreads);
     void        set_iq_fft_window(int window_type, bool normalize_energy);
     int         get_iq_fft_data(float* fftPoints);
+    int         get_iq_fft_data_reduced(float *maxPoints, float *avgPoints,
+                                        double start_bin, double bins_per_point,
+                                        int npts);
     int         get_audio_fft_data(float* fftPoints);
     unsigned int audio_fft_size(void) const;
 
@@ -174,6 +186,7 @@ public:
     /* Squelch parameter */
     status      set_sql_level(double level_db);
     status      set_sql_alpha(double alpha);
+    bool        is_sql_open() const;
 
     /* AGC */
     status      set_agc_on(bool agc_on);
@@ -198,7 +211,11 @@ public:
 
     /* Audio parameters */
     status      set_af_gain(float gain_db);
-    status      start_audio_recording(const std::string filename);
+    status      start_audio_recording(const std::string filename,
+                                      double segment_seconds = 0.0,
+                                      std::function<std::string(uint64_t)> segment_name = nullptr);
+    status      start_sql_audio_recording(const std::string dir, double preroll,
+                                          double hang, audio_file_format fmt);
     status      stop_audio_recording();
     status      start_audio_playback(const std::string filename);
     status      stop_audio_playback();
@@ -207,9 +224,34 @@ public:
     status      stop_udp_streaming();
 
     /* I/Q recording and playback */
-    status      start_iq_recording(const std::string filename);
+    status      start_iq_recording(const std::string filename,
+                                   iq_format fmt = IQ_FORMAT_CF32,
+                                   bool direct_io = false,
+                                   uint64_t segment_bytes = 0,
+                                   std::function<std::string(uint64_t)> segment_name = nullptr);
     status      stop_iq_recording();
     status      seek_iq_file(long pos);
+    void        set_iq_file_speed(double speed);
+    void        set_iq_file_loop(uint64_t start, uint64_t end);
+    int64_t     get_iq_file_position(void) const;
+    bool        is_iq_file_at_end(void) const;
+    bool        is_recording_iq(void) const { return d_recording_iq; }
+    bool        is_writing_iq(void);
+    float       get_iq_recording_fill(void) const;
+    uint64_t    get_iq_recording_dropped(void) const;
+    uint64_t    get_iq_recording_samples(void) const;
+    uint64_t    get_iq_recording_segment(void) const;
+    uint64_t    get_iq_recording_segment_samples(void) const;
+
+    /* I/Q history */
+    void        set_iq_history(double seconds, iq_format fmt);
+    status      start_iq_history_save(const std::string filename, double post_seconds,
+                                      uint64_t &pre_samples);
+    status      stop_iq_history_save();
+    bool        is_saving_iq_history(void) const;
+    double      get_iq_history_length(void) const;
+    uint64_t    get_iq_history_dropped(void) const;
+    uint64_t    get_iq_history_gap(void) const;
 
     /* sample sniffer */
     status      start_sniffer(unsigned int samplrate, int buffsize);
@@ -217,6 +259,7 @@ public:
     void        get_sniffer_data(float * outbuff, unsigned int &num);
 
     bool        is_recording_audio(void) const { return d_recording_wav; }
+    double      get_audio_rate(void) const { return d_audio_rate; }
     bool        is_snifffer_active(void) const { return d_sniffer_active; }
 
     /* rds functions */
@@ -226,11 +269,38 @@ public:
     bool        is_rds_decoder_active(void) const;
     void        reset_rds_parser(void);
 
+    /* signal detector */
+    void        set_detector_enabled(bool enabled);
+    bool        is_detector_enabled(void) const;
+    void        set_detector_threshold(float snr_db);
+    void        set_detector_hysteresis(float db);
+    void        set_detector_hold_time(double seconds);
+    std::vector<signal_detector::signal> get_detected_signals(void) const;
+
+    /* wideband sweep */
+    status      start_sweep(double start_freq, double stop_freq,
+                            unsigned int fftsize, unsigned int averages,
+                            double settle_time, double trim);
+    void        stop_sweep(void);
+    bool        is_sweeping(void) const;
+    int         get_sweep_data(std::vector<float> &data, unsigned int *generation);
+    int         get_sweep_data_reduced(float *maxPoints, float *avgPoints,
+                                       double start_bin, double bins_per_point,
+                                       int npts, unsigned int *generation);
+    unsigned int get_sweep_size(void) const;
+    void        get_sweep_range(double *start_freq, double *stop_freq) const;
+    double      get_sweep_rate(void) const;
+
     /* utility functions */
     static std::string escape_filename(std::string filename);
 
 private:
     void        connect_all(rx_chain type);
+    gr::basic_block_sptr input_source() const;
+    gr::basic_block_sptr iq_tap() const;
+    gr::basic_block_sptr audio_rec_sink() const;
+    void        connect_input();
+    void        disconnect_input();
 
 private:
     bool        d_running;          /*!< Whether receiver is running or not. */
@@ -244,6 +314,8 @@ private:
     double      d_filter_offset;    /*!< Current filter offset */
     double      d_cw_offset;        /*!< CW offset */
     bool        d_recording_iq;     /*!< Whether we are recording I/Q file. */
+    uint64_t    d_iq_segment;       /*!< Last segment of the I/Q recording. */
+    uint64_t    d_iq_samples;       /*!< Samples in the last I/Q recording. */
     bool        d_recording_wav;    /*!< Whether we are recording WAV file. */
     bool        d_sniffer_active;   /*!< Only one data decoder allowed. */
     bool        d_iq_rev;           /*!< Whether I/Q is reversed or not. */
@@ -258,6 +330,7 @@ private:
     gr::top_block_sptr         tb;        /*!< The GNU Radio top block. */
 
     osmosdr::source::sptr     src;       /*!< Real time I/Q source. */
+    iq_file_source_sptr       file_src;  /*!< Memory mapped I/Q file being played. */
     fir_decim_cc_sptr         input_decim;      /*!< Input decimator. */
     receiver_base_cf_sptr     rx;        /*!< receiver. */
 
@@ -274,15 +347,20 @@ private:
     gr::blocks::multiply_const_ff::sptr wav_gain0; /*!< WAV file gain block. */
     gr::blocks::multiply_const_ff::sptr wav_gain1; /*!< WAV file gain block. */
 
-    gr::blocks::file_sink::sptr         iq_sink;     /*!< I/Q file sink. */
+    iq_file_sink_sptr                   iq_sink;     /*!< I/Q file sink. */
+    iq_history_sink_sptr                iq_history;  /*!< Pre-trigger I/Q history. */
 
-    gr::blocks::wavfile_sink::sptr      wav_sink;   /*!< WAV file sink for recording. */
+    audio_file_sink_sptr                wav_sink;   /*!< WAV or FLAC file sink for recording. */
+    sql_wav_sink_sptr                   sql_wav;    /*!< Squelch triggered WAV recorder. */
     gr::blocks::wavfile_source::sptr    wav_src;    /*!< WAV file source for playback. */
     gr::blocks::null_sink::sptr         audio_null_sink0; /*!< Audio null sink used during playback. */
     gr::blocks::null_sink::sptr         audio_null_sink1; /*!< Audio null sink used during playback. */
 
     udp_sink_f_sptr   audio_udp_sink;  /*!< UDP sink to stream audio over the network. */
     sniffer_f_sptr    sniffer;    /*!< Sample sniffer for data decoders. */
+    signal_detector_sptr detector; /*!< Signal detector fed by iq_fft. */
+    sweeper_sptr      sweep;      /*!< Wideband sweeper fed by iq_fft. */
+    mutable std::mutex d_src_mutex; /*!< Serializes device settings with sweep retuning. */
     resampler_ff_sptr sniffer_rr; /*!< Sniffer resampler. */
 
 #ifdef WITH_PULSEAUDIO
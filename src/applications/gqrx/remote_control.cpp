@@ -46,11 +46,13 @@ RemoteControl::RemoteControl(QObject *parent) :
     rds_station = QString("");
     rds_radiotext = QString("");
     rds_status = false;
+    detector_status = false;
     signal_level = -200.0;
     squelch_level = -150.0;
     audio_gain = -6.0;
     audio_recorder_status = false;
     iq_recorder_status = false;
+    iq_history_status = false;
     receiver_running = false;
     hamlib_compatible = false;
     is_audio_muted = false;
@@ -404,6 +406,12 @@ void RemoteControl::stopIqRecorder()
     iq_recorder_status = false;
 }
 
+/*! \brief Set whether the IQ history is being saved (from mainwindow). */
+void RemoteControl::setIqHistoryStatus(bool saving)
+{
+    iq_history_status = saving;
+}
+
 /*! \brief Set receiver status (from mainwindow). */
 void RemoteControl::setReceiverStatus(bool enabled)
 {
@@ -460,6 +468,20 @@ void RemoteControl::setRdsRadiotext(QString text)
     rds_radiotext = text;
 }
 
+/*! \brief Set signal detector status (from signals dock). */
+void RemoteControl::setDetectorStatus(bool enabled)
+{
+    detector_status = enabled;
+    if (!enabled)
+        detected_signals.clear();
+}
+
+/*! \brief Set the list of active signals (from signal detector). */
+void RemoteControl::setDetectedSignals(const std::vector<signal_detector::signal> &sigs)
+{
+    detected_signals = sigs;
+}
+
 
 /*! \brief Convert mode string to enum (DockRxOpt::rxopt_mode_idx)
  *  \param mode The Hamlib rigctld compatible mode string
@@ -779,17 +801,21 @@ QString RemoteControl::cmd_get_func(QStringList cmdlist)
     QString func = cmdlist.value(1, "");
 
     if (func == "?")
-        answer = QString("RECORD IQRECORD DSP RDS MUTE\n");
+        answer = QString("RECORD IQRECORD IQHISTORY DSP RDS MUTE DETECT\n");
     else if (func.compare("RECORD", Qt::CaseInsensitive) == 0)
         answer = QString("%1\n").arg(audio_recorder_status);
     else if (func.compare("IQRECORD", Qt::CaseInsensitive) == 0)
         answer = QString("%1\n").arg(iq_recorder_status);
+    else if (func.compare("IQHISTORY", Qt::CaseInsensitive) == 0)
+        answer = QString("%1\n").arg(iq_history_status);
     else if (func.compare("DSP", Qt::CaseInsensitive) == 0)
         answer = QString("%1\n").arg(receiver_running);
     else if (func.compare("RDS", Qt::CaseInsensitive) == 0)
         answer = QString("%1\n").arg(rds_status);
     else if (func.compare("MUTE", Qt::CaseInsensitive) == 0)
         answer = QString("%1\n").arg(is_audio_muted ? '1' : '0');
+    else if (func.compare("DETECT", Qt::CaseInsensitive) == 0)
+        answer = QString("%1\n").arg(detector_status);
     else
         answer = QString("RPRT 1\n");
 
@@ -806,7 +832,7 @@ QString RemoteControl::cmd_set_func(QStringList cmdlist)
 
     if (func == "?")
     {
-        answer = QString("RECORD IQRECORD DSP RDS MUTE\n");
+        answer = QString("RECORD IQRECORD IQHISTORY DSP RDS MUTE DETECT\n");
     }
     else if ((func.compare("RECORD", Qt::CaseInsensitive) == 0) && ok)
     {
@@ -840,6 +866,21 @@ QString RemoteControl::cmd_set_func(QStringList cmdlist)
                 emit stopIqRecorderEvent();
         }
     }
+    else if ((func.compare("IQHISTORY", Qt::CaseInsensitive) == 0) && ok)
+    {
+        if (!receiver_running)
+        {
+            answer = QString("RPRT 1\n");
+        }
+        else
+        {
+            answer = QString("RPRT 0\n");
+            if (status)
+                emit startIqHistoryEvent();
+            else
+                emit stopIqHistoryEvent();
+        }
+    }
     else if ((func.compare("DSP", Qt::CaseInsensitive) == 0) && ok)
     {
         if (status)
@@ -867,6 +908,12 @@ QString RemoteControl::cmd_set_func(QStringList cmdlist)
 
         answer = QString("RPRT 0\n");
     }
+    else if ((func.compare("DETECT", Qt::CaseInsensitive) == 0) && ok)
+    {
+        emit newDetectorMode(status != 0);
+
+        answer = QString("RPRT 0\n");
+    }
     else
     {
         answer = QString("RPRT 1\n");
@@ -882,13 +929,26 @@ QString RemoteControl::cmd_get_param(QStringList cmdlist)
     QString func = cmdlist.value(1, "");
 
     if (func == "?")
-        answer = QString("RDS_PI RDS_PS_NAME RDS_RADIOTEXT\n");
+        answer = QString("RDS_PI RDS_PS_NAME RDS_RADIOTEXT SIGNALS\n");
     else if (func.compare("RDS_PI", Qt::CaseInsensitive) == 0)
         answer = QString("%1\n").arg(rc_program_id);
     else if (func.compare("RDS_PS_NAME", Qt::CaseInsensitive) == 0)
         answer = QString("%1\n").arg(rds_station);
     else if (func.compare("RDS_RADIOTEXT", Qt::CaseInsensitive) == 0)
         answer = QString("%1\n").arg(rds_radiotext);
+    else if (func.compare("SIGNALS", Qt::CaseInsensitive) == 0)
+    {
+        // freq,bandwidth,snr,first_seen,last_seen;...
+        QStringList entries;
+        for (const auto &sig : detected_signals)
+            entries << QString("%1,%2,%3,%4,%5")
+                           .arg((qint64)std::llround(sig.freq))
+                           .arg((qint64)std::llround(sig.bandwidth))
+                           .arg(sig.snr, 0, 'f', 1)
+                           .arg((qint64)sig.first_seen)
+                           .arg((qint64)sig.last_seen);
+        answer = QString("%1\n").arg(entries.join(';'));
+    }
     else
         answer = QString("RPRT 1\n");
 
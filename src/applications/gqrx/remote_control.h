@@ -31,9 +31,11 @@
 #include <QTcpSocket>
 #include <QtNetwork>
 #include <set>
+#include <vector>
 
 /* For gain_t and gain_list_t */
 #include "qtgui/dockinputctl.h"
+#include "dsp/signal_detector.h"
 
 /*! \brief Simple TCP server for remote control.
  *
@@ -99,11 +101,14 @@ public slots:
     void stopAudioRecorder();
     void startIqRecorder(QString unused1, QString unused2);
     void stopIqRecorder();
+    void setIqHistoryStatus(bool saving);
     bool setGain(QString name, double gain);
     void setRDSstatus(bool enabled);
     void rdsPI(QString program_id);
     void setRdsStation(QString name);
     void setRdsRadiotext(QString text);
+    void setDetectorStatus(bool enabled);
+    void setDetectedSignals(const std::vector<signal_detector::signal> &sigs);
 
 signals:
     void newFrequency(qint64 freq);
@@ -117,10 +122,13 @@ signals:
     void stopAudioRecorderEvent();
     void startIqRecorderEvent();
     void stopIqRecorderEvent();
+    void startIqHistoryEvent();
+    void stopIqHistoryEvent();
     void gainChanged(QString name, double value);
     void dspChanged(bool value);
     void newRDSmode(bool value);
     void newAudioMuted(bool muted);
+    void newDetectorMode(bool enabled);
 
 private slots:
     void acceptConnection();
@@ -149,8 +157,11 @@ private:
     QString     rc_program_id;     /*!< RDS Program identification */
     QString     rds_station;       /*!< RDS program service (station) name */
     QString     rds_radiotext;     /*!< RDS Radiotext */
+    bool        detector_status;   /*!< Signal detector enabled */
+    std::vector<signal_detector::signal> detected_signals; /*!< Active signals, display frequencies */
     bool        audio_recorder_status; /*!< Audio recording enabled */
     bool        iq_recorder_status;    /*!< IQ recording enabled */
+    bool        iq_history_status;     /*!< IQ history being saved */
     bool        receiver_running;  /*!< Whether the receiver is running or not */
     bool        hamlib_compatible;
     gain_list_t gains;             /*!< Possible and current gain settings */
@@ -0,0 +1,296 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <thread>
+#include <type_traits>
+#include <gnuradio/gr_complex.h>
+#ifdef WITH_FFTW3F
+#include <fftw3.h>
+#endif
+#include "dsp/fft_plan_cache.h"
+
+/* Memory budget for idle FFT objects: one 4M point FFT. */
+#define FFT_CACHE_MAX_MEMORY (64u * 1024u * 1024u)
+
+
+fft_plan_cache& fft_plan_cache::Get()
+{
+    // Not destroyed at exit, a detached pre-planning thread may still use it
+    static fft_plan_cache *instance = new fft_plan_cache();
+    return *instance;
+}
+
+fft_plan_cache::fft_plan_cache()
+    : d_max_memory(FFT_CACHE_MAX_MEMORY)
+{
+}
+
+/*! \brief Get an FFT object of the requested size.
+ *  \param size The FFT size.
+ *  \param nthreads Number of threads to use for large FFTs.
+ *
+ * Returns a cached object if one is available, otherwise a new one is created.
+ * If the size is being planned in the background, wait for that plan instead
+ * of planning the same size twice. The object must be given back using
+ * release() when it is no longer used.
+ */
+fft_complex_fwd_t *fft_plan_cache::acquire(unsigned int size, int nthreads)
+{
+    fft_complex_fwd_t *fft;
+    const std::pair<unsigned int, int> key(size, fft_threads(size, nthreads));
+
+    {
+        std::unique_lock<std::mutex> lock(d_mutex);
+
+        d_cond.wait(lock, [this, &key] { return d_planning.count(key) == 0; });
+
+        for (auto it = d_idle.begin(); it != d_idle.end(); ++it)
+        {
+            if (it->size == key.first && it->nthreads == key.second)
+            {
+                fft = it->fft;
+                d_idle.erase(it);
+                return fft;
+            }
+        }
+
+        d_planning.insert(key);
+    }
+
+    fft = create(key.first, key.second);
+
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_planning.erase(key);
+    }
+    d_cond.notify_all();
+
+    return fft;
+}
+
+/*! \brief Give an FFT object obtained from acquire() back to the cache. */
+void fft_plan_cache::release(fft_complex_fwd_t *fft)
+{
+    if (!fft)
+        return;
+
+    std::lock_guard<std::mutex> lock(d_mutex);
+    d_idle.push_front({(unsigned int)fft->inbuf_length(), fft->nthreads(), fft});
+    trim();
+}
+
+/*! \brief Check whether an idle FFT object of the given size is available.
+ *  \param size The FFT size.
+ *  \param nthreads Number of threads to use for large FFTs.
+ *
+ * If true, acquire() with the same arguments returns without planning, unless
+ * another user takes the object first.
+ */
+bool fft_plan_cache::has_plan(unsigned int size, int nthreads)
+{
+    const std::pair<unsigned int, int> key(size, fft_threads(size, nthreads));
+
+    std::lock_guard<std::mutex> lock(d_mutex);
+    for (const auto &e : d_idle)
+    {
+        if (e.size == key.first && e.nthreads == key.second)
+            return true;
+    }
+    return false;
+}
+
+/*! \brief Plan the given FFT sizes on a background thread.
+ *  \param sizes The FFT sizes to plan.
+ *  \param nthreads Number of threads to plan large FFTs for.
+ *
+ * Any pre-planning already in progress is stopped first. Sizes whose buffers
+ * alone exceed the memory budget are skipped, and the planned objects are
+ * subject to the budget like any other idle object. Sizes are planned in
+ * ascending order, so the sizes that are quick to plan become available
+ * first. The wisdom is saved after each plan.
+ */
+void fft_plan_cache::preplan(const std::vector<unsigned int> &sizes, int nthreads)
+{
+    stop_preplan();
+
+    auto stop = std::make_shared<std::atomic<bool>>(false);
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_stop = stop;
+    }
+    std::thread(&fft_plan_cache::preplan_thread, this, sizes, nthreads, stop).detach();
+}
+
+/*! \brief Stop background planning.
+ *
+ * A plan that is already being computed can not be interrupted. It is left to
+ * finish in the background and no further sizes are planned, so this never
+ * blocks.
+ */
+void fft_plan_cache::stop_preplan()
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+    if (d_stop)
+        *d_stop = true;
+    d_stop.reset();
+}
+
+/*! \brief Load FFTW wisdom from file and use the file for saving it later.
+ *  \param filename The wisdom file, usually in the gqrx configuration directory.
+ *
+ * Without FFTW support at build time this does nothing, and the wisdom is only
+ * kept in the GNU Radio wisdom file.
+ */
+void fft_plan_cache::set_wisdom_file(const std::string &filename)
+{
+#ifdef WITH_FFTW3F
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_wisdom_file = filename;
+    }
+
+    // FFTW planning is not thread safe, GNU Radio serializes it using this mutex
+    auto &planner_mutex = gr::fft::planner::mutex();
+    std::lock_guard<std::remove_reference<decltype(planner_mutex)>::type> lock(planner_mutex);
+    fftwf_import_wisdom_from_filename(filename.c_str());
+#else
+    (void) filename;
+#endif
+}
+
+/*! \brief Save the accumulated FFTW wisdom to the wisdom file, if any.
+ *  \param wait Wait for a plan in progress to finish before saving. If false
+ *              and a plan is in progress, nothing is saved.
+ */
+void fft_plan_cache::save_wisdom(bool wait)
+{
+#ifdef WITH_FFTW3F
+    std::string filename;
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        filename = d_wisdom_file;
+    }
+    if (filename.empty())
+        return;
+
+    auto &planner_mutex = gr::fft::planner::mutex();
+    std::unique_lock<std::remove_reference<decltype(planner_mutex)>::type> lock(planner_mutex, std::defer_lock);
+    if (wait)
+        lock.lock();
+    else if (!lock.try_lock())
+        return;
+    fftwf_export_wisdom_to_filename(filename.c_str());
+#else
+    (void) wait;
+#endif
+}
+
+/*! \brief Delete all idle FFT objects. */
+void fft_plan_cache::clear()
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+    for (auto &e : d_idle)
+        delete e.fft;
+    d_idle.clear();
+}
+
+/*! \brief Approximate memory used by an FFT object (input and output buffers). */
+size_t fft_plan_cache::fft_memory(unsigned int size)
+{
+    return 2 * (size_t)size * sizeof(gr_complex);
+}
+
+/*! \brief Number of threads actually used for an FFT of the given size.
+ *
+ * Splitting small FFTs between threads costs more than it gains.
+ */
+int fft_plan_cache::fft_threads(unsigned int size, int nthreads)
+{
+    if (size < FFT_THREADS_MIN_SIZE)
+        return 1;
+    return std::max(nthreads, 1);
+}
+
+fft_complex_fwd_t *fft_plan_cache::create(unsigned int size, int nthreads)
+{
+#if GNURADIO_VERSION < 0x030900
+    return new gr::fft::fft_complex(size, true, nthreads);
+#else
+    return new gr::fft::fft_complex_fwd(size, nthreads);
+#endif
+}
+
+/*! \brief Drop least recently used idle objects until within the memory budget.
+ *
+ * Must be called with d_mutex held.
+ */
+void fft_plan_cache::trim()
+{
+    size_t total = 0;
+    for (const auto &e : d_idle)
+        total += fft_memory(e.size);
+
+    while (total > d_max_memory && !d_idle.empty())
+    {
+        total -= fft_memory(d_idle.back().size);
+        delete d_idle.back().fft;
+        d_idle.pop_back();
+    }
+}
+
+void fft_plan_cache::preplan_thread(std::vector<unsigned int> sizes, int nthreads,
+                                    std::shared_ptr<std::atomic<bool>> stop)
+{
+    std::sort(sizes.begin(), sizes.end());
+
+    for (unsigned int size : sizes)
+    {
+        if (*stop)
+            break;
+        if (fft_memory(size) > d_max_memory)
+            continue;
+
+        const std::pair<unsigned int, int> key(size, fft_threads(size, nthreads));
+
+        {
+            std::lock_guard<std::mutex> lock(d_mutex);
+            bool have = d_planning.count(key) > 0;
+            for (const auto &e : d_idle)
+                have = have || (e.size == key.first && e.nthreads == key.second);
+            if (have)
+                continue;
+            d_planning.insert(key);
+        }
+
+        fft_complex_fwd_t *fft = create(key.first, key.second);
+
+        {
+            std::lock_guard<std::mutex> lock(d_mutex);
+            d_planning.erase(key);
+            // The larger sizes are planned last and are the costliest to plan again
+            d_idle.push_front({key.first, key.second, fft});
+            trim();
+        }
+        d_cond.notify_all();
+
+        save_wisdom();
+    }
+}
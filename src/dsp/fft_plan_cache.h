@@ -0,0 +1,111 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef FFT_PLAN_CACHE_H
+#define FFT_PLAN_CACHE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include <gnuradio/fft/fft.h>
+
+
+#if GNURADIO_VERSION < 0x030900
+typedef gr::fft::fft_complex fft_complex_fwd_t;
+#else
+typedef gr::fft::fft_complex_fwd fft_complex_fwd_t;
+#endif
+
+/* FFTs smaller than this are always computed by a single thread. */
+#define FFT_THREADS_MIN_SIZE (256 * 1024)
+
+/*! \brief Cache of forward complex FFT objects (FFTW plans) indexed by size.
+ *
+ * Planning a large FFT with FFTW_MEASURE takes a long time, so FFT objects
+ * that are no longer used are kept around and handed out again when the same
+ * size is requested. An FFT object is owned by exactly one user between
+ * acquire() and release(), since its input and output buffers are not shared.
+ *
+ * Large FFTs can be computed by several threads (FFTW threads). Since the
+ * number of threads is part of the plan, objects are cached per size and
+ * number of threads.
+ *
+ * Idle objects are dropped in least recently used order once their buffers
+ * exceed a memory budget. Sizes can be planned ahead on a background thread,
+ * which also fills the FFTW wisdom. When gqrx is built with FFTW the wisdom
+ * is stored in the gqrx configuration directory, so that planning is fast
+ * from the first use on the next start.
+ *
+ * The cache is never destroyed, since a background plan may still be in
+ * progress when the application exits.
+ */
+class fft_plan_cache
+{
+public:
+    static fft_plan_cache& Get();
+
+    fft_complex_fwd_t *acquire(unsigned int size, int nthreads = 1);
+    void release(fft_complex_fwd_t *fft);
+    bool has_plan(unsigned int size, int nthreads = 1);
+
+    void preplan(const std::vector<unsigned int> &sizes, int nthreads = 1);
+    void stop_preplan();
+
+    void set_wisdom_file(const std::string &filename);
+    void save_wisdom(bool wait = true);
+
+    void clear();
+
+private:
+    fft_plan_cache();
+    fft_plan_cache(const fft_plan_cache&) = delete;
+    fft_plan_cache& operator=(const fft_plan_cache&) = delete;
+
+    struct entry {
+        unsigned int       size;
+        int                nthreads;
+        fft_complex_fwd_t *fft;
+    };
+
+    static size_t fft_memory(unsigned int size);
+    static int    fft_threads(unsigned int size, int nthreads);
+    static fft_complex_fwd_t *create(unsigned int size, int nthreads);
+    void trim();
+    void preplan_thread(std::vector<unsigned int> sizes, int nthreads,
+                        std::shared_ptr<std::atomic<bool>> stop);
+
+    std::mutex              d_mutex;
+    std::condition_variable d_cond;
+    std::list<entry>        d_idle;      /*!< Idle FFT objects, most recently used first. */
+    std::set<std::pair<unsigned int, int>> d_planning;  /*!< Size and threads of plans in progress. */
+    size_t                  d_max_memory;
+
+    std::shared_ptr<std::atomic<bool>> d_stop;  /*!< Stop flag of the current pre-planning. */
+
+    std::string             d_wisdom_file;
+};
+
+#endif /* FFT_PLAN_CACHE_H */
@@ -0,0 +1,69 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <cmath>
+#include <volk/volk.h>
+#include "dsp/fft_reduce.h"
+
+/*! \brief Reduce a shifted power spectrum to screen resolution.
+ *  \param power Linear power of each bin, with DC in the center.
+ *  \param size Number of bins.
+ *  \param maxPoints Buffer receiving the peak power for each point.
+ *  \param avgPoints Buffer receiving the average power for each point.
+ *  \param start_bin Bin at the center of the first point.
+ *  \param bins_per_point Number of bins covered by each point.
+ *  \param npts Number of points to compute.
+ *
+ * Point p covers the bins whose center is less than half a point away from
+ * start_bin + p * bins_per_point, i.e. the same bins the plotter would map to
+ * that pixel column. Bin 0 (Nyquist after shifting) is never used.
+ */
+void fft_reduce_power(const float *power, unsigned int size,
+                      float *maxPoints, float *avgPoints,
+                      double start_bin, double bins_per_point, int npts)
+{
+    const double last = (double)size - 1.0;
+
+    for (int p = 0; p < npts; p++)
+    {
+        const double b = start_bin + (double)p * bins_per_point;
+        const double lo = std::max(std::ceil(b - 0.5 * bins_per_point), 1.0);
+        const double hi = std::min(std::ceil(b + 0.5 * bins_per_point) - 1.0, last);
+
+        if (hi < lo)
+        {
+            // Point narrower than a bin or outside the spectrum: use nearest bin
+            const float v = power[(unsigned int)std::min(std::max(std::round(b), 1.0), last)];
+            maxPoints[p] = v;
+            avgPoints[p] = v;
+            continue;
+        }
+
+        const unsigned int first = (unsigned int)lo;
+        const unsigned int n = (unsigned int)hi - first + 1;
+        uint32_t idx = 0;
+        float sum = 0.0f;
+        volk_32f_index_max_32u(&idx, power + first, n);
+        volk_32f_accumulator_s32f(&sum, power + first, n);
+        maxPoints[p] = power[first + idx];
+        avgPoints[p] = sum / (float)n;
+    }
+}
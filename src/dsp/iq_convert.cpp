@@ -0,0 +1,199 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <cstring>
+#include <gnuradio/io_signature.h>
+#include <volk/volk.h>
+#include "dsp/iq_convert.h"
+
+
+/*! \brief Size in bytes of one I/Q pair. */
+size_t iq_format_item_size(iq_format fmt)
+{
+    switch (fmt)
+    {
+    case IQ_FORMAT_CS16:
+        return 2 * sizeof(int16_t);
+    case IQ_FORMAT_CS8:
+        return 2 * sizeof(int8_t);
+    default:
+        return sizeof(gr_complex);
+    }
+}
+
+/*! \brief Integer value corresponding to full scale. */
+float iq_format_scale(iq_format fmt)
+{
+    switch (fmt)
+    {
+    case IQ_FORMAT_CS16:
+        return 32767.0f;
+    case IQ_FORMAT_CS8:
+        return 127.0f;
+    default:
+        return 1.0f;
+    }
+}
+
+/*! \brief Short name used in settings and file names, e.g. "cs16". */
+std::string iq_format_name(iq_format fmt)
+{
+    switch (fmt)
+    {
+    case IQ_FORMAT_CS16:
+        return "cs16";
+    case IQ_FORMAT_CS8:
+        return "cs8";
+    default:
+        return "cf32";
+    }
+}
+
+/*! \brief Parse a short name, unknown names give IQ_FORMAT_CF32. */
+iq_format iq_format_from_name(const std::string &name)
+{
+    if (name == "cs16")
+        return IQ_FORMAT_CS16;
+    if (name == "cs8")
+        return IQ_FORMAT_CS8;
+    return IQ_FORMAT_CF32;
+}
+
+/*! \brief SigMF core:datatype of files written on this host. */
+std::string iq_format_sigmf_datatype(iq_format fmt)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    const std::string endian = "_be";
+#else
+    const std::string endian = "_le";
+#endif
+
+    switch (fmt)
+    {
+    case IQ_FORMAT_CS16:
+        return "ci16" + endian;
+    case IQ_FORMAT_CS8:
+        return "ci8";
+    default:
+        return "cf32" + endian;
+    }
+}
+
+/**
+ * Convert samples in a file sample format to complex.
+ * @param fmt The sample format of the input.
+ * @param in The input samples.
+ * @param out The output, room for nitems samples.
+ * @param nitems Number of I/Q pairs to convert.
+ */
+void iq_format_decode(iq_format fmt, const void *in, gr_complex *out, int nitems)
+{
+    switch (fmt)
+    {
+    case IQ_FORMAT_CS16:
+        volk_16i_s32f_convert_32f((float *)out, (const int16_t *)in,
+                                  iq_format_scale(fmt), 2 * nitems);
+        break;
+    case IQ_FORMAT_CS8:
+        volk_8i_s32f_convert_32f((float *)out, (const int8_t *)in,
+                                 iq_format_scale(fmt), 2 * nitems);
+        break;
+    default:
+        memcpy(out, in, nitems * sizeof(gr_complex));
+        break;
+    }
+}
+
+
+iq_encode_sptr make_iq_encode(iq_format fmt)
+{
+    return gnuradio::get_initial_sptr(new iq_encode(fmt));
+}
+
+iq_encode::iq_encode(iq_format fmt)
+    : gr::sync_block ("iq_encode",
+          gr::io_signature::make(1, 1, sizeof(gr_complex)),
+          gr::io_signature::make(1, 1, iq_format_item_size(fmt))),
+      d_fmt(fmt),
+      d_scale(iq_format_scale(fmt))
+{
+    const int alignment_multiple = volk_get_alignment() / sizeof(gr_complex);
+    set_alignment(std::max(1, alignment_multiple));
+}
+
+iq_encode::~iq_encode()
+{
+
+}
+
+int iq_encode::work(int noutput_items,
+                    gr_vector_const_void_star& input_items,
+                    gr_vector_void_star& output_items)
+{
+    const float *in = (const float *)input_items[0];
+
+    switch (d_fmt)
+    {
+    case IQ_FORMAT_CS16:
+        volk_32f_s32f_convert_16i((int16_t *)output_items[0], in, d_scale,
+                                  2 * noutput_items);
+        break;
+    case IQ_FORMAT_CS8:
+        volk_32f_s32f_convert_8i((int8_t *)output_items[0], in, d_scale,
+                                 2 * noutput_items);
+        break;
+    default:
+        memcpy(output_items[0], in, noutput_items * sizeof(gr_complex));
+        break;
+    }
+
+    return noutput_items;
+}
+
+
+iq_decode_sptr make_iq_decode(iq_format fmt)
+{
+    return gnuradio::get_initial_sptr(new iq_decode(fmt));
+}
+
+iq_decode::iq_decode(iq_format fmt)
+    : gr::sync_block ("iq_decode",
+          gr::io_signature::make(1, 1, iq_format_item_size(fmt)),
+          gr::io_signature::make(1, 1, sizeof(gr_complex))),
+      d_fmt(fmt)
+{
+    const int alignment_multiple = volk_get_alignment() / sizeof(gr_complex);
+    set_alignment(std::max(1, alignment_multiple));
+}
+
+iq_decode::~iq_decode()
+{
+
+}
+
+int iq_decode::work(int noutput_items,
+                    gr_vector_const_void_star& input_items,
+                    gr_vector_void_star& output_items)
+{
+    iq_format_decode(d_fmt, input_items[0], (gr_complex *)output_items[0], noutput_items);
+
+    return noutput_items;
+}
@@ -0,0 +1,109 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef IQ_CONVERT_H
+#define IQ_CONVERT_H
+
+#include <gnuradio/gr_complex.h>
+#include <gnuradio/sync_block.h>
+#include <string>
+
+/*! \brief Sample formats of I/Q files. */
+enum iq_format {
+    IQ_FORMAT_CF32 = 0,  /*!< Interleaved 32 bit float. */
+    IQ_FORMAT_CS16 = 1,  /*!< Interleaved 16 bit signed integer. */
+    IQ_FORMAT_CS8  = 2   /*!< Interleaved 8 bit signed integer. */
+};
+
+size_t      iq_format_item_size(iq_format fmt);
+float       iq_format_scale(iq_format fmt);
+std::string iq_format_name(iq_format fmt);
+iq_format   iq_format_from_name(const std::string &name);
+std::string iq_format_sigmf_datatype(iq_format fmt);
+void        iq_format_decode(iq_format fmt, const void *in, gr_complex *out, int nitems);
+
+class iq_encode;
+class iq_decode;
+
+#if GNURADIO_VERSION < 0x030900
+typedef boost::shared_ptr<iq_encode> iq_encode_sptr;
+typedef boost::shared_ptr<iq_decode> iq_decode_sptr;
+#else
+typedef std::shared_ptr<iq_encode> iq_encode_sptr;
+typedef std::shared_ptr<iq_decode> iq_decode_sptr;
+#endif
+
+/*! \brief Return a shared_ptr to a new instance of iq_encode.
+ *  \param fmt The sample format of the output.
+ */
+iq_encode_sptr make_iq_encode(iq_format fmt);
+
+/*! \brief Convert complex samples to a file sample format.
+ *  \ingroup DSP
+ *
+ * Full scale (1.0) maps to the largest integer value, samples outside are
+ * clipped. One output item is one I/Q pair of iq_format_item_size() bytes.
+ */
+class iq_encode : public gr::sync_block
+{
+    friend iq_encode_sptr make_iq_encode(iq_format fmt);
+
+protected:
+    iq_encode(iq_format fmt);
+
+public:
+    ~iq_encode();
+    int work(int noutput_items,
+             gr_vector_const_void_star& input_items,
+             gr_vector_void_star& output_items);
+
+private:
+    iq_format d_fmt;
+    float     d_scale;
+};
+
+/*! \brief Return a shared_ptr to a new instance of iq_decode.
+ *  \param fmt The sample format of the input.
+ */
+iq_decode_sptr make_iq_decode(iq_format fmt);
+
+/*! \brief Convert samples in a file sample format to complex.
+ *  \ingroup DSP
+ *
+ * This is the inverse of iq_encode.
+ */
+class iq_decode : public gr::sync_block
+{
+    friend iq_decode_sptr make_iq_decode(iq_format fmt);
+
+protected:
+    iq_decode(iq_format fmt);
+
+public:
+    ~iq_decode();
+    int work(int noutput_items,
+             gr_vector_const_void_star& input_items,
+             gr_vector_void_star& output_items);
+
+private:
+    iq_format d_fmt;
+};
+
+#endif /* IQ_CONVERT_H */
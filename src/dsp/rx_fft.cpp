@@ -26,8 +26,10 @@
 #include <gnuradio/filter/firdes.h>
 #include <gnuradio/gr_complex.h>
 #include <gnuradio/fft/fft.h>
+#include "dsp/fft_reduce.h"
 #include "dsp/rx_fft.h"
 #include <algorithm>
+#include <cmath>
 
 
 rx_fft_c_sptr make_rx_fft_c (unsigned int fftsize, double quad_rate,
@@ -48,18 +50,15 @@ rx_fft_c::rx_fft_c(unsigned int fftsize, double quad_rate, int wintype, bool nor
           gr::io_signature::make(1, 1, sizeof(gr_complex)),
           gr::io_signature::make(0, 0, 0)),
       d_fftsize(fftsize),
+      d_nthreads(1),
       d_startup_samples(0),
       d_quadrate(quad_rate),
       d_wintype(-1),
       d_normalize_energy(false)
 {
 
-    /* create FFT object */
-#if GNURADIO_VERSION < 0x030900
-    d_fft = new gr::fft::fft_complex(d_fftsize, true);
-#else
-    d_fft = new gr::fft::fft_complex_fwd(d_fftsize);
-#endif
+    /* get FFT object */
+    d_fft = fft_plan_cache::Get().acquire(d_fftsize);
 
     /* allocate circular buffer */
 #if GNURADIO_VERSION < 0x031000
@@ -80,7 +79,7 @@ rx_fft_c::rx_fft_c(unsigned int fftsize, double quad_rate, int wintype, bool nor
 
 rx_fft_c::~rx_fft_c()
 {
-    delete d_fft;
+    fft_plan_cache::Get().release(d_fft);
 }
 
 /*! \brief Receiver FFT work method.
@@ -89,7 +88,7 @@ rx_fft_c::~rx_fft_c()
  *  \param output_items
  *
  * This method does nothing except throwing the incoming samples into the
- * circular buffer.
+ * circular buffer and passing them to the sweeper, if any.
  * FFT is only executed when the GUI asks for new FFT data via get_fft_data().
  */
 int rx_fft_c::work(int noutput_items,
@@ -99,6 +98,9 @@ int rx_fft_c::work(int noutput_items,
     const gr_complex *in = (const gr_complex*)input_items[0];
     (void) output_items;
 
+    if (d_sweeper)
+        d_sweeper->process(in, noutput_items);
+
     /* just throw new samples into the buffer */
     int items_to_copy = std::min(noutput_items, (int)d_writer->bufsize());
     if (items_to_copy < noutput_items)
@@ -124,6 +126,52 @@ int rx_fft_c::work(int noutput_items,
  *  \param fftSize Current FFT size (output).
  */
 int rx_fft_c::get_fft_data(float* fftPoints)
+{
+    if (compute_fft() < 0)
+        return -1;
+
+    shift_power(fftPoints);
+
+    if (d_detector)
+        d_detector->process(fftPoints, d_fftsize, d_quadrate);
+
+    return 0;
+}
+
+/*! \brief Get FFT data reduced to screen resolution.
+ *  \param maxPoints Buffer receiving the peak power for each point.
+ *  \param avgPoints Buffer receiving the average power for each point.
+ *  \param start_bin Shifted FFT bin at the center of the first point.
+ *  \param bins_per_point Number of FFT bins covered by each point.
+ *  \param npts Number of points to compute.
+ *
+ * See fft_reduce_power() for the bins covered by each point. This keeps the
+ * per-frame data handed to the GUI proportional to the screen width rather
+ * than to the FFT size.
+ */
+int rx_fft_c::get_fft_data_reduced(float *maxPoints, float *avgPoints,
+                                   double start_bin, double bins_per_point,
+                                   int npts)
+{
+    if (compute_fft() < 0)
+        return -1;
+
+    d_power.resize(d_fftsize);
+    shift_power(d_power.data());
+
+    if (d_detector)
+        d_detector->process(d_power.data(), d_fftsize, d_quadrate);
+
+    fft_reduce_power(d_power.data(), d_fftsize, maxPoints, avgPoints,
+                     start_bin, bins_per_point, npts);
+
+    return 0;
+}
+
+/*! \brief Window and transform the most recent d_fftsize samples.
+ *  \returns 0 on success, -1 if not enough samples have been received yet.
+ */
+int rx_fft_c::compute_fft()
 {
     std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
     std::chrono::duration<double> diff = now - d_lasttime;
@@ -144,15 +192,17 @@ int rx_fft_c::get_fft_data(float* fftPoints)
     /* compute FFT */
     d_fft->execute();
 
-    const std::complex<float> *fftOut = d_fft->get_outbuf();
+    return 0;
+}
 
-    // Shifted mag^2(FFT)
-    for (unsigned int i = 0; i < d_fftsize/2; ++i)
-        fftPoints[i] = static_cast<float>(std::norm(fftOut[i + d_fftsize/2]));
-    for (unsigned int i = d_fftsize/2; i < d_fftsize; ++i)
-        fftPoints[i] = static_cast<float>(std::norm(fftOut[i - d_fftsize/2]));
+/*! \brief Copy shifted mag^2(FFT) of the last transform into fftPoints. */
+void rx_fft_c::shift_power(float *fftPoints)
+{
+    const gr_complex *fftOut = d_fft->get_outbuf();
+    const unsigned int half = d_fftsize / 2;
 
-    return 0;
+    volk_32fc_magnitude_squared_32f(fftPoints, fftOut + half, half);
+    volk_32fc_magnitude_squared_32f(fftPoints + half, fftOut, d_fftsize - half);
 }
 
 /*! \brief Compute FFT on the available input data.
@@ -185,18 +235,31 @@ void rx_fft_c::set_fft_size(unsigned int fftsize)
     {
         d_fftsize = fftsize;
 
-        /* reset FFT object (also reset FFTW plan) */
-        delete d_fft;
-#if GNURADIO_VERSION < 0x030900
-        d_fft = new gr::fft::fft_complex(d_fftsize, true);
-#else
-        d_fft = new gr::fft::fft_complex_fwd(d_fftsize);
-#endif
+        /* swap FFT object, reusing a cached FFTW plan if possible */
+        fft_plan_cache::Get().release(d_fft);
+        d_fft = fft_plan_cache::Get().acquire(d_fftsize, d_nthreads);
 
         update_window();
     }
 }
 
+/*! \brief Set number of threads used for large FFTs.
+ *  \param nthreads The number of threads.
+ *
+ * Only FFTs of at least FFT_THREADS_MIN_SIZE points use more than one thread.
+ */
+void rx_fft_c::set_fft_threads(int nthreads)
+{
+    nthreads = std::max(nthreads, 1);
+    if (nthreads != d_nthreads)
+    {
+        d_nthreads = nthreads;
+
+        fft_plan_cache::Get().release(d_fft);
+        d_fft = fft_plan_cache::Get().acquire(d_fftsize, d_nthreads);
+    }
+}
+
 /*! \brief Set new quadrature rate. */
 void rx_fft_c::set_quad_rate(double quad_rate)
 {
@@ -265,12 +328,8 @@ rx_fft_f::rx_fft_f(unsigned int fftsize, double audio_rate,
       d_normalize_energy(false)
 {
 
-    /* create FFT object */
-#if GNURADIO_VERSION < 0x030900
-    d_fft = new gr::fft::fft_complex(d_fftsize, true);
-#else
-    d_fft = new gr::fft::fft_complex_fwd(d_fftsize);
-#endif
+    /* get FFT object */
+    d_fft = fft_plan_cache::Get().acquire(d_fftsize);
 
     /* allocate circular buffer */
 #if GNURADIO_VERSION < 0x031000
@@ -291,7 +350,7 @@ rx_fft_f::rx_fft_f(unsigned int fftsize, double audio_rate,
 
 rx_fft_f::~rx_fft_f()
 {
-    delete d_fft;
+    fft_plan_cache::Get().release(d_fft);
 }
 
 /*! \brief Audio FFT work method.
@@ -401,13 +460,9 @@ void rx_fft_f::set_fft_size(unsigned int fftsize)
     {
         d_fftsize = fftsize;
 
-        /* reset FFT object (also reset FFTW plan) */
-        delete d_fft;
-#if GNURADIO_VERSION < 0x030900
-        d_fft = new gr::fft::fft_complex(d_fftsize, true);
-#else
-        d_fft = new gr::fft::fft_complex_fwd(d_fftsize);
-#endif
+        /* swap FFT object, reusing a cached FFTW plan if possible */
+        fft_plan_cache::Get().release(d_fft);
+        d_fft = fft_plan_cache::Get().acquire(d_fftsize);
 
         update_window();
     }
@@ -33,6 +33,9 @@
 #include <gnuradio/buffer_reader.h>
 #endif
 #include <chrono>
+#include "dsp/fft_plan_cache.h"
+#include "dsp/signal_detector.h"
+#include "dsp/sweeper.h"
 
 
 #define MAX_FFT_SIZE (1024 * 1024 * 4)
@@ -95,16 +98,24 @@ public:
              gr_vector_void_star &output_items);
 
     int get_fft_data(float* fftPoints);
+    int get_fft_data_reduced(float *maxPoints, float *avgPoints,
+                             double start_bin, double bins_per_point,
+                             int npts);
 
     void set_window_type(int wintype, bool normalize_energy);
     int  get_window_type() const { return d_wintype; }
 
     void set_fft_size(unsigned int fftsize);
+    void set_fft_threads(int nthreads);
+    int  get_fft_threads() const { return d_nthreads; }
+    void set_detector(signal_detector_sptr detector) { d_detector = detector; }
+    void set_sweeper(sweeper_sptr sweeper) { d_sweeper = sweeper; }
     void set_quad_rate(double quad_rate);
     unsigned int fft_size() const {return d_fftsize;}
 
 private:
     unsigned int d_fftsize;   /*! Current FFT size. */
+    int          d_nthreads;  /*! Number of threads for large FFTs. */
     unsigned int d_startup_samples;
     double       d_quadrate;
     int          d_wintype;   /*! Current window type. */
@@ -112,17 +123,18 @@ private:
 
     std::mutex   d_in_mutex;   /*! Used to lock input buffer. */
 
-#if GNURADIO_VERSION < 0x030900
-    gr::fft::fft_complex    *d_fft;    /*! FFT object. */
-#else
-    gr::fft::fft_complex_fwd *d_fft;   /*! FFT object. */
-#endif
+    fft_complex_fwd_t  *d_fft;    /*! FFT object, owned by fft_plan_cache. */
     std::vector<float>  d_window; /*! FFT window taps. */
+    std::vector<float>  d_power;  /*! Shifted power spectrum used for reduction. */
+    signal_detector_sptr d_detector; /*! Optional signal detector fed with each frame. */
+    sweeper_sptr d_sweeper;       /*! Optional wideband sweeper fed with all samples. */
 
     gr::buffer_sptr d_writer;
     gr::buffer_reader_sptr d_reader;
     std::chrono::time_point<std::chrono::steady_clock> d_lasttime;
 
+    int  compute_fft();
+    void shift_power(float *fftPoints);
     void apply_window(unsigned int size);
     void update_window();
 };
@@ -190,11 +202,7 @@ private:
 
     std::mutex   d_in_mutex;   /*! Used to lock input buffer. */
 
-#if GNURADIO_VERSION < 0x030900
-    gr::fft::fft_complex    *d_fft;    /*! FFT object. */
-#else
-    gr::fft::fft_complex_fwd *d_fft;   /*! FFT object. */
-#endif
+    fft_complex_fwd_t  *d_fft;    /*! FFT object, owned by fft_plan_cache. */
     std::vector<float>  d_window; /*! FFT window taps. */
 
     gr::buffer_sptr d_writer;
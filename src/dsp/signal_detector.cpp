@@ -0,0 +1,303 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "dsp/signal_detector.h"
+
+#define DETECTOR_AVG_ALPHA      0.25f   /* Spectrum averaging per frame */
+#define DETECTOR_MIN_HITS       3       /* Frames before a signal is reported */
+#define DETECTOR_REF_DIV        64      /* Reference window is fftsize / DETECTOR_REF_DIV bins */
+#define DETECTOR_REF_MIN        8       /* Minimum reference window in bins */
+
+
+signal_detector::signal_detector()
+    : d_enabled(false),
+      d_center_freq(0.0),
+      d_sample_rate(0.0),
+      d_threshold(10.0f),
+      d_hysteresis(3.0f),
+      d_hold_time(2.0),
+      d_next_id(1),
+      d_avg_valid(false)
+{
+}
+
+/*! \brief Process a new FFT frame.
+ *  \param power Shifted power spectrum (mag^2), DC in the center.
+ *  \param fftsize The number of FFT bins.
+ *  \param sample_rate The sample rate of the spectrum in Hz.
+ *
+ * The absolute scale of the spectrum does not matter, since the detector
+ * only looks at the ratio between signal and local noise.
+ */
+void signal_detector::process(const float *power, unsigned int fftsize, double sample_rate)
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+
+    if (!d_enabled || fftsize < 4 * DETECTOR_REF_MIN)
+        return;
+
+    const double now = std::chrono::duration<double>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    if (fftsize != d_avg.size() || sample_rate != d_sample_rate)
+    {
+        d_avg.resize(fftsize);
+        d_cumsum.resize(fftsize + 1);
+        d_sample_rate = sample_rate;
+        d_avg_valid = false;
+    }
+
+    if (d_avg_valid)
+    {
+        for (unsigned int i = 0; i < fftsize; i++)
+            d_avg[i] += DETECTOR_AVG_ALPHA * (power[i] - d_avg[i]);
+    }
+    else
+    {
+        std::copy(power, power + fftsize, d_avg.begin());
+        d_avg_valid = true;
+    }
+
+    detect(fftsize, sample_rate, now);
+    update_tracks(now);
+}
+
+void signal_detector::set_enabled(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+
+    if (enabled != d_enabled)
+    {
+        d_enabled = enabled;
+        d_avg_valid = false;
+        d_tracks.clear();
+    }
+}
+
+bool signal_detector::is_enabled() const
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+    return d_enabled;
+}
+
+/*! \brief Set the center frequency of the spectrum.
+ *
+ * The average is restarted, but tracked signals are kept since they are
+ * stored with absolute frequencies.
+ */
+void signal_detector::set_center_freq(double freq)
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+
+    if (freq != d_center_freq)
+    {
+        d_center_freq = freq;
+        d_avg_valid = false;
+    }
+}
+
+/*! \brief Set detection threshold in dB above the noise estimate. */
+void signal_detector::set_threshold(float snr_db)
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+    d_threshold = std::max(snr_db, 0.0f);
+}
+
+/*! \brief Set how far below the threshold a detected signal may drop. */
+void signal_detector::set_hysteresis(float db)
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+    d_hysteresis = std::max(db, 0.0f);
+}
+
+/*! \brief Set how long a signal is kept after it was last seen. */
+void signal_detector::set_hold_time(double seconds)
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+    d_hold_time = std::max(seconds, 0.0);
+}
+
+/*! \brief Get the currently active signals, sorted by frequency. */
+std::vector<signal_detector::signal> signal_detector::get_signals() const
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+    std::vector<signal> sigs;
+
+    for (const auto &t : d_tracks)
+        if (t.hits >= DETECTOR_MIN_HITS)
+            sigs.push_back(t.sig);
+
+    std::sort(sigs.begin(), sigs.end(),
+              [](const signal &a, const signal &b) { return a.freq < b.freq; });
+
+    return sigs;
+}
+
+/*! \brief Forget all signals and restart averaging. */
+void signal_detector::reset()
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+    d_avg_valid = false;
+    d_tracks.clear();
+}
+
+/*! \brief Find signals in the averaged spectrum.
+ *
+ * Must be called with d_mutex held.
+ */
+void signal_detector::detect(unsigned int fftsize, double sample_rate, double now)
+{
+    const int n = (int)fftsize;
+    const int ref = std::max((int)fftsize / DETECTOR_REF_DIV, DETECTOR_REF_MIN);
+    const int guard = std::max(ref / 4, 2);
+    const double bin_width = sample_rate / (double)fftsize;
+    const float on_ratio = std::pow(10.0f, d_threshold / 10.0f);
+    const float keep_ratio = std::pow(10.0f, (d_threshold - d_hysteresis) / 10.0f);
+
+    d_cumsum[0] = 0.0;
+    for (int i = 0; i < n; i++)
+        d_cumsum[i + 1] = d_cumsum[i] + (double)d_avg[i];
+
+    d_detections.clear();
+    d_det_strong.clear();
+
+    // Bin 0 is the Nyquist bin after shifting and is not used
+    int start = -1;
+    float peak = 0.0f;
+    double wsum = 0.0;
+    double psum = 0.0;
+    for (int i = 1; i <= n; i++)
+    {
+        float ratio = 0.0f;
+
+        if (i < n)
+        {
+            // Leading and lagging reference windows, excluding guard cells
+            const int lead_hi = std::max(i - guard, 1);
+            const int lead_lo = std::max(lead_hi - ref, 1);
+            const int lag_lo = std::min(i + guard + 1, n);
+            const int lag_hi = std::min(lag_lo + ref, n);
+
+            double noise = -1.0;
+            if (lead_hi > lead_lo)
+                noise = (d_cumsum[lead_hi] - d_cumsum[lead_lo]) / (double)(lead_hi - lead_lo);
+            if (lag_hi > lag_lo)
+            {
+                const double lag = (d_cumsum[lag_hi] - d_cumsum[lag_lo]) / (double)(lag_hi - lag_lo);
+                noise = (noise < 0.0) ? lag : std::min(noise, lag);
+            }
+
+            if (noise > 0.0)
+                ratio = (float)(d_avg[i] / noise);
+        }
+
+        if (ratio >= keep_ratio)
+        {
+            if (start < 0)
+            {
+                start = i;
+                peak = 0.0f;
+                wsum = 0.0;
+                psum = 0.0;
+            }
+            peak = std::max(peak, ratio);
+            wsum += (double)d_avg[i] * (double)i;
+            psum += (double)d_avg[i];
+        }
+        else if (start >= 0)
+        {
+            // End of region. Regions where no bin reached the threshold can
+            // only keep an already tracked signal alive.
+            if (psum > 0.0)
+            {
+                signal s;
+                s.id = 0;
+                s.freq = d_center_freq + (wsum / psum - (double)(n / 2)) * bin_width;
+                s.bandwidth = (double)(i - start) * bin_width;
+                s.snr = 10.0f * std::log10(peak);
+                s.first_seen = now;
+                s.last_seen = now;
+                d_detections.push_back(s);
+                d_det_strong.push_back(peak >= on_ratio);
+            }
+            start = -1;
+        }
+    }
+}
+
+/*! \brief Match detections in the last frame against tracked signals.
+ *
+ * Must be called with d_mutex held.
+ */
+void signal_detector::update_tracks(double now)
+{
+    const double bin_width = d_sample_rate / (double)d_avg.size();
+    std::vector<bool> matched(d_tracks.size(), false);
+
+    for (size_t j = 0; j < d_detections.size(); j++)
+    {
+        const signal &det = d_detections[j];
+        bool found = false;
+
+        for (size_t k = 0; k < d_tracks.size(); k++)
+        {
+            if (matched[k])
+                continue;
+
+            signal &s = d_tracks[k].sig;
+            const double tol = std::max(s.bandwidth, det.bandwidth) / 2.0 + bin_width;
+            if (std::fabs(s.freq - det.freq) <= tol)
+            {
+                s.freq = det.freq;
+                s.bandwidth = det.bandwidth;
+                s.snr = det.snr;
+                s.last_seen = now;
+                d_tracks[k].hits++;
+                matched[k] = true;
+                found = true;
+                break;
+            }
+        }
+
+        if (!found && d_det_strong[j])
+        {
+            track t;
+            t.sig = det;
+            t.sig.id = d_next_id++;
+            t.hits = 1;
+            d_tracks.push_back(t);
+            matched.push_back(true);
+        }
+    }
+
+    // Drop signals not seen within the hold time, and unconfirmed signals
+    // that were missed in this frame.
+    std::vector<track> kept;
+    for (size_t k = 0; k < d_tracks.size(); k++)
+    {
+        const track &t = d_tracks[k];
+        if (t.hits < DETECTOR_MIN_HITS ? matched[k] : now - t.sig.last_seen <= d_hold_time)
+            kept.push_back(t);
+    }
+    d_tracks.swap(kept);
+}
@@ -0,0 +1,105 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef SIGNAL_DETECTOR_H
+#define SIGNAL_DETECTOR_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+class signal_detector;
+
+typedef std::shared_ptr<signal_detector> signal_detector_sptr;
+
+/*! \brief Detector for active signals in the baseband spectrum.
+ *
+ * Each FFT frame is averaged and compared against a local noise estimate
+ * using a cell averaging CFAR with "smallest of" selection between the
+ * leading and lagging reference windows, which keeps the noise estimate low
+ * next to strong or wide signals. Adjacent bins above the detection threshold
+ * form one detection.
+ *
+ * Detections are tracked from frame to frame with hysteresis: a signal must
+ * exceed the threshold to be detected but only needs to stay above the
+ * threshold minus the hysteresis to be kept, and it must be seen in a few
+ * consecutive frames before it is reported. Signals that disappear are kept
+ * in the list for the hold time.
+ *
+ * All methods are thread safe.
+ */
+class signal_detector
+{
+public:
+    /*! \brief A detected signal. */
+    struct signal {
+        unsigned int id;      /*!< Unique ID of the detection. */
+        double freq;          /*!< Center frequency in Hz. */
+        double bandwidth;     /*!< Occupied bandwidth in Hz. */
+        float  snr;           /*!< Peak signal to noise ratio in dB. */
+        double first_seen;    /*!< Time of first detection, seconds since the epoch. */
+        double last_seen;     /*!< Time of last detection, seconds since the epoch. */
+    };
+
+    signal_detector();
+
+    void process(const float *power, unsigned int fftsize, double sample_rate);
+
+    void set_enabled(bool enabled);
+    bool is_enabled() const;
+
+    void set_center_freq(double freq);
+    void set_threshold(float snr_db);
+    void set_hysteresis(float db);
+    void set_hold_time(double seconds);
+
+    std::vector<signal> get_signals() const;
+
+    void reset();
+
+private:
+    struct track {
+        signal       sig;
+        unsigned int hits;    /*!< Number of frames the signal has been seen in. */
+    };
+
+    void detect(unsigned int fftsize, double sample_rate, double now);
+    void update_tracks(double now);
+
+    mutable std::mutex  d_mutex;
+
+    bool                d_enabled;
+    double              d_center_freq;
+    double              d_sample_rate;
+    float               d_threshold;    /*!< Detection threshold in dB above noise. */
+    float               d_hysteresis;   /*!< Hysteresis in dB. */
+    double              d_hold_time;    /*!< Seconds a lost signal is kept in the list. */
+    unsigned int        d_next_id;
+    bool                d_avg_valid;
+
+    std::vector<float>  d_avg;          /*!< Averaged power spectrum. */
+    std::vector<double> d_cumsum;       /*!< Cumulative sum of d_avg for CFAR windows. */
+    std::vector<signal> d_detections;   /*!< Detections in the last frame. */
+    std::vector<bool>   d_det_strong;   /*!< Detection reached the threshold. */
+    std::vector<track>  d_tracks;
+};
+
+#endif /* SIGNAL_DETECTOR_H */
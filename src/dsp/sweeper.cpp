@@ -0,0 +1,406 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <volk/volk.h>
+#include <gnuradio/fft/window.h>
+#include "dsp/fft_reduce.h"
+#include "dsp/sweeper.h"
+
+/* Largest panorama, limited by the span the plotter can show */
+#define SWEEP_MAX_BINS (16u * 1024u * 1024u)
+
+
+sweeper::sweeper()
+    : d_start_freq(0.0),
+      d_sample_rate(0.0),
+      d_fftsize(0),
+      d_averages(1),
+      d_settle(0),
+      d_keep(0),
+      d_nsteps(0),
+      d_running(false),
+      d_quit(false),
+      d_collecting(false),
+      d_handoff(false),
+      d_step(0),
+      d_work_step(0),
+      d_skip(0),
+      d_collected(0),
+      d_sweeps(0),
+      d_rate(0.0),
+      d_fft(nullptr),
+      d_generation(0)
+{
+}
+
+sweeper::~sweeper()
+{
+    stop();
+    fft_plan_cache::Get().release(d_fft);
+}
+
+void sweeper::set_retune_func(retune_func func)
+{
+    stop();
+
+    std::lock_guard<std::mutex> lock(d_mutex);
+    d_retune = func;
+}
+
+/*! \brief Start sweeping.
+ *  \param start_freq Lower edge of the sweep range in Hz.
+ *  \param stop_freq Upper edge of the sweep range in Hz.
+ *  \param sample_rate Sample rate of the input samples.
+ *  \param fftsize FFT size used for each step.
+ *  \param averages Number of FFT frames averaged for each step.
+ *  \param settle_time Time in seconds to discard after each retune, including
+ *                    the samples still buffered from the previous step.
+ *  \param trim Fraction of the bins to discard at the edges (both edges).
+ *  \returns false if the parameters are invalid.
+ *
+ * The range is extended upwards to a whole number of steps. A sweep that is
+ * already running is stopped first.
+ */
+bool sweeper::start(double start_freq, double stop_freq, double sample_rate,
+                    unsigned int fftsize, unsigned int averages,
+                    double settle_time, double trim)
+{
+    if (stop_freq <= start_freq || sample_rate <= 0.0 || fftsize < 64 || averages < 1)
+        return false;
+
+    trim = std::min(std::max(trim, 0.0), 0.9);
+
+    // Keep an even number of bins so the step centers are on a bin boundary
+    const unsigned int keep = std::max(2u, (unsigned int)((1.0 - trim) * fftsize) & ~1u);
+    const double bin_width = sample_rate / (double)fftsize;
+    const unsigned int nsteps = (unsigned int)std::ceil((stop_freq - start_freq) / (keep * bin_width));
+
+    if ((size_t)nsteps * keep > SWEEP_MAX_BINS)
+        return false;
+
+    // The worker uses the sweep parameters without locking
+    stop();
+
+    if (!d_fft || (unsigned int)d_fft->inbuf_length() != fftsize)
+    {
+        fft_plan_cache::Get().release(d_fft);
+        d_fft = fft_plan_cache::Get().acquire(fftsize);
+    }
+
+    d_averages = averages;
+    d_settle = (unsigned int)(settle_time * sample_rate);
+    d_keep = keep;
+    d_nsteps = nsteps;
+
+    // Hann window normalized for amplitude, like the baseband FFT
+    d_window = gr::fft::window::build(gr::fft::window::WIN_HANN, fftsize, 6.76);
+    float sum = 0.0f;
+    for (auto v : d_window)
+        sum += v;
+    volk_32f_s32f_normalize(d_window.data(), sum / (float)fftsize, fftsize);
+
+    d_power.resize(fftsize);
+
+    {
+        std::lock_guard<std::mutex> lock(d_pan_mutex);
+        d_start_freq = start_freq;
+        d_sample_rate = sample_rate;
+        d_fftsize = fftsize;
+        d_panorama.assign((size_t)nsteps * keep, 0.0f);
+        d_generation++;
+        d_sweeps = 0;
+        d_rate = 0.0;
+        d_sweep_start = std::chrono::steady_clock::now();
+    }
+
+    retune_func retune;
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_buf.resize((size_t)fftsize * averages);
+        d_work.resize((size_t)fftsize * averages);
+        d_step = 0;
+        d_collected = 0;
+        d_handoff = false;
+        d_quit = false;
+        d_running = true;
+        retune = d_retune;
+    }
+
+    if (retune)
+        retune(step_center(0));
+
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_skip = d_settle;
+        d_collecting = true;
+    }
+
+    d_thread = std::thread(&sweeper::worker, this);
+
+    return true;
+}
+
+/*! \brief Stop sweeping. The panorama is kept.
+ *
+ * Waits for a retune in progress, so the caller can tune the receiver back
+ * when this returns.
+ */
+void sweeper::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_running = false;
+        d_collecting = false;
+        d_quit = true;
+    }
+    d_cond.notify_all();
+
+    if (d_thread.joinable())
+        d_thread.join();
+}
+
+bool sweeper::is_running() const
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+    return d_running;
+}
+
+/*! \brief Process input samples.
+ *
+ * Called from the GNU Radio thread. Samples are only copied into the step
+ * buffer, a complete step is handed to the worker thread. While the worker
+ * retunes, or is still busy with the previous step, samples are discarded.
+ */
+void sweeper::process(const gr_complex *in, int nitems)
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+
+    if (!d_collecting)
+        return;
+
+    const unsigned int needed = d_fftsize * d_averages;
+    unsigned int n = (unsigned int)nitems;
+
+    while (n > 0 && d_collected < needed)
+    {
+        if (d_skip > 0)
+        {
+            const unsigned int skip = std::min(d_skip, n);
+            d_skip -= skip;
+            in += skip;
+            n -= skip;
+            continue;
+        }
+
+        const unsigned int count = std::min(needed - d_collected, n);
+        memcpy(&d_buf[d_collected], in, sizeof(gr_complex) * count);
+        d_collected += count;
+        in += count;
+        n -= count;
+    }
+
+    if (d_collected < needed || d_handoff)
+        return;
+
+    d_buf.swap(d_work);
+    d_work_step = d_step;
+    d_handoff = true;
+    d_collecting = false;
+    d_cond.notify_one();
+}
+
+/*! \brief Get the stitched panorama.
+ *  \param data Receives the power of each bin, scaled like a single FFT of
+ *              the panorama size so that it can be shown as a spectrum.
+ *  \param generation Generation of the panorama in data. Updated when the
+ *                    panorama has changed since, otherwise data is not touched.
+ *  \returns 1 if data was updated, 0 if it is still current, -1 if there is
+ *           no panorama.
+ */
+int sweeper::get_panorama(std::vector<float> &data, unsigned int *generation) const
+{
+    std::lock_guard<std::mutex> lock(d_pan_mutex);
+
+    if (d_panorama.empty())
+        return -1;
+    if (*generation == d_generation)
+        return 0;
+
+    data = d_panorama;
+    *generation = d_generation;
+    return 1;
+}
+
+/*! \brief Get the stitched panorama reduced to screen resolution.
+ *  \param maxPoints Buffer receiving the peak power for each point.
+ *  \param avgPoints Buffer receiving the average power for each point.
+ *  \param start_bin Panorama bin at the center of the first point.
+ *  \param bins_per_point Number of panorama bins covered by each point.
+ *  \param npts Number of points to compute.
+ *  \param generation Generation of the panorama in the buffers, see
+ *                    get_panorama(). The caller must reset it when the other
+ *                    parameters change.
+ *  \returns 1 if the buffers were updated, 0 if they are still current, -1
+ *           if there is no panorama.
+ */
+int sweeper::get_panorama_reduced(float *maxPoints, float *avgPoints,
+                                  double start_bin, double bins_per_point,
+                                  int npts, unsigned int *generation) const
+{
+    std::lock_guard<std::mutex> lock(d_pan_mutex);
+
+    if (d_panorama.empty())
+        return -1;
+    if (*generation == d_generation)
+        return 0;
+
+    fft_reduce_power(d_panorama.data(), (unsigned int)d_panorama.size(),
+                     maxPoints, avgPoints, start_bin, bins_per_point, npts);
+    *generation = d_generation;
+    return 1;
+}
+
+/*! \brief Number of bins in the panorama. */
+unsigned int sweeper::get_panorama_size() const
+{
+    std::lock_guard<std::mutex> lock(d_pan_mutex);
+    return (unsigned int)d_panorama.size();
+}
+
+/*! \brief Get the frequency range covered by the panorama. */
+void sweeper::get_range(double *start_freq, double *stop_freq) const
+{
+    std::lock_guard<std::mutex> lock(d_pan_mutex);
+
+    *start_freq = d_start_freq;
+    *stop_freq = d_start_freq + (double)d_panorama.size() * d_sample_rate / (double)std::max(d_fftsize, 1u);
+}
+
+/*! \brief Sweep rate in MHz/s, estimated over the current sweep. */
+double sweeper::get_sweep_rate() const
+{
+    std::lock_guard<std::mutex> lock(d_pan_mutex);
+    return d_rate;
+}
+
+unsigned int sweeper::get_sweep_count() const
+{
+    std::lock_guard<std::mutex> lock(d_pan_mutex);
+    return d_sweeps;
+}
+
+/*! \brief Worker thread retuning and computing the collected steps.
+ *
+ * The receiver is retuned to the next step before the spectrum of the
+ * collected step is computed, so the tuner settles while the FFTs are
+ * running. The settle time is counted from the end of the retune.
+ */
+void sweeper::worker()
+{
+    std::unique_lock<std::mutex> lock(d_mutex);
+
+    while (true)
+    {
+        d_cond.wait(lock, [this] { return d_quit || d_handoff; });
+        if (d_quit)
+            break;
+
+        const unsigned int step = d_work_step;
+        const unsigned int next = (step + 1) % d_nsteps;
+        lock.unlock();
+
+        if (d_retune && d_nsteps > 1)
+            d_retune(step_center(next));
+
+        lock.lock();
+        if (d_quit)
+            break;
+        d_step = next;
+        d_skip = (d_nsteps > 1) ? d_settle : 0;
+        d_collected = 0;
+        d_collecting = true;
+        lock.unlock();
+
+        stitch_step(step);
+
+        lock.lock();
+        d_handoff = false;
+    }
+}
+
+/*! \brief Compute the averaged spectrum of a step and add it to the panorama.
+ *
+ * Called from the worker thread, which owns d_work at this point.
+ */
+void sweeper::stitch_step(unsigned int step)
+{
+    const unsigned int half = d_fftsize / 2;
+    gr_complex *inbuf = d_fft->get_inbuf();
+    const gr_complex *outbuf = d_fft->get_outbuf();
+
+    std::fill(d_power.begin(), d_power.end(), 0.0f);
+    for (unsigned int k = 0; k < d_averages; k++)
+    {
+        volk_32fc_32f_multiply_32fc(inbuf, &d_work[(size_t)k * d_fftsize], d_window.data(), d_fftsize);
+        d_fft->execute();
+
+        // Reuse the FFT input buffer for mag^2, shifted with DC in the center
+        float *pwr = (float *)inbuf;
+        volk_32fc_magnitude_squared_32f(pwr, outbuf + half, half);
+        volk_32fc_magnitude_squared_32f(pwr + half, outbuf, d_fftsize - half);
+        volk_32f_x2_add_32f(d_power.data(), d_power.data(), pwr, d_fftsize);
+    }
+
+    // The DC bin is dominated by the LO leakage of the tuner
+    d_power[half] = 0.5f * (d_power[half - 1] + d_power[half + 1]);
+
+    std::lock_guard<std::mutex> lock(d_pan_mutex);
+
+    // Scale the average so that the plotter normalization for an FFT of the
+    // panorama size gives the same level as for a single step.
+    const float ratio = (float)d_panorama.size() / (float)d_fftsize;
+    const float scale = ratio * ratio / (float)d_averages;
+
+    const unsigned int first = (d_fftsize - d_keep) / 2;
+    volk_32f_s32f_multiply_32f(&d_panorama[(size_t)step * d_keep], &d_power[first], scale, d_keep);
+    d_generation++;
+
+    const auto now = std::chrono::steady_clock::now();
+    const double elapsed = std::chrono::duration<double>(now - d_sweep_start).count();
+    const double covered = (double)(step + 1) * d_keep * d_sample_rate / d_fftsize;
+    if (elapsed > 0.0)
+        d_rate = covered / elapsed * 1.e-6;
+
+    if (step + 1 == d_nsteps)
+    {
+        d_sweeps++;
+        d_sweep_start = now;
+    }
+}
+
+/*! \brief RF frequency to tune to for a step. */
+double sweeper::step_center(unsigned int step) const
+{
+    const double bin_width = d_sample_rate / (double)d_fftsize;
+    return d_start_freq + ((double)step * d_keep + d_keep / 2.0) * bin_width;
+}
@@ -0,0 +1,132 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef SWEEPER_H
+#define SWEEPER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <gnuradio/gr_complex.h>
+#include "dsp/fft_plan_cache.h"
+
+
+class sweeper;
+
+typedef std::shared_ptr<sweeper> sweeper_sptr;
+
+/*! \brief Wideband spectrum sweep across several tunings.
+ *
+ * The sweeper steps the receiver frequency across a range that is wider than
+ * the sample rate and stitches the spectra of the individual steps into one
+ * panorama. For each step it:
+ *
+ *   1. Discards the samples received during the settle time. It must cover
+ *      the tuner settling and the samples from the previous frequency still
+ *      buffered in the flow graph, which depend on the device and rate.
+ *   2. Collects enough samples for the requested number of FFT averages.
+ *   3. Retunes to the next step, then computes the averaged power spectrum
+ *      of the collected samples while the tuner settles. Retuning and FFT
+ *      computation are thereby pipelined.
+ *   4. Trims the filter roll-off at both edges and copies the remaining bins
+ *      into the panorama.
+ *
+ * Steps are spaced by the number of kept bins, so the panorama has a uniform
+ * bin width of sample_rate / fftsize. Samples are fed from the GNU Radio
+ * thread using process(), which only copies them. Retuning and the FFTs run
+ * on a worker thread, so they never hold up the flow graph. The panorama is
+ * read by the GUI, reduced to screen resolution, and only when a step has
+ * been added since the last read. All methods are thread safe.
+ */
+class sweeper
+{
+public:
+    /*! \brief Function called to retune the receiver (RF frequency in Hz). */
+    typedef std::function<void(double)> retune_func;
+
+    sweeper();
+    ~sweeper();
+
+    void set_retune_func(retune_func func);
+
+    bool start(double start_freq, double stop_freq, double sample_rate,
+               unsigned int fftsize, unsigned int averages,
+               double settle_time, double trim);
+    void stop();
+    bool is_running() const;
+
+    void process(const gr_complex *in, int nitems);
+
+    int    get_panorama(std::vector<float> &data, unsigned int *generation) const;
+    int    get_panorama_reduced(float *maxPoints, float *avgPoints,
+                                double start_bin, double bins_per_point,
+                                int npts, unsigned int *generation) const;
+    unsigned int get_panorama_size() const;
+    void   get_range(double *start_freq, double *stop_freq) const;
+    double get_sweep_rate() const;
+    unsigned int get_sweep_count() const;
+
+private:
+    void   worker();
+    void   stitch_step(unsigned int step);
+    double step_center(unsigned int step) const;
+
+    mutable std::mutex  d_mutex;        /*!< Protects the collection state. */
+    mutable std::mutex  d_pan_mutex;    /*!< Protects the panorama and statistics. */
+    std::condition_variable d_cond;
+    std::thread         d_thread;
+    retune_func         d_retune;
+
+    // Set by start() while the worker is not running
+    double              d_start_freq;   /*!< Lower edge of the panorama. */
+    double              d_sample_rate;
+    unsigned int        d_fftsize;
+    unsigned int        d_averages;
+    unsigned int        d_settle;       /*!< Samples to discard after a retune. */
+    unsigned int        d_keep;         /*!< Bins kept from each step. */
+    unsigned int        d_nsteps;
+
+    bool                d_running;
+    bool                d_quit;         /*!< The worker should exit. */
+    bool                d_collecting;   /*!< Samples are collected, false while retuning. */
+    bool                d_handoff;      /*!< The worker owns d_work. */
+    unsigned int        d_step;         /*!< Step being collected. */
+    unsigned int        d_work_step;    /*!< Step in d_work. */
+    unsigned int        d_skip;         /*!< Samples left to discard. */
+    unsigned int        d_collected;    /*!< Samples collected for the current step. */
+
+    unsigned int        d_sweeps;       /*!< Number of completed sweeps. */
+    double              d_rate;         /*!< Sweep rate in MHz/s. */
+    std::chrono::steady_clock::time_point d_sweep_start;
+
+    fft_complex_fwd_t  *d_fft;          /*!< FFT object, owned by fft_plan_cache. */
+    std::vector<float>  d_window;
+    std::vector<gr_complex> d_buf;      /*!< Samples being collected by process(). */
+    std::vector<gr_complex> d_work;     /*!< Samples of a step being computed. */
+    std::vector<float>  d_power;        /*!< Averaged power of one step. */
+    std::vector<float>  d_panorama;
+    unsigned int        d_generation;   /*!< Incremented when the panorama changes. */
+};
+
+#endif /* SWEEPER_H */
@@ -0,0 +1,371 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <gnuradio/io_signature.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "interfaces/async_file_sink.h"
+
+/* Size of each write, a multiple of any direct I/O alignment */
+#define WRITE_CHUNK         (4 << 20)
+
+/* Alignment of direct I/O offsets */
+#define DIRECT_ALIGN        4096
+
+/* File space reserved ahead of the data */
+#define PREALLOC_BYTES      (256 << 20)
+
+
+async_file_sink_sptr make_async_file_sink(size_t item_size, const std::string &filename,
+                                          size_t buffer_size, bool direct_io,
+                                          uint64_t segment_bytes,
+                                          std::function<std::string(uint64_t)> segment_name)
+{
+    return gnuradio::get_initial_sptr(new async_file_sink(item_size, filename,
+                                                          buffer_size, direct_io,
+                                                          segment_bytes, segment_name));
+}
+
+async_file_sink::async_file_sink(size_t item_size, const std::string &filename,
+                                 size_t buffer_size, bool direct_io, uint64_t segment_bytes,
+                                 std::function<std::string(uint64_t)> segment_name)
+    : gr::sync_block ("async_file_sink",
+          gr::io_signature::make(1, 1, item_size),
+          gr::io_signature::make(0, 0, 0)),
+      d_item_size(item_size),
+      d_ring(buffer_size, WRITE_CHUNK, true),
+      d_direct(false),
+      d_offset(0),
+      d_allocated(0),
+      d_next_direct(false),
+      d_direct_io(direct_io),
+      d_segment_bytes(0),
+      d_segment_fill(0),
+      d_segment(0),
+      d_segment_name(segment_name)
+{
+#ifdef _WIN32
+    d_file = nullptr;
+    d_next_file = nullptr;
+#else
+    d_fd = -1;
+    d_next_fd = -1;
+#endif
+
+    // Whole items and direct I/O blocks, so that segments can be split anywhere
+    if (segment_bytes > 0 && segment_name)
+    {
+        uint64_t unit = DIRECT_ALIGN;
+        while (unit % item_size != 0)
+            unit += DIRECT_ALIGN;
+        d_segment_bytes = std::max((segment_bytes + unit - 1) / unit * unit, unit);
+    }
+
+    std::string error;
+    if (!open_next(filename, error))
+        throw std::runtime_error("can't open file: " + error);
+    use_next();
+
+    d_ring.start([this](const char *data, size_t len) { return write_bytes(data, len); },
+                 [this] { begin(); }, [this] { end(); });
+}
+
+async_file_sink::~async_file_sink()
+{
+    close();
+    d_ring.wait();
+}
+
+int async_file_sink::work(int noutput_items,
+                          gr_vector_const_void_star& input_items,
+                          gr_vector_void_star& output_items)
+{
+    (void) output_items;
+
+    d_ring.put(input_items[0], (size_t)noutput_items * d_item_size);
+
+    return noutput_items;
+}
+
+/*! \brief Stop recording, then write all buffered data and close the file.
+ *
+ * Samples arriving later are ignored. This returns at once, the buffered
+ * data is written by the writer thread. Use finished() to find out when the
+ * file has been closed. The destructor waits for it.
+ */
+void async_file_sink::close()
+{
+    d_ring.stop();
+}
+
+// Called on the writer thread before the first write
+void async_file_sink::begin()
+{
+    if (d_segment_bytes > 0)
+    {
+        const std::string name = d_segment_name(segment_items());
+        std::string error;
+        if (!open_next(name, error))
+            std::cout << "async_file_sink: can't open " << name << ": " << error << std::endl;
+    }
+}
+
+// Called on the writer thread after the last write
+void async_file_sink::end()
+{
+    // The next segment was opened for nothing
+    close_next();
+    close_file();
+
+    if (dropped() > 0)
+        std::cout << "async_file_sink: " << dropped() << " items dropped" << std::endl;
+}
+
+// Called on the writer thread
+bool async_file_sink::write_bytes(const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        if (d_segment_bytes > 0 && d_segment_fill == d_segment_bytes && !next_segment())
+            return false;
+
+        size_t n = len;
+        if (d_segment_bytes > 0)
+            n = (size_t)std::min((uint64_t)n, d_segment_bytes - d_segment_fill);
+        if (!write_file(data, n))
+            return false;
+
+        data += n;
+        len -= n;
+        d_segment_fill += n;
+    }
+
+    return true;
+}
+
+// Called on the writer thread
+bool async_file_sink::write_file(const char *data, size_t len)
+{
+    preallocate(len);
+
+#ifdef O_DIRECT
+    // Only the last write may not be a whole number of blocks
+    if (d_direct && len % DIRECT_ALIGN != 0)
+    {
+        fcntl(d_fd, F_SETFL, fcntl(d_fd, F_GETFL) & ~O_DIRECT);
+        d_direct = false;
+    }
+#endif
+
+#ifdef _WIN32
+    if (fwrite(data, 1, len, d_file) != len)
+    {
+        std::cout << "async_file_sink: write error" << std::endl;
+        return false;
+    }
+#else
+    while (len > 0)
+    {
+        ssize_t n = ::write(d_fd, data, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            std::cout << "async_file_sink: write error: " << strerror(errno) << std::endl;
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+        d_offset += (uint64_t)n;
+    }
+#endif
+
+    return true;
+}
+
+// Reserve file space ahead of the data, which keeps the file contiguous
+// and avoids allocating blocks in every write
+void async_file_sink::preallocate(size_t len)
+{
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+    if (d_offset + len <= d_allocated)
+        return;
+
+    if (fallocate(d_fd, FALLOC_FL_KEEP_SIZE, (off_t)d_allocated, PREALLOC_BYTES) == 0)
+        d_allocated += PREALLOC_BYTES;
+    else
+        d_allocated = UINT64_MAX;    // not supported, don't try again
+#else
+    (void) len;
+#endif
+}
+
+// Switch to the next segment, called on the writer thread
+bool async_file_sink::next_segment()
+{
+    const uint64_t segment = d_segment + 1;
+    std::string error;
+
+    if (d_next_name.empty())
+    {
+        const std::string name = d_segment_name(segment * segment_items());
+        if (!open_next(name, error))
+        {
+            std::cout << "async_file_sink: can't open " << name << ": " << error << std::endl;
+            return false;
+        }
+    }
+
+    use_next();
+    d_segment_fill = 0;
+    d_segment = segment;
+
+    // Open the following segment now rather than at the boundary. If this
+    // fails it is tried again when the segment is needed.
+    const std::string name = d_segment_name((segment + 1) * segment_items());
+    if (!open_next(name, error))
+        std::cout << "async_file_sink: can't open " << name << ": " << error << std::endl;
+
+    return true;
+}
+
+/*! \brief Open a file as the next segment, or as the first one. */
+bool async_file_sink::open_next(const std::string &filename, std::string &error)
+{
+#ifdef _WIN32
+    d_next_file = fopen(filename.c_str(), "ab");
+    if (!d_next_file)
+    {
+        error = strerror(errno);
+        return false;
+    }
+    setvbuf(d_next_file, nullptr, _IONBF, 0);
+#else
+    int flags = O_WRONLY | O_CREAT | O_APPEND;
+#ifdef O_DIRECT
+    if (d_direct_io)
+        flags |= O_DIRECT;
+#endif
+    d_next_direct = false;
+    d_next_fd = ::open(filename.c_str(), flags, 0664);
+#ifdef O_DIRECT
+    if (d_next_fd < 0 && d_direct_io)
+    {
+        // Not all file systems support O_DIRECT
+        d_next_fd = ::open(filename.c_str(), flags & ~O_DIRECT, 0664);
+    }
+    else if (d_next_fd >= 0 && d_direct_io)
+    {
+        d_next_direct = true;
+    }
+#endif
+    if (d_next_fd < 0)
+    {
+        error = strerror(errno);
+        return false;
+    }
+#ifdef F_NOCACHE
+    if (d_direct_io)
+        fcntl(d_next_fd, F_NOCACHE, 1);
+#endif
+#endif
+
+    d_next_name = filename;
+    return true;
+}
+
+/*! \brief Close the current file and continue in the next one. */
+void async_file_sink::use_next()
+{
+    close_file();
+
+#ifdef _WIN32
+    d_file = d_next_file;
+    d_next_file = nullptr;
+    d_offset = (uint64_t)_ftelli64(d_file);
+#else
+    d_fd = d_next_fd;
+    d_next_fd = -1;
+    d_direct = d_next_direct;
+
+    off_t end = lseek(d_fd, 0, SEEK_END);
+    d_offset = end > 0 ? (uint64_t)end : 0;
+
+#ifdef O_DIRECT
+    // Direct writes must start at an aligned offset
+    if (d_direct && d_offset % DIRECT_ALIGN != 0)
+    {
+        fcntl(d_fd, F_SETFL, fcntl(d_fd, F_GETFL) & ~O_DIRECT);
+        d_direct = false;
+    }
+#endif
+#endif
+
+    d_allocated = d_offset;
+    d_next_name.clear();
+}
+
+/*! \brief Close and delete the next segment if it has been opened. */
+void async_file_sink::close_next()
+{
+    if (d_next_name.empty())
+        return;
+
+#ifdef _WIN32
+    fclose(d_next_file);
+    d_next_file = nullptr;
+#else
+    ::close(d_next_fd);
+    d_next_fd = -1;
+#endif
+    std::remove(d_next_name.c_str());
+    d_next_name.clear();
+}
+
+void async_file_sink::close_file()
+{
+#ifdef _WIN32
+    if (d_file)
+        fclose(d_file);
+    d_file = nullptr;
+#else
+    if (d_fd < 0)
+        return;
+
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+    // Release space preallocated beyond the end of the data
+    if (d_allocated > d_offset && ftruncate(d_fd, (off_t)d_offset) != 0)
+        std::cout << "async_file_sink: can't truncate file" << std::endl;
+#endif
+
+    ::close(d_fd);
+    d_fd = -1;
+#endif
+}
@@ -0,0 +1,144 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef ASYNC_FILE_SINK_H
+#define ASYNC_FILE_SINK_H
+
+#include <gnuradio/sync_block.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include "interfaces/ring_writer.h"
+
+class async_file_sink;
+
+#if GNURADIO_VERSION < 0x030900
+typedef boost::shared_ptr<async_file_sink> async_file_sink_sptr;
+#else
+typedef std::shared_ptr<async_file_sink> async_file_sink_sptr;
+#endif
+
+/*! \brief Return a shared_ptr to a new instance of async_file_sink.
+ *  \param item_size Size of one item in bytes.
+ *  \param filename The file to write, new data is appended.
+ *  \param buffer_size Size of the buffer in bytes, rounded up to whole chunks.
+ *  \param direct_io Bypass the page cache where the platform supports it.
+ *  \param segment_bytes Start a new file after this many bytes, 0 for one file.
+ *  \param segment_name Name of the file starting with the given item.
+ *
+ * Throws std::runtime_error if the file can not be opened.
+ */
+async_file_sink_sptr make_async_file_sink(size_t item_size, const std::string &filename,
+                                          size_t buffer_size, bool direct_io,
+                                          uint64_t segment_bytes = 0,
+                                          std::function<std::string(uint64_t)> segment_name = nullptr);
+
+/*! \brief File sink that never blocks the flow graph.
+ *  \ingroup IO
+ *
+ * work() only copies samples into a large ring_writer buffer, which is
+ * written to the file by a separate thread in large sequential chunks.
+ * When the disk can not keep up the buffer fills and new samples are
+ * dropped, counted by dropped(), instead of stalling the source.
+ *
+ * On Linux the file is preallocated ahead of the data, and direct I/O uses
+ * O_DIRECT.
+ *
+ * Long recordings can be split into segments of a fixed size, rounded to
+ * whole items and direct I/O blocks. The writer opens the next file while
+ * the current one is being written and switches at the exact byte, so no
+ * sample is lost or repeated at the boundary.
+ */
+class async_file_sink : public gr::sync_block
+{
+    friend async_file_sink_sptr make_async_file_sink(size_t item_size,
+                                                     const std::string &filename,
+                                                     size_t buffer_size,
+                                                     bool direct_io,
+                                                     uint64_t segment_bytes,
+                                                     std::function<std::string(uint64_t)> segment_name);
+
+protected:
+    async_file_sink(size_t item_size, const std::string &filename,
+                    size_t buffer_size, bool direct_io, uint64_t segment_bytes,
+                    std::function<std::string(uint64_t)> segment_name);
+
+public:
+    ~async_file_sink();
+
+    int work(int noutput_items,
+             gr_vector_const_void_star& input_items,
+             gr_vector_void_star& output_items);
+
+    void close();
+
+    float fill_level() const { return d_ring.fill_level(); }
+    float peak_fill_level() const { return d_ring.peak_fill_level(); }
+    uint64_t dropped() const { return d_ring.dropped() / d_item_size; }
+    uint64_t items() const { return d_ring.bytes() / d_item_size; }
+    bool failed() const { return d_ring.failed(); }
+    bool finished() const { return d_ring.finished(); }
+    uint64_t segment() const { return d_segment; }
+    uint64_t segment_items() const { return d_segment_bytes / d_item_size; }
+
+private:
+    void begin();
+    void end();
+    bool write_bytes(const char *data, size_t len);
+    bool write_file(const char *data, size_t len);
+    void preallocate(size_t len);
+    bool open_next(const std::string &filename, std::string &error);
+    void use_next();
+    void close_next();
+    bool next_segment();
+    void close_file();
+
+    size_t      d_item_size;
+    ring_writer d_ring;
+
+    // Owned by the writer thread
+#ifdef _WIN32
+    FILE       *d_file;
+#else
+    int         d_fd;
+#endif
+    bool        d_direct;         /*!< Direct I/O is in use. */
+    uint64_t    d_offset;         /*!< File size. */
+    uint64_t    d_allocated;      /*!< Preallocated file size. */
+
+    // The next segment, opened in advance by the writer thread
+#ifdef _WIN32
+    FILE       *d_next_file;
+#else
+    int         d_next_fd;
+#endif
+    bool        d_next_direct;
+    std::string d_next_name;
+
+    bool        d_direct_io;      /*!< Direct I/O was requested. */
+    uint64_t    d_segment_bytes;  /*!< Segment size, 0 for one file. */
+    uint64_t    d_segment_fill;   /*!< Bytes in the current segment. */
+    std::atomic<uint64_t> d_segment;  /*!< Index of the current segment. */
+    std::function<std::string(uint64_t)> d_segment_name;
+};
+
+#endif // ASYNC_FILE_SINK_H
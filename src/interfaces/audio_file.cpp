@@ -0,0 +1,235 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#ifdef WITH_SNDFILE
+#include <sndfile.h>
+#endif
+#include "interfaces/audio_file.h"
+
+/* Size of the WAV header written by audio_file_writer::open() */
+#define WAV_HEADER_SIZE     44
+
+/* Largest WAV data chunk, its size and the RIFF size must fit in 32 bits */
+#define WAV_MAX_DATA_BYTES  (UINT32_MAX - (WAV_HEADER_SIZE - 8))
+
+
+const char *audio_file_format_name(audio_file_format fmt)
+{
+    switch (fmt)
+    {
+    case AUDIO_FORMAT_FLAC:
+        return "flac";
+    case AUDIO_FORMAT_WAV:
+    default:
+        return "wav";
+    }
+}
+
+audio_file_format audio_file_format_from_name(const std::string &name)
+{
+    std::string lower(name);
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c) { return (char)std::tolower(c); });
+
+    const std::string flac(audio_file_format_name(AUDIO_FORMAT_FLAC));
+    if (lower == flac)
+        return AUDIO_FORMAT_FLAC;
+    if (lower.size() > flac.size()
+        && lower.compare(lower.size() - flac.size() - 1, std::string::npos, "." + flac) == 0)
+        return AUDIO_FORMAT_FLAC;
+
+    return AUDIO_FORMAT_WAV;
+}
+
+bool audio_file_format_supported(audio_file_format fmt)
+{
+#ifdef WITH_SNDFILE
+    (void) fmt;
+    return true;
+#else
+    return fmt == AUDIO_FORMAT_WAV;
+#endif
+}
+
+uint64_t audio_file_max_frames(audio_file_format fmt)
+{
+    if (fmt == AUDIO_FORMAT_FLAC)
+        return 0;
+    return WAV_MAX_DATA_BYTES / AUDIO_FILE_FRAME_BYTES;
+}
+
+static void put_le16(unsigned char *p, uint16_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+static void put_le32(unsigned char *p, uint32_t v)
+{
+    put_le16(p, v & 0xffff);
+    put_le16(p + 2, v >> 16);
+}
+
+audio_file_writer::audio_file_writer()
+    : d_file(nullptr),
+      d_data_bytes(0),
+      d_sndfile(nullptr)
+{
+}
+
+audio_file_writer::~audio_file_writer()
+{
+    close();
+}
+
+/**
+ * Create a new file, closing any file already open.
+ * @param filename The file to create.
+ * @param sample_rate The audio sample rate.
+ * @param fmt The file format.
+ * @param error Set to the reason when the file can not be created.
+ * @return Whether the file was created.
+ */
+bool audio_file_writer::open(const std::string &filename, unsigned int sample_rate,
+                             audio_file_format fmt, std::string &error)
+{
+    close();
+
+    if (fmt == AUDIO_FORMAT_FLAC)
+    {
+#ifdef WITH_SNDFILE
+        SF_INFO info;
+        memset(&info, 0, sizeof(info));
+        info.samplerate = (int)sample_rate;
+        info.channels = 2;
+        info.format = SF_FORMAT_FLAC | SF_FORMAT_PCM_16;
+        d_sndfile = sf_open(filename.c_str(), SFM_WRITE, &info);
+        if (!d_sndfile)
+        {
+            error = sf_strerror(nullptr);
+            return false;
+        }
+        return true;
+#else
+        error = "FLAC requires libsndfile";
+        return false;
+#endif
+    }
+
+    d_file = fopen(filename.c_str(), "wb");
+    if (!d_file)
+    {
+        error = strerror(errno);
+        return false;
+    }
+
+    // Sizes are filled in by close()
+    unsigned char header[WAV_HEADER_SIZE] = {0};
+    memcpy(header, "RIFF", 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put_le32(header + 16, 16);
+    put_le16(header + 20, 1);                       // PCM
+    put_le16(header + 22, 2);                       // channels
+    put_le32(header + 24, sample_rate);
+    put_le32(header + 28, sample_rate * AUDIO_FILE_FRAME_BYTES);
+    put_le16(header + 32, AUDIO_FILE_FRAME_BYTES);
+    put_le16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    if (fwrite(header, 1, sizeof(header), d_file) != sizeof(header))
+    {
+        error = strerror(errno);
+        fclose(d_file);
+        d_file = nullptr;
+        return false;
+    }
+    d_data_bytes = 0;
+
+    return true;
+}
+
+/*! \brief Write interleaved left and right samples. */
+bool audio_file_writer::write(const int16_t *data, size_t frames)
+{
+#ifdef WITH_SNDFILE
+    if (d_sndfile)
+        return sf_writef_short((SNDFILE *)d_sndfile, data, (sf_count_t)frames)
+               == (sf_count_t)frames;
+#endif
+
+    if (!d_file)
+        return false;
+
+    if (frames > audio_file_max_frames(AUDIO_FORMAT_WAV) - d_data_bytes / AUDIO_FILE_FRAME_BYTES)
+        return false;
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    d_swapped.resize(2 * frames);
+    for (size_t i = 0; i < 2 * frames; i++)
+        d_swapped[i] = (int16_t)__builtin_bswap16((uint16_t)data[i]);
+    data = d_swapped.data();
+#endif
+
+    const size_t bytes = frames * AUDIO_FILE_FRAME_BYTES;
+    if (fwrite(data, 1, bytes, d_file) != bytes)
+        return false;
+    d_data_bytes += bytes;
+
+    return true;
+}
+
+void audio_file_writer::close()
+{
+#ifdef WITH_SNDFILE
+    if (d_sndfile)
+        sf_close((SNDFILE *)d_sndfile);
+#endif
+    d_sndfile = nullptr;
+
+    if (!d_file)
+        return;
+
+    unsigned char size[4];
+    put_le32(size, (uint32_t)d_data_bytes + WAV_HEADER_SIZE - 8);
+    fseek(d_file, 4, SEEK_SET);
+    fwrite(size, 1, 4, d_file);
+    put_le32(size, (uint32_t)d_data_bytes);
+    fseek(d_file, 40, SEEK_SET);
+    fwrite(size, 1, 4, d_file);
+
+    fclose(d_file);
+    d_file = nullptr;
+}
+
+bool audio_file_writer::is_open() const
+{
+    return d_file || d_sndfile;
+}
+
+/*! \brief Exchange the open files of two writers. */
+void audio_file_writer::swap(audio_file_writer &other)
+{
+    std::swap(d_file, other.d_file);
+    std::swap(d_data_bytes, other.d_data_bytes);
+    std::swap(d_sndfile, other.d_sndfile);
+}
@@ -0,0 +1,84 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef AUDIO_FILE_H
+#define AUDIO_FILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/* Size of one stereo 16 bit frame */
+#define AUDIO_FILE_FRAME_BYTES  (2 * sizeof(int16_t))
+
+/*! \brief Audio recording file formats, both stereo 16 bit. */
+enum audio_file_format {
+    AUDIO_FORMAT_WAV,
+    AUDIO_FORMAT_FLAC
+};
+
+/*! \brief Name and file extension of an audio format, e.g. "flac". */
+const char *audio_file_format_name(audio_file_format fmt);
+
+/*! \brief Audio format from its name or from a file name ending in its extension.
+ *
+ * Anything unknown is WAV.
+ */
+audio_file_format audio_file_format_from_name(const std::string &name);
+
+/*! \brief Whether this build can write the format. FLAC requires libsndfile. */
+bool audio_file_format_supported(audio_file_format fmt);
+
+/*! \brief Most frames a file of the format can hold, 0 for no limit.
+ *
+ * WAV sizes are 32 bit, so a WAV file holds less than 4 GiB of audio.
+ */
+uint64_t audio_file_max_frames(audio_file_format fmt);
+
+/*! \brief Writes stereo 16 bit audio to a WAV or FLAC file.
+ *
+ * Not thread safe, meant to be used by the writer thread of a sink. WAV is
+ * written directly, in little endian on any host, FLAC is encoded by
+ * libsndfile. Writing fails once a file would exceed audio_file_max_frames().
+ */
+class audio_file_writer
+{
+public:
+    audio_file_writer();
+    ~audio_file_writer();
+    audio_file_writer(const audio_file_writer &) = delete;
+    audio_file_writer &operator=(const audio_file_writer &) = delete;
+
+    bool open(const std::string &filename, unsigned int sample_rate,
+              audio_file_format fmt, std::string &error);
+    bool write(const int16_t *data, size_t frames);
+    void close();
+    bool is_open() const;
+    void swap(audio_file_writer &other);
+
+private:
+    FILE           *d_file;         /*!< WAV file. */
+    uint64_t        d_data_bytes;   /*!< Size of the WAV data chunk. */
+    void           *d_sndfile;      /*!< SNDFILE handle for FLAC. */
+    std::vector<int16_t> d_swapped; /*!< Samples in little endian, on big endian hosts. */
+};
+
+#endif // AUDIO_FILE_H
@@ -0,0 +1,208 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <gnuradio/io_signature.h>
+#include "interfaces/audio_file_sink.h"
+
+/* Audio buffered for the writer thread */
+#define BUFFER_SECONDS      10
+
+/* Audio encoded and written at a time */
+#define CHUNK_SECONDS       0.25
+
+
+audio_file_sink_sptr make_audio_file_sink(const std::string &filename,
+                                          unsigned int sample_rate,
+                                          audio_file_format fmt,
+                                          uint64_t segment_frames,
+                                          std::function<std::string(uint64_t)> segment_name)
+{
+    return gnuradio::get_initial_sptr(new audio_file_sink(filename, sample_rate, fmt,
+                                                          segment_frames, segment_name));
+}
+
+audio_file_sink::audio_file_sink(const std::string &filename, unsigned int sample_rate,
+                                 audio_file_format fmt, uint64_t segment_frames,
+                                 std::function<std::string(uint64_t)> segment_name)
+    : gr::sync_block ("audio_file_sink",
+          gr::io_signature::make(2, 2, sizeof(float)),
+          gr::io_signature::make(0, 0, 0)),
+      d_sample_rate(sample_rate),
+      d_fmt(fmt),
+      d_ring((size_t)(BUFFER_SECONDS * sample_rate) * AUDIO_FILE_FRAME_BYTES,
+             std::max((size_t)(CHUNK_SECONDS * sample_rate), (size_t)1) * AUDIO_FILE_FRAME_BYTES,
+             false),
+      d_segment_frames(0),
+      d_segment_fill(0),
+      d_segment(0),
+      d_segment_name(segment_name)
+{
+    // Roll over to a new file before the format's size limit
+    if (segment_name)
+    {
+        const uint64_t max_frames = audio_file_max_frames(fmt);
+        d_segment_frames = segment_frames;
+        if (max_frames > 0 && (segment_frames == 0 || segment_frames > max_frames))
+            d_segment_frames = max_frames;
+    }
+
+    std::string error;
+    if (!d_writer.open(filename, sample_rate, fmt, error))
+        throw std::runtime_error(error);
+
+    d_ring.start([this](const char *data, size_t len) {
+                     return write_frames((const int16_t *)data, len / AUDIO_FILE_FRAME_BYTES);
+                 },
+                 [this] { begin(); }, [this] { end(); });
+}
+
+audio_file_sink::~audio_file_sink()
+{
+    close();
+}
+
+static void convert(const float *in0, const float *in1, int16_t *out, size_t frames)
+{
+    for (size_t i = 0; i < frames; i++)
+    {
+        out[2 * i] = (int16_t)std::lrint(std::min(std::max(in0[i], -1.0f), 1.0f) * 32767.0f);
+        out[2 * i + 1] = (int16_t)std::lrint(std::min(std::max(in1[i], -1.0f), 1.0f) * 32767.0f);
+    }
+}
+
+int audio_file_sink::work(int noutput_items,
+                          gr_vector_const_void_star& input_items,
+                          gr_vector_void_star& output_items)
+{
+    (void) output_items;
+
+    const float *in0 = (const float *)input_items[0];
+    const float *in1 = (const float *)input_items[1];
+    const size_t len = (size_t)noutput_items * AUDIO_FILE_FRAME_BYTES;
+
+    // The buffer is whole frames, so a frame never wraps
+    char *part[2];
+    size_t part_len[2];
+    const size_t n = d_ring.reserve(len, part, part_len);
+    const size_t first = part_len[0] / AUDIO_FILE_FRAME_BYTES;
+
+    convert(in0, in1, (int16_t *)part[0], first);
+    convert(in0 + first, in1 + first, (int16_t *)part[1], part_len[1] / AUDIO_FILE_FRAME_BYTES);
+    d_ring.commit(n, len);
+
+    return noutput_items;
+}
+
+/*! \brief Write all buffered audio and close the file.
+ *
+ * Audio arriving later is ignored.
+ */
+void audio_file_sink::close()
+{
+    d_ring.stop();
+    d_ring.wait();
+}
+
+// Called on the writer thread before the first write
+void audio_file_sink::begin()
+{
+    if (d_segment_frames > 0)
+        open_next(1);
+}
+
+// Called on the writer thread after the last write
+void audio_file_sink::end()
+{
+    // The next segment was created for nothing
+    close_next();
+    d_writer.close();
+
+    if (dropped() > 0)
+        std::cout << "audio_file_sink: " << dropped() << " frames dropped" << std::endl;
+}
+
+// Called on the writer thread
+bool audio_file_sink::write_frames(const int16_t *data, size_t frames)
+{
+    while (frames > 0)
+    {
+        if (d_segment_frames > 0 && d_segment_fill == d_segment_frames)
+        {
+            const uint64_t segment = d_segment + 1;
+            if (!d_next_writer.is_open() && !open_next(segment))
+                return false;
+
+            // Switch to the file opened in advance, then open the following one
+            d_writer.swap(d_next_writer);
+            d_next_writer.close();
+            d_next_name.clear();
+            d_segment_fill = 0;
+            d_segment = segment;
+            open_next(segment + 1);
+        }
+
+        size_t n = frames;
+        if (d_segment_frames > 0)
+            n = (size_t)std::min((uint64_t)n, d_segment_frames - d_segment_fill);
+        if (!d_writer.write(data, n))
+        {
+            std::cout << "audio_file_sink: write error" << std::endl;
+            return false;
+        }
+
+        data += 2 * n;
+        frames -= n;
+        d_segment_fill += n;
+    }
+
+    return true;
+}
+
+// Create the file of a segment, called on the writer thread
+bool audio_file_sink::open_next(uint64_t segment)
+{
+    const std::string name = d_segment_name(segment * d_segment_frames);
+    std::string error;
+
+    if (!d_next_writer.open(name, d_sample_rate, d_fmt, error))
+    {
+        std::cout << "audio_file_sink: can't create " << name << ": " << error << std::endl;
+        return false;
+    }
+    d_next_name = name;
+
+    return true;
+}
+
+// Close and delete the next segment if it has been created
+void audio_file_sink::close_next()
+{
+    if (d_next_name.empty())
+        return;
+
+    d_next_writer.close();
+    std::remove(d_next_name.c_str());
+    d_next_name.clear();
+}
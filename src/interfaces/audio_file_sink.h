@@ -0,0 +1,117 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef AUDIO_FILE_SINK_H
+#define AUDIO_FILE_SINK_H
+
+#include <gnuradio/sync_block.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "interfaces/audio_file.h"
+#include "interfaces/ring_writer.h"
+
+class audio_file_sink;
+
+#if GNURADIO_VERSION < 0x030900
+typedef boost::shared_ptr<audio_file_sink> audio_file_sink_sptr;
+#else
+typedef std::shared_ptr<audio_file_sink> audio_file_sink_sptr;
+#endif
+
+/*! \brief Return a shared_ptr to a new instance of audio_file_sink.
+ *  \param filename The file to create.
+ *  \param sample_rate The audio sample rate.
+ *  \param fmt The file format.
+ *  \param segment_frames Start a new file after this many frames, 0 for one file
+ *                        up to the size limit of the format.
+ *  \param segment_name Name of the file starting with the given frame.
+ *
+ * Throws std::runtime_error if the file can not be created.
+ */
+audio_file_sink_sptr make_audio_file_sink(const std::string &filename,
+                                          unsigned int sample_rate,
+                                          audio_file_format fmt,
+                                          uint64_t segment_frames = 0,
+                                          std::function<std::string(uint64_t)> segment_name = nullptr);
+
+/*! \brief Records stereo audio to a WAV or FLAC file without blocking the flow graph.
+ *  \ingroup IO
+ *
+ * work() converts the audio to 16 bit samples in a ring_writer buffer of a
+ * few seconds. A separate thread encodes and writes it, so FLAC encoding and
+ * slow disks never stall the audio output. When the buffer is full new
+ * audio is dropped and counted by dropped().
+ *
+ * Long recordings can be split into files of a fixed length. The next file
+ * is created while the current one is written, and the switch happens at
+ * the exact frame. WAV files are always split before they reach the 4 GiB
+ * limit of the format when a segment name is given, otherwise recording
+ * stops there.
+ */
+class audio_file_sink : public gr::sync_block
+{
+    friend audio_file_sink_sptr make_audio_file_sink(const std::string &filename,
+                                                     unsigned int sample_rate,
+                                                     audio_file_format fmt,
+                                                     uint64_t segment_frames,
+                                                     std::function<std::string(uint64_t)> segment_name);
+
+protected:
+    audio_file_sink(const std::string &filename, unsigned int sample_rate,
+                    audio_file_format fmt, uint64_t segment_frames,
+                    std::function<std::string(uint64_t)> segment_name);
+
+public:
+    ~audio_file_sink();
+
+    int work(int noutput_items,
+             gr_vector_const_void_star& input_items,
+             gr_vector_void_star& output_items);
+
+    void close();
+
+    uint64_t dropped() const { return d_ring.dropped() / AUDIO_FILE_FRAME_BYTES; }
+    bool failed() const { return d_ring.failed(); }
+    uint64_t segment() const { return d_segment; }
+
+private:
+    void begin();
+    void end();
+    bool write_frames(const int16_t *data, size_t frames);
+    bool open_next(uint64_t segment);
+    void close_next();
+
+    unsigned int          d_sample_rate;
+    audio_file_format     d_fmt;
+    ring_writer           d_ring;       /*!< Interleaved left and right. */
+
+    // Owned by the writer thread
+    audio_file_writer     d_writer;
+    audio_file_writer     d_next_writer;    /*!< The next segment, opened in advance. */
+    std::string           d_next_name;
+    uint64_t              d_segment_frames; /*!< Segment length, 0 for one file. */
+    uint64_t              d_segment_fill;   /*!< Frames in the current segment. */
+    std::atomic<uint64_t> d_segment;        /*!< Index of the current segment. */
+    std::function<std::string(uint64_t)> d_segment_name;
+};
+
+#endif // AUDIO_FILE_SINK_H
@@ -0,0 +1,72 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <gnuradio/io_signature.h>
+#include "interfaces/iq_file_sink.h"
+
+
+iq_file_sink_sptr make_iq_file_sink(const std::string &filename, iq_format fmt,
+                                    size_t buffer_size, bool direct_io,
+                                    uint64_t segment_bytes,
+                                    std::function<std::string(uint64_t)> segment_name)
+{
+    return gnuradio::get_initial_sptr(new iq_file_sink(filename, fmt, buffer_size,
+                                                       direct_io, segment_bytes,
+                                                       segment_name));
+}
+
+iq_file_sink::iq_file_sink(const std::string &filename, iq_format fmt,
+                           size_t buffer_size, bool direct_io,
+                           uint64_t segment_bytes,
+                           std::function<std::string(uint64_t)> segment_name)
+    : gr::hier_block2("iq_file_sink",
+                      gr::io_signature::make(1, 1, sizeof(gr_complex)),
+                      gr::io_signature::make(0, 0, 0)),
+      d_fmt(fmt)
+{
+    d_sink = make_async_file_sink(iq_format_item_size(fmt), filename, buffer_size, direct_io,
+                                  segment_bytes, segment_name);
+
+    if (fmt == IQ_FORMAT_CF32)
+    {
+        connect(self(), 0, d_sink, 0);
+    }
+    else
+    {
+        d_encode = make_iq_encode(fmt);
+        connect(self(), 0, d_encode, 0);
+        connect(d_encode, 0, d_sink, 0);
+    }
+}
+
+iq_file_sink::~iq_file_sink()
+{
+
+}
+
+/*! \brief Stop recording, buffered samples are written in the background.
+ *
+ * Samples arriving later are ignored. finished() tells when the file has
+ * been closed.
+ */
+void iq_file_sink::close()
+{
+    d_sink->close();
+}
@@ -0,0 +1,85 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef IQ_FILE_SINK_H
+#define IQ_FILE_SINK_H
+
+#include <gnuradio/hier_block2.h>
+#include <string>
+#include "dsp/iq_convert.h"
+#include "interfaces/async_file_sink.h"
+
+class iq_file_sink;
+
+#if GNURADIO_VERSION < 0x030900
+typedef boost::shared_ptr<iq_file_sink> iq_file_sink_sptr;
+#else
+typedef std::shared_ptr<iq_file_sink> iq_file_sink_sptr;
+#endif
+
+/*! \brief Return a shared_ptr to a new instance of iq_file_sink.
+ *  \param filename The file to write.
+ *  \param fmt Sample format of the file.
+ *  \param buffer_size Size of the write buffer in bytes.
+ *  \param direct_io Bypass the page cache where the platform supports it.
+ *  \param segment_bytes Start a new file after this many bytes, 0 for one file.
+ *  \param segment_name Name of the file starting with the given sample.
+ *
+ * Throws std::runtime_error if the file can not be opened.
+ */
+iq_file_sink_sptr make_iq_file_sink(const std::string &filename, iq_format fmt,
+                                    size_t buffer_size, bool direct_io,
+                                    uint64_t segment_bytes = 0,
+                                    std::function<std::string(uint64_t)> segment_name = nullptr);
+
+/*! \brief Write complex samples to an I/Q file in the selected format. */
+class iq_file_sink : public gr::hier_block2
+{
+    friend iq_file_sink_sptr make_iq_file_sink(const std::string &filename,
+                                               iq_format fmt, size_t buffer_size,
+                                               bool direct_io, uint64_t segment_bytes,
+                                               std::function<std::string(uint64_t)> segment_name);
+
+protected:
+    iq_file_sink(const std::string &filename, iq_format fmt,
+                 size_t buffer_size, bool direct_io, uint64_t segment_bytes,
+                 std::function<std::string(uint64_t)> segment_name);
+
+public:
+    ~iq_file_sink();
+
+    void close();
+    iq_format format() const { return d_fmt; }
+    float fill_level() const { return d_sink->fill_level(); }
+    float peak_fill_level() const { return d_sink->peak_fill_level(); }
+    uint64_t dropped() const { return d_sink->dropped(); }
+    uint64_t samples() const { return d_sink->items(); }
+    bool failed() const { return d_sink->failed(); }
+    bool finished() const { return d_sink->finished(); }
+    uint64_t segment() const { return d_sink->segment(); }
+    uint64_t segment_samples() const { return d_sink->segment_items(); }
+
+private:
+    iq_format                    d_fmt;
+    iq_encode_sptr               d_encode;  /*!< Converter, unused for cf32. */
+    async_file_sink_sptr         d_sink;
+};
+
+#endif // IQ_FILE_SINK_H
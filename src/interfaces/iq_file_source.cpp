@@ -0,0 +1,336 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <gnuradio/io_signature.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "interfaces/iq_file_source.h"
+
+/* Longest time produced by one call to work() while paced */
+#define PACE_CHUNK_SECONDS  0.02
+
+/* Restart pacing when this far behind, instead of catching up */
+#define PACE_MAX_LAG        0.5
+
+/* Data read ahead after a seek */
+#define SEEK_READAHEAD      (4 << 20)
+
+
+iq_file_source_sptr make_iq_file_source(const std::string &filename,
+                                        iq_format fmt, double sample_rate)
+{
+    return gnuradio::get_initial_sptr(new iq_file_source(filename, fmt, sample_rate));
+}
+
+iq_file_source::iq_file_source(const std::string &filename, iq_format fmt,
+                               double sample_rate)
+    : gr::sync_block ("iq_file_source",
+          gr::io_signature::make(0, 0, 0),
+          gr::io_signature::make(1, 1, sizeof(gr_complex))),
+      d_fmt(fmt),
+      d_item_size(iq_format_item_size(fmt)),
+      d_data(nullptr),
+      d_map_size(0),
+      d_length(0),
+#ifdef _WIN32
+      d_file(INVALID_HANDLE_VALUE),
+      d_mapping(NULL),
+#endif
+      d_pos(0),
+      d_seek(-1),
+      d_loop_start(0),
+      d_loop_end(0),
+      d_sample_rate(sample_rate),
+      d_speed(1.0),
+      d_pace_samples(0),
+      d_pace_rate(0.0)
+{
+    uint64_t size = 0;
+
+#ifdef _WIN32
+    d_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                         NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (d_file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("can not open file");
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(d_file, &file_size))
+    {
+        close();
+        throw std::runtime_error("can not get file size");
+    }
+    size = file_size.QuadPart;
+
+    if (size > 0)
+    {
+        d_mapping = CreateFileMappingA(d_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (d_mapping)
+            d_data = (const char *)MapViewOfFile(d_mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!d_data)
+        {
+            close();
+            throw std::runtime_error("can not map file");
+        }
+    }
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error(strerror(errno));
+
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        std::string error = strerror(errno);
+        ::close(fd);
+        throw std::runtime_error(error);
+    }
+    size = st.st_size;
+
+    if (size > (uint64_t)SIZE_MAX)
+    {
+        ::close(fd);
+        throw std::runtime_error("file too large to map");
+    }
+
+    if (size > 0)
+    {
+        void *data = mmap(nullptr, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            std::string error = strerror(errno);
+            ::close(fd);
+            throw std::runtime_error(error);
+        }
+        d_data = (const char *)data;
+        d_map_size = (size_t)size;
+        madvise(data, (size_t)size, MADV_SEQUENTIAL);
+    }
+
+    // The mapping stays valid without the descriptor
+    ::close(fd);
+#endif
+
+    d_length = size / d_item_size;
+}
+
+iq_file_source::~iq_file_source()
+{
+    close();
+}
+
+void iq_file_source::close()
+{
+#ifdef _WIN32
+    if (d_data)
+        UnmapViewOfFile(d_data);
+    if (d_mapping)
+        CloseHandle(d_mapping);
+    if (d_file != INVALID_HANDLE_VALUE)
+        CloseHandle(d_file);
+    d_mapping = NULL;
+    d_file = INVALID_HANDLE_VALUE;
+#else
+    if (d_data)
+        munmap((void *)d_data, d_map_size);
+#endif
+    d_data = nullptr;
+}
+
+/**
+ * Seek to a sample position.
+ * @param pos Sample number from the beginning of the file.
+ * @returns False if the position is after the end of the file.
+ *
+ * Safe to call from any thread while the flow graph is running.
+ */
+bool iq_file_source::seek(uint64_t pos)
+{
+    if (pos > d_length)
+        return false;
+
+    d_seek = (int64_t)pos;
+    return true;
+}
+
+/*! \brief The sample being played, including a pending seek. */
+uint64_t iq_file_source::position() const
+{
+    int64_t pending = d_seek;
+    return pending >= 0 ? (uint64_t)pending : d_pos.load();
+}
+
+/*! \brief Whether playback has reached the end of the file, never while looping. */
+bool iq_file_source::at_end() const
+{
+    std::lock_guard<std::mutex> lock(d_loop_mutex);
+    return d_loop_end <= d_loop_start && position() >= d_length;
+}
+
+void iq_file_source::set_sample_rate(double sample_rate)
+{
+    d_sample_rate = sample_rate;
+}
+
+/**
+ * Set the playback speed.
+ * @param speed Speed relative to the sample rate, 0 for as fast as possible.
+ */
+void iq_file_source::set_speed(double speed)
+{
+    d_speed = std::max(speed, 0.0);
+}
+
+/**
+ * Loop a region of the file.
+ * @param start First sample of the region.
+ * @param end Sample after the region, or start to stop looping.
+ *
+ * Playback outside the region jumps to its start.
+ */
+void iq_file_source::set_loop(uint64_t start, uint64_t end)
+{
+    end = std::min(end, d_length);
+    start = std::min(start, end);
+
+    std::lock_guard<std::mutex> lock(d_loop_mutex);
+    d_loop_start = start;
+    d_loop_end = end;
+}
+
+int iq_file_source::work(int noutput_items,
+                         gr_vector_const_void_star& input_items,
+                         gr_vector_void_star& output_items)
+{
+    (void) input_items;
+
+    gr_complex *out = (gr_complex *)output_items[0];
+
+    int64_t pending = d_seek.exchange(-1);
+    if (pending >= 0)
+    {
+        d_pos = (uint64_t)pending;
+        d_pace_rate = 0.0;
+#ifndef _WIN32
+        // Start reading in the background, so scrubbing does not wait for each page
+        if (d_data && (uint64_t)pending < d_length)
+        {
+            const long page = sysconf(_SC_PAGESIZE);
+            const uint64_t offset = (uint64_t)pending * d_item_size / page * page;
+            const uint64_t bytes = std::min((uint64_t)SEEK_READAHEAD,
+                                            d_length * d_item_size - offset);
+            madvise((void *)(d_data + offset), (size_t)bytes, MADV_WILLNEED);
+        }
+#endif
+    }
+
+    noutput_items = pace(noutput_items, d_pos >= d_length);
+    d_pos = read(out, d_pos, noutput_items);
+
+    return noutput_items;
+}
+
+/**
+ * Copy samples to the output, following the loop.
+ * @returns The position after the samples.
+ */
+uint64_t iq_file_source::read(gr_complex *out, uint64_t pos, int nitems)
+{
+    uint64_t loop_start;
+    uint64_t loop_end;
+    {
+        std::lock_guard<std::mutex> lock(d_loop_mutex);
+        loop_start = d_loop_start;
+        loop_end = d_loop_end;
+    }
+    const bool looping = loop_end > loop_start;
+
+    while (nitems > 0)
+    {
+        uint64_t end = d_length;
+
+        if (looping)
+        {
+            if (pos < loop_start || pos >= loop_end)
+                pos = loop_start;
+            end = loop_end;
+        }
+
+        if (pos >= end)
+        {
+            // End of file
+            std::fill_n(out, nitems, gr_complex(0.0f, 0.0f));
+            return d_length;
+        }
+
+        const int n = (int)std::min((uint64_t)nitems, end - pos);
+        iq_format_decode(d_fmt, d_data + pos * d_item_size, out, n);
+        out += n;
+        nitems -= n;
+        pos += n;
+    }
+
+    return pos;
+}
+
+/**
+ * Wait until samples are due at the playback speed.
+ * @param at_end True at the end of the file, where zeros are produced at the
+ *               sample rate even when the speed is unlimited.
+ * @returns The number of samples to produce.
+ */
+int iq_file_source::pace(int noutput_items, bool at_end)
+{
+    const double speed = d_speed;
+    const double rate = d_sample_rate * ((at_end && speed <= 0.0) ? 1.0 : speed);
+    if (rate <= 0.0)
+        return noutput_items;
+
+    const int chunk = std::max(1, (int)(rate * PACE_CHUNK_SECONDS));
+    noutput_items = std::min(noutput_items, chunk);
+
+    const auto now = std::chrono::steady_clock::now();
+    if (rate != d_pace_rate
+        || now - d_pace_start > std::chrono::duration<double>(
+               (double)d_pace_samples / rate + PACE_MAX_LAG))
+    {
+        d_pace_start = now;
+        d_pace_samples = 0;
+        d_pace_rate = rate;
+    }
+
+    d_pace_samples += noutput_items;
+    const auto due = d_pace_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>((double)d_pace_samples / rate));
+    if (due > now)
+        std::this_thread::sleep_until(due);
+
+    return noutput_items;
+}
@@ -0,0 +1,119 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef IQ_FILE_SOURCE_H
+#define IQ_FILE_SOURCE_H
+
+#include <gnuradio/sync_block.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "dsp/iq_convert.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+class iq_file_source;
+
+#if GNURADIO_VERSION < 0x030900
+typedef boost::shared_ptr<iq_file_source> iq_file_source_sptr;
+#else
+typedef std::shared_ptr<iq_file_source> iq_file_source_sptr;
+#endif
+
+/*! \brief Return a shared_ptr to a new instance of iq_file_source.
+ *  \param filename The file to play.
+ *  \param fmt Sample format of the file.
+ *  \param sample_rate The sample rate of the file.
+ *
+ * Throws std::runtime_error if the file can not be opened.
+ */
+iq_file_source_sptr make_iq_file_source(const std::string &filename,
+                                        iq_format fmt, double sample_rate);
+
+/*! \brief Play an I/Q file in the selected format as complex samples.
+ *
+ * The file is memory mapped, so seeking only changes the read position and
+ * takes effect at the next call to work(), without locking the flow graph.
+ * The output is paced to the sample rate times the playback speed, or not
+ * paced at all when the speed is 0. A region of the file can be looped.
+ *
+ * Zeros are produced at the end of the file, paced at the sample rate, so
+ * that the flow graph keeps running until playback is stopped. at_end()
+ * tells when the end has been reached.
+ */
+class iq_file_source : public gr::sync_block
+{
+    friend iq_file_source_sptr make_iq_file_source(const std::string &filename,
+                                                   iq_format fmt, double sample_rate);
+
+protected:
+    iq_file_source(const std::string &filename, iq_format fmt, double sample_rate);
+
+public:
+    ~iq_file_source();
+
+    int work(int noutput_items,
+             gr_vector_const_void_star& input_items,
+             gr_vector_void_star& output_items);
+
+    bool seek(uint64_t pos);
+    uint64_t position() const;
+    uint64_t length() const { return d_length; }
+    bool at_end() const;
+
+    void set_sample_rate(double sample_rate);
+    void set_speed(double speed);
+    double speed() const { return d_speed; }
+    void set_loop(uint64_t start, uint64_t end);
+
+private:
+    void close();
+    uint64_t read(gr_complex *out, uint64_t pos, int nitems);
+    int pace(int noutput_items, bool at_end);
+
+    iq_format       d_fmt;
+    size_t          d_item_size;
+    const char     *d_data;         /*!< Mapped file. */
+    size_t          d_map_size;     /*!< Bytes mapped. */
+    uint64_t        d_length;       /*!< Length of the file in samples. */
+#ifdef _WIN32
+    HANDLE          d_file;
+    HANDLE          d_mapping;
+#endif
+
+    std::atomic<uint64_t>   d_pos;          /*!< Next sample to play. */
+    std::atomic<int64_t>    d_seek;         /*!< Pending seek, or -1. */
+    mutable std::mutex      d_loop_mutex;   /*!< Protects the loop region. */
+    uint64_t                d_loop_start;
+    uint64_t                d_loop_end;     /*!< No loop when not after start. */
+    std::atomic<double>     d_sample_rate;
+    std::atomic<double>     d_speed;
+
+    // Pacing, owned by work()
+    std::chrono::steady_clock::time_point d_pace_start;
+    uint64_t        d_pace_samples; /*!< Samples produced since d_pace_start. */
+    double          d_pace_rate;    /*!< Rate d_pace_start was set for. */
+};
+
+#endif // IQ_FILE_SOURCE_H
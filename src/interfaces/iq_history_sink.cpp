@@ -0,0 +1,273 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <gnuradio/io_signature.h>
+#include <volk/volk.h>
+#include "interfaces/iq_history_sink.h"
+
+/* Bytes per write while saving */
+#define SAVE_CHUNK      (4 << 20)
+
+/* Seconds of samples that can be received while the history is written,
+ * at most a quarter of the memory limit */
+#define WRITE_AHEAD_SECONDS 2.0
+
+
+iq_history_sink_sptr make_iq_history_sink(iq_format fmt, double seconds,
+                                          double sample_rate, size_t max_bytes)
+{
+    return gnuradio::get_initial_sptr(new iq_history_sink(fmt, seconds, sample_rate,
+                                                          max_bytes));
+}
+
+iq_history_sink::iq_history_sink(iq_format fmt, double seconds, double sample_rate,
+                                 size_t max_bytes)
+    : gr::sync_block ("iq_history_sink",
+          gr::io_signature::make(1, 1, sizeof(gr_complex)),
+          gr::io_signature::make(0, 0, 0)),
+      d_fmt(fmt),
+      d_item_size(iq_format_item_size(fmt)),
+      d_seconds(seconds),
+      d_sample_rate(sample_rate),
+      d_max_bytes(max_bytes),
+      d_capacity(0),
+      d_history(0),
+      d_head(0),
+      d_read(0),
+      d_end(0),
+      d_dropped(0),
+      d_gap(UINT64_MAX),
+      d_save_start(0),
+      d_saving(false),
+      d_file(nullptr)
+{
+    const int alignment_multiple = volk_get_alignment() / sizeof(gr_complex);
+    set_alignment(std::max(1, alignment_multiple));
+
+    resize();
+}
+
+iq_history_sink::~iq_history_sink()
+{
+    finish_save();
+}
+
+int iq_history_sink::work(int noutput_items,
+                          gr_vector_const_void_star& input_items,
+                          gr_vector_void_star& output_items)
+{
+    (void) output_items;
+
+    const float *in = (const float *)input_items[0];
+    const uint64_t head = d_head.load(std::memory_order_relaxed);
+    size_t n = noutput_items;
+
+    // Samples not saved yet must not be overwritten
+    if (d_saving)
+    {
+        const size_t space = d_capacity - (size_t)(head - d_read.load(std::memory_order_acquire));
+        if (n > space)
+        {
+            // Samples after the end of the file are not missed
+            const uint64_t end = d_end.load();
+            const uint64_t wanted = (end > head) ? std::min((uint64_t)n, end - head) : 0;
+            if (wanted > space)
+            {
+                if (d_dropped == 0)
+                    d_gap = head + space - d_save_start;
+                d_dropped += wanted - space;
+            }
+            n = space;
+        }
+    }
+
+    size_t pos = (size_t)(head % d_capacity);
+    size_t done = 0;
+    while (done < n)
+    {
+        const size_t len = std::min(n - done, d_capacity - pos);
+        char *out = d_buf.data() + pos * d_item_size;
+
+        switch (d_fmt)
+        {
+        case IQ_FORMAT_CS16:
+            volk_32f_s32f_convert_16i((int16_t *)out, in + 2 * done,
+                                      iq_format_scale(d_fmt), 2 * len);
+            break;
+        case IQ_FORMAT_CS8:
+            volk_32f_s32f_convert_8i((int8_t *)out, in + 2 * done,
+                                     iq_format_scale(d_fmt), 2 * len);
+            break;
+        default:
+            memcpy(out, in + 2 * done, len * sizeof(gr_complex));
+            break;
+        }
+
+        done += len;
+        pos = 0;
+    }
+    d_head.store(head + n, std::memory_order_release);
+
+    if (d_saving)
+        d_cond.notify_one();
+
+    return noutput_items;
+}
+
+/*! \brief Set a new input rate, which clears the history.
+ *
+ * Must not be called while the flow graph is running.
+ */
+void iq_history_sink::set_sample_rate(double sample_rate)
+{
+    if (sample_rate == d_sample_rate)
+        return;
+
+    finish_save();
+    d_sample_rate = sample_rate;
+    resize();
+}
+
+/*! \brief Seconds of data in the history. */
+double iq_history_sink::length() const
+{
+    return (double)std::min(d_head.load(), (uint64_t)d_history) / d_sample_rate;
+}
+
+/**
+ * Start saving the history to a file.
+ * @param filename The file to write.
+ * @param post_samples Samples to save after the history, 0 to save until
+ *                     stop_save() is called.
+ * @param pre_samples Filled in with the number of samples saved from the
+ *                    history.
+ * @returns False if already saving or if the file can not be opened.
+ *
+ * Must not be called while work() runs, i.e. with the flow graph locked.
+ */
+bool iq_history_sink::save(const std::string &filename, uint64_t post_samples,
+                           uint64_t *pre_samples)
+{
+    if (d_saving)
+        return false;
+
+    if (d_thread.joinable())
+        d_thread.join();
+
+    d_file = fopen(filename.c_str(), "wb");
+    if (!d_file)
+    {
+        std::cout << "iq_history_sink: can't open " << filename << std::endl;
+        return false;
+    }
+    setvbuf(d_file, nullptr, _IONBF, 0);
+
+    const uint64_t head = d_head;
+    const uint64_t stored = std::min(head, (uint64_t)d_history);
+    d_save_start = head - stored;
+    d_read = d_save_start;
+    d_end = post_samples > 0 ? head + post_samples : UINT64_MAX;
+    d_dropped = 0;
+    d_gap = UINT64_MAX;
+    d_saving = true;
+    d_thread = std::thread(&iq_history_sink::writer_thread, this);
+
+    if (pre_samples)
+        *pre_samples = stored;
+
+    return true;
+}
+
+/*! \brief Stop saving after the samples received so far. */
+void iq_history_sink::stop_save()
+{
+    const uint64_t head = d_head;
+    if (head < d_end)
+        d_end = head;
+    d_cond.notify_one();
+}
+
+// Stop saving and wait until the file is complete
+void iq_history_sink::finish_save()
+{
+    stop_save();
+    if (d_thread.joinable())
+        d_thread.join();
+}
+
+// Allocate the ring buffer for the current rate and length
+void iq_history_sink::resize()
+{
+    const size_t max_samples = std::max(d_max_bytes / d_item_size, (size_t)2);
+    const size_t room = std::min((size_t)std::max(WRITE_AHEAD_SECONDS * d_sample_rate, 1.0),
+                                 max_samples / 4);
+    d_history = (size_t)std::max(d_seconds * d_sample_rate, 1.0);
+    d_history = std::min(d_history, max_samples - room);
+    d_capacity = d_history + room;
+
+    // Zero filled now rather than on first use while running
+    d_buf.assign(d_capacity * d_item_size, 0);
+    d_head = 0;
+    d_read = 0;
+}
+
+void iq_history_sink::writer_thread()
+{
+    std::unique_lock<std::mutex> lock(d_mutex);
+    uint64_t read = d_read;
+
+    while (true)
+    {
+        d_cond.wait_for(lock, std::chrono::milliseconds(100), [this, read] {
+            return d_head != read || d_end <= read;
+        });
+        lock.unlock();
+
+        const uint64_t avail = std::min(d_head.load(std::memory_order_acquire),
+                                        d_end.load());
+        while (read < avail)
+        {
+            const size_t pos = (size_t)(read % d_capacity);
+            const size_t n = std::min({(size_t)(avail - read), d_capacity - pos,
+                                       SAVE_CHUNK / d_item_size});
+            if (fwrite(d_buf.data() + pos * d_item_size, d_item_size, n, d_file) != n)
+            {
+                std::cout << "iq_history_sink: write error" << std::endl;
+                d_end = read;
+                break;
+            }
+            read += n;
+            d_read.store(read, std::memory_order_release);
+        }
+
+        if (read >= d_end)
+            break;
+
+        lock.lock();
+    }
+
+    fclose(d_file);
+    d_file = nullptr;
+    d_saving = false;
+}
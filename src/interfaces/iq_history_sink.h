@@ -0,0 +1,124 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef IQ_HISTORY_SINK_H
+#define IQ_HISTORY_SINK_H
+
+#include <gnuradio/sync_block.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "dsp/iq_convert.h"
+
+class iq_history_sink;
+
+#if GNURADIO_VERSION < 0x030900
+typedef boost::shared_ptr<iq_history_sink> iq_history_sink_sptr;
+#else
+typedef std::shared_ptr<iq_history_sink> iq_history_sink_sptr;
+#endif
+
+/*! \brief Return a shared_ptr to a new instance of iq_history_sink.
+ *  \param fmt Sample format used in memory and in saved files.
+ *  \param seconds Length of the history.
+ *  \param sample_rate The input sample rate.
+ *  \param max_bytes Upper limit for the memory used.
+ */
+iq_history_sink_sptr make_iq_history_sink(iq_format fmt, double seconds,
+                                          double sample_rate, size_t max_bytes);
+
+/*! \brief Keeps the last seconds of I/Q data, which can be saved on demand.
+ *  \ingroup IO
+ *
+ * Samples are kept in a ring buffer in the selected sample format. A call
+ * to save() writes the whole history to a file and keeps appending new
+ * samples until stop_save() or the requested number of samples, so a
+ * recording can start before the event that triggered it.
+ *
+ * The file is written on a separate thread. While saving, the ring buffer
+ * is also the write buffer. It is larger than the history by a write-ahead
+ * room, which holds the samples received while the history is written. If
+ * the disk falls behind by more than that, new samples are dropped and the
+ * position of the first gap in the file is kept, see gap().
+ */
+class iq_history_sink : public gr::sync_block
+{
+    friend iq_history_sink_sptr make_iq_history_sink(iq_format fmt, double seconds,
+                                                     double sample_rate,
+                                                     size_t max_bytes);
+
+protected:
+    iq_history_sink(iq_format fmt, double seconds, double sample_rate,
+                    size_t max_bytes);
+
+public:
+    ~iq_history_sink();
+
+    int work(int noutput_items,
+             gr_vector_const_void_star& input_items,
+             gr_vector_void_star& output_items);
+
+    void set_sample_rate(double sample_rate);
+    double length() const;
+    double seconds() const { return d_seconds; }
+    double sample_rate() const { return d_sample_rate; }
+    size_t memory_size() const { return d_capacity * d_item_size; }
+    iq_format format() const { return d_fmt; }
+
+    bool save(const std::string &filename, uint64_t post_samples, uint64_t *pre_samples);
+    void stop_save();
+    bool is_saving() const { return d_saving; }
+    uint64_t dropped() const { return d_dropped; }
+    uint64_t gap() const { return d_gap; }
+
+private:
+    void resize();
+    void writer_thread();
+    void finish_save();
+
+    iq_format   d_fmt;
+    size_t      d_item_size;
+    double      d_seconds;
+    double      d_sample_rate;
+    size_t      d_max_bytes;
+
+    std::vector<char>     d_buf;
+    size_t                d_capacity;   /*!< Ring size in samples. */
+    size_t                d_history;    /*!< Samples kept as history, the rest is write-ahead room. */
+    std::atomic<uint64_t> d_head;       /*!< Samples received. */
+    std::atomic<uint64_t> d_read;       /*!< Next sample to save. */
+    std::atomic<uint64_t> d_end;        /*!< Sample where saving stops. */
+    std::atomic<uint64_t> d_dropped;    /*!< Samples dropped while saving. */
+    std::atomic<uint64_t> d_gap;        /*!< Sample in the file after the first drop, UINT64_MAX if none. */
+    uint64_t              d_save_start; /*!< First sample saved. */
+    std::atomic<bool>     d_saving;
+
+    std::thread             d_thread;
+    std::mutex              d_mutex;
+    std::condition_variable d_cond;
+    FILE                   *d_file;
+};
+
+#endif // IQ_HISTORY_SINK_H
@@ -0,0 +1,274 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "interfaces/ring_writer.h"
+
+/* Alignment of the buffer, suitable for direct I/O */
+#define PAGE_ALIGN          4096
+
+/* Alignment used to get huge pages for the buffer */
+#define HUGE_PAGE_SIZE      (2 << 20)
+
+
+/**
+ * Allocate the buffer. The writer thread is started by start().
+ * @param size Size of the buffer in bytes, rounded up to whole chunks and at
+ *             least two chunks.
+ * @param chunk Bytes written at a time.
+ * @param whole_chunks Only write whole chunks until stopped, for direct I/O.
+ *                     Otherwise all buffered data is written at once.
+ *
+ * Throws std::runtime_error if the buffer can not be allocated.
+ */
+ring_writer::ring_writer(size_t size, size_t chunk, bool whole_chunks)
+    : d_buf(nullptr),
+      d_chunk(std::max(chunk, (size_t)1)),
+      d_whole_chunks(whole_chunks),
+      d_head(0),
+      d_tail(0),
+      d_peak(0),
+      d_dropped(0),
+      d_failed(false),
+      d_open(false),
+      d_finished(false),
+      d_stop(false)
+{
+    d_size = std::max(size, 2 * d_chunk);
+    d_size = (d_size + d_chunk - 1) / d_chunk * d_chunk;
+
+#ifdef _WIN32
+    d_buf = (char *)_aligned_malloc(d_size, PAGE_ALIGN);
+#else
+    void *buf = nullptr;
+    const size_t align = d_size >= HUGE_PAGE_SIZE ? HUGE_PAGE_SIZE : PAGE_ALIGN;
+    if (posix_memalign(&buf, align, d_size) == 0)
+        d_buf = (char *)buf;
+#ifdef MADV_HUGEPAGE
+    if (d_buf)
+        madvise(d_buf, d_size, MADV_HUGEPAGE);
+#endif
+#endif
+
+    if (!d_buf)
+        throw std::runtime_error("can't allocate buffer");
+}
+
+ring_writer::~ring_writer()
+{
+    stop();
+    wait();
+#ifdef _WIN32
+    _aligned_free(d_buf);
+#else
+    free(d_buf);
+#endif
+}
+
+/**
+ * Start the writer thread and accept data.
+ * @param write Writes data, returns false on failure. After a failure nothing
+ *              more is written and new data is ignored.
+ * @param begin Run on the writer thread before the first write.
+ * @param end Run on the writer thread after the last write.
+ */
+void ring_writer::start(write_func write, std::function<void()> begin,
+                        std::function<void()> end)
+{
+    d_write = write;
+    d_begin = begin;
+    d_end = end;
+    d_open = true;
+    d_thread = std::thread(&ring_writer::writer_thread, this);
+}
+
+/*! \brief Stop accepting data, the buffered data is still written.
+ *
+ * This returns at once. Use finished() to find out when everything has been
+ * written, or wait().
+ */
+void ring_writer::stop()
+{
+    if (!d_open)
+        return;
+
+    d_open = false;
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_stop = true;
+    }
+    d_cond.notify_one();
+}
+
+/*! \brief Wait for the writer thread to end after stop(). */
+void ring_writer::wait()
+{
+    if (d_thread.joinable())
+        d_thread.join();
+}
+
+/**
+ * Get free space for new data, called from work().
+ * @param len Bytes to store.
+ * @param part Set to where the data goes, the second part is used where the
+ *             buffer wraps.
+ * @param part_len Set to the size of each part.
+ * @return The bytes that fit, then to be passed to commit().
+ *
+ * Nothing fits once stopped or after a write failure.
+ */
+size_t ring_writer::reserve(size_t len, char *part[2], size_t part_len[2])
+{
+    size_t space = 0;
+    const uint64_t head = d_head.load(std::memory_order_relaxed);
+
+    if (d_open && !d_failed)
+        space = d_size - (size_t)(head - d_tail.load(std::memory_order_acquire));
+    len = std::min(len, space);
+
+    const size_t pos = (size_t)(head % d_size);
+    part[0] = d_buf + pos;
+    part_len[0] = std::min(len, d_size - pos);
+    part[1] = d_buf;
+    part_len[1] = len - part_len[0];
+
+    return len;
+}
+
+/**
+ * Make stored data available to the writer, called from work().
+ * @param len Bytes stored, as returned by reserve().
+ * @param wanted Bytes that should have been stored, the rest is counted as
+ *               dropped when the buffer is full.
+ */
+void ring_writer::commit(size_t len, size_t wanted)
+{
+    if (!d_open || d_failed)
+        return;
+
+    const uint64_t head = d_head.load(std::memory_order_relaxed) + len;
+    d_head.store(head, std::memory_order_release);
+
+    if (len < wanted)
+        d_dropped += wanted - len;
+
+    const uint64_t fill = head - d_tail.load(std::memory_order_relaxed);
+    if (fill > d_peak.load(std::memory_order_relaxed))
+        d_peak.store(fill, std::memory_order_relaxed);
+
+    // The writer also wakes up by itself, so a lost notification only
+    // delays it a little
+    if (fill >= d_chunk)
+        d_cond.notify_one();
+}
+
+/*! \brief Copy data into the buffer, returns the bytes stored. */
+size_t ring_writer::put(const void *data, size_t len)
+{
+    char *part[2];
+    size_t part_len[2];
+    const size_t n = reserve(len, part, part_len);
+
+    memcpy(part[0], data, part_len[0]);
+    memcpy(part[1], (const char *)data + part_len[0], part_len[1]);
+    commit(n, len);
+
+    return n;
+}
+
+/*! \brief Current buffer fill, 0 to 1. */
+float ring_writer::fill_level() const
+{
+    return (float)(d_head - d_tail) / (float)d_size;
+}
+
+/*! \brief Highest buffer fill since the start, 0 to 1. */
+float ring_writer::peak_fill_level() const
+{
+    return (float)d_peak / (float)d_size;
+}
+
+void ring_writer::writer_thread()
+{
+#ifdef MADV_POPULATE_WRITE
+    // Fault in the buffer now rather than while recording. Unlike writing
+    // to it, this does not race with work().
+    madvise(d_buf, d_size, MADV_POPULATE_WRITE);
+#endif
+
+    if (d_begin)
+        d_begin();
+
+    std::unique_lock<std::mutex> lock(d_mutex);
+    uint64_t tail = d_tail.load(std::memory_order_relaxed);
+
+    while (!d_failed)
+    {
+        d_cond.wait_for(lock, std::chrono::milliseconds(100), [this] {
+            return d_stop || d_head - d_tail >= d_chunk;
+        });
+        const bool stop = d_stop;
+        lock.unlock();
+
+        uint64_t head = d_head.load(std::memory_order_acquire);
+        if (d_whole_chunks && !stop)
+            head = tail + (head - tail) / d_chunk * d_chunk;
+
+        // work() is not called any more once stopped, so this is the end
+        if (!write_range(tail, head) || stop)
+            break;
+
+        lock.lock();
+    }
+
+    if (d_end)
+        d_end();
+    d_finished = true;
+}
+
+// Write [tail, head) in chunks, called on the writer thread
+bool ring_writer::write_range(uint64_t &tail, uint64_t head)
+{
+    while (tail < head)
+    {
+        const size_t pos = (size_t)(tail % d_size);
+        const size_t len = std::min({(size_t)(head - tail), d_size - pos, d_chunk});
+        if (!d_write(d_buf + pos, len))
+        {
+            d_failed = true;
+            return false;
+        }
+        tail += len;
+        d_tail.store(tail, std::memory_order_release);
+    }
+
+    return true;
+}
@@ -0,0 +1,99 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef RING_WRITER_H
+#define RING_WRITER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/*! \brief Ring buffer between work() and a writer thread.
+ *
+ * work() puts data into a large buffer allocated up front and never blocks.
+ * A separate thread hands the data to a write function in chunks, so a slow
+ * disk or encoder can not stall the flow graph. When the writer can not keep
+ * up the buffer fills and new data is dropped, counted by dropped().
+ *
+ * The buffer is page aligned and, on Linux, backed by huge pages when
+ * available. Its size is a whole number of chunks, so a chunk never wraps
+ * around the end, and data of a fixed item size never wraps if the chunk
+ * size is a multiple of it.
+ *
+ * The write function is called on the writer thread only, as are the
+ * functions run when the thread starts and ends.
+ */
+class ring_writer
+{
+public:
+    typedef std::function<bool(const char *data, size_t len)> write_func;
+
+    ring_writer(size_t size, size_t chunk, bool whole_chunks);
+    ~ring_writer();
+    ring_writer(const ring_writer &) = delete;
+    ring_writer &operator=(const ring_writer &) = delete;
+
+    void start(write_func write, std::function<void()> begin = nullptr,
+               std::function<void()> end = nullptr);
+    void stop();
+    void wait();
+
+    size_t reserve(size_t len, char *part[2], size_t part_len[2]);
+    void commit(size_t len, size_t wanted);
+    size_t put(const void *data, size_t len);
+
+    float fill_level() const;
+    float peak_fill_level() const;
+    uint64_t bytes() const { return d_head; }
+    uint64_t dropped() const { return d_dropped; }
+    bool failed() const { return d_failed; }
+    bool finished() const { return d_finished; }
+
+private:
+    void writer_thread();
+    bool write_range(uint64_t &tail, uint64_t head);
+
+    char       *d_buf;
+    size_t      d_size;           /*!< Size of the buffer in bytes. */
+    size_t      d_chunk;          /*!< Bytes written at a time. */
+    bool        d_whole_chunks;   /*!< Write partial chunks only at the end. */
+
+    std::atomic<uint64_t> d_head;     /*!< Bytes put in the buffer, by work(). */
+    std::atomic<uint64_t> d_tail;     /*!< Bytes written. */
+    std::atomic<uint64_t> d_peak;     /*!< Highest buffer fill in bytes. */
+    std::atomic<uint64_t> d_dropped;  /*!< Bytes dropped on a full buffer. */
+    std::atomic<bool>     d_failed;   /*!< A write has failed. */
+    std::atomic<bool>     d_open;     /*!< Accepting data. */
+    std::atomic<bool>     d_finished; /*!< The writer thread has ended. */
+
+    write_func              d_write;
+    std::function<void()>   d_begin;
+    std::function<void()>   d_end;
+
+    std::thread             d_thread;
+    std::mutex              d_mutex;
+    std::condition_variable d_cond;
+    bool                    d_stop;
+};
+
+#endif // RING_WRITER_H
@@ -0,0 +1,336 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <iostream>
+#include <sstream>
+#include <gnuradio/io_signature.h>
+#include "interfaces/sql_wav_sink.h"
+
+/* Audio waiting to be written before new audio is dropped */
+#define MAX_QUEUED_SECONDS  30
+
+/* Longest audio handled by one call to work(), sets the squelch resolution */
+#define MAX_WORK_SECONDS    0.02
+
+/* Transmission starts and ends waiting to be written */
+#define MAX_EVENTS          64
+
+
+static inline int16_t to_s16(float v)
+{
+    return (int16_t)std::lrint(std::min(std::max(v, -1.0f), 1.0f) * 32767.0f);
+}
+
+sql_wav_sink_sptr make_sql_wav_sink(const std::string &dir, unsigned int sample_rate,
+                                    double preroll, double hang, audio_file_format fmt,
+                                    std::function<bool()> squelch_open)
+{
+    return gnuradio::get_initial_sptr(new sql_wav_sink(dir, sample_rate, preroll, hang,
+                                                       fmt, squelch_open));
+}
+
+sql_wav_sink::sql_wav_sink(const std::string &dir, unsigned int sample_rate,
+                           double preroll, double hang, audio_file_format fmt,
+                           std::function<bool()> squelch_open)
+    : gr::sync_block ("sql_wav_sink",
+          gr::io_signature::make(2, 2, sizeof(float)),
+          gr::io_signature::make(0, 0, 0)),
+      d_dir(dir),
+      d_sample_rate(sample_rate),
+      d_preroll((size_t)(std::max(preroll, 0.0) * sample_rate)),
+      d_hang((uint64_t)(std::max(hang, 0.0) * sample_rate)),
+      d_fmt(fmt),
+      d_squelch_open(squelch_open),
+      d_freq(0),
+      d_ring_head(0),
+      d_ring_fill(0),
+      d_closed(0),
+      d_active(false),
+      d_files(0),
+      d_dropped(0),
+      d_capacity(0),
+      d_head(0),
+      d_tail(0),
+      d_ev_read(0),
+      d_ev_write(0),
+      d_stop(false),
+      d_name_count(0)
+{
+    d_ring.resize(2 * d_preroll);
+    d_capacity = (size_t)MAX_QUEUED_SECONDS * sample_rate + d_preroll;
+    d_buf.resize(2 * d_capacity);
+    d_events.resize(MAX_EVENTS);
+    set_max_noutput_items(std::max(1, (int)(sample_rate * MAX_WORK_SECONDS)));
+    d_thread = std::thread(&sql_wav_sink::writer_thread, this);
+}
+
+sql_wav_sink::~sql_wav_sink()
+{
+    close();
+}
+
+/*! \brief Set the frequency used in new file names. */
+void sql_wav_sink::set_frequency(int64_t freq_hz)
+{
+    d_freq = freq_hz;
+}
+
+/**
+ * Finish the current recording and stop the writer thread.
+ *
+ * Must not be called while the block is connected to a running flow graph.
+ */
+void sql_wav_sink::close()
+{
+    if (!d_thread.joinable())
+        return;
+
+    if (d_active)
+    {
+        push_event(event{d_head.load(), false, {}}, 1);
+        d_active = false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_stop = true;
+    }
+    d_cond.notify_one();
+    d_thread.join();
+}
+
+int sql_wav_sink::work(int noutput_items,
+                       gr_vector_const_void_star& input_items,
+                       gr_vector_void_star& output_items)
+{
+    (void) output_items;
+
+    const float *in0 = (const float *)input_items[0];
+    const float *in1 = (const float *)input_items[1];
+    const bool open = d_squelch_open();
+
+    // A transmission only starts when its end can be queued as well
+    if (!d_active && open
+        && push_event(event{d_head.load(std::memory_order_relaxed), true,
+                            std::chrono::system_clock::now()
+                            - std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                                std::chrono::duration<double>((double)d_ring_fill / d_sample_rate))},
+                      2))
+    {
+        // New transmission, starting with the pre-roll
+        const size_t first = (d_ring_head + d_preroll - d_ring_fill) % std::max(d_preroll, (size_t)1);
+        const size_t len = std::min(d_ring_fill, d_preroll - first);
+        write_frames(d_ring.data() + 2 * first, len);
+        write_frames(d_ring.data(), d_ring_fill - len);
+        write_audio(in0, in1, noutput_items);
+        d_cond.notify_one();
+
+        d_ring_fill = 0;
+        d_closed = 0;
+        d_active = true;
+        return noutput_items;
+    }
+
+    if (d_active)
+    {
+        d_closed = open ? 0 : d_closed + noutput_items;
+
+        write_audio(in0, in1, noutput_items);
+        if (!open && d_closed >= d_hang)
+        {
+            push_event(event{d_head.load(std::memory_order_relaxed), false, {}}, 1);
+            d_active = false;
+        }
+        d_cond.notify_one();
+        return noutput_items;
+    }
+
+    // Squelch closed, keep the pre-roll
+    for (int i = noutput_items > (int)d_preroll ? noutput_items - (int)d_preroll : 0;
+         i < noutput_items; i++)
+    {
+        d_ring[2 * d_ring_head] = to_s16(in0[i]);
+        d_ring[2 * d_ring_head + 1] = to_s16(in1[i]);
+        d_ring_head = (d_ring_head + 1) % d_preroll;
+        d_ring_fill = std::min(d_ring_fill + 1, d_preroll);
+    }
+
+    return noutput_items;
+}
+
+/**
+ * Queue the start or end of a transmission, called from work().
+ * @param room Free entries needed, so that a start leaves room for its end.
+ * @returns False if the event could not be queued.
+ */
+bool sql_wav_sink::push_event(const event &e, size_t room)
+{
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        if (d_ev_write - d_ev_read + room > MAX_EVENTS)
+            return false;
+        d_events[d_ev_write % MAX_EVENTS] = e;
+        d_ev_write++;
+    }
+    d_cond.notify_one();
+    return true;
+}
+
+// Frames that fit into the write ring, the rest is dropped. Called from work().
+size_t sql_wav_sink::reserve(size_t frames)
+{
+    const uint64_t used = d_head.load(std::memory_order_relaxed)
+                        - d_tail.load(std::memory_order_acquire);
+    const size_t space = d_capacity - (size_t)used;
+    if (frames <= space)
+        return frames;
+
+    d_dropped += frames - space;
+    return space;
+}
+
+// Copy interleaved frames into the write ring, called from work()
+void sql_wav_sink::write_frames(const int16_t *data, size_t frames)
+{
+    uint64_t head = d_head.load(std::memory_order_relaxed);
+
+    frames = reserve(frames);
+    for (size_t i = 0; i < frames; i++, head++)
+    {
+        const size_t k = (size_t)(head % d_capacity);
+        d_buf[2 * k] = data[2 * i];
+        d_buf[2 * k + 1] = data[2 * i + 1];
+    }
+    d_head.store(head, std::memory_order_release);
+}
+
+// Convert audio into the write ring, called from work()
+void sql_wav_sink::write_audio(const float *in0, const float *in1, size_t frames)
+{
+    uint64_t head = d_head.load(std::memory_order_relaxed);
+
+    frames = reserve(frames);
+    for (size_t i = 0; i < frames; i++, head++)
+    {
+        const size_t k = (size_t)(head % d_capacity);
+        d_buf[2 * k] = to_s16(in0[i]);
+        d_buf[2 * k + 1] = to_s16(in1[i]);
+    }
+    d_head.store(head, std::memory_order_release);
+}
+
+void sql_wav_sink::writer_thread()
+{
+    std::unique_lock<std::mutex> lock(d_mutex);
+    uint64_t tail = d_tail;
+
+    while (true)
+    {
+        const bool have_event = d_ev_read != d_ev_write;
+        const event ev = have_event ? d_events[d_ev_read % MAX_EVENTS] : event{0, false, {}};
+        const uint64_t head = d_head.load(std::memory_order_acquire);
+
+        // Audio before the next event, at most one second per write
+        const uint64_t end = std::min({have_event ? ev.pos : head, head,
+                                       tail + d_sample_rate});
+        if (tail < end)
+        {
+            lock.unlock();
+
+            const size_t pos = (size_t)(tail % d_capacity);
+            const size_t n = std::min((size_t)(end - tail), d_capacity - pos);
+            // Stop this recording on errors, or when it reaches the file size limit
+            if (d_writer.is_open() && !d_writer.write(&d_buf[2 * pos], n))
+            {
+                std::cerr << "sql_wav_sink: write error" << std::endl;
+                d_writer.close();
+            }
+            tail += n;
+            d_tail.store(tail, std::memory_order_release);
+
+            lock.lock();
+            continue;
+        }
+
+        if (have_event)
+        {
+            d_ev_read++;
+            lock.unlock();
+
+            if (!ev.open)
+                d_writer.close();
+            else if (open_file(ev.time))
+                d_files++;
+
+            lock.lock();
+            continue;
+        }
+
+        // Stop only when everything has been written
+        if (d_stop)
+            break;
+
+        d_cond.wait_for(lock, std::chrono::milliseconds(100));
+    }
+
+    lock.unlock();
+    d_writer.close();
+}
+
+// Called on the writer thread
+bool sql_wav_sink::open_file(const std::chrono::system_clock::time_point &time)
+{
+    const time_t t = std::chrono::system_clock::to_time_t(time);
+    struct tm tm_utc;
+#ifdef _WIN32
+    gmtime_s(&tm_utc, &t);
+#else
+    gmtime_r(&t, &tm_utc);
+#endif
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &tm_utc);
+
+    std::ostringstream name;
+    name << d_dir << "/gqrx_" << stamp << "_" << d_freq.load();
+
+    // Transmissions starting within the same second
+    if (name.str() == d_last_name)
+        d_name_count++;
+    else
+        d_name_count = 0;
+    d_last_name = name.str();
+    if (d_name_count > 0)
+        name << "_" << d_name_count;
+    name << "." << audio_file_format_name(d_fmt);
+
+    std::string error;
+    if (!d_writer.open(name.str(), d_sample_rate, d_fmt, error))
+    {
+        std::cerr << "sql_wav_sink: can not create " << name.str() << ": "
+                  << error << std::endl;
+        return false;
+    }
+
+    std::cout << "Recording audio to " << name.str() << std::endl;
+    return true;
+}
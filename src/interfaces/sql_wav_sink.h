@@ -0,0 +1,147 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef SQL_WAV_SINK_H
+#define SQL_WAV_SINK_H
+
+#include <gnuradio/sync_block.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "interfaces/audio_file.h"
+
+class sql_wav_sink;
+
+#if GNURADIO_VERSION < 0x030900
+typedef boost::shared_ptr<sql_wav_sink> sql_wav_sink_sptr;
+#else
+typedef std::shared_ptr<sql_wav_sink> sql_wav_sink_sptr;
+#endif
+
+/*! \brief Return a shared_ptr to a new instance of sql_wav_sink.
+ *  \param dir Directory for the recordings.
+ *  \param sample_rate The audio sample rate.
+ *  \param preroll Seconds of audio kept from before the squelch opens.
+ *  \param hang Seconds the squelch must stay closed to end a recording.
+ *  \param fmt File format of the recordings.
+ *  \param squelch_open Returns whether the squelch is open.
+ */
+sql_wav_sink_sptr make_sql_wav_sink(const std::string &dir, unsigned int sample_rate,
+                                    double preroll, double hang, audio_file_format fmt,
+                                    std::function<bool()> squelch_open);
+
+/*! \brief Records stereo audio to a new WAV or FLAC file for each transmission.
+ *  \ingroup IO
+ *
+ * A recording starts when the squelch opens, including the audio of the
+ * preceding pre-roll time, and ends when the squelch has been closed for
+ * the hang time. Files are named gqrx_yyyyMMdd_hhmmss_<freq>.wav after the
+ * time (UTC) of their first sample, like continuous audio recordings.
+ *
+ * Audio is converted to 16 bit samples in work(), straight into a ring
+ * buffer that is allocated up front. Files are created, encoded and written
+ * by a separate thread, so neither a slow disk nor the FLAC encoder ever
+ * blocks the flow graph.
+ */
+class sql_wav_sink : public gr::sync_block
+{
+    friend sql_wav_sink_sptr make_sql_wav_sink(const std::string &dir, unsigned int sample_rate,
+                                               double preroll, double hang,
+                                               audio_file_format fmt,
+                                               std::function<bool()> squelch_open);
+
+protected:
+    sql_wav_sink(const std::string &dir, unsigned int sample_rate,
+                 double preroll, double hang, audio_file_format fmt,
+                 std::function<bool()> squelch_open);
+
+public:
+    ~sql_wav_sink();
+
+    int work(int noutput_items,
+             gr_vector_const_void_star& input_items,
+             gr_vector_void_star& output_items);
+
+    void set_frequency(int64_t freq_hz);
+    void close();
+
+    bool is_active() const { return d_active; }
+    uint64_t files() const { return d_files; }
+    uint64_t dropped() const { return d_dropped; }
+
+private:
+    /*! \brief Start or end of a transmission in the write ring. */
+    struct event {
+        uint64_t    pos;    /*!< Frame in the write ring. */
+        bool        open;   /*!< Start a new file, otherwise close it. */
+        std::chrono::system_clock::time_point time;  /*!< Time of the first frame. */
+    };
+
+    bool push_event(const event &e, size_t room);
+    size_t reserve(size_t frames);
+    void write_frames(const int16_t *data, size_t frames);
+    void write_audio(const float *in0, const float *in1, size_t frames);
+    void writer_thread();
+    bool open_file(const std::chrono::system_clock::time_point &time);
+
+    std::string     d_dir;
+    unsigned int    d_sample_rate;
+    size_t          d_preroll;      /*!< Pre-roll length in frames. */
+    uint64_t        d_hang;         /*!< Hang time in frames. */
+    audio_file_format d_fmt;
+    std::function<bool()> d_squelch_open;
+    std::atomic<int64_t>  d_freq;
+
+    // Owned by work()
+    std::vector<int16_t> d_ring;    /*!< Pre-roll, interleaved. */
+    size_t          d_ring_head;    /*!< Next frame to write. */
+    size_t          d_ring_fill;    /*!< Frames in the ring. */
+    uint64_t        d_closed;       /*!< Frames since the squelch closed. */
+    std::atomic<bool>     d_active; /*!< A transmission is being recorded. */
+    std::atomic<uint64_t> d_files;
+    std::atomic<uint64_t> d_dropped;
+
+    // Write ring, filled by work() while a transmission is recorded
+    std::vector<int16_t>    d_buf;      /*!< Interleaved left and right. */
+    size_t                  d_capacity; /*!< Ring size in frames. */
+    std::atomic<uint64_t>   d_head;     /*!< Frames written by work(). */
+    std::atomic<uint64_t>   d_tail;     /*!< Frames consumed by the writer. */
+
+    std::thread             d_thread;
+    std::mutex              d_mutex;    /*!< Protects the events and d_stop. */
+    std::condition_variable d_cond;
+    std::vector<event>      d_events;   /*!< Ring of pending events. */
+    uint64_t                d_ev_read;
+    uint64_t                d_ev_write;
+    bool                    d_stop;
+
+    // Owned by the writer thread
+    audio_file_writer d_writer;
+    std::string     d_last_name;
+    int             d_name_count;
+};
+
+#endif // SQL_WAV_SINK_H
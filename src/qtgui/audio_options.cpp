@@ -23,15 +23,26 @@
 #include <QFileDialog>
 #include <QPalette>
 #include <QDebug>
+#include <QStandardItemModel>
 
 #include "audio_options.h"
 #include "ui_audio_options.h"
+#include "interfaces/audio_file.h"
 
 CAudioOptions::CAudioOptions(QWidget *parent) :
     QDialog(parent),
     ui(new Ui::CAudioOptions)
 {
     ui->setupUi(this);
+    setSqlRec(false);
+
+    // FLAC is encoded by libsndfile, which is optional
+    if (!audio_file_format_supported(AUDIO_FORMAT_FLAC))
+    {
+        auto *model = qobject_cast<QStandardItemModel *>(ui->recFormatCombo->model());
+        if (model)
+            model->item(AUDIO_FORMAT_FLAC)->setEnabled(false);
+    }
 
     work_dir = new QDir();
 
@@ -78,6 +89,22 @@ void CAudioOptions::setRecDir(const QString &dir)
     ui->recDirEdit->setText(dir);
 }
 
+/** Set the audio recording format, "wav" or "flac". */
+void CAudioOptions::setRecFormat(const QString &format)
+{
+    audio_file_format fmt = audio_file_format_from_name(format.toStdString());
+
+    if (!audio_file_format_supported(fmt))
+        fmt = AUDIO_FORMAT_WAV;
+    ui->recFormatCombo->setCurrentIndex(fmt);
+}
+
+/** Set the length of each file of a split recording, 0 for one file. */
+void CAudioOptions::setSplitSeconds(int seconds)
+{
+    ui->splitSpinBox->setValue(seconds);
+}
+
 /** Set new UDP host name or IP. */
 void CAudioOptions::setUdpHost(const QString &host)
 {
@@ -96,6 +123,26 @@ void CAudioOptions::setUdpStereo(bool stereo)
     ui->udpStereo->setChecked(stereo);
 }
 
+/** Enable or disable squelch triggered recording. */
+void CAudioOptions::setSqlRec(bool enabled)
+{
+    ui->sqlRecCheckBox->setChecked(enabled);
+    ui->sqlPrerollSpinBox->setEnabled(enabled);
+    ui->sqlHangSpinBox->setEnabled(enabled);
+}
+
+/** Set the audio recorded from before the squelch opens, in seconds. */
+void CAudioOptions::setSqlPreroll(double seconds)
+{
+    ui->sqlPrerollSpinBox->setValue(seconds);
+}
+
+/** Set the time the squelch must stay closed to finish a file, in seconds. */
+void CAudioOptions::setSqlHang(double seconds)
+{
+    ui->sqlHangSpinBox->setValue(seconds);
+}
+
 
 void CAudioOptions::setFftSplit(int pct_2d)
 {
@@ -224,6 +271,18 @@ void CAudioOptions::on_recDirButton_clicked()
         ui->recDirEdit->setText(dir);
 }
 
+/** Audio recording format has changed. */
+void CAudioOptions::on_recFormatCombo_currentIndexChanged(int index)
+{
+    emit newRecFormat(audio_file_format_name((audio_file_format)index));
+}
+
+/** Length of split recordings has changed. */
+void CAudioOptions::on_splitSpinBox_valueChanged(int seconds)
+{
+    emit newSplitSeconds(seconds);
+}
+
 /** UDP host name has changed. */
 void CAudioOptions::on_udpHost_textChanged(const QString &text)
 {
@@ -242,3 +301,23 @@ void CAudioOptions::on_udpStereo_stateChanged(int state)
 {
     emit newUdpStereo(state);
 }
+
+/** Squelch triggered recording has been enabled or disabled. */
+void CAudioOptions::on_sqlRecCheckBox_toggled(bool checked)
+{
+    ui->sqlPrerollSpinBox->setEnabled(checked);
+    ui->sqlHangSpinBox->setEnabled(checked);
+    emit newSqlRec(checked);
+}
+
+/** Squelch triggered recording pre-roll has changed. */
+void CAudioOptions::on_sqlPrerollSpinBox_valueChanged(double value)
+{
+    emit newSqlPreroll(value);
+}
+
+/** Squelch triggered recording hang time has changed. */
+void CAudioOptions::on_sqlHangSpinBox_valueChanged(double value)
+{
+    emit newSqlHang(value);
+}
@@ -44,9 +44,14 @@ public:
     void closeEvent(QCloseEvent *event);
 
     void setRecDir(const QString &dir);
+    void setRecFormat(const QString &format);
+    void setSplitSeconds(int seconds);
     void setUdpHost(const QString &host);
     void setUdpPort(int port);
     void setUdpStereo(bool stereo);
+    void setSqlRec(bool enabled);
+    void setSqlPreroll(double seconds);
+    void setSqlHang(double seconds);
 
     void setFftSplit(int pct_2d);
     int  getFftSplit(void) const;
@@ -71,10 +76,20 @@ signals:
     /*! \brief Signal emitted when a new valid directory has been selected. */
     void newRecDirSelected(const QString &dir);
 
+    /*! \brief Signal emitted when the recording format changes, "wav" or "flac". */
+    void newRecFormat(const QString &format);
+
+    /*! \brief Signal emitted when the length of split recordings changes. */
+    void newSplitSeconds(int seconds);
+
     void newUdpHost(const QString text);
     void newUdpPort(int port);
     void newUdpStereo(bool enabled);
 
+    void newSqlRec(bool enabled);
+    void newSqlPreroll(double seconds);
+    void newSqlHang(double seconds);
+
 private slots:
     void on_fftSplitSlider_valueChanged(int value);
     void on_pandRangeSlider_valuesChanged(int min, int max);
@@ -82,9 +97,14 @@ private slots:
     void on_audioLockButton_toggled(bool checked);
     void on_recDirEdit_textChanged(const QString &text);
     void on_recDirButton_clicked();
+    void on_recFormatCombo_currentIndexChanged(int index);
+    void on_splitSpinBox_valueChanged(int seconds);
     void on_udpHost_textChanged(const QString &text);
     void on_udpPort_valueChanged(int port);
     void on_udpStereo_stateChanged(int state);
+    void on_sqlRecCheckBox_toggled(bool checked);
+    void on_sqlPrerollSpinBox_valueChanged(double value);
+    void on_sqlHangSpinBox_valueChanged(double value);
 
 private:
     Ui::CAudioOptions *ui;                   /*!< The user interface widget. */
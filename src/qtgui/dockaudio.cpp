@@ -29,10 +29,18 @@
 #include "ui_dockaudio.h"
 
 #define DEFAULT_FFT_SPLIT 100
+#define DEFAULT_SQL_PREROLL 1.0
+#define DEFAULT_SQL_HANG 2.0
+#define DEFAULT_REC_FORMAT "wav"
 
 DockAudio::DockAudio(QWidget *parent) :
     QDockWidget(parent),
     ui(new Ui::DockAudio),
+    rec_format(DEFAULT_REC_FORMAT),
+    split_seconds(0),
+    sql_rec(false),
+    sql_preroll(DEFAULT_SQL_PREROLL),
+    sql_hang(DEFAULT_SQL_HANG),
     autoSpan(true),
     rx_freq(144000000)
 {
@@ -44,9 +52,14 @@ DockAudio::DockAudio(QWidget *parent) :
     connect(audioOptions, SIGNAL(newPandapterRange(int,int)), this, SLOT(setNewPandapterRange(int,int)));
     connect(audioOptions, SIGNAL(newWaterfallRange(int,int)), this, SLOT(setNewWaterfallRange(int,int)));
     connect(audioOptions, SIGNAL(newRecDirSelected(QString)), this, SLOT(setNewRecDir(QString)));
+    connect(audioOptions, SIGNAL(newRecFormat(QString)), this, SLOT(setNewRecFormat(QString)));
+    connect(audioOptions, SIGNAL(newSplitSeconds(int)), this, SLOT(setNewSplitSeconds(int)));
     connect(audioOptions, SIGNAL(newUdpHost(QString)), this, SLOT(setNewUdpHost(QString)));
     connect(audioOptions, SIGNAL(newUdpPort(int)), this, SLOT(setNewUdpPort(int)));
     connect(audioOptions, SIGNAL(newUdpStereo(bool)), this, SLOT(setNewUdpStereo(bool)));
+    connect(audioOptions, SIGNAL(newSqlRec(bool)), this, SLOT(setNewSqlRec(bool)));
+    connect(audioOptions, SIGNAL(newSqlPreroll(double)), this, SLOT(setNewSqlPreroll(double)));
+    connect(audioOptions, SIGNAL(newSqlHang(double)), this, SLOT(setNewSqlHang(double)));
 
     connect(ui->audioSpectrum, SIGNAL(pandapterRangeChanged(float,float)), audioOptions, SLOT(setPandapterSliderValues(float,float)));
 
@@ -222,15 +235,23 @@ void DockAudio::on_audioStreamButton_clicked(bool checked)
  */
 void DockAudio::on_audioRecButton_clicked(bool checked)
 {
-    if (checked) {
+    if (checked && sql_rec) {
+        // a new file is created by the receiver for each transmission
+        emit audioSqlRecStarted(rec_dir, sql_preroll, sql_hang, rec_format);
+
+        ui->audioRecLabel->setText(tr("Squelch triggered"));
+        ui->audioRecButton->setToolTip(tr("Stop audio recorder"));
+        ui->audioPlayButton->setEnabled(false);
+    }
+    else if (checked) {
         // FIXME: option to use local time
         // use toUTC() function compatible with older versions of Qt.
         QString file_name = QDateTime::currentDateTime().toUTC().toString("gqrx_yyyyMMdd_hhmmss");
-        last_audio = QString("%1/%2_%3.wav").arg(rec_dir).arg(file_name).arg(rx_freq);
+        last_audio = QString("%1/%2_%3.%4").arg(rec_dir).arg(file_name).arg(rx_freq).arg(rec_format);
         QFileInfo info(last_audio);
 
         // emit signal and start timer
-        emit audioRecStarted(last_audio);
+        emit audioRecStarted(last_audio, split_seconds);
 
         ui->audioRecLabel->setText(info.fileName());
         ui->audioRecButton->setToolTip(tr("Stop audio recorder"));
@@ -381,6 +402,16 @@ void DockAudio::saveSettings(QSettings *settings)
     else
         settings->remove("rec_dir");
 
+    if (rec_format != DEFAULT_REC_FORMAT)
+        settings->setValue("rec_format", rec_format);
+    else
+        settings->remove("rec_format");
+
+    if (split_seconds != 0)
+        settings->setValue("split_seconds", split_seconds);
+    else
+        settings->remove("split_seconds");
+
     if (udp_host.isEmpty())
         settings->remove("udp_host");
     else
@@ -396,6 +427,21 @@ void DockAudio::saveSettings(QSettings *settings)
     else
         settings->remove("udp_stereo");
 
+    if (sql_rec)
+        settings->setValue("sql_rec", true);
+    else
+        settings->remove("sql_rec");
+
+    if (sql_preroll != DEFAULT_SQL_PREROLL)
+        settings->setValue("sql_preroll", sql_preroll);
+    else
+        settings->remove("sql_preroll");
+
+    if (sql_hang != DEFAULT_SQL_HANG)
+        settings->setValue("sql_hang", sql_hang);
+    else
+        settings->remove("sql_hang");
+
     settings->endGroup();
 }
 
@@ -439,6 +485,10 @@ void DockAudio::readSettings(QSettings *settings)
     // Location of audio recordings
     rec_dir = settings->value("rec_dir", QDir::homePath()).toString();
     audioOptions->setRecDir(rec_dir);
+    rec_format = settings->value("rec_format", DEFAULT_REC_FORMAT).toString();
+    audioOptions->setRecFormat(rec_format);
+    split_seconds = settings->value("split_seconds", 0).toInt();
+    audioOptions->setSplitSeconds(split_seconds);
 
     // Audio streaming host, port and stereo setting
     udp_host = settings->value("udp_host", "localhost").toString();
@@ -451,6 +501,19 @@ void DockAudio::readSettings(QSettings *settings)
     audioOptions->setUdpPort(udp_port);
     audioOptions->setUdpStereo(udp_stereo);
 
+    // Squelch triggered recording
+    sql_rec = settings->value("sql_rec", false).toBool();
+    sql_preroll = settings->value("sql_preroll", DEFAULT_SQL_PREROLL).toDouble(&conv_ok);
+    if (!conv_ok)
+        sql_preroll = DEFAULT_SQL_PREROLL;
+    sql_hang = settings->value("sql_hang", DEFAULT_SQL_HANG).toDouble(&conv_ok);
+    if (!conv_ok)
+        sql_hang = DEFAULT_SQL_HANG;
+
+    audioOptions->setSqlPreroll(sql_preroll);
+    audioOptions->setSqlHang(sql_hang);
+    audioOptions->setSqlRec(sql_rec);
+
     settings->endGroup();
 }
 
@@ -472,6 +535,18 @@ void DockAudio::setNewRecDir(const QString &dir)
     rec_dir = dir;
 }
 
+/*! \brief Slot called when the audio recording format changes. */
+void DockAudio::setNewRecFormat(const QString &format)
+{
+    rec_format = format;
+}
+
+/*! \brief Slot called when the length of split recordings changes. */
+void DockAudio::setNewSplitSeconds(int seconds)
+{
+    split_seconds = seconds;
+}
+
 /*! \brief Slot called when a new network host has been entered. */
 void DockAudio::setNewUdpHost(const QString &host)
 {
@@ -493,6 +568,24 @@ void DockAudio::setNewUdpStereo(bool enabled)
     udp_stereo = enabled;
 }
 
+/*! \brief Slot called when squelch triggered recording is enabled or disabled. */
+void DockAudio::setNewSqlRec(bool enabled)
+{
+    sql_rec = enabled;
+}
+
+/*! \brief Slot called when the squelch triggered recording pre-roll changes. */
+void DockAudio::setNewSqlPreroll(double seconds)
+{
+    sql_preroll = seconds;
+}
+
+/*! \brief Slot called when the squelch triggered recording hang time changes. */
+void DockAudio::setNewSqlHang(double seconds)
+{
+    sql_hang = seconds;
+}
+
 void DockAudio::recordToggleShortcut() {
     ui->audioRecButton->click();
 }
@@ -86,7 +86,11 @@ signals:
     void audioStreamingStopped();
 
     /*! \brief Signal emitted when audio recording is started. */
-    void audioRecStarted(const QString filename);
+    void audioRecStarted(const QString filename, int split_seconds);
+
+    /*! \brief Signal emitted when squelch triggered audio recording is started. */
+    void audioSqlRecStarted(const QString dir, double preroll, double hang,
+                            const QString format);
 
     /*! \brief Signal emitted when audio recording is stopped. */
     void audioRecStopped();
@@ -113,21 +117,31 @@ private slots:
     void setNewPandapterRange(int min, int max);
     void setNewWaterfallRange(int min, int max);
     void setNewRecDir(const QString &dir);
+    void setNewRecFormat(const QString &format);
+    void setNewSplitSeconds(int seconds);
     void setNewUdpHost(const QString &host);
     void setNewUdpPort(int port);
     void setNewUdpStereo(bool enabled);
-
+    void setNewSqlRec(bool enabled);
+    void setNewSqlPreroll(double seconds);
+    void setNewSqlHang(double seconds);
 
 private:
     Ui::DockAudio *ui;
     CAudioOptions *audioOptions; /*! Audio options dialog. */
     QString        rec_dir;      /*! Location for audio recordings. */
+    QString        rec_format;   /*! Audio recording format, "wav" or "flac". */
+    int            split_seconds; /*! Length of each file of a recording, 0 for one file. */
     QString        last_audio;   /*! Last audio recording. */
 
     QString        udp_host;     /*! UDP client host name. */
     int            udp_port;     /*! UDP client port number. */
     bool           udp_stereo;   /*! Enable stereo streaming for UDP. */
 
+    bool           sql_rec;      /*! Record a file per transmission while the squelch is open. */
+    double         sql_preroll;  /*! Seconds recorded from before the squelch opens. */
+    double         sql_hang;     /*! Seconds the squelch stays closed before a file ends. */
+
     bool           autoSpan;     /*! Whether to allow mode-dependent auto span. */
 
     qint64         rx_freq;      /*! RX frequency used in filenames. */
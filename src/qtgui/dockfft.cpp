@@ -21,6 +21,8 @@
  * Boston, MA 02110-1301, USA.
  */
 #include <math.h>
+#include <QDir>
+#include <QFileDialog>
 #include <QString>
 #include <QSettings>
 #include <QDebug>
@@ -40,6 +42,7 @@
 #define DEFAULT_FFT_SPLIT       35
 #define DEFAULT_FFT_AVG         25
 #define DEFAULT_COLORMAP        "gqrx"
+#define DEFAULT_FFT_THREADS     1
 
 static const QStringList window_strs = {
     "hamming", "hann", "blackman", "rectangular", "kaiser",
@@ -75,6 +78,8 @@ DockFft::DockFft(QWidget *parent) :
     m_pand_last_modified = false;
     m_actual_frame_rate = 0.f;
     m_frame_dropping = false;
+    m_effective_frame_rate = 0;
+    m_wf_rec_dir = QDir::homePath();
 
     // Add predefined gqrx colors to chooser.
     ui->colorPicker->insertColor(QColor(0xFF,0xFF,0xFF,0xFF), "White");
@@ -215,6 +220,36 @@ int DockFft::fftSize()
     return fft_size;
 }
 
+/**
+ * @brief Get the FFT sizes offered in the FFT size selector.
+ * @return List of FFT sizes.
+ */
+QList<int> DockFft::fftSizes()
+{
+    QList<int> sizes;
+    bool ok;
+
+    for (int i = 0; i < ui->fftSizeComboBox->count(); i++)
+    {
+        int size = ui->fftSizeComboBox->itemText(i).toInt(&ok, 10);
+        if (ok && size > 0)
+            sizes.append(size);
+    }
+
+    return sizes;
+}
+
+/**
+ * @brief Get the number of threads to use for large FFTs.
+ */
+int DockFft::fftThreads()
+{
+    bool ok;
+    int nthreads = ui->fftThreadsComboBox->currentText().toInt(&ok, 10);
+
+    return (ok && nthreads > 0) ? nthreads : DEFAULT_FFT_THREADS;
+}
+
 quint64 DockFft::wfSpan()
 {
     return wf_span_table[ui->wfSpanComboBox->currentIndex()];
@@ -359,11 +394,37 @@ void DockFft::saveSettings(QSettings *settings)
     else
         settings->remove("min_hold");
 
+    if (ui->dspReduceCheckBox->isChecked())
+        settings->remove("dsp_reduce");
+    else
+        settings->setValue("dsp_reduce", false);
+
+    if (ui->adaptiveRateCheckBox->isChecked())
+        settings->setValue("adaptive_rate", true);
+    else
+        settings->remove("adaptive_rate");
+
+    intval = fftThreads();
+    if (intval != DEFAULT_FFT_THREADS)
+        settings->setValue("fft_threads", intval);
+    else
+        settings->remove("fft_threads");
+
     if (QString::compare(ui->cmapComboBox->currentData().toString(), DEFAULT_COLORMAP))
         settings->setValue("waterfall_colormap", ui->cmapComboBox->currentData().toString());
     else
         settings->remove("waterfall_colormap");
 
+    if (m_wf_rec_dir != QDir::homePath())
+        settings->setValue("wf_rec_dir", m_wf_rec_dir);
+    else
+        settings->remove("wf_rec_dir");
+
+    if (ui->wfRecFormatBox->currentIndex() != 0)
+        settings->setValue("wf_rec_colors", true);
+    else
+        settings->remove("wf_rec_colors");
+
     // FFT Zoom
     if (ui->fftZoomSlider->value() != DEFAULT_FFT_ZOOM)
         settings->setValue("fft_zoom", ui->fftZoomSlider->value());
@@ -507,9 +568,29 @@ void DockFft::readSettings(QSettings *settings)
     ui->minHoldCheckBox->setChecked(bool_val);
     emit fftMinHoldToggled(bool_val);
 
+    bool_val = settings->value("dsp_reduce", true).toBool();
+    ui->dspReduceCheckBox->setChecked(bool_val);
+    emit fftReduceToggled(bool_val);
+
+    bool_val = settings->value("adaptive_rate", false).toBool();
+    ui->adaptiveRateCheckBox->setChecked(bool_val);
+    emit fftAdaptiveRateToggled(bool_val);
+
+    intval = settings->value("fft_threads", DEFAULT_FFT_THREADS).toInt(&conv_ok);
+    if (conv_ok)
+    {
+        int idx = ui->fftThreadsComboBox->findText(QString::number(intval));
+        ui->fftThreadsComboBox->setCurrentIndex(idx < 0 ? 0 : idx);
+    }
+    emit fftThreadsChanged(fftThreads());
+
     QString cmap = settings->value("waterfall_colormap", "gqrx").toString();
     ui->cmapComboBox->setCurrentIndex(ui->cmapComboBox->findData(cmap));
 
+    m_wf_rec_dir = settings->value("wf_rec_dir", QDir::homePath()).toString();
+    bool_val = settings->value("wf_rec_colors", false).toBool();
+    ui->wfRecFormatBox->setCurrentIndex(bool_val ? 1 : 0);
+
     // FFT Zoom
     intval = settings->value("fft_zoom", DEFAULT_FFT_ZOOM).toInt(&conv_ok);
     if (conv_ok)
@@ -554,14 +635,38 @@ void DockFft::setMarkersEnabled(bool enable)
 
 void DockFft::setActualFrameRate(float rate, bool dropping)
 {
-    if (dropping) {
-        ui->rateLabel->setText(">>> Rate");
+    m_actual_frame_rate = rate;
+    m_frame_dropping = dropping;
+    updateRateLabel();
+}
+
+/**
+ * Show the FFT rate chosen by the adaptive rate control.
+ * @param fps The rate in use, 0 or the selected rate if not reduced.
+ */
+void DockFft::setEffectiveFrameRate(int fps)
+{
+    m_effective_frame_rate = (fps > 0 && fps < fftRate()) ? fps : 0;
+    updateRateLabel();
+}
+
+void DockFft::updateRateLabel(void)
+{
+    QString text = m_effective_frame_rate ? "Rate*" : "Rate";
+
+    if (m_frame_dropping) {
+        ui->rateLabel->setText(">>> " + text);
         ui->rateLabel->setStyleSheet("QLabel { background-color : red; }");
     }
     else {
-        ui->rateLabel->setText("Rate");
+        ui->rateLabel->setText(text);
         ui->rateLabel->setStyleSheet("");
     }
+
+    if (m_effective_frame_rate)
+        ui->rateLabel->setToolTip(tr("Reduced to %1 fps to keep up").arg(m_effective_frame_rate));
+    else
+        ui->rateLabel->setToolTip("");
 }
 
 /** FFT size changed. */
@@ -597,6 +702,15 @@ void DockFft::on_wfSpanComboBox_currentIndexChanged(int index)
 }
 
 /** Set waterfall time resolution. */
+/** Show whether the waterfall is being recorded, without emitting signals. */
+void DockFft::setWfRecording(bool recording)
+{
+    ui->wfRecButton->blockSignals(true);
+    ui->wfRecButton->setChecked(recording);
+    ui->wfRecButton->blockSignals(false);
+    ui->wfRecFormatBox->setEnabled(!recording);
+}
+
 void DockFft::setWfResolution(quint64 msec_per_line)
 {
     float res = 1.0e-3f * (float)msec_per_line;
@@ -736,6 +850,43 @@ void DockFft::on_markersCheckBox_stateChanged(int state)
     emit markersChanged(state == Qt::Checked);
 }
 
+void DockFft::on_dspReduceCheckBox_stateChanged(int state)
+{
+    emit fftReduceToggled(state == Qt::Checked);
+}
+
+void DockFft::on_adaptiveRateCheckBox_stateChanged(int state)
+{
+    emit fftAdaptiveRateToggled(state == Qt::Checked);
+}
+
+/** Waterfall record button toggled, ask for the directory when starting. */
+void DockFft::on_wfRecButton_toggled(bool checked)
+{
+    if (checked)
+    {
+        QString dir = QFileDialog::getExistingDirectory(this, tr("Select a directory"),
+                                                        m_wf_rec_dir,
+                                                        QFileDialog::ShowDirsOnly |
+                                                        QFileDialog::DontResolveSymlinks);
+        if (dir.isEmpty())
+        {
+            setWfRecording(false);
+            return;
+        }
+        m_wf_rec_dir = dir;
+    }
+
+    ui->wfRecFormatBox->setEnabled(!checked);
+    emit wfRecordToggled(checked, m_wf_rec_dir, ui->wfRecFormatBox->currentIndex() == 1);
+}
+
+void DockFft::on_fftThreadsComboBox_currentIndexChanged(int index)
+{
+    (void) index;
+    emit fftThreadsChanged(fftThreads());
+}
+
 /** lock button toggled */
 void DockFft::on_lockCheckBox_stateChanged(int state)
 {
@@ -44,6 +44,9 @@ public:
 
     int fftSize();
     int setFftSize(int fft_size);
+    QList<int> fftSizes();
+
+    int fftThreads();
 
     quint64 wfSpan();
     quint64 setWfSpan(quint64 fft_size);
@@ -78,6 +81,10 @@ signals:
     void bandPlanChanged(bool enabled);            /*! Toggle Band Plan at bottom of FFT area. */
     void markersChanged(bool enabled);             /*! Toggle markers and on-plot controls. */
     void wfColormapChanged(const QString &cmap);
+    void fftReduceToggled(bool enabled);           /*! Toggle spectrum reduction in the DSP. */
+    void fftAdaptiveRateToggled(bool enabled);     /*! Toggle adaptive FFT rate. */
+    void wfRecordToggled(bool enabled, const QString &dir, bool colors); /*! Start or stop waterfall recording. */
+    void fftThreadsChanged(int nthreads);          /*! Number of FFT threads changed. */
 
 public slots:
     void setPandapterRange(float min, float max);
@@ -86,6 +93,8 @@ public slots:
     void setZoomLevel(float level);
     void setMarkersEnabled(bool enable);
     void setActualFrameRate(float rate, bool dropping);
+    void setEffectiveFrameRate(int fps);
+    void setWfRecording(bool recording);
 
 private slots:
     void on_fftSizeComboBox_currentIndexChanged(int index);
@@ -113,9 +122,14 @@ private slots:
     void on_bandPlanCheckBox_stateChanged(int state);
     void on_markersCheckBox_stateChanged(int state);
     void on_cmapComboBox_currentIndexChanged(int index);
+    void on_dspReduceCheckBox_stateChanged(int state);
+    void on_adaptiveRateCheckBox_stateChanged(int state);
+    void on_wfRecButton_toggled(bool checked);
+    void on_fftThreadsComboBox_currentIndexChanged(int index);
 
 private:
     void updateInfoLabels(void);
+    void updateRateLabel(void);
 
 private:
     Ui::DockFft   * ui;
@@ -125,6 +139,8 @@ private:
     bool          m_pand_last_modified; /* Flag to indicate which slider was changed last */
     float         m_actual_frame_rate;
     bool          m_frame_dropping;
+    int           m_effective_frame_rate; /* Reduced by adaptive rate, 0 if not */
+    QString       m_wf_rec_dir;         /* Directory for waterfall recordings */
 };
 
 #endif // DOCKFFT_H
@@ -0,0 +1,209 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <cmath>
+#include <QDateTime>
+#include <QHeaderView>
+#include <QTableWidgetItem>
+#include "docksignals.h"
+#include "ui_docksignals.h"
+
+#define DEFAULT_THRESHOLD   10.0
+#define DEFAULT_HYSTERESIS  3.0
+#define DEFAULT_HOLD_TIME   2.0
+
+/* Columns in the signal table */
+#define COL_FREQ        0
+#define COL_BW          1
+#define COL_SNR         2
+#define COL_FIRST       3
+#define COL_LAST        4
+#define COL_COUNT       5
+
+DockSignals::DockSignals(QWidget *parent) :
+    QDockWidget(parent),
+    ui(new Ui::DockSignals)
+{
+    ui->setupUi(this);
+
+    ui->signalTable->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    ui->signalTable->horizontalHeader()->setStretchLastSection(true);
+}
+
+DockSignals::~DockSignals()
+{
+    delete ui;
+}
+
+bool DockSignals::detectorEnabled() const
+{
+    return ui->detectCheckBox->isChecked();
+}
+
+float DockSignals::threshold() const
+{
+    return (float)ui->thresholdSpinBox->value();
+}
+
+float DockSignals::hysteresis() const
+{
+    return (float)ui->hysteresisSpinBox->value();
+}
+
+double DockSignals::holdTime() const
+{
+    return ui->holdSpinBox->value();
+}
+
+void DockSignals::saveSettings(QSettings *settings)
+{
+    if (!settings)
+        return;
+
+    settings->beginGroup("detector");
+
+    if (detectorEnabled())
+        settings->setValue("enabled", true);
+    else
+        settings->remove("enabled");
+
+    if (ui->thresholdSpinBox->value() != DEFAULT_THRESHOLD)
+        settings->setValue("threshold", ui->thresholdSpinBox->value());
+    else
+        settings->remove("threshold");
+
+    if (ui->hysteresisSpinBox->value() != DEFAULT_HYSTERESIS)
+        settings->setValue("hysteresis", ui->hysteresisSpinBox->value());
+    else
+        settings->remove("hysteresis");
+
+    if (ui->holdSpinBox->value() != DEFAULT_HOLD_TIME)
+        settings->setValue("hold_time", ui->holdSpinBox->value());
+    else
+        settings->remove("hold_time");
+
+    settings->endGroup();
+}
+
+/*! \brief Read settings and emit the corresponding signals. */
+void DockSignals::readSettings(QSettings *settings)
+{
+    if (!settings)
+        return;
+
+    settings->beginGroup("detector");
+
+    ui->thresholdSpinBox->setValue(settings->value("threshold", DEFAULT_THRESHOLD).toDouble());
+    ui->hysteresisSpinBox->setValue(settings->value("hysteresis", DEFAULT_HYSTERESIS).toDouble());
+    ui->holdSpinBox->setValue(settings->value("hold_time", DEFAULT_HOLD_TIME).toDouble());
+    ui->detectCheckBox->setChecked(settings->value("enabled", false).toBool());
+
+    settings->endGroup();
+
+    emit thresholdChanged(threshold());
+    emit hysteresisChanged(hysteresis());
+    emit holdTimeChanged(holdTime());
+    emit detectorToggled(detectorEnabled());
+}
+
+/*! \brief Show the currently active signals.
+ *  \param sigs The signals, frequencies as displayed (including LNB LO).
+ *
+ * Existing rows are reused so that the selection and scroll position are
+ * kept while the list is updated.
+ */
+void DockSignals::setSignals(const std::vector<signal_detector::signal> &sigs)
+{
+    QTableWidget *table = ui->signalTable;
+    const int rows = (int)sigs.size();
+
+    table->setUpdatesEnabled(false);
+    table->setRowCount(rows);
+
+    for (int row = 0; row < rows; row++)
+    {
+        const signal_detector::signal &s = sigs[row];
+        const qint64 freq = (qint64)std::llround(s.freq);
+        QString text[COL_COUNT];
+
+        text[COL_FREQ] = QString("%1 kHz").arg(freq / 1.e3, 0, 'f', 3);
+        text[COL_BW] = QString("%1 kHz").arg(s.bandwidth / 1.e3, 0, 'f', 1);
+        text[COL_SNR] = QString("%1 dB").arg(s.snr, 0, 'f', 1);
+        text[COL_FIRST] = QDateTime::fromMSecsSinceEpoch((qint64)(s.first_seen * 1.e3))
+                              .toString("hh:mm:ss");
+        text[COL_LAST] = QDateTime::fromMSecsSinceEpoch((qint64)(s.last_seen * 1.e3))
+                              .toString("hh:mm:ss");
+
+        for (int col = 0; col < COL_COUNT; col++)
+        {
+            QTableWidgetItem *item = table->item(row, col);
+            if (!item)
+            {
+                item = new QTableWidgetItem();
+                if (col != COL_FIRST && col != COL_LAST)
+                    item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+                table->setItem(row, col, item);
+            }
+            item->setText(text[col]);
+        }
+        table->item(row, COL_FREQ)->setData(Qt::UserRole, freq);
+    }
+
+    table->setUpdatesEnabled(true);
+}
+
+/* used by remote control */
+void DockSignals::setDetectorEnabled(bool enabled)
+{
+    ui->detectCheckBox->setChecked(enabled);
+}
+
+void DockSignals::on_detectCheckBox_toggled(bool checked)
+{
+    if (!checked)
+        ui->signalTable->setRowCount(0);
+
+    emit detectorToggled(checked);
+}
+
+void DockSignals::on_thresholdSpinBox_valueChanged(double value)
+{
+    emit thresholdChanged((float)value);
+}
+
+void DockSignals::on_hysteresisSpinBox_valueChanged(double value)
+{
+    emit hysteresisChanged((float)value);
+}
+
+void DockSignals::on_holdSpinBox_valueChanged(double value)
+{
+    emit holdTimeChanged(value);
+}
+
+/*! \brief Tune to the signal that was double clicked. */
+void DockSignals::on_signalTable_cellDoubleClicked(int row, int column)
+{
+    Q_UNUSED(column);
+
+    QTableWidgetItem *item = ui->signalTable->item(row, COL_FREQ);
+    if (item)
+        emit signalActivated(item->data(Qt::UserRole).toLongLong());
+}
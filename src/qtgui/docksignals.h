@@ -0,0 +1,72 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef DOCKSIGNALS_H
+#define DOCKSIGNALS_H
+#include <vector>
+#include <QDockWidget>
+#include <QSettings>
+#include "dsp/signal_detector.h"
+
+namespace Ui {
+    class DockSignals;
+}
+
+
+/*! \brief Dock widget with signal detector settings and a list of active signals. */
+class DockSignals : public QDockWidget
+{
+    Q_OBJECT
+
+public:
+    explicit DockSignals(QWidget *parent = 0);
+    ~DockSignals();
+
+    bool  detectorEnabled() const;
+    float threshold() const;
+    float hysteresis() const;
+    double holdTime() const;
+
+    void saveSettings(QSettings *settings);
+    void readSettings(QSettings *settings);
+
+public slots:
+    void setSignals(const std::vector<signal_detector::signal> &sigs);
+    void setDetectorEnabled(bool enabled);
+
+signals:
+    void detectorToggled(bool enabled);
+    void thresholdChanged(float snr_db);
+    void hysteresisChanged(float db);
+    void holdTimeChanged(double seconds);
+    void signalActivated(qint64 freq);
+
+private slots:
+    void on_detectCheckBox_toggled(bool checked);
+    void on_thresholdSpinBox_valueChanged(double value);
+    void on_hysteresisSpinBox_valueChanged(double value);
+    void on_holdSpinBox_valueChanged(double value);
+    void on_signalTable_cellDoubleClicked(int row, int column);
+
+private:
+    Ui::DockSignals *ui;        /*! The Qt designer UI file. */
+};
+
+#endif // DOCKSIGNALS_H
@@ -0,0 +1,179 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <cmath>
+#include "docksweep.h"
+#include "ui_docksweep.h"
+
+#define DEFAULT_START_FREQ  88.0
+#define DEFAULT_STOP_FREQ   108.0
+#define DEFAULT_FFT_SIZE    2048
+#define DEFAULT_AVERAGES    8
+#define DEFAULT_SETTLE_MS   50
+#define DEFAULT_TRIM_PCT    25
+
+DockSweep::DockSweep(QWidget *parent) :
+    QDockWidget(parent),
+    ui(new Ui::DockSweep)
+{
+    ui->setupUi(this);
+}
+
+DockSweep::~DockSweep()
+{
+    delete ui;
+}
+
+/*! \brief Lower edge of the sweep range in Hz, as displayed (including LNB LO). */
+qint64 DockSweep::startFreq() const
+{
+    return (qint64)std::llround(ui->startSpinBox->value() * 1.e6);
+}
+
+/*! \brief Upper edge of the sweep range in Hz, as displayed (including LNB LO). */
+qint64 DockSweep::stopFreq() const
+{
+    return (qint64)std::llround(ui->stopSpinBox->value() * 1.e6);
+}
+
+unsigned int DockSweep::fftSize() const
+{
+    return ui->fftSizeComboBox->currentText().toUInt();
+}
+
+unsigned int DockSweep::averages() const
+{
+    return (unsigned int)ui->averagesSpinBox->value();
+}
+
+/*! \brief Settle time in seconds. */
+double DockSweep::settleTime() const
+{
+    return ui->settleSpinBox->value() * 1.e-3;
+}
+
+/*! \brief Fraction of each step discarded at the edges. */
+double DockSweep::trim() const
+{
+    return ui->trimSpinBox->value() * 1.e-2;
+}
+
+void DockSweep::saveSettings(QSettings *settings)
+{
+    if (!settings)
+        return;
+
+    settings->beginGroup("sweep");
+
+    if (ui->startSpinBox->value() != DEFAULT_START_FREQ)
+        settings->setValue("start", startFreq());
+    else
+        settings->remove("start");
+
+    if (ui->stopSpinBox->value() != DEFAULT_STOP_FREQ)
+        settings->setValue("stop", stopFreq());
+    else
+        settings->remove("stop");
+
+    if (fftSize() != DEFAULT_FFT_SIZE)
+        settings->setValue("fft_size", fftSize());
+    else
+        settings->remove("fft_size");
+
+    if (averages() != DEFAULT_AVERAGES)
+        settings->setValue("averages", averages());
+    else
+        settings->remove("averages");
+
+    if (ui->settleSpinBox->value() != DEFAULT_SETTLE_MS)
+        settings->setValue("settle_ms", ui->settleSpinBox->value());
+    else
+        settings->remove("settle_ms");
+
+    if (ui->trimSpinBox->value() != DEFAULT_TRIM_PCT)
+        settings->setValue("trim", ui->trimSpinBox->value());
+    else
+        settings->remove("trim");
+
+    settings->endGroup();
+}
+
+void DockSweep::readSettings(QSettings *settings)
+{
+    bool conv_ok;
+    qint64 int64_val;
+    int intval;
+
+    if (!settings)
+        return;
+
+    settings->beginGroup("sweep");
+
+    int64_val = settings->value("start", 0).toLongLong(&conv_ok);
+    ui->startSpinBox->setValue(conv_ok && int64_val > 0 ? int64_val * 1.e-6 : DEFAULT_START_FREQ);
+
+    int64_val = settings->value("stop", 0).toLongLong(&conv_ok);
+    ui->stopSpinBox->setValue(conv_ok && int64_val > 0 ? int64_val * 1.e-6 : DEFAULT_STOP_FREQ);
+
+    intval = settings->value("fft_size", DEFAULT_FFT_SIZE).toInt(&conv_ok);
+    intval = ui->fftSizeComboBox->findText(QString::number(intval));
+    ui->fftSizeComboBox->setCurrentIndex(intval >= 0 ? intval :
+        ui->fftSizeComboBox->findText(QString::number(DEFAULT_FFT_SIZE)));
+
+    ui->averagesSpinBox->setValue(settings->value("averages", DEFAULT_AVERAGES).toInt());
+    ui->settleSpinBox->setValue(settings->value("settle_ms", DEFAULT_SETTLE_MS).toInt());
+    ui->trimSpinBox->setValue(settings->value("trim", DEFAULT_TRIM_PCT).toInt());
+
+    settings->endGroup();
+}
+
+/*! \brief Update the button state without emitting sweepToggled(). */
+void DockSweep::setSweepRunning(bool running)
+{
+    ui->sweepButton->blockSignals(true);
+    ui->sweepButton->setChecked(running);
+    ui->sweepButton->blockSignals(false);
+    updateControls(running);
+
+    if (!running)
+        ui->rateLabel->setText("-- MHz/s");
+}
+
+void DockSweep::setSweepRate(double mhz_per_sec)
+{
+    ui->rateLabel->setText(QString("%1 MHz/s").arg(mhz_per_sec, 0, 'f', 1));
+}
+
+void DockSweep::on_sweepButton_toggled(bool checked)
+{
+    updateControls(checked);
+    emit sweepToggled(checked);
+}
+
+/*! \brief The settings can not be changed while sweeping. */
+void DockSweep::updateControls(bool running)
+{
+    ui->startSpinBox->setEnabled(!running);
+    ui->stopSpinBox->setEnabled(!running);
+    ui->fftSizeComboBox->setEnabled(!running);
+    ui->averagesSpinBox->setEnabled(!running);
+    ui->settleSpinBox->setEnabled(!running);
+    ui->trimSpinBox->setEnabled(!running);
+}
@@ -0,0 +1,66 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef DOCKSWEEP_H
+#define DOCKSWEEP_H
+#include <QDockWidget>
+#include <QSettings>
+
+namespace Ui {
+    class DockSweep;
+}
+
+
+/*! \brief Dock widget with wideband sweep settings. */
+class DockSweep : public QDockWidget
+{
+    Q_OBJECT
+
+public:
+    explicit DockSweep(QWidget *parent = 0);
+    ~DockSweep();
+
+    qint64 startFreq() const;
+    qint64 stopFreq() const;
+    unsigned int fftSize() const;
+    unsigned int averages() const;
+    double settleTime() const;
+    double trim() const;
+
+    void saveSettings(QSettings *settings);
+    void readSettings(QSettings *settings);
+
+public slots:
+    void setSweepRunning(bool running);
+    void setSweepRate(double mhz_per_sec);
+
+signals:
+    void sweepToggled(bool enabled);
+
+private slots:
+    void on_sweepButton_toggled(bool checked);
+
+private:
+    void updateControls(bool running);
+
+    Ui::DockSweep *ui;        /*! The Qt designer UI file. */
+};
+
+#endif // DOCKSWEEP_H
@@ -0,0 +1,306 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <QStringList>
+#include <gnuradio/fft/window.h>
+#include "dsp/fft_plan_cache.h"
+#include "dsp/iq_convert.h"
+#include "iq_overview.h"
+
+/* FFTs averaged per column */
+#define FFTS_PER_COLUMN     16
+
+/* Samples read at a time */
+#define READ_CHUNK          (256 * 1024)
+
+/* Dynamic range of the spectrogram */
+#define MAX_RANGE_DB        80.0f
+
+CIqOverview::CIqOverview(QObject *parent)
+    : QObject(parent),
+      m_stop(false),
+      m_building(false),
+      m_ready(false),
+      m_progress(0.0f)
+{
+}
+
+CIqOverview::~CIqOverview()
+{
+    cancel();
+}
+
+/**
+ * Load the overview of a recording.
+ * @param filename The recording.
+ * @param sample_format Sample format of the recording, e.g. "cs16".
+ *
+ * The sidecar is used when it is up to date, otherwise the overview is built
+ * on a background thread. ready() is emitted when it is available.
+ */
+void CIqOverview::load(const QString &filename, const QString &sample_format)
+{
+    cancel();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_image = QImage();
+        m_power.clear();
+    }
+    m_ready = false;
+    m_progress = 0.0f;
+
+    if (readSidecar(filename))
+    {
+        m_ready = true;
+        emit ready();
+        return;
+    }
+
+    m_stop = false;
+    m_building = true;
+    m_thread = std::thread(&CIqOverview::buildThread, this, filename, sample_format);
+}
+
+/** Stop building an overview. */
+void CIqOverview::cancel()
+{
+    m_stop = true;
+    if (m_thread.joinable())
+        m_thread.join();
+    m_building = false;
+}
+
+QImage CIqOverview::image() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_image;
+}
+
+QVector<float> CIqOverview::power() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_power;
+}
+
+QString CIqOverview::sidecarName(const QString &filename)
+{
+    return filename + ".overview.png";
+}
+
+// Use the sidecar if it was made from the current recording
+bool CIqOverview::readSidecar(const QString &filename)
+{
+    QFileInfo info(filename);
+    QImage image;
+
+    if (!QFileInfo::exists(sidecarName(filename)) || !image.load(sidecarName(filename), "PNG"))
+        return false;
+
+    if (image.text("SourceSize") != QString::number(info.size()) ||
+        image.text("SourceModified") != QString::number(info.lastModified().toMSecsSinceEpoch()))
+        return false;
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 14, 0)
+    const QStringList values = image.text("Power").split(' ', QString::SkipEmptyParts);
+#else
+    const QStringList values = image.text("Power").split(' ', Qt::SkipEmptyParts);
+#endif
+    if (values.size() != image.width())
+        return false;
+
+    QVector<float> power;
+    power.reserve(values.size());
+    for (const auto &v : values)
+        power.append(v.toFloat());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_image = image;
+    m_power = power;
+    return true;
+}
+
+void CIqOverview::buildThread(QString filename, QString sample_format)
+{
+    const iq_format fmt = iq_format_from_name(sample_format.toStdString());
+    const size_t item_size = iq_format_item_size(fmt);
+    const QFileInfo info(filename);
+    const quint64 nsamples = info.size() / item_size;
+
+    FILE *file = fopen(filename.toLocal8Bit().constData(), "rb");
+    if (!file || nsamples < FFT_SIZE)
+    {
+        if (file)
+            fclose(file);
+        m_building = false;
+        return;
+    }
+
+    // Each column has FFTS_PER_COLUMN evenly spaced FFTs and the power of all samples
+    const int columns = (int)std::min<quint64>(MAX_COLUMNS, nsamples / FFT_SIZE);
+    const quint64 per_column = nsamples / columns;
+    const int nfft = (int)std::max<quint64>(1, std::min<quint64>(FFTS_PER_COLUMN,
+                                                                 per_column / FFT_SIZE));
+    const quint64 stride = per_column / nfft;
+
+    fft_complex_fwd_t *fft = fft_plan_cache::Get().acquire(FFT_SIZE);
+    const std::vector<float> window = gr::fft::window::build(gr::fft::window::WIN_HANN,
+                                                             FFT_SIZE, 6.76);
+
+    std::vector<char> raw(READ_CHUNK * item_size);
+    std::vector<gr_complex> buf(READ_CHUNK);
+    std::vector<float> spectra((size_t)columns * FFT_SIZE, 0.0f);
+    std::vector<float> power(columns, 0.0f);
+    std::vector<float> bins(FFT_SIZE, 0.0f);
+    gr_complex *fftin = fft->get_inbuf();
+    const gr_complex *fftout = fft->get_outbuf();
+
+    int column = 0;
+    quint64 col_pos = 0;        // position in the column
+    int ffts_done = 0;
+    double col_power = 0.0;
+
+    while (column < columns && !m_stop)
+    {
+        const size_t n = fread(raw.data(), item_size, READ_CHUNK, file);
+        if (n == 0)
+            break;
+        iq_format_decode(fmt, raw.data(), buf.data(), (int)n);
+
+        size_t i = 0;
+        while (i < n && column < columns)
+        {
+            // The last column takes the remaining samples
+            const quint64 col_len = (column == columns - 1) ? nsamples - (quint64)column * per_column
+                                                            : per_column;
+            const quint64 block = col_pos / stride;
+            const quint64 offset = col_pos % stride;
+            quint64 m;
+
+            if (block < (quint64)nfft && offset < FFT_SIZE)
+            {
+                m = std::min<quint64>(n - i, FFT_SIZE - offset);
+                for (quint64 k = 0; k < m; k++)
+                    fftin[offset + k] = buf[i + k] * window[offset + k];
+                if (offset + m == FFT_SIZE)
+                {
+                    fft->execute();
+                    for (int k = 0; k < FFT_SIZE; k++)
+                        bins[k] += std::norm(fftout[k]);
+                    ffts_done++;
+                }
+            }
+            else
+            {
+                const quint64 next = (block + 1 < (quint64)nfft) ? (block + 1) * stride : col_len;
+                m = std::min<quint64>(n - i, next - col_pos);
+            }
+            m = std::min<quint64>(m, col_len - col_pos);
+
+            for (quint64 k = 0; k < m; k++)
+                col_power += std::norm(buf[i + k]);
+
+            i += m;
+            col_pos += m;
+
+            if (col_pos == col_len)
+            {
+                // Negative frequencies in the lower half
+                float *out = &spectra[(size_t)column * FFT_SIZE];
+                for (int k = 0; k < FFT_SIZE; k++)
+                {
+                    const float p = bins[(k + FFT_SIZE / 2) % FFT_SIZE] / std::max(ffts_done, 1);
+                    out[k] = 10.0f * log10f(p / (FFT_SIZE * FFT_SIZE) + 1.0e-20f);
+                }
+                power[column] = 10.0f * log10f((float)(col_power / col_len) + 1.0e-20f);
+
+                std::fill(bins.begin(), bins.end(), 0.0f);
+                ffts_done = 0;
+                col_power = 0.0;
+                col_pos = 0;
+                column++;
+                m_progress = (float)column / columns;
+            }
+        }
+    }
+
+    fclose(file);
+    fft_plan_cache::Get().release(fft);
+
+    if (column < columns)
+    {
+        // Cancelled or read error
+        m_building = false;
+        return;
+    }
+
+    float max_db = *std::max_element(spectra.begin(), spectra.end());
+    float min_db = *std::min_element(spectra.begin(), spectra.end());
+    min_db = std::max(min_db, max_db - MAX_RANGE_DB);
+    const float scale = 255.0f / std::max(max_db - min_db, 1.0f);
+
+    QImage image(columns, FFT_SIZE, QImage::Format_Grayscale8);
+    for (int y = 0; y < FFT_SIZE; y++)
+    {
+        uchar *line = image.scanLine(y);
+        const int bin = FFT_SIZE - 1 - y;
+        for (int x = 0; x < columns; x++)
+        {
+            const float v = (spectra[(size_t)x * FFT_SIZE + bin] - min_db) * scale;
+            line[x] = (uchar)std::min(std::max(v, 0.0f), 255.0f);
+        }
+    }
+
+    QStringList values;
+    QVector<float> power_db;
+    for (auto p : power)
+    {
+        values << QString::number(p, 'f', 1);
+        power_db.append(p);
+    }
+
+    image.setText("Software", "Gqrx");
+    image.setText("MinDb", QString::number(min_db));
+    image.setText("MaxDb", QString::number(max_db));
+    image.setText("SamplesPerColumn", QString::number(per_column));
+    image.setText("Power", values.join(' '));
+    image.setText("SourceSize", QString::number(info.size()));
+    image.setText("SourceModified", QString::number(info.lastModified().toMSecsSinceEpoch()));
+
+    // The overview is still shown if the directory can't be written
+    if (!image.save(sidecarName(filename), "PNG"))
+        qDebug() << "Can not write" << sidecarName(filename);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_image = image;
+        m_power = power_db;
+    }
+    m_ready = true;
+    m_building = false;
+    emit ready();
+}
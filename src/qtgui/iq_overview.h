@@ -0,0 +1,82 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef IQ_OVERVIEW_H
+#define IQ_OVERVIEW_H
+
+#include <QImage>
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+/*! \brief Overview of an I/Q recording: a coarse spectrogram and power envelope.
+ *
+ * The overview is built by streaming through the file on a background thread
+ * with bounded memory, and stored next to the recording as a PNG sidecar,
+ * "<recording>.overview.png". The spectrogram is 8 bit grayscale with time
+ * from left to right and frequency from bottom to top. The dB scale, the
+ * power envelope and the size and time stamp of the recording are stored as
+ * PNG text, and the sidecar is rebuilt when the recording changes.
+ */
+class CIqOverview : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int FFT_SIZE = 256;    /*!< Frequency bins. */
+    static const int MAX_COLUMNS = 1024;
+
+    explicit CIqOverview(QObject *parent = nullptr);
+    ~CIqOverview();
+
+    void load(const QString &filename, const QString &sample_format);
+    void cancel();
+
+    bool isReady() const { return m_ready; }
+    bool isBuilding() const { return m_building; }
+    float progress() const { return m_progress; }
+
+    QImage image() const;
+    QVector<float> power() const;
+
+signals:
+    /*! \brief A new overview is available from image() and power(). */
+    void ready();
+
+private:
+    void buildThread(QString filename, QString sample_format);
+    bool readSidecar(const QString &filename);
+    static QString sidecarName(const QString &filename);
+
+    std::thread         m_thread;
+    std::atomic<bool>   m_stop;
+    std::atomic<bool>   m_building;
+    std::atomic<bool>   m_ready;
+    std::atomic<float>  m_progress;
+
+    mutable std::mutex  m_mutex;    // result
+    QImage              m_image;
+    QVector<float>      m_power;    // dB per column
+};
+
+#endif // IQ_OVERVIEW_H
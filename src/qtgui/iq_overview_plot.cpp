@@ -0,0 +1,162 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QPainterPath>
+#include "iq_overview_plot.h"
+
+CIqOverviewPlot::CIqOverviewPlot(QWidget *parent)
+    : QFrame(parent),
+      m_powerMin(0.0f),
+      m_powerMax(0.0f),
+      m_position(0.0),
+      m_loopStart(0.0),
+      m_loopEnd(0.0)
+{
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+}
+
+QSize CIqOverviewPlot::minimumSizeHint() const
+{
+    return QSize(100, 48);
+}
+
+QSize CIqOverviewPlot::sizeHint() const
+{
+    return QSize(400, 64);
+}
+
+/**
+ * Show a new overview.
+ * @param image Spectrogram, time from left to right.
+ * @param power Power in dB, one value per image column.
+ */
+void CIqOverviewPlot::setOverview(const QImage &image, const QVector<float> &power)
+{
+    m_image = image;
+    m_power = power;
+    m_message.clear();
+
+    if (!m_power.isEmpty())
+    {
+        auto range = std::minmax_element(m_power.begin(), m_power.end());
+        m_powerMin = *range.first;
+        m_powerMax = *range.second;
+    }
+    update();
+}
+
+/*! \brief Show a message instead of an overview. */
+void CIqOverviewPlot::setMessage(const QString &message)
+{
+    m_image = QImage();
+    m_power.clear();
+    m_message = message;
+    update();
+}
+
+/*! \brief Set the marked position, 0 at the start and 1 at the end. */
+void CIqOverviewPlot::setPosition(double pos)
+{
+    if (pos == m_position)
+        return;
+    m_position = pos;
+    update();
+}
+
+/*! \brief Shade a region, none when end is not after start. */
+void CIqOverviewPlot::setLoop(double start, double end)
+{
+    m_loopStart = start;
+    m_loopEnd = end;
+    update();
+}
+
+void CIqOverviewPlot::paintEvent(QPaintEvent *event)
+{
+    QFrame::paintEvent(event);
+
+    QPainter painter(this);
+    const QRect r = contentsRect();
+    painter.fillRect(r, Qt::black);
+
+    if (m_image.isNull())
+    {
+        painter.setPen(palette().color(QPalette::Mid));
+        painter.drawText(r, Qt::AlignCenter, m_message);
+        return;
+    }
+
+    painter.drawImage(r, m_image);
+
+    // Power envelope
+    if (m_power.size() > 1 && m_powerMax > m_powerMin)
+    {
+        const double dx = (double)r.width() / (m_power.size() - 1);
+        const double dy = (r.height() - 2) / (m_powerMax - m_powerMin);
+        QPainterPath path;
+        for (int i = 0; i < m_power.size(); i++)
+        {
+            const QPointF p(r.left() + i * dx, r.bottom() - 1 - (m_power[i] - m_powerMin) * dy);
+            if (i == 0)
+                path.moveTo(p);
+            else
+                path.lineTo(p);
+        }
+        painter.setPen(QColor(255, 200, 0));
+        painter.drawPath(path);
+    }
+
+    if (m_loopEnd > m_loopStart)
+    {
+        const int x0 = r.left() + qRound(m_loopStart * r.width());
+        const int x1 = r.left() + qRound(m_loopEnd * r.width());
+        painter.fillRect(QRect(x0, r.top(), x1 - x0, r.height()), QColor(0, 128, 255, 64));
+    }
+
+    const int x = r.left() + qRound(m_position * r.width());
+    painter.setPen(Qt::red);
+    painter.drawLine(x, r.top(), x, r.bottom());
+}
+
+void CIqOverviewPlot::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton)
+        select(event->pos().x());
+}
+
+void CIqOverviewPlot::mouseMoveEvent(QMouseEvent *event)
+{
+    if (event->buttons() & Qt::LeftButton)
+        select(event->pos().x());
+}
+
+void CIqOverviewPlot::select(int x)
+{
+    const QRect r = contentsRect();
+    if (m_image.isNull() || r.width() <= 0)
+        return;
+
+    const double pos = std::min(std::max((double)(x - r.left()) / r.width(), 0.0), 1.0);
+    setPosition(pos);
+    emit positionSelected(pos);
+}
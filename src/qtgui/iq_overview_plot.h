@@ -0,0 +1,71 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef IQ_OVERVIEW_PLOT_H
+#define IQ_OVERVIEW_PLOT_H
+
+#include <QFrame>
+#include <QImage>
+#include <QString>
+#include <QVector>
+#include <QtGui>
+
+/*! \brief Shows the overview of an I/Q recording with the play position.
+ *
+ * Clicking or dragging selects a position in the recording.
+ */
+class CIqOverviewPlot : public QFrame
+{
+    Q_OBJECT
+
+public:
+    explicit CIqOverviewPlot(QWidget *parent = nullptr);
+
+    QSize minimumSizeHint() const override;
+    QSize sizeHint() const override;
+
+    void setOverview(const QImage &image, const QVector<float> &power);
+    void setMessage(const QString &message);
+    void setPosition(double pos);
+    void setLoop(double start, double end);
+
+signals:
+    /*! \brief A position was selected, 0 at the start and 1 at the end. */
+    void positionSelected(double pos);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+
+private:
+    void select(int x);
+
+    QImage          m_image;
+    QVector<float>  m_power;
+    float           m_powerMin;
+    float           m_powerMax;
+    QString         m_message;
+    double          m_position;
+    double          m_loopStart;
+    double          m_loopEnd;
+};
+
+#endif // IQ_OVERVIEW_PLOT_H
@@ -21,11 +21,17 @@
  * Boston, MA 02110-1301, USA.
  */
 #include <QMessageBox>
+#include <QDateTime>
 #include <QDebug>
 #include <QFileDialog>
+#include <QFile>
 #include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QDir>
 #include <QPalette>
+#include <QJsonArray>
+#include <QSet>
 #include <QString>
 #include <QStringList>
 #include <QScrollBar>
@@ -35,6 +41,11 @@
 #include "iq_tool.h"
 #include "ui_iq_tool.h"
 
+/* Time the squelch must stay closed to stop a squelch triggered save */
+#define HISTORY_SQL_HANG_MS 3000
+
+/* Directory changes within this time are handled together */
+#define DIR_CHANGE_DELAY_MS 250
 
 CIqTool::CIqTool(QWidget *parent) :
     QDialog(parent),
@@ -44,10 +55,15 @@ CIqTool::CIqTool(QWidget *parent) :
 
     is_recording = false;
     is_playing = false;
+    sample_format = "cf32";
     bytes_per_sample = 8;
     sample_rate = 192000;
     rec_len = 0;
+    loop_start = 0;
+    loop_end = 0;
     center_freq = 1e8;
+    sql_triggered = false;
+    sql_closed_ms = 0;
 
     //ui->recDirEdit->setText(QDir::currentPath());
 
@@ -59,11 +75,26 @@ CIqTool::CIqTool(QWidget *parent) :
 
     timer = new QTimer(this);
     connect(timer, SIGNAL(timeout()), this, SLOT(timeoutFunction()));
+
+    // The directory is only listed again when it changes
+    dir_changed = true;
+    dir_timer = new QTimer(this);
+    dir_timer->setSingleShot(true);
+    dir_timer->setInterval(DIR_CHANGE_DELAY_MS);
+    connect(dir_timer, SIGNAL(timeout()), this, SLOT(refreshDir()));
+    watcher = new QFileSystemWatcher(this);
+    connect(watcher, SIGNAL(directoryChanged(QString)), this, SLOT(recDirChanged()));
+
+    overview = new CIqOverview(this);
+    connect(overview, SIGNAL(ready()), this, SLOT(overviewReady()));
+    connect(ui->overviewPlot, SIGNAL(positionSelected(double)),
+            this, SLOT(overviewPositionSelected(double)));
 }
 
 CIqTool::~CIqTool()
 {
     timer->stop();
+    overview->cancel();
     delete timer;
     delete ui;
     delete recdir;
@@ -79,22 +110,118 @@ void CIqTool::setSampleRate(qint64 sr)
     if (!current_file.isEmpty())
     {
         // Get duration of selected recording and update label
-        QFileInfo info(*recdir, current_file);
-        rec_len = (int)(info.size() / (sample_rate * bytes_per_sample));
+        updateRecLen();
         refreshTimeWidgets();
     }
 }
 
+/**
+ * Show the state of the recording buffer.
+ * @param fill Buffer fill level, 0 to 1.
+ * @param dropped Number of samples dropped since the recording started.
+ */
+void CIqTool::setRecordingStats(float fill, quint64 dropped)
+{
+    QString text = tr("Buffer %1%").arg(qRound(fill * 100.0f));
+    if (dropped > 0)
+        text += tr(", %1 dropped").arg(dropped);
+
+    QPalette palette;
+    if (dropped > 0)
+        palette.setColor(QPalette::WindowText, Qt::red);
+
+    ui->bufferLabel->setText(text);
+    ui->bufferLabel->setPalette(palette);
+}
+
+/**
+ * Show how much data is in the I/Q history.
+ * @param seconds Seconds of data in the history.
+ */
+void CIqTool::setHistoryLength(double seconds)
+{
+    if (ui->historySpinBox->value() == 0)
+        ui->historyLabel->clear();
+    else if (ui->historyButton->isChecked())
+        ui->historyLabel->setText(tr("Saving"));
+    else
+        ui->historyLabel->setText(tr("%1 s").arg(qRound(seconds)));
+}
+
+/**
+ * Update the squelch state used to trigger saving the history.
+ * @param open Whether the squelch is open.
+ *
+ * Saving stops when the squelch has been closed for HISTORY_SQL_HANG_MS,
+ * but only if it was started by the squelch.
+ */
+void CIqTool::setSquelchOpen(bool open)
+{
+    if (!ui->historySqlCheckBox->isChecked() || !ui->historyButton->isEnabled())
+        return;
+
+    if (open)
+    {
+        sql_closed_ms = 0;
+        if (!ui->historyButton->isChecked())
+        {
+            ui->historyButton->click();
+            sql_triggered = ui->historyButton->isChecked();
+        }
+        return;
+    }
+
+    if (!sql_triggered)
+        return;
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (sql_closed_ms == 0)
+        sql_closed_ms = now;
+    else if (now - sql_closed_ms >= HISTORY_SQL_HANG_MS && ui->historyButton->isChecked())
+        ui->historyButton->click();
+}
+
+/**
+ * Show the position of the file being played.
+ * @param pos The sample being played.
+ */
+void CIqTool::setPlaybackPosition(qint64 pos)
+{
+    // Don't move the slider away from the user
+    if (!is_playing || ui->slider->isSliderDown() || sample_rate <= 0)
+        return;
+
+    ui->slider->blockSignals(true);
+    ui->slider->setValue((int)(pos * 1000 / sample_rate));
+    ui->slider->blockSignals(false);
+    refreshTimeWidgets();
+}
 
 /*! \brief Slot activated when the user selects a file. */
 void CIqTool::on_listWidget_currentTextChanged(const QString &currentText)
 {
 
     current_file = currentText;
-    QFileInfo info(*recdir, current_file);
 
-    parseFileName(currentText);
-    rec_len = (int)(info.size() / (sample_rate * bytes_per_sample));
+    if (!current_file.isEmpty())
+    {
+        const iq_file_info &info = fileInfo(current_file);
+        if (info.sample_rate > 0)
+            sample_rate = info.sample_rate;
+        if (info.center_freq > 0)
+            center_freq = info.center_freq;
+        sample_format = info.sample_format;
+        bytes_per_sample = info.bytes_per_sample;
+    }
+    updateRecLen();
+
+    // A loop belongs to one file
+    loop_start = 0;
+    loop_end = 0;
+    ui->loopButton->setChecked(false);
+    updateLoop();
+
+    loadOverview();
 
     // Get duration of selected recording and update label
     refreshTimeWidgets();
@@ -129,7 +256,16 @@ void CIqTool::on_playButton_clicked(bool checked)
             ui->listWidget->setEnabled(false);
             ui->recButton->setEnabled(false);
             emit startPlayback(recdir->absoluteFilePath(current_file),
-                               (float)sample_rate, center_freq);
+                               (float)sample_rate, center_freq, sample_format);
+
+            // Playback may have been cancelled
+            if (is_playing)
+            {
+                emit speedChanged(playbackSpeed());
+                updateLoop();
+                if (ui->slider->value() > 0)
+                    on_slider_valueChanged(ui->slider->value());
+            }
         }
     }
     else
@@ -161,30 +297,142 @@ void CIqTool::on_slider_valueChanged(int value)
 {
     refreshTimeWidgets();
 
-    qint64 seek_pos = (qint64)(value)*sample_rate;
+    qint64 seek_pos = (qint64)(value) * sample_rate / 1000;
     emit seek(seek_pos);
 }
 
+/*! \brief Playback speed relative to real time, 0 for as fast as possible. */
+double CIqTool::playbackSpeed(void) const
+{
+    // The last entry is "Max"
+    if (ui->speedCombo->currentIndex() == ui->speedCombo->count() - 1)
+        return 0.0;
+
+    QString text = ui->speedCombo->currentText();
+    text.chop(1);
+    return text.toDouble();
+}
+
+void CIqTool::on_speedCombo_currentIndexChanged(int index)
+{
+    Q_UNUSED(index);
+    emit speedChanged(playbackSpeed());
+}
+
+/*! \brief Set the start of the loop to the current position. */
+void CIqTool::on_loopStartButton_clicked()
+{
+    loop_start = ui->slider->value();
+    if (loop_end <= loop_start)
+        loop_end = rec_len;
+    updateLoop();
+}
+
+/*! \brief Set the end of the loop to the current position. */
+void CIqTool::on_loopEndButton_clicked()
+{
+    loop_end = ui->slider->value();
+    if (loop_start >= loop_end)
+        loop_start = 0;
+    updateLoop();
+}
+
+void CIqTool::on_loopButton_clicked(bool checked)
+{
+    Q_UNUSED(checked);
+    updateLoop();
+}
+
+/*! \brief Load or build the overview of the selected file. */
+void CIqTool::loadOverview(void)
+{
+    if (current_file.isEmpty())
+    {
+        overview->cancel();
+        ui->overviewPlot->setMessage("");
+    }
+    else if (is_recording)
+    {
+        // The file may be growing, and the disk is busy
+        overview->cancel();
+        ui->overviewPlot->setMessage(tr("No overview while recording"));
+    }
+    else
+    {
+        ui->overviewPlot->setMessage(tr("Building overview"));
+        overview->load(recdir->absoluteFilePath(current_file), sample_format);
+    }
+}
+
+void CIqTool::overviewReady(void)
+{
+    ui->overviewPlot->setOverview(overview->image(), overview->power());
+}
+
+/*! \brief Go to a position selected in the overview. */
+void CIqTool::overviewPositionSelected(double pos)
+{
+    ui->slider->setValue((int)(pos * rec_len));
+}
+
+/*! \brief Show the loop and send it to the receiver while playing. */
+void CIqTool::updateLoop(void)
+{
+    if (rec_len > 0 && loop_end > loop_start)
+        ui->overviewPlot->setLoop((double)loop_start / rec_len, (double)loop_end / rec_len);
+    else
+        ui->overviewPlot->setLoop(0.0, 0.0);
+
+    if (loop_end > loop_start)
+        ui->loopLabel->setText(tr("%1 s - %2 s")
+                               .arg(loop_start / 1000.0, 0, 'f', 1)
+                               .arg(loop_end / 1000.0, 0, 'f', 1));
+    else
+        ui->loopLabel->clear();
+
+    if (!is_playing)
+        return;
+
+    if (ui->loopButton->isChecked() && loop_end > loop_start)
+        emit loopChanged(loop_start * sample_rate / 1000, loop_end * sample_rate / 1000);
+    else
+        emit loopChanged(0, 0);
+}
+
 /*! \brief Start/stop recording */
 void CIqTool::on_recButton_clicked(bool checked)
 {
-    is_recording = checked;
-
     if (checked)
     {
+        is_recording = true;
         ui->playButton->setEnabled(false);
-        emit startRecording(recdir->path(), ui->formatCombo->currentText());
+        emit startRecording(recdir->path(), ui->formatCombo->currentText(),
+                            ui->sampleFormatCombo->currentText(),
+                            ui->splitTimeSpinBox->value(), ui->splitSizeSpinBox->value());
 
         refreshDir();
         ui->listWidget->setCurrentRow(ui->listWidget->count()-1);
+        loadOverview();
     }
     else
     {
-        ui->playButton->setEnabled(true);
+        // Buffered data is still being written, see finishRecording()
+        ui->recButton->setEnabled(false);
         emit stopRecording();
     }
 }
 
+/*! \brief A stopped recording has been written and closed. */
+void CIqTool::finishRecording()
+{
+    is_recording = false;
+    ui->recButton->setEnabled(true);
+    ui->playButton->setEnabled(true);
+    ui->bufferLabel->clear();
+    catalog.remove(current_file);   // Size has changed
+    on_listWidget_currentTextChanged(current_file);
+}
+
 /*! Public slot to start IQ recording by external events (e.g. remote control).
  *
  * If a recording is already in progress we ignore the event.
@@ -213,6 +461,73 @@ void CIqTool::stopIqRecorder(void)
         qDebug() << __func__ << "No IQ recording in progress";
 }
 
+/*! \brief Save the history, or stop saving it. */
+void CIqTool::on_historyButton_clicked(bool checked)
+{
+    sql_triggered = false;
+    sql_closed_ms = 0;
+
+    if (checked)
+    {
+        emit startHistorySave(recdir->path());
+        refreshDir();
+    }
+    else
+    {
+        emit stopHistorySave();
+
+        // The saved file has grown since it was parsed
+        catalog.clear();
+        if (!current_file.isEmpty())
+        {
+            fileInfo(current_file);
+            updateRecLen();
+            refreshTimeWidgets();
+        }
+    }
+}
+
+/*! Public slot to save the history by external events (e.g. remote control). */
+void CIqTool::startIqHistorySave(void)
+{
+    if (ui->historyButton->isEnabled() && !ui->historyButton->isChecked())
+        ui->historyButton->click();
+}
+
+/*! Public slot to stop saving the history by external events. */
+void CIqTool::stopIqHistorySave(void)
+{
+    if (ui->historyButton->isChecked())
+        ui->historyButton->click();
+}
+
+/*! \brief Cancel saving the history.
+ *
+ * This slot should be used when saving could not be started or has failed.
+ */
+void CIqTool::cancelHistorySave()
+{
+    ui->historyButton->setChecked(false);
+    sql_triggered = false;
+}
+
+/*! \brief The length of the history has changed. */
+void CIqTool::on_historySpinBox_valueChanged(int value)
+{
+    if (value == 0 && ui->historyButton->isChecked())
+        ui->historyButton->click();
+
+    ui->historyButton->setEnabled(value > 0);
+    emit historyChanged(value, ui->sampleFormatCombo->currentText());
+}
+
+/*! \brief The sample format of new recordings and the history has changed. */
+void CIqTool::on_sampleFormatCombo_currentTextChanged(const QString &text)
+{
+    if (ui->historySpinBox->value() > 0)
+        emit historyChanged(ui->historySpinBox->value(), text);
+}
+
 /*! \brief Cancel a recording.
  *
  * This slot can be activated to cancel an ongoing recording. Cancelling an
@@ -225,7 +540,10 @@ void CIqTool::cancelRecording()
 {
     ui->recButton->setChecked(false);
     ui->playButton->setEnabled(true);
+    ui->bufferLabel->clear();
     is_recording = false;
+    catalog.remove(current_file);
+    on_listWidget_currentTextChanged(current_file);
 }
 
 /*! \brief Catch window close events.
@@ -245,7 +563,8 @@ void CIqTool::closeEvent(QCloseEvent *event)
 void CIqTool::showEvent(QShowEvent * event)
 {
     Q_UNUSED(event);
-    refreshDir();
+    if (dir_changed)
+        refreshDir();
     refreshTimeWidgets();
     timer->start(1000);
 }
@@ -268,6 +587,35 @@ void CIqTool::saveSettings(QSettings *settings)
         settings->setValue("baseband/rec_format", format);
     else
         settings->remove("baseband/rec_format");
+
+    QString sample_fmt = ui->sampleFormatCombo->currentText();
+    if (sample_fmt != "cf32")
+        settings->setValue("baseband/rec_sample_format", sample_fmt);
+    else
+        settings->remove("baseband/rec_sample_format");
+
+    int split = ui->splitTimeSpinBox->value();
+    if (split != 0)
+        settings->setValue("baseband/rec_split_seconds", split);
+    else
+        settings->remove("baseband/rec_split_seconds");
+
+    split = ui->splitSizeSpinBox->value();
+    if (split != 0)
+        settings->setValue("baseband/rec_split_mb", split);
+    else
+        settings->remove("baseband/rec_split_mb");
+
+    int history = ui->historySpinBox->value();
+    if (history != 0)
+        settings->setValue("baseband/history_seconds", history);
+    else
+        settings->remove("baseband/history_seconds");
+
+    if (ui->historySqlCheckBox->isChecked())
+        settings->setValue("baseband/history_squelch", true);
+    else
+        settings->remove("baseband/history_squelch");
 }
 
 void CIqTool::readSettings(QSettings *settings)
@@ -282,6 +630,18 @@ void CIqTool::readSettings(QSettings *settings)
     // Format of baseband recordings
     QString format = settings->value("baseband/rec_format", "Raw").toString();
     ui->formatCombo->setCurrentText(format);
+
+    // Sample format of baseband recordings
+    QString sample_fmt = settings->value("baseband/rec_sample_format", "cf32").toString();
+    ui->sampleFormatCombo->setCurrentText(sample_fmt);
+
+    // Split long recordings into several files
+    ui->splitTimeSpinBox->setValue(settings->value("baseband/rec_split_seconds", 0).toInt());
+    ui->splitSizeSpinBox->setValue(settings->value("baseband/rec_split_mb", 0).toInt());
+
+    // Pre-trigger history
+    ui->historySqlCheckBox->setChecked(settings->value("baseband/history_squelch", false).toBool());
+    ui->historySpinBox->setValue(settings->value("baseband/history_seconds", 0).toInt());
 }
 
 
@@ -296,6 +656,12 @@ void CIqTool::on_recDirEdit_textChanged(const QString &dir)
         recdir->setPath(dir);
         recdir->cd(dir);
         //emit newRecDirSelected(dir);
+
+        if (!watcher->directories().isEmpty())
+            watcher->removePaths(watcher->directories());
+        watcher->addPath(recdir->absolutePath());
+        catalog.clear();
+        recDirChanged();
     }
     else
     {
@@ -317,48 +683,86 @@ void CIqTool::on_recDirButton_clicked()
 
 void CIqTool::timeoutFunction(void)
 {
-    refreshDir();
+    if (overview->isBuilding())
+        ui->overviewPlot->setMessage(tr("Building overview %1%")
+                                     .arg(qRound(overview->progress() * 100.0f)));
 
-    if (is_playing)
+    // The slider follows playback through setPlaybackPosition(). Only a
+    // file being written is checked for its size.
+    if ((is_recording || ui->historyButton->isChecked()) && catalog.contains(current_file))
     {
-        // advance slider with one second
-        int val = ui->slider->value();
-        if (val < ui->slider->maximum())
-        {
-            ui->slider->blockSignals(true);
-            ui->slider->setValue(val+1);
-            ui->slider->blockSignals(false);
-            refreshTimeWidgets();
-        }
-    }
-    if (is_recording)
+        catalog[current_file].size = QFileInfo(*recdir, current_file).size();
+        updateRecLen();
         refreshTimeWidgets();
+    }
+}
+
+/*! \brief The recordings directory has changed. */
+void CIqTool::recDirChanged(void)
+{
+    dir_changed = true;
+    if (isVisible())
+        dir_timer->start();
 }
 
-/*! \brief Refresh list of files in current working directory. */
+/*! \brief Refresh list of files in current working directory.
+ *
+ * Only the list of names is read. Files are parsed when they are selected.
+ */
 void CIqTool::refreshDir()
 {
-    int selection = ui->listWidget->currentRow();
-    QScrollBar * sc = ui->listWidget->verticalScrollBar();
-    int lastScroll = sc->sliderPosition();
+    dir_timer->stop();
+    dir_changed = false;
 
     recdir->refresh();
     QStringList files = recdir->entryList();
+    if (files == listed_files)
+        return;
+
+    // Forget files that are gone
+    QSet<QString> names;
+    for (const auto &name : files)
+        names.insert(name);
+    for (auto it = catalog.begin(); it != catalog.end(); )
+    {
+        if (names.contains(it.key()))
+            ++it;
+        else
+            it = catalog.erase(it);
+    }
+
+    QScrollBar * sc = ui->listWidget->verticalScrollBar();
+    int lastScroll = sc->sliderPosition();
 
     ui->listWidget->blockSignals(true);
     ui->listWidget->clear();
     ui->listWidget->insertItems(0, files);
-    ui->listWidget->setCurrentRow(selection);
+    ui->listWidget->setCurrentRow(files.indexOf(current_file));
     sc->setSliderPosition(lastScroll);
     ui->listWidget->blockSignals(false);
+    listed_files = files;
 
-    if (is_recording)
-    {
-        // update rec_len; if the file being recorded is the one selected
-        // in the list, the length will update periodically
-        QFileInfo info(*recdir, current_file);
-        rec_len = (int)(info.size() / (sample_rate * bytes_per_sample));
-    }
+    if (!current_file.isEmpty() && !names.contains(current_file))
+        on_listWidget_currentTextChanged("");
+}
+
+/*! \brief Length of the selected recording from the catalog. */
+void CIqTool::updateRecLen(void)
+{
+    auto it = catalog.constFind(current_file);
+    if (it == catalog.constEnd() || sample_rate <= 0)
+        rec_len = 0;
+    else
+        rec_len = it->size * 1000 / ((qint64)sample_rate * bytes_per_sample);
+}
+
+/*! \brief Information about a file, parsed the first time it is needed. */
+const iq_file_info &CIqTool::fileInfo(const QString &filename)
+{
+    auto it = catalog.find(filename);
+    if (it == catalog.end())
+        it = catalog.insert(filename, parseFileName(filename));
+    return it.value();
 }
 
 /*! \brief Refresh time labels and slider position
@@ -367,10 +771,11 @@ void CIqTool::refreshDir()
  */
 void CIqTool::refreshTimeWidgets(void)
 {
-    ui->slider->setMaximum(rec_len);
+    ui->slider->setMaximum((int)rec_len);
+    ui->overviewPlot->setPosition(rec_len > 0 ? (double)ui->slider->value() / rec_len : 0.0);
 
     // duration
-    int len = rec_len;
+    int len = (int)(rec_len / 1000);
     int lh, lm, ls;
     lh = len / 3600;
     len = len % 3600;
@@ -378,7 +783,7 @@ void CIqTool::refreshTimeWidgets(void)
     ls = len % 60;
 
     // current position
-    int pos = ui->slider->value();
+    int pos = ui->slider->value() / 1000;
     int ph, pm, ps;
     ph = pos / 3600;
     pos = pos % 3600;
@@ -395,25 +800,85 @@ void CIqTool::refreshTimeWidgets(void)
 }
 
 
-/*! \brief Extract sample rate and offset frequency from file name */
-void CIqTool::parseFileName(const QString &filename)
+/*! \brief Extract sample rate, offset frequency and sample format from file name */
+iq_file_info CIqTool::parseFileName(const QString &filename)
 {
     bool   sr_ok;
     qint64 sr;
     bool   center_ok;
     qint64 center;
+    iq_file_info info;
+
+    info.size = QFileInfo(*recdir, filename).size();
+    info.sample_rate = 0;
+    info.center_freq = 0;
+    info.sample_format = "cf32";
+    info.bytes_per_sample = 8;
 
     QStringList list = filename.split('_');
 
-    if (list.size() < 5)
+    if (list.size() >= 5)
+    {
+        // gqrx_yymmdd_hhmmss_freq_samprate_fc.raw
+        sr = list.at(4).toLongLong(&sr_ok);
+        center = list.at(3).toLongLong(&center_ok);
+
+        if (sr_ok)
+            info.sample_rate = sr;
+        if (center_ok)
+            info.center_freq = center;
+    }
+
+    // fc, cs16 or cs8
+    if (list.size() > 5)
+    {
+        QString tag = list.at(5).section('.', 0, 0);
+        if (tag == "cs16" || tag == "cs8")
+            info.sample_format = tag;
+    }
+
+    if (filename.endsWith(".sigmf-data"))
+        parseSigmfMeta(filename, info);
+
+    if (info.sample_format == "cs16")
+        info.bytes_per_sample = 4;
+    else if (info.sample_format == "cs8")
+        info.bytes_per_sample = 2;
+
+    return info;
+}
+
+/*! \brief Read the sample format, rate and frequency from the SigMF meta file, if any. */
+void CIqTool::parseSigmfMeta(const QString &filename, iq_file_info &info)
+{
+    QString metaName = filename;
+    metaName.replace(metaName.lastIndexOf(".sigmf-data"), 11, ".sigmf-meta");
+
+    QFile metaFile(recdir->absoluteFilePath(metaName));
+    if (!metaFile.open(QIODevice::ReadOnly))
         return;
 
-    // gqrx_yymmdd_hhmmss_freq_samprate_fc.raw
-    sr = list.at(4).toLongLong(&sr_ok);
-    center = list.at(3).toLongLong(&center_ok);
+    QJsonObject root = QJsonDocument::fromJson(metaFile.readAll()).object();
+    QJsonObject global = root["global"].toObject();
+    QString datatype = global["core:datatype"].toString();
+
+    // Only the host byte order is supported
+    if (datatype.startsWith("ci16"))
+        info.sample_format = "cs16";
+    else if (datatype == "ci8")
+        info.sample_format = "cs8";
+    else if (datatype.startsWith("cf32"))
+        info.sample_format = "cf32";
+
+    qint64 sr = (qint64)global["core:sample_rate"].toDouble();
+    if (sr > 0)
+        info.sample_rate = sr;
 
-    if (sr_ok)
-        sample_rate = sr;
-    if (center_ok)
-        center_freq = center;
+    QJsonArray captures = root["captures"].toArray();
+    if (!captures.isEmpty())
+    {
+        qint64 freq = (qint64)captures.at(0).toObject()["core:frequency"].toDouble();
+        if (freq > 0)
+            info.center_freq = freq;
+    }
 }
@@ -26,11 +26,15 @@
 #include <QCloseEvent>
 #include <QDialog>
 #include <QDir>
+#include <QFileSystemWatcher>
+#include <QHash>
 #include <QPalette>
 #include <QSettings>
 #include <QShowEvent>
 #include <QString>
+#include <QStringList>
 #include <QTimer>
+#include "iq_overview.h"
 
 namespace Ui {
     class CIqTool;
@@ -43,6 +47,16 @@ struct iqt_cplx
     float im;
 };
 
+/*! \brief Information about a recording, from its name and SigMF meta file. */
+struct iq_file_info
+{
+    qint64  size;              /*!< File size in bytes. */
+    qint64  sample_rate;       /*!< Sample rate, 0 if unknown. */
+    qint64  center_freq;       /*!< Center frequency, 0 if unknown. */
+    QString sample_format;     /*!< "cf32", "cs16" or "cs8". */
+    int     bytes_per_sample;
+};
+
 
 /*! \brief User interface for I/Q recording and playback. */
 class CIqTool : public QDialog
@@ -54,6 +68,10 @@ public:
     ~CIqTool();
 
     void setSampleRate(qint64 sr);
+    void setRecordingStats(float fill, quint64 dropped);
+    void setHistoryLength(double seconds);
+    void setSquelchOpen(bool open);
+    void setPlaybackPosition(qint64 pos);
 
     void closeEvent(QCloseEvent *event);
     void showEvent(QShowEvent * event);
@@ -62,17 +80,28 @@ public:
     void readSettings(QSettings *settings);
 
 signals:
-    void startRecording(const QString recdir, const QString format);
+    void startRecording(const QString recdir, const QString format,
+                        const QString sample_format, int split_seconds, int split_mb);
     void stopRecording();
-    void startPlayback(const QString filename, float samprate, qint64 center_freq);
+    void startPlayback(const QString filename, float samprate, qint64 center_freq,
+                       const QString sample_format);
     void stopPlayback();
     void seek(qint64 seek_pos);
+    void speedChanged(double speed);
+    void loopChanged(qint64 start, qint64 end);
+    void historyChanged(int seconds, const QString sample_format);
+    void startHistorySave(const QString recdir);
+    void stopHistorySave();
 
 public slots:
     void cancelRecording();
+    void finishRecording();
     void cancelPlayback();
     void startIqRecorder(void);     /*!< Used if IQ Recorder is started e.g. from remote control */
     void stopIqRecorder(void);      /*!< Used if IQ Recorder is stopped e.g. from remote control */
+    void startIqHistorySave(void);  /*!< Used if the history is saved e.g. from remote control */
+    void stopIqHistorySave(void);
+    void cancelHistorySave();
 
 private slots:
     void on_recDirEdit_textChanged(const QString &text);
@@ -80,29 +109,56 @@ private slots:
     void on_recButton_clicked(bool checked);
     void on_playButton_clicked(bool checked);
     void on_slider_valueChanged(int value);
+    void on_speedCombo_currentIndexChanged(int index);
+    void on_loopStartButton_clicked();
+    void on_loopEndButton_clicked();
+    void on_loopButton_clicked(bool checked);
     void on_listWidget_currentTextChanged(const QString &currentText);
+    void on_sampleFormatCombo_currentTextChanged(const QString &text);
+    void on_historySpinBox_valueChanged(int value);
+    void on_historyButton_clicked(bool checked);
+    void overviewReady(void);
+    void overviewPositionSelected(double pos);
     void timeoutFunction(void);
+    void recDirChanged(void);
+    void refreshDir(void);
 
 private:
-    void refreshDir(void);
     void refreshTimeWidgets(void);
-    void parseFileName(const QString &filename);
+    void updateRecLen(void);
+    const iq_file_info &fileInfo(const QString &filename);
+    iq_file_info parseFileName(const QString &filename);
+    void parseSigmfMeta(const QString &filename, iq_file_info &info);
+    void updateLoop(void);
+    void loadOverview(void);
+    double playbackSpeed(void) const;
 
 private:
     Ui::CIqTool *ui;
 
     QDir        *recdir;
     QTimer      *timer;
+    QTimer      *dir_timer;     /*!< Collects directory changes. */
+    QFileSystemWatcher *watcher;
+    QHash<QString, iq_file_info> catalog;   /*!< Parsed files, filled when selected. */
+    QStringList listed_files;   /*!< Files in the list widget. */
+    bool        dir_changed;    /*!< The directory must be listed again. */
     QPalette    *error_palette; /*!< Palette used to indicate an error. */
+    CIqOverview *overview;      /*!< Overview of the selected file. */
 
     QString current_file;      /*!< Selected file in file browser. */
 
     bool    is_recording;
     bool    is_playing;
-    int     bytes_per_sample;  /*!< Bytes per sample (fc = 4) */
+    QString sample_format;     /*!< Sample format of the selected file. */
+    int     bytes_per_sample;  /*!< Bytes per sample (cf32 = 8) */
     int     sample_rate;       /*!< Current sample rate. */
     qint64  center_freq;       /*!< Center frequency. */
-    int     rec_len;           /*!< Length of a recording in seconds */
+    qint64  rec_len;           /*!< Length of a recording in milliseconds */
+    qint64  loop_start;        /*!< Start of the loop in milliseconds */
+    qint64  loop_end;          /*!< End of the loop in milliseconds */
+    bool    sql_triggered;     /*!< The history is being saved because of the squelch. */
+    qint64  sql_closed_ms;     /*!< When the squelch closed, 0 while it is open. */
 };
 
 #endif // IQ_TOOL_H
@@ -31,6 +31,7 @@
 #include <QColor>
 #include <QDateTime>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFont>
 #include <QPainter>
 #include <QtGlobal>
@@ -39,6 +40,10 @@
 #include "bandplan.h"
 #include "bookmarks.h"
 #include "dxc_spots.h"
+#include "waterfall_recorder.h"
+#ifdef WITH_OPENGL_WATERFALL
+#include "waterfall_gl.h"
+#endif
 #include <volk/volk.h>
 
 Q_LOGGING_CATEGORY(plotter, "plotter")
@@ -66,6 +71,21 @@ Q_LOGGING_CATEGORY(plotter, "plotter")
 #define HOR_MARGIN 5
 #define VER_MARGIN 5
 
+/* 10 * log10(2), converts log2 of power to dB */
+#define DB_PER_LOG2 3.0103f
+
+/* Spectrum levels are kept in dB, zero power is stored as this */
+#define SPECTRUM_MIN_DB -300.f
+
+/* Raw waterfall lines are stored in steps of 1/256 dB above WF_RAW_MIN_DB.
+ * Value 0 means no data. */
+#define WF_RAW_MIN_DB       -200.f
+#define WF_RAW_STEPS_PER_DB 256.f
+#define WF_RAW_MAX          65535
+
+/* Memory used for waterfall history. At least one screen is always kept. */
+#define WF_HISTORY_MAX_BYTES (16 * 1024 * 1024)
+
 static inline bool val_is_out_of_range(float val, float min, float max)
 {
     return (val < min || val > max);
@@ -78,10 +98,85 @@ static inline bool out_of_range(float min, float max)
             max < min + FFT_MIN_DB_RANGE);
 }
 
+// Running average of the time spent per frame
+static inline float averageCost(float avg, float ms)
+{
+    return (avg > 0.f) ? avg + 0.1f * (ms - avg) : ms;
+}
+
+/**
+ * Convert linear power to dB.
+ * @param out Output in dB, at least SPECTRUM_MIN_DB.
+ * @param in Linear power.
+ * @param n Number of values.
+ *
+ * The logarithm is computed for all values at once with VOLK, which is a lot
+ * faster than calling log10f() per value. Output may be the same as input.
+ */
+static void powerToDb(float *out, const float *in, int n)
+{
+    if (n <= 0)
+        return;
+
+    volk_32f_log2_32f(out, in, n);
+
+    for (int i = 0; i < n; ++i)
+    {
+        // Written so that NaN and -inf from zero input map to the minimum
+        const float v = DB_PER_LOG2 * out[i];
+        out[i] = v > SPECTRUM_MIN_DB ? v : SPECTRUM_MIN_DB;
+    }
+}
+
+/**
+ * Convert dB to levels below a reference, in the unit of a plot axis or
+ * color map.
+ * @param out Output, gain * (maxdB - in) limited to 0 ... limit.
+ * @param in Levels in dB.
+ * @param n Number of values.
+ * @param maxdB The reference level in dB, mapped to 0.
+ * @param gain Output units per dB.
+ * @param limit The maximum output value.
+ */
+static void dbToLevel(float *out, const float *in, int n,
+                      float maxdB, float gain, float limit)
+{
+    const float offset = gain * maxdB;
+    for (int i = 0; i < n; ++i)
+    {
+        const float v = offset - gain * in[i];
+        out[i] = v < limit ? std::max(v, 0.0f) : limit;
+    }
+}
+
+/**
+ * Update a spectrum IIR in the log domain.
+ * @param iir IIR state in dB.
+ * @param in New levels in dB.
+ * @param n Number of values.
+ * @param a IIR coefficient, 1 to use the new levels only.
+ *
+ * A linear blend of dB values is the same as the geometric blend
+ * iir * (in / iir)^a of linear power, which gives symmetric attack and decay
+ * on the logarithmic y-axis, without a pow() per value.
+ */
+static void updateIirDb(float *iir, const float *in, int n, float a)
+{
+    if (a == 1.0f)
+    {
+        memcpy(iir, in, n * sizeof(float));
+        return;
+    }
+
+    for (int i = 0; i < n; ++i)
+        iir[i] += a * (in[i] - iir[i]);
+}
+
 #define STATUS_TIP \
     "Click, drag or scroll on spectrum to tune. " \
     "Drag and scroll X and Y axes for pan and zoom. " \
-    "Drag filter edges to adjust filter."
+    "Drag filter edges to adjust filter. " \
+    "Ctrl+Shift+scroll on waterfall to view history."
 
 CPlotter::CPlotter(QWidget *parent) : QFrame(parent)
 {
@@ -105,6 +200,7 @@ CPlotter::CPlotter(QWidget *parent) : QFrame(parent)
     m_histIIRValid = false;
     m_alpha = 1.0;
     m_histMaxIIR = std::numeric_limits<float>::min();
+    m_renderResets = 0;
 
     m_FftCenter = 0;
     m_CenterFreq = 144500000;
@@ -146,10 +242,9 @@ CPlotter::CPlotter(QWidget *parent) : QFrame(parent)
     m_FreqUnits = 1000000;
     m_CursorCaptured = NOCAP;
     m_Running = false;
-    m_DrawOverlay = true;
-    m_2DPixmap = QPixmap();
-    m_OverlayPixmap = QPixmap();
-    m_PeakPixmap = QPixmap();
+    m_OverlayDirty = OVERLAY_ALL;
+    m_2DImage = QImage();
+    m_OverlayImage = QImage();
     m_WaterfallImage = QImage();
     m_Size = QSize(0,0);
     m_GrabPosition = 0;
@@ -177,10 +272,27 @@ CPlotter::CPlotter(QWidget *parent) : QFrame(parent)
     wf_avg_count = 0;
     wf_span = 0;
     fft_rate = 15;
+
+    m_renderStop = false;
+    m_renderJobPending = false;
+    m_renderResultPending = false;
+    m_renderedPeaksValid = false;
+    m_renderedCost = 0.f;
+    m_renderCost = 0.f;
+    m_renderDoneCost = 0.f;
+    m_paintCost = 0.f;
+    m_renderThread = std::thread(&CPlotter::renderThread, this);
 }
 
 CPlotter::~CPlotter()
-= default;
+{
+    {
+        std::lock_guard<std::mutex> lock(m_renderMutex);
+        m_renderStop = true;
+    }
+    m_renderCond.notify_one();
+    m_renderThread.join();
+}
 
 QSize CPlotter::minimumSizeHint() const
 {
@@ -196,8 +308,8 @@ void CPlotter::mouseMoveEvent(QMouseEvent* event)
 {
     QPoint pt = event->pos();
 
-    int w = m_OverlayPixmap.width();
-    int h = m_OverlayPixmap.height();
+    int w = m_OverlayImage.width();
+    int h = m_OverlayImage.height();
     int px = qRound((qreal)pt.x() * m_DPR);
     int py = qRound((qreal)pt.y() * m_DPR);
     QPoint ppos = QPoint(px, py);
@@ -365,11 +477,11 @@ void CPlotter::mouseMoveEvent(QMouseEvent* event)
             {
                 emit pandapterRangeChanged(m_PandMindB, m_PandMaxdB);
 
-                m_histIIRValid = false;
+                m_renderResets |= RESET_HIST;
 
                 m_Yzero = py;
 
-                updateOverlay();
+                updateOverlay(OVERLAY_GRID);
             }
         }
     }
@@ -394,9 +506,7 @@ void CPlotter::mouseMoveEvent(QMouseEvent* event)
                     setFftCenterFreq(m_FftCenter + delta_hz);
                 }
 
-                m_MaxHoldValid = false;
-                m_MinHoldValid = false;
-                m_histIIRValid = false;
+                m_renderResets |= RESET_MAXHOLD | RESET_MINHOLD | RESET_HIST;
 
                 m_Xzero = px;
 
@@ -423,7 +533,7 @@ void CPlotter::mouseMoveEvent(QMouseEvent* event)
                 clampDemodParameters();
 
                 emit newFilterFreq(m_DemodLowCutFreq, m_DemodHiCutFreq);
-                updateOverlay();
+                updateOverlay(OVERLAY_MARKERS);
             }
             else
             {
@@ -456,7 +566,7 @@ void CPlotter::mouseMoveEvent(QMouseEvent* event)
                 clampDemodParameters();
 
                 emit newFilterFreq(m_DemodLowCutFreq, m_DemodHiCutFreq);
-                updateOverlay();
+                updateOverlay(OVERLAY_MARKERS);
             }
             else
             {
@@ -481,7 +591,7 @@ void CPlotter::mouseMoveEvent(QMouseEvent* event)
                                               m_ClickResolution );
                 emit newDemodFreq(m_DemodCenterFreq,
                                   m_DemodCenterFreq - m_CenterFreq);
-                updateOverlay();
+                updateOverlay(OVERLAY_MARKERS);
             }
             else
             {
@@ -587,16 +697,51 @@ void CPlotter::setWaterfallSpan(quint64 span_ms)
 {
     wf_span = span_ms;
     quint64 tnow = QDateTime::currentMSecsSinceEpoch();
-    if (!m_WaterfallImage.isNull()) {
+    if (!m_WaterfallSize.isEmpty()) {
         wf_epoch = tnow;
         wf_count = 0;
-        msec_per_wfline = (double)wf_span / (qreal)m_WaterfallImage.height();
+        msec_per_wfline = (double)wf_span / (qreal)m_WaterfallSize.height();
     }
     wf_valid_since_ms = tnow;
     clearWaterfallBuf();
 }
 
 void CPlotter::clearWaterfallBuf()
+{
+    m_renderResets |= RESET_WFBUF;
+}
+
+/**
+ * Allocate histogram storage, called on the render thread.
+ * @param cols Number of pixel columns, 0 to free the storage.
+ * @param bins Number of histogram bins per column.
+ *
+ * The histogram is invalidated when the size changes.
+ */
+void CPlotter::resizeHistogram(int cols, int bins)
+{
+    if (cols == m_histCols && bins == m_histBins)
+        return;
+
+    m_histCols = cols;
+    m_histBins = bins;
+    if (cols > 0 && bins > 0)
+    {
+        m_histogram.assign((size_t)cols * bins, 0.0f);
+        m_histIIR.assign((size_t)cols * bins, 0.0f);
+        m_histTop.assign(cols, 0.0f);
+    }
+    else
+    {
+        std::vector<float>().swap(m_histogram);
+        std::vector<float>().swap(m_histIIR);
+        std::vector<float>().swap(m_histTop);
+    }
+    m_histIIRValid = false;
+}
+
+// Clear the waterfall accumulator, called on the render thread
+void CPlotter::clearWaterfallAccumulator()
 {
     for (int i = 0; i < MAX_SCREENSIZE; i++)
         m_wfbuf[i] = 0.0;
@@ -612,6 +757,20 @@ quint64 CPlotter::getWfTimeRes() const
         return 1000 / fft_rate;
 }
 
+/**
+ * Set the recorder to pass new waterfall lines to.
+ * @param recorder The recorder, or nullptr to stop passing lines.
+ */
+void CPlotter::setWaterfallRecorder(CWaterfallRecorder *recorder)
+{
+    m_wfRecorder = recorder;
+    if (m_wfRecorder)
+    {
+        m_wfRecorder->setRawScale(WF_RAW_MIN_DB, WF_RAW_STEPS_PER_DB);
+        m_wfRecorder->setColors(m_ColorTbl, m_WfMindB, m_WfMaxdB);
+    }
+}
+
 void CPlotter::setFftRate(int rate_hz)
 {
     fft_rate = rate_hz;
@@ -655,6 +814,8 @@ void CPlotter::mousePressEvent(QMouseEvent * event)
                 quint32 mods = event->modifiers() & (Qt::ShiftModifier|Qt::ControlModifier);
                 if (m_MarkersEnabled && ((event->modifiers() & mods) != 0))
                 {
+                    // Plot buffers are owned by the render thread
+                    std::lock_guard<std::mutex> stateLock(m_renderStateMutex);
                     float *selectBuf = nullptr;
 
                     // when max hold is valid, ctrl-shift selects max hold
@@ -690,10 +851,10 @@ void CPlotter::mousePressEvent(QMouseEvent * event)
                     {
                         // Find the data value of the click y()
 
-                        const qreal plotHeight = m_2DPixmap.height();
+                        const qreal plotHeight = m_OverlayImage.height();
                         const float panddBGainFactor = (float)plotHeight / fabsf(m_PandMaxdB - m_PandMindB);
-                        const float vlog = m_PandMaxdB - py / panddBGainFactor;
-                        const float v = powf(10.0f, vlog / 10.0f);
+                        // Plot buffers are in dB
+                        const float v = m_PandMaxdB - py / panddBGainFactor;
 
                         // Ignore clicks exactly on the plot, below the
                         // pandapter, or when uninitialized
@@ -742,7 +903,7 @@ void CPlotter::mousePressEvent(QMouseEvent * event)
                     // setCursor(QCursor(Qt::CrossCursor));
                     m_CursorCaptured = CENTER;
                     m_GrabPosition = 1;
-                    updateOverlay();
+                    updateOverlay(OVERLAY_MARKERS);
                 }
             }
             else if (event->buttons() == Qt::MiddleButton)
@@ -794,7 +955,7 @@ void CPlotter::mouseReleaseEvent(QMouseEvent * event)
     QPoint pt = event->pos();
     int py = qRound((qreal)pt.y() * m_DPR);
 
-    if (py >= m_OverlayPixmap.height())
+    if (py >= m_OverlayImage.height())
     {
         // not in Overlay region
         if (NOCAP != m_CursorCaptured)
@@ -872,9 +1033,7 @@ void CPlotter::zoomStepX(float step, int x)
     m_Span = new_span;
     setFftCenterFreq(qRound64((f_max + f_min) / 2.0f));
 
-    m_MaxHoldValid = false;
-    m_MinHoldValid = false;
-    m_histIIRValid = false;
+    m_renderResets |= RESET_MAXHOLD | RESET_MINHOLD | RESET_HIST;
 
     updateOverlay();
 
@@ -894,8 +1053,7 @@ void CPlotter::zoomOnXAxis(float level)
 void CPlotter::setPlotMode(int mode)
 {
     m_PlotMode = (ePlotMode)mode;
-    m_MaxHoldValid = false;
-    m_MinHoldValid = false;
+    m_renderResets |= RESET_MAXHOLD | RESET_MINHOLD;
     // Do not need to invalidate IIR data when switching modes
 
     updateOverlay();
@@ -905,15 +1063,15 @@ void CPlotter::setPlotScale(int scale, bool perHz)
 {
     m_PlotScale = (ePlotScale)scale;
     m_PlotPerHz = perHz;
-    m_MaxHoldValid = false;
-    m_MinHoldValid = false;
-    m_IIRValid = false;
-    m_histIIRValid = false;
+    m_renderResets |= RESET_MAXHOLD | RESET_MINHOLD | RESET_IIR | RESET_HIST;
 }
 
 void CPlotter::setWaterfallMode(int mode)
 {
     m_WaterfallMode = (eWaterfallMode)mode;
+
+    // The sync mode accumulates dB rather than linear power
+    m_renderResets |= RESET_WFBUF;
 }
 
 // Called when a mouse wheel is turned
@@ -924,7 +1082,7 @@ void CPlotter::wheelEvent(QWheelEvent * event)
 #else
     QPointF pt = event->position();
 #endif
-    int h = m_OverlayPixmap.height();
+    int h = m_OverlayImage.height();
     int px = qRound((qreal)pt.x() * m_DPR);
     int py = qRound((qreal)pt.y() * m_DPR);
 
@@ -933,6 +1091,8 @@ void CPlotter::wheelEvent(QWheelEvent * event)
     double numSteps = delta / (8.0 * 15.0);
     // zoom faster when Ctrl is held
     double zoomBase = (event->modifiers() & Qt::ControlModifier) ? 0.7 : 0.9;
+    // most wheel actions only move the filter
+    int overlayLayers = OVERLAY_MARKERS;
 
     if (m_CursorCaptured == YAXIS)
     {
@@ -954,13 +1114,26 @@ void CPlotter::wheelEvent(QWheelEvent * event)
         if (m_PandMindB < FFT_MIN_DB)
             m_PandMindB = FFT_MIN_DB;
 
-        m_histIIRValid = false;
+        m_renderResets |= RESET_HIST;
+        overlayLayers = OVERLAY_GRID;
 
         emit pandapterRangeChanged(m_PandMindB, m_PandMaxdB);
     }
     else if (m_CursorCaptured == XAXIS)
     {
         zoomStepX(pow(zoomBase, numSteps), px);
+        overlayLayers = OVERLAY_ALL;
+    }
+    else if (py >= h && !m_WaterfallSize.isEmpty()
+             && (event->modifiers() & Qt::ControlModifier)
+             && (event->modifiers() & Qt::ShiftModifier))
+    {
+        // waterfall scrollback, wheel up shows older lines
+        const int wfHeight = m_WaterfallSize.height();
+        const int maxScroll = std::max((int)m_wfHistory.size() - wfHeight, 0);
+        m_wfScroll = qBound(0, m_wfScroll + qRound(numSteps * wfHeight / 8.0), maxScroll);
+        m_wfRerender = true;
+        update();
     }
     else if (event->modifiers() & Qt::ControlModifier)
     {
@@ -993,7 +1166,7 @@ void CPlotter::wheelEvent(QWheelEvent * event)
         emit newDemodFreq(m_DemodCenterFreq, m_DemodCenterFreq-m_CenterFreq);
     }
 
-    updateOverlay();
+    updateOverlay(overlayLayers);
     m_CumWheelDelta = 0;
 }
 
@@ -1012,6 +1185,7 @@ void CPlotter::resizeEvent(QResizeEvent* )
         // Use scaled system font
         m_Font = QFont();
         m_Font.setPointSizeF(m_Font.pointSizeF() * m_DPR);
+        m_TagLabelCache.clear();
 
         // Higher resolution pixmaps are used with higher DPR. They are
         // rescaled in paintEvent().
@@ -1022,50 +1196,56 @@ void CPlotter::resizeEvent(QResizeEvent* )
         const int plotHeight = qRound((qreal)rawPlotHeight * m_DPR);
         const int wfHeight = qRound((qreal)rawWfHeight * m_DPR);
 
-        m_OverlayPixmap = QPixmap(w, plotHeight);
-        m_OverlayPixmap.fill(Qt::transparent);
+        m_OverlayImage = QImage(w, plotHeight, QImage::Format_ARGB32_Premultiplied);
+        m_OverlayImage.fill(Qt::transparent);
 
-        m_2DPixmap = QPixmap(w, plotHeight);
-        m_2DPixmap.fill(QColor::fromRgba(PLOTTER_BGD_COLOR));
+        m_2DImage = QImage(w, plotHeight, QImage::Format_ARGB32_Premultiplied);
+        m_2DImage.fill(QColor::fromRgba(PLOTTER_BGD_COLOR));
 
         // No waterfall, use null image
         if (wfHeight == 0)
         {
             m_WaterfallImage = QImage();
+            m_WaterfallSize = QSize();
+#ifdef WITH_OPENGL_WATERFALL
+            if (m_wfGL)
+                m_wfGL->hide();
+#endif
         }
 
-        // New waterfall, create blank area
-        else if (m_WaterfallImage.isNull()) {
-            m_WaterfallImage = QImage(w, wfHeight, QImage::Format_RGB32);
-            m_WaterfallImage.setDevicePixelRatio(m_DPR);
-            m_WaterfallImage.fill(Qt::black);
-            m_WaterfallOffset = wfHeight;
-        }
-
-        // Existing waterfall, rescale width but no height as that would
-        // invalidate time
+        // New size, the waterfall is colored from the history in paintEvent()
         else
         {
-            const int wfHeightOld = m_WaterfallImage.height();
-            QImage oldWaterfall = m_WaterfallImage.scaled(
-                w, wfHeightOld,
-                Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
-            m_WaterfallImage = QImage(w, wfHeight, QImage::Format_RGB32);
-            m_WaterfallImage.setDevicePixelRatio(m_DPR);
-            m_WaterfallImage.fill(Qt::black);
-            const int firstHeight = std::min(wfHeight, wfHeightOld - m_WaterfallOffset);
-            memcpy(m_WaterfallImage.scanLine(0), oldWaterfall.scanLine(m_WaterfallOffset),
-                 m_WaterfallImage.bytesPerLine() * firstHeight);
-            const int secondHeight = std::min(wfHeight - firstHeight, m_WaterfallOffset);
-            memcpy(m_WaterfallImage.scanLine(firstHeight), oldWaterfall.scanLine(0),
-                 m_WaterfallImage.bytesPerLine() * secondHeight);
+            m_WaterfallSize = QSize(w, wfHeight);
             m_WaterfallOffset = wfHeight;
+            m_wfRerender = true;
+#ifdef WITH_OPENGL_WATERFALL
+            if (!m_wfGL && !m_wfGLFailed)
+            {
+                m_wfGL = new CWaterfallGL(this);
+                // Queued, since the widget is deleted on failure
+                connect(m_wfGL, SIGNAL(failed()), this, SLOT(openGLWaterfallFailed()),
+                        Qt::QueuedConnection);
+                m_wfLutValid = false;
+            }
+            if (m_wfGL)
+            {
+                m_WaterfallImage = QImage();
+                m_wfGL->setGeometry(0, rawPlotHeight, s.width(), rawWfHeight);
+                m_wfGL->setTextureSize(w, wfHeight);
+                m_wfGL->show();
+            }
+            else
+#endif
+            {
+                m_WaterfallImage = QImage(w, wfHeight, QImage::Format_RGB32);
+                m_WaterfallImage.setDevicePixelRatio(m_DPR);
+                m_WaterfallImage.fill(Qt::black);
+            }
         }
 
         // Invalidate on resize
-        m_MaxHoldValid = false;
-        m_MinHoldValid = false;
-        m_histIIRValid = false;
+        m_renderResets |= RESET_MAXHOLD | RESET_MINHOLD | RESET_HIST;
         // Do not need to invalidate IIR data (just histogram IIR)
 
         // Waterfall accumulator may be the wrong size now, so invalidate.
@@ -1083,27 +1263,45 @@ void CPlotter::resizeEvent(QResizeEvent* )
 // Called by QT when screen needs to be redrawn
 void CPlotter::paintEvent(QPaintEvent *)
 {
-    // Pixmap resolution scales with DPR. Here, they are rescaled to fit the
-    // the CPlotter resolution.
+    // Image resolution scales with DPR. Here, they are rescaled to fit the
+    // the CPlotter resolution. Everything is rendered already, see draw().
+
+    QElapsedTimer cost;
+    cost.start();
 
     QPainter painter(this);
 
     int plotHeightT = 0;
-    if (!m_2DPixmap.isNull())
+    if (!m_2DImage.isNull())
     {
-        const int plotWidthS = m_2DPixmap.width();
-        const int plotHeightS = m_2DPixmap.height();
+        const int plotWidthS = m_2DImage.width();
+        const int plotHeightS = m_2DImage.height();
         const QRectF plotRectS(0.0, 0.0, plotWidthS, plotHeightS);
 
         const int plotWidthT = qRound((qreal)plotWidthS / m_DPR);
         plotHeightT = qRound((qreal)plotHeightS / m_DPR);
         const QRectF plotRectT(0.0, 0.0, plotWidthT, plotHeightT);
 
-        painter.drawPixmap(plotRectT, m_2DPixmap, plotRectS);
+        painter.drawImage(plotRectT, m_2DImage, plotRectS);
+    }
+
+    if (!m_WaterfallSize.isEmpty())
+    {
+        // Color the history again if the range, colormap or zoom has changed
+        if (!m_wfLutValid)
+            updateWaterfallLut();
+        if (m_wfRerender
+            || m_wfViewHzPerPx != (double)m_Span / (double)m_WaterfallSize.width()
+            || m_wfViewStartHz != (double)(m_CenterFreq + m_FftCenter) - (double)m_Span / 2.0)
+        {
+            renderWaterfall();
+        }
     }
 
+    // The OpenGL waterfall draws itself
     if (!m_WaterfallImage.isNull())
     {
+
         const int wfWidth = m_WaterfallImage.width();
         const int wfWidthT = qRound((qreal)wfWidth / m_DPR);
         const int wfHeight = m_WaterfallImage.height();
@@ -1118,31 +1316,68 @@ void CPlotter::paintEvent(QPaintEvent *)
         painter.drawImage(QRectF(0.0, plotHeightT + firstHeightT, wfWidthT, secondHeightT), m_WaterfallImage,
             QRectF(0.0, 0.0, wfWidth, m_WaterfallOffset));
     }
+
+    m_paintCost = averageCost(m_paintCost, m_renderDoneCost + cost.nsecsElapsed() * 1e-6f);
+    m_renderDoneCost = 0.f;
 }
 
-// Called to update spectrum data for displaying on the screen
-void CPlotter::draw(bool newData)
+/**
+ * Quantize linear power to raw waterfall values.
+ * @param out Output, 1 ... WF_RAW_MAX.
+ * @param in Linear power.
+ * @param n Number of values.
+ * @param scratch Scratch buffer for n values.
+ */
+static void powerToRaw(quint16 *out, const float *in, int n, float *scratch)
 {
-    qint32        i, j;
-    float         histMax;
-    QFontMetricsF metrics(m_Font);
+    if (n <= 0)
+        return;
+
+    volk_32f_log2_32f(scratch, in, n);
+
+    const float scale = DB_PER_LOG2 * WF_RAW_STEPS_PER_DB;
+    const float offset = -WF_RAW_MIN_DB * WF_RAW_STEPS_PER_DB + 0.5f;
+    for (int i = 0; i < n; ++i)
+    {
+        // Written so that NaN from zero input maps to 1
+        const float v = offset + scale * scratch[i];
+        out[i] = v >= 1.0f ? (quint16)std::min(v, (float)WF_RAW_MAX) : 1;
+    }
+}
+
+/**
+ * Quantize levels in dB to raw waterfall values.
+ * @param out Output, 1 ... WF_RAW_MAX.
+ * @param in Levels in dB.
+ * @param n Number of values.
+ */
+static void dbToRaw(quint16 *out, const float *in, int n)
+{
+    const float offset = -WF_RAW_MIN_DB * WF_RAW_STEPS_PER_DB + 0.5f;
+    for (int i = 0; i < n; ++i)
+    {
+        const float v = offset + WF_RAW_STEPS_PER_DB * in[i];
+        out[i] = v >= 1.0f ? (quint16)std::min(v, (float)WF_RAW_MAX) : 1;
+    }
+}
 
+// Called to update spectrum data for displaying on the screen. The plot and
+// the new waterfall line are rendered on the render thread, see renderFrame().
+void CPlotter::draw(bool newData)
+{
     // No fft data yet? Draw overlay if needed and return.
     if (m_fftDataSize == 0)
     {
-        if (!m_2DPixmap.isNull()) {
+        if (!m_2DImage.isNull()) {
             // Update the overlay if needed
-            if (m_DrawOverlay)
-            {
+            if (m_OverlayDirty)
                 drawOverlay();
-                m_DrawOverlay = false;
-            }
 
             // Draw overlay over plot
-            m_2DPixmap.fill(QColor::fromRgba(PLOTTER_BGD_COLOR));
-            QPainter painter(&m_2DPixmap);
+            m_2DImage.fill(QColor::fromRgba(PLOTTER_BGD_COLOR));
+            QPainter painter(&m_2DImage);
             painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-            painter.drawPixmap(QPointF(0.0, 0.0), m_OverlayPixmap);
+            painter.drawImage(QPointF(0.0, 0.0), m_OverlayImage);
             update();
         }
 
@@ -1150,202 +1385,861 @@ void CPlotter::draw(bool newData)
     }
 
     const quint64 tnow_ms = QDateTime::currentMSecsSinceEpoch();
+    QFontMetricsF metrics(m_Font);
+    RenderJob job;
 
-    // Pixmaps might be null, so scale up m_Size to get width.
-    const qreal w = m_Size.width() * m_DPR;
-    const qreal plotHeight = m_2DPixmap.height();
-    const qreal shadowOffset = metrics.height() / 20.0;
-
-    // Scale plotter for graph height
-    const float panddBGainFactor = (float)plotHeight / fabsf(m_PandMaxdB - m_PandMindB);
-    // Scale waterfall and histogram for colormap
-    const float wfdBGainFactor = 256.0f / fabsf(m_WfMaxdB - m_WfMindB);
-
-    const double fftSize = m_fftDataSize;
-    const double sampleFreq = (double)m_SampleFreq;
-    const double fftCenter = (double)m_FftCenter;
-    const double span = (double)m_Span;
-    const double startFreq = fftCenter - span / 2.0;
-    const double binsPerHz = fftSize / sampleFreq;
-
-    // Scale factor for x -> fft bin (pixels per bin).
-    double xScale = sampleFreq * w / fftSize / span;
-
-    // Center of fft is the center of the DC bin. The Nyquist bin (index 0
-    // after shift) is not used.
-    const double startBinD = startFreq * binsPerHz + fftSize / 2.0;
-    const qint32 startBin = std::min(qRound(startBinD), m_fftDataSize - 1);
-    const qint32 numBins = (qint32)ceil(span * binsPerHz);
-    const qint32 endBin = startBin + numBins;
-    const qint32 minbin = std::max(startBin, 1);
-    const qint32 maxbin = std::min(endBin + 1, m_fftDataSize - 1);
-
-    const qint32 xmin = qRound((double)(minbin - startBin) * xScale);
-    const qint32 xmax = std::min(qRound((double)(maxbin - startBin) * xScale), qRound(w));
-
-    const float frameTime = 1.0f / (float)fft_rate;
-
-    // Do plotter work only if visible.
-    const bool plotterVisible = (!m_2DPixmap.isNull());
-
-    // Limit plotter drawing rate.
-    const bool drawPlotter = (plotterVisible
+    // Do plotter work only if visible. Limit plotter drawing rate.
+    job.plotVisible = !m_OverlayImage.isNull();
+    job.drawPlot = (job.plotVisible
         && tnow_ms >= tlast_plot_drawn_ms + PLOTTER_UPDATE_LIMIT_MS);
 
-    // Do not waste time with histogram calculations unless in this mode.
-    const bool doHistogram = (plotterVisible && m_PlotMode == PLOT_MODE_HISTOGRAM && (!m_histIIRValid || newData));
-
-    // Use fewer histogram bins when statistics are sparse
-    const int histBinsDisplayed = std::min(
-        MAX_HISTOGRAM_SIZE,
-        std::max(32,
-            qRound(32 * (float)numBins / 2048.0f))
-        );
-
-    // Amount to add to histogram for each hit
-    const float histWeight = 10e6f * frameTime / (float)histBinsDisplayed / (float)fftSize;
+    if (job.drawPlot)
+    {
+        tlast_plot_drawn_ms = tnow_ms;
 
-    // Bins / dB
-    const float histdBGainFactor = (float)histBinsDisplayed / fabsf(m_PandMaxdB - m_PandMindB);
+        // Run peak detection periodically. If overlay will be redrawn, run
+        // peak detection since zoom/pan may have changed.
+        if (m_PeakDetectActive
+            && (tnow_ms > tlast_peaks_ms + PEAK_UPDATE_PERIOD || m_OverlayDirty))
+        {
+            tlast_peaks_ms = tnow_ms;
+            job.updatePeaks = true;
+        }
 
-    // Show max and average highlights on histogram if it would not be too
-    // cluttered
-    const bool showHistHighlights = histBinsDisplayed >= MAX_HISTOGRAM_SIZE / 2;
+        // Update the overlay if needed
+        if (m_OverlayDirty)
+            drawOverlay();
+        job.overlay = m_OverlayImage;
+    }
 
     // Waterfall is advanced only if visible and running, and if there is new
     // data. Repaints for other reasons do not require any action here.
-    const bool doWaterfall = !m_WaterfallImage.isNull() && m_Running && newData;
+    job.doWaterfall = !m_WaterfallSize.isEmpty() && m_Running && newData;
+    job.useWfBuf = msec_per_wfline > 0;
+    job.wfWidth = m_WaterfallSize.width();
 
-    // Draw avg line, except in max mode. Suppress if it would clutter histogram.
-    const bool doAvgLine = m_PlotMode != PLOT_MODE_MAX
-                           && (m_PlotMode != PLOT_MODE_HISTOGRAM || showHistHighlights);
+    // is it time to update waterfall? msec_per_wfline is 0 in auto mode.
+    if (job.doWaterfall && tnow_ms - wf_epoch > wf_count * msec_per_wfline)
+    {
+        // Lines missed while frames came in slowly, e.g. while the plotter
+        // was hidden, are skipped rather than caught up with a burst of lines
+        if (msec_per_wfline > 0)
+            wf_count = (quint64)((tnow_ms - wf_epoch) / msec_per_wfline) + 1;
+        else
+            ++wf_count;
 
-    // Draw max line, except in avg and histogram modes
-    const bool doMaxLine = m_PlotMode != PLOT_MODE_AVG
-                           && m_PlotMode != PLOT_MODE_HISTOGRAM;
+        // cursor times are relative to last time drawn
+        tlast_wf_ms = tnow_ms;
+        if (wf_valid_since_ms == 0)
+            wf_valid_since_ms = tnow_ms;
+        tlast_wf_drawn_ms = tnow_ms;
 
-    // Initialize results
-    if (doHistogram)
-        memset(m_histogram, 0, sizeof(m_histogram));
+        job.wfLine = true;
+        job.wfTime = tnow_ms;
+    }
 
-    // Peak means "peak of average" in AVG mode, else "peak of max"
-    const bool peakIsAverage = m_PlotMode == PLOT_MODE_AVG;
-    // Min mean "min of peak" in PEAK mode, else "min of average"
-    const bool minIsAverage = m_PlotMode != PLOT_MODE_MAX;
+    // Images might be null, so scale up m_Size to get width.
+    job.w = m_Size.width() * m_DPR;
+    job.wfStartHz = (double)(m_CenterFreq + m_FftCenter) - (double)m_Span / 2.0;
+    job.wfHzPerPx = job.wfWidth > 0 ? (double)m_Span / (double)job.wfWidth : 0.0;
+    job.plotHeight = m_OverlayImage.height();
+    job.dpr = m_DPR;
+    job.shadowOffset = metrics.height() / 20.0;
+    job.sampleFreq = (double)m_SampleFreq;
+    job.fftCenter = (double)m_FftCenter;
+    job.span = (double)m_Span;
+    job.pandMindB = m_PandMindB;
+    job.pandMaxdB = m_PandMaxdB;
+    job.alpha = m_alpha;
+    job.fftRate = fft_rate;
+    job.plotMode = m_PlotMode;
+    job.wfMode = m_WaterfallMode;
+    job.fftFill = m_FftFill;
+    job.maxHold = m_MaxHoldActive;
+    job.minHold = m_MinHoldActive;
+    job.peakDetect = m_PeakDetectActive;
+
+    // The m_Marker{AB}X values are one cycle old, which makes for a laggy
+    // effect, so get fresh values here.
+    job.markerAX = xFromFreq(m_MarkerFreqA);
+    job.markerBX = xFromFreq(m_MarkerFreqB);
+    job.fillMarkers = (m_MarkersEnabled && m_MarkerFreqA != MARKER_OFF
+                                        && m_MarkerFreqB != MARKER_OFF);
+
+    job.colorTbl = m_ColorTbl;
+    job.fftFillCol = m_FftFillCol;
+    job.filledModeFillCol = m_FilledModeFillCol;
+    job.filledModeMaxLineCol = m_FilledModeMaxLineCol;
+    job.filledModeAvgLineCol = m_FilledModeAvgLineCol;
+    job.mainLineCol = m_MainLineCol;
+    job.holdLineCol = m_HoldLineCol;
+
+    // Hand the new data over to the render thread
+    job.newData = newData;
+    job.fftSize = m_fftDataSize;
+    job.reduced = m_fftReduced;
+    job.reducedXmin = m_reducedXmin;
+    job.reducedNpts = m_reducedNpts;
+    job.iirCoeff = iirCoefficient();
+    if (newData)
+    {
+        if (m_fftReduced)
+        {
+            job.reducedMax.swap(m_reducedMax);
+            job.reducedAvg.swap(m_reducedAvg);
+        }
+        else
+        {
+            job.fftData.swap(m_fftData);
+        }
+    }
 
-    // Make sure zeros don't get through to log calcs
-    const float fmin = std::numeric_limits<float>::min();
+    job.resets = m_renderResets;
+    m_renderResets = 0;
 
-    float vmax;
-    float vmaxIIR;
-    float vsum;
-    float vsumIIR;
+    postRenderJob(job);
+}
 
-    if ((qreal)numBins >= w)
+/**
+ * Queue a frame for the render thread.
+ *
+ * There is at most one pending job. If the render thread has not picked up
+ * the previous job yet, that frame is dropped, but its data and invalidations
+ * are carried over so that nothing but the frame itself is lost.
+ */
+void CPlotter::postRenderJob(RenderJob &job)
+{
     {
-        qint32 count;
-        qint32 xprev = xmin;
-        bool first = true;
+        std::lock_guard<std::mutex> lock(m_renderMutex);
 
-        for(qint32 i = minbin; i <= maxbin; i++)
+        if (m_renderJobPending)
         {
-            const float xD = (float)(i - startBin) * (float)xScale;
-            const int x = qRound(xD);
-
-            // Plot uses IIR output. Histogram and waterfall use raw fft data.
-            const float v = m_fftData[i];
-            const float viir = m_fftIIR[i];
+            RenderJob &old = m_renderJob;
 
-            if (first)
+            if (old.newData && !job.newData)
             {
-                vmax = v;
-                vmaxIIR = viir;
-                vsum = v;
-                vsumIIR = viir;
-                count = 1;
+                job.newData = true;
+                job.fftData.swap(old.fftData);
+                job.reducedMax.swap(old.reducedMax);
+                job.reducedAvg.swap(old.reducedAvg);
             }
-
-            // Histogram increments the appropriate bin for each value. Ignore
-            // out-of-range values, rather than clipping. Allocate value to two
-            // closest bins using linear interpolation.
-            if (doHistogram)
+            else if (old.newData)
             {
-                const float binD = histdBGainFactor * (m_PandMaxdB - 10.0f * log10f(v));
-                if (binD > 0.0f && binD < (float)histBinsDisplayed) {
-                    const int binLeft = std::max((int)(xD - 0.5f), 0);
-                    const int binRight = std::min(binLeft + 1, numBins - 1);
-                    const int binLow = std::min(std::max((int)(binD - 0.5f), 0), histBinsDisplayed - 1);
-                    const int binHigh = std::min(binLow + 1, histBinsDisplayed - 1);
-                    const float wgtH = (xD - (float)binLeft) / 2.0f;
-                    const float wgtV = (binD - (float)binLow) / 2.0f;
-                    m_histogram[binLeft][binLow] += (1.0f - wgtV) * (1.0f - wgtH) * histWeight;
-                    m_histogram[binLeft][binHigh] += wgtV * (1.0f - wgtH) * histWeight;
-                    m_histogram[binRight][binLow] += (1.0f - wgtV) * wgtH * histWeight;
-                    m_histogram[binRight][binHigh] += wgtV * wgtH * histWeight;
-                }
+                recycleRenderBuffers(old);
             }
 
-            // New (or last) pixel - output values
-            if (x != xprev || i == maxbin)
+            if (old.drawPlot && !job.drawPlot)
             {
-                vmax = std::max(vmax, fmin);
-                m_wfMaxBuf[xprev] = vmax;
-
-                vmaxIIR = std::max(vmaxIIR, fmin);
-                m_fftMaxBuf[xprev] = vmaxIIR;
-
-                const float vavg = std::max((float)(vsum / (float)count), fmin);
-                m_wfAvgBuf[xprev] = vavg;
-                const float vavgIIR = std::max((float)(vsumIIR / (float)count), fmin);
-                m_fftAvgBuf[xprev] = vavgIIR;
-
-                // New peak hold value if greater, or reset
-                const float currentPeak = m_fftMaxHoldBuf[xprev];
-                const float newPeak = peakIsAverage ? vavgIIR : vmaxIIR;
-                m_fftMaxHoldBuf[xprev] = m_MaxHoldValid ? std::max(currentPeak, newPeak) : newPeak;
-
-                // New min hold value if less, or reset
-                const float currentMin = m_fftMinHoldBuf[xprev];
-                const float newMin = minIsAverage ? vavgIIR : vmaxIIR;
-                m_fftMinHoldBuf[xprev] = m_MinHoldValid ? std::min(currentMin, newMin) : newMin;
-
-                vmax = v;
-                vmaxIIR = viir;
-                vsum = v;
-                vsumIIR = viir;
-                count = 1;
-                xprev = x;
+                job.drawPlot = true;
+                job.overlay = old.overlay;
             }
-
-            else if (!first)
+            job.resets |= old.resets;
+            job.plotVisible = job.plotVisible || old.plotVisible;
+            job.updatePeaks = job.updatePeaks || old.updatePeaks;
+            job.doWaterfall = job.doWaterfall || old.doWaterfall;
+            if (old.wfLine && !job.wfLine)
             {
-                vmax = std::max(v, vmax);
-                vmaxIIR = std::max(viir, vmaxIIR);
-                vsum += v;
-                vsumIIR += viir;
-                ++count;
+                job.wfLine = true;
+                job.wfTime = old.wfTime;
             }
-
-            first = false;
         }
 
-        m_MaxHoldValid = true;
-        m_MinHoldValid = true;
+        m_renderJob = std::move(job);
+        m_renderJobPending = true;
     }
-    // w > m_fftDataSize uses no averaging
-    else
-    {
-        for (i = xmin; i < xmax; i++)
-        {
-            j = qRound((float)i / (float)xScale + (float)startBinD);
 
-            const float v = m_fftData[j];
-            const float viir = m_fftIIR[j];
+    m_renderCond.notify_one();
+}
 
-            m_wfMaxBuf[i] = v;
-            m_wfAvgBuf[i] = v;
-            m_fftMaxBuf[i] = viir;
-            m_fftAvgBuf[i] = viir;
+/**
+ * Keep data buffers released by a job for reuse by the GUI thread.
+ *
+ * Must be called with m_renderMutex held.
+ */
+void CPlotter::recycleRenderBuffers(RenderJob &job)
+{
+    if (m_spareFftData.capacity() < job.fftData.capacity())
+        m_spareFftData.swap(job.fftData);
+    if (m_spareReducedMax.capacity() < job.reducedMax.capacity())
+        m_spareReducedMax.swap(job.reducedMax);
+    if (m_spareReducedAvg.capacity() < job.reducedAvg.capacity())
+        m_spareReducedAvg.swap(job.reducedAvg);
+}
+
+/** Get a data buffer back from the render thread to avoid reallocation. */
+void CPlotter::reuseRenderBuffer(std::vector<float> &buf, std::vector<float> &spare)
+{
+    if (buf.empty())
+    {
+        std::lock_guard<std::mutex> lock(m_renderMutex);
+        buf.swap(spare);
+    }
+}
+
+void CPlotter::renderThread()
+{
+    std::unique_lock<std::mutex> lock(m_renderMutex);
+
+    while (true)
+    {
+        m_renderCond.wait(lock, [this] { return m_renderStop || m_renderJobPending; });
+        if (m_renderStop)
+            break;
+
+        RenderJob job = std::move(m_renderJob);
+        m_renderJob = RenderJob();
+        m_renderJobPending = false;
+        lock.unlock();
+
+        QImage plot;
+        WaterfallLine wfLine;
+        QElapsedTimer cost;
+        cost.start();
+        {
+            std::lock_guard<std::mutex> stateLock(m_renderStateMutex);
+            renderFrame(job, plot, wfLine);
+        }
+        const float costMs = cost.nsecsElapsed() * 1e-6f;
+
+        lock.lock();
+
+        m_renderedCost = averageCost(m_renderedCost, costMs);
+
+        recycleRenderBuffers(job);
+
+        if (!plot.isNull())
+            m_renderedPlot = plot;
+        if (!wfLine.data.empty())
+            m_renderedWfLines.push_back(std::move(wfLine));
+        if (job.updatePeaks && !plot.isNull())
+        {
+            m_renderedPeaks = m_renderPeaks;
+            m_renderedPeaksValid = true;
+        }
+
+        // One notification is enough for any number of results
+        if (!m_renderResultPending)
+        {
+            m_renderResultPending = true;
+            QMetaObject::invokeMethod(this, "renderDone", Qt::QueuedConnection);
+        }
+    }
+}
+
+// Called on the GUI thread when the render thread has finished frames
+void CPlotter::renderDone()
+{
+    QElapsedTimer cost;
+    cost.start();
+
+    QImage plot;
+    std::vector<WaterfallLine> wfLines;
+    QMap<int,qreal> peaks;
+    bool peaksValid;
+
+    {
+        std::lock_guard<std::mutex> lock(m_renderMutex);
+        plot.swap(m_renderedPlot);
+        wfLines.swap(m_renderedWfLines);
+        peaks.swap(m_renderedPeaks);
+        peaksValid = m_renderedPeaksValid;
+        m_renderedPeaksValid = false;
+        m_renderResultPending = false;
+        m_renderCost = m_renderedCost;
+    }
+
+    // Frames rendered before a resize do not fit anymore
+    if (!plot.isNull() && plot.size() == m_OverlayImage.size())
+        m_2DImage = plot;
+
+    if (peaksValid)
+        m_Peaks = peaks;
+
+    for (auto &line : wfLines)
+        addWaterfallLine(line);
+
+    // Accounted for with the next paint
+    m_renderDoneCost += cost.nsecsElapsed() * 1e-6f;
+
+    // trigger a new paintEvent
+    update();
+}
+
+/**
+ * Add a new line to the waterfall history and draw it.
+ * @param line The raw waterfall line, moved into the history.
+ *
+ * While the waterfall is scrolled back the view stays on the same lines.
+ */
+void CPlotter::addWaterfallLine(WaterfallLine &line)
+{
+    if (m_WaterfallSize.isEmpty())
+        return;
+
+    if (!m_wfLutValid)
+        updateWaterfallLut();
+    if (m_wfRecorder)
+        m_wfRecorder->addLine(line.data, line.startHz, line.hzPerPx, line.time_ms);
+
+    const int wfWidth = m_WaterfallSize.width();
+    const int wfHeight = m_WaterfallSize.height();
+
+    m_wfHistory.push_front(std::move(line));
+    const size_t capacity = std::max((size_t)WF_HISTORY_MAX_BYTES / (2 * (size_t)wfWidth),
+                                     (size_t)wfHeight);
+    while (m_wfHistory.size() > capacity)
+        m_wfHistory.pop_back();
+
+    if (m_wfScroll > 0)
+    {
+        const int maxScroll = std::max((int)m_wfHistory.size() - wfHeight, 0);
+        m_wfScroll++;
+        if (m_wfScroll > maxScroll)
+        {
+            m_wfScroll = maxScroll;
+            m_wfRerender = true;
+        }
+        return;
+    }
+
+    if (m_wfRerender)
+        return;
+
+    // move the offset "up"
+    // this changes how the resulting waterfall is drawn
+    // it is more efficient than moving all of the image scan lines
+    m_WaterfallOffset--;
+    // color new line of fft data at top of waterfall bitmap
+    colorWaterfallLine(m_wfHistory.front(), m_WaterfallOffset);
+    if (m_WaterfallOffset == 0)
+    {
+        m_WaterfallOffset = wfHeight;
+    }
+#ifdef WITH_OPENGL_WATERFALL
+    if (m_wfGL)
+        m_wfGL->setOffset(m_WaterfallOffset);
+#endif
+}
+
+/**
+ * Color a raw waterfall line into the waterfall.
+ * @param line The raw waterfall line.
+ * @param row Row of the waterfall image.
+ */
+void CPlotter::colorWaterfallLine(const WaterfallLine &line, int row)
+{
+    const quint16 *in = resampleWaterfallLine(line);
+
+#ifdef WITH_OPENGL_WATERFALL
+    // Colors are applied by the shader
+    if (m_wfGL)
+    {
+        m_wfGL->setRow(row, in);
+        return;
+    }
+#endif
+
+    QRgb *out = reinterpret_cast<QRgb *>(m_WaterfallImage.scanLine(row));
+    const QRgb *lut = m_wfLut.constData();
+    const int w = m_WaterfallSize.width();
+    for (int x = 0; x < w; ++x)
+        out[x] = lut[in[x]];
+}
+
+void CPlotter::clearWaterfallRow(int row)
+{
+#ifdef WITH_OPENGL_WATERFALL
+    if (m_wfGL)
+    {
+        m_wfGL->clearRow(row);
+        return;
+    }
+#endif
+
+    memset(m_WaterfallImage.scanLine(row), 0, m_WaterfallImage.bytesPerLine());
+}
+
+/**
+ * Get a raw waterfall line at the current waterfall frequency range.
+ * @param line The raw waterfall line.
+ * @returns One level per waterfall pixel, valid until the next call.
+ *
+ * Lines recorded with another zoom or frequency are resampled, keeping the
+ * strongest level when several source pixels fall into one image pixel.
+ */
+const quint16 *CPlotter::resampleWaterfallLine(const WaterfallLine &line)
+{
+    const quint16 *in = line.data.data();
+    const int w = m_WaterfallSize.width();
+    const int n = (int)line.data.size();
+
+    if (n == w && line.startHz == m_wfViewStartHz && line.hzPerPx == m_wfViewHzPerPx)
+        return in;
+
+    m_wfRowBuf.assign(w, 0);
+    if (line.hzPerPx <= 0.0 || m_wfViewHzPerPx <= 0.0)
+        return m_wfRowBuf.data();
+
+    // Source pixels per image pixel, and source position of image pixel 0
+    const double a = m_wfViewHzPerPx / line.hzPerPx;
+    const double b = (m_wfViewStartHz - line.startHz) / line.hzPerPx;
+    for (int x = 0; x < w; ++x)
+    {
+        const double s0 = b + a * (double)x;
+        quint16 v = 0;
+        if (a <= 1.0)
+        {
+            const double k = std::floor(s0 + a / 2.0);
+            if (k >= 0.0 && k < (double)n)
+                v = in[(int)k];
+        }
+        else
+        {
+            const int k0 = (int)qBound(0.0, std::floor(s0), (double)n);
+            const int k1 = (int)qBound(0.0, std::floor(s0 + a), (double)n);
+            for (int k = k0; k < k1; ++k)
+                v = std::max(v, in[k]);
+        }
+        m_wfRowBuf[x] = v;
+    }
+    return m_wfRowBuf.data();
+}
+
+// Color the visible part of the waterfall history again
+void CPlotter::renderWaterfall()
+{
+    if (m_WaterfallSize.isEmpty())
+        return;
+
+    const int wfWidth = m_WaterfallSize.width();
+    const int wfHeight = m_WaterfallSize.height();
+
+    if (!m_wfLutValid)
+        updateWaterfallLut();
+    m_wfRerender = false;
+
+    m_wfViewStartHz = (double)(m_CenterFreq + m_FftCenter) - (double)m_Span / 2.0;
+    m_wfViewHzPerPx = (double)m_Span / (double)wfWidth;
+
+    m_wfScroll = qBound(0, m_wfScroll, std::max((int)m_wfHistory.size() - wfHeight, 0));
+
+    for (int y = 0; y < wfHeight; ++y)
+    {
+        const size_t idx = (size_t)(m_wfScroll + y);
+        if (idx < m_wfHistory.size())
+            colorWaterfallLine(m_wfHistory[idx], y);
+        else
+            clearWaterfallRow(y);
+    }
+    m_WaterfallOffset = wfHeight;
+#ifdef WITH_OPENGL_WATERFALL
+    if (m_wfGL)
+        m_wfGL->setOffset(m_WaterfallOffset);
+#endif
+}
+
+/**
+ * Map raw waterfall levels to colors for the current range and colormap.
+ *
+ * The OpenGL waterfall maps levels in the shader, so only the software
+ * waterfall has to be colored again.
+ */
+void CPlotter::updateWaterfallLut()
+{
+    const float gain = 256.0f / fabsf(m_WfMaxdB - m_WfMindB);
+    m_wfLutValid = true;
+
+    if (m_wfRecorder)
+        m_wfRecorder->setColors(m_ColorTbl, m_WfMindB, m_WfMaxdB);
+
+#ifdef WITH_OPENGL_WATERFALL
+    if (m_wfGL)
+    {
+        m_wfGL->setColorTable(m_ColorTbl);
+        m_wfGL->setLevels((m_WfMaxdB - WF_RAW_MIN_DB) * WF_RAW_STEPS_PER_DB,
+                          gain / WF_RAW_STEPS_PER_DB);
+        return;
+    }
+#endif
+
+    m_wfLut.resize(WF_RAW_MAX + 1);
+    m_wfLut[0] = qRgb(0, 0, 0);
+    for (int q = 1; q <= WF_RAW_MAX; ++q)
+    {
+        const float dB = WF_RAW_MIN_DB + (float)q / WF_RAW_STEPS_PER_DB;
+        const float v = qBound(0.0f, gain * (m_WfMaxdB - dB), 255.0f);
+        m_wfLut[q] = m_ColorTbl[255 - (int)(v + 0.5f)];
+    }
+    m_wfRerender = true;
+}
+
+#ifdef WITH_OPENGL_WATERFALL
+// OpenGL is not usable, fall back to drawing the waterfall image
+void CPlotter::openGLWaterfallFailed()
+{
+    if (!m_wfGL)
+        return;
+
+    m_wfGL->hide();
+    m_wfGL->deleteLater();
+    m_wfGL = nullptr;
+    m_wfGLFailed = true;
+
+    if (!m_WaterfallSize.isEmpty())
+    {
+        m_WaterfallImage = QImage(m_WaterfallSize, QImage::Format_RGB32);
+        m_WaterfallImage.setDevicePixelRatio(m_DPR);
+        m_WaterfallImage.fill(Qt::black);
+    }
+    m_wfLutValid = false;
+    m_wfRerender = true;
+    update();
+}
+#endif
+
+/**
+ * Render one frame on the render thread.
+ * @param job Data and settings for the frame.
+ * @param plot The rendered 2D plot (output, null if not drawn).
+ * @param wfLine The new raw waterfall line (output, empty if none).
+ *
+ * Updates the spectrum IIR, max/min hold, histogram and waterfall accumulator,
+ * which are owned by the render thread.
+ */
+void CPlotter::renderFrame(RenderJob &job, QImage &plot, WaterfallLine &wfLine)
+{
+    qint32        i, j;
+    float         histMax;
+
+    // Make sure zeros don't get through to log calcs
+    const float fmin = std::numeric_limits<float>::min();
+
+    // Apply invalidations requested by the GUI thread
+    if (job.resets & RESET_MAXHOLD)
+        m_MaxHoldValid = false;
+    if (job.resets & RESET_MINHOLD)
+        m_MinHoldValid = false;
+    if (job.resets & RESET_IIR)
+        m_IIRValid = false;
+    if (job.resets & RESET_HIST)
+        m_histIIRValid = false;
+    if (job.resets & RESET_HISTMAX)
+        m_histMaxIIR = std::numeric_limits<float>::min();
+    if (job.resets & RESET_WFBUF)
+        clearWaterfallAccumulator();
+    if (job.resets & RESET_PEAKS)
+        m_PeakImage = QImage();
+
+    // Update IIR. If IIR is invalid, set alpha to use latest value. Users
+    // would like to see symmetric attack/decay on the logarithmic y-axis, so
+    // the IIR runs on dB values, see updateIirDb(). The plot, holds and peaks
+    // stay in dB from here on, while the waterfall uses the linear data.
+    const float a = m_IIRValid ? job.iirCoeff : 1.0f;
+    if (job.newData && job.reduced)
+    {
+        const int npts = job.reducedNpts;
+
+        m_renderReducedMax.swap(job.reducedMax);
+        m_renderReducedAvg.swap(job.reducedAvg);
+
+        // Full resolution buffers are not needed while frames arrive reduced
+        if (!m_fftIIR.empty())
+        {
+            std::vector<float>().swap(m_renderFftData);
+            std::vector<float>().swap(m_renderFftDb);
+            std::vector<float>().swap(m_fftIIR);
+        }
+
+        const bool resized = m_reducedMaxIIR.size() != (size_t)npts;
+        if (resized)
+        {
+            m_reducedMaxIIR.resize(npts);
+            m_reducedAvgIIR.resize(npts);
+        }
+        if (m_X.size() < (size_t)npts)
+            m_X.resize(npts);
+
+        const float ar = resized ? 1.0f : a;
+        powerToDb(m_X.data(), m_renderReducedMax.data(), npts);
+        updateIirDb(m_reducedMaxIIR.data(), m_X.data(), npts, ar);
+        powerToDb(m_X.data(), m_renderReducedAvg.data(), npts);
+        updateIirDb(m_reducedAvgIIR.data(), m_X.data(), npts, ar);
+
+        m_IIRValid = true;
+    }
+    else if (job.newData)
+    {
+        const int size = job.fftSize;
+
+        m_renderFftData.swap(job.fftData);
+
+        const bool resized = m_fftIIR.size() != (size_t)size;
+        if (resized)
+            m_fftIIR.resize(size);
+        if (m_X.size() < (size_t)size)
+            m_X.resize(size);
+
+        // One logarithm per bin, shared by the IIR and the histogram
+        m_renderFftDb.resize(size);
+        powerToDb(m_renderFftDb.data(), m_renderFftData.data(), size);
+        updateIirDb(m_fftIIR.data(), m_renderFftDb.data(), size, resized ? 1.0f : a);
+
+        m_IIRValid = true;
+    }
+
+    // Nothing to draw until data matching the job has arrived
+    if (job.reduced ? m_reducedMaxIIR.size() != (size_t)job.reducedNpts
+                      || m_renderReducedMax.size() != (size_t)job.reducedNpts
+                    : m_fftIIR.size() != (size_t)job.fftSize
+                      || m_renderFftData.size() != (size_t)job.fftSize)
+        return;
+
+    const qreal w = job.w;
+    const qreal plotHeight = job.plotHeight;
+    const qreal shadowOffset = job.shadowOffset;
+
+    // Scale plotter for graph height
+    const float panddBGainFactor = (float)plotHeight / fabsf(job.pandMaxdB - job.pandMindB);
+
+    const double fftSize = job.fftSize;
+    const double sampleFreq = job.sampleFreq;
+    const double fftCenter = job.fftCenter;
+    const double span = job.span;
+    const double startFreq = fftCenter - span / 2.0;
+    const double binsPerHz = fftSize / sampleFreq;
+
+    // Scale factor for x -> fft bin (pixels per bin).
+    double xScale = sampleFreq * w / fftSize / span;
+
+    // Center of fft is the center of the DC bin. The Nyquist bin (index 0
+    // after shift) is not used.
+    const double startBinD = startFreq * binsPerHz + fftSize / 2.0;
+    const qint32 startBin = std::min(qRound(startBinD), job.fftSize - 1);
+    const qint32 numBins = (qint32)ceil(span * binsPerHz);
+    const qint32 endBin = startBin + numBins;
+    const qint32 minbin = std::max(startBin, 1);
+    const qint32 maxbin = std::min(endBin + 1, job.fftSize - 1);
+
+    // Pre-reduced frames carry their own pixel range
+    const qint32 xmin = job.reduced ? job.reducedXmin
+                                    : qRound((double)(minbin - startBin) * xScale);
+    const qint32 xmax = job.reduced ? std::min(job.reducedXmin + job.reducedNpts, qRound(w))
+                                    : std::min(qRound((double)(maxbin - startBin) * xScale), qRound(w));
+
+    const float frameTime = 1.0f / (float)job.fftRate;
+
+    const bool drawPlotter = job.drawPlot;
+
+    // Use fewer histogram bins when statistics are sparse
+    const int histBinsDisplayed = std::min(
+        MAX_HISTOGRAM_SIZE,
+        std::max(32,
+            qRound(32 * (float)numBins / 2048.0f))
+        );
+
+    // Histogram storage only exists while in histogram mode. Reduced frames
+    // are only seen while switching modes and keep the storage.
+    if (job.plotMode != PLOT_MODE_HISTOGRAM)
+        resizeHistogram(0, 0);
+    else if (!job.reduced)
+        resizeHistogram(qRound(w) + 1, histBinsDisplayed);
+
+    // Do not waste time with histogram calculations unless in this mode.
+    const bool doHistogram = (job.plotVisible && job.plotMode == PLOT_MODE_HISTOGRAM && !job.reduced
+                              && (!m_histIIRValid || job.newData));
+
+    // Amount to add to histogram for each hit
+    const float histWeight = 10e6f * frameTime / (float)histBinsDisplayed / (float)fftSize;
+
+    // Bins / dB
+    const float histdBGainFactor = (float)histBinsDisplayed / fabsf(job.pandMaxdB - job.pandMindB);
+
+    // Show max and average highlights on histogram if it would not be too
+    // cluttered
+    const bool showHistHighlights = histBinsDisplayed >= MAX_HISTOGRAM_SIZE / 2;
+
+    const bool doWaterfall = job.doWaterfall;
+
+    // Draw avg line, except in max mode. Suppress if it would clutter histogram.
+    const bool doAvgLine = job.plotMode != PLOT_MODE_MAX
+                           && (job.plotMode != PLOT_MODE_HISTOGRAM || showHistHighlights);
+
+    // Draw max line, except in avg and histogram modes
+    const bool doMaxLine = job.plotMode != PLOT_MODE_AVG
+                           && job.plotMode != PLOT_MODE_HISTOGRAM;
+
+    // Initialize results. Histogram bins are found for all FFT bins at once.
+    const int histCols = m_histCols;
+    const int histBins = m_histBins;
+    float *histogram = m_histogram.data();
+    if (doHistogram)
+    {
+        std::fill(m_histogram.begin(), m_histogram.end(), 0.0f);
+        dbToLevel(m_X.data(), m_renderFftDb.data(), job.fftSize,
+                  job.pandMaxdB, histdBGainFactor, (float)histBinsDisplayed);
+    }
+
+    // Peak means "peak of average" in AVG mode, else "peak of max"
+    const bool peakIsAverage = job.plotMode == PLOT_MODE_AVG;
+    // Min mean "min of peak" in PEAK mode, else "min of average"
+    const bool minIsAverage = job.plotMode != PLOT_MODE_MAX;
+
+    float vmax;
+    float vsum;
+
+    if (job.reduced)
+    {
+        for (i = xmin; i < xmax; i++)
+        {
+            const int k = i - xmin;
+
+            m_wfMaxBuf[i] = std::max(m_renderReducedMax[k], fmin);
+            m_wfAvgBuf[i] = std::max(m_renderReducedAvg[k], fmin);
+            const float vmaxIIR = m_reducedMaxIIR[k];
+            const float vavgIIR = m_reducedAvgIIR[k];
+            m_fftMaxBuf[i] = vmaxIIR;
+            m_fftAvgBuf[i] = vavgIIR;
+
+            // New peak hold value if greater, or reset
+            const float currentPeak = m_fftMaxHoldBuf[i];
+            const float newPeak = peakIsAverage ? vavgIIR : vmaxIIR;
+            m_fftMaxHoldBuf[i] = m_MaxHoldValid ? std::max(currentPeak, newPeak) : newPeak;
+
+            // New min hold value if less, or reset
+            const float currentMin = m_fftMinHoldBuf[i];
+            const float newMin = minIsAverage ? vavgIIR : vmaxIIR;
+            m_fftMinHoldBuf[i] = m_MinHoldValid ? std::min(currentMin, newMin) : newMin;
+        }
+
+        m_MaxHoldValid = true;
+        m_MinHoldValid = true;
+    }
+    else if ((qreal)numBins >= w)
+    {
+        qint32 count;
+        qint32 xprev = xmin;
+        bool first = true;
+
+        for(qint32 i = minbin; i <= maxbin; i++)
+        {
+            const float xD = (float)(i - startBin) * (float)xScale;
+            const int x = qRound(xD);
+
+            // Max and average of the linear power per pixel, the plot levels
+            // are derived from them below
+            const float v = m_renderFftData[i];
+
+            if (first)
+            {
+                vmax = v;
+                vsum = v;
+                count = 1;
+            }
+
+            // Histogram increments the appropriate bin for each value. Ignore
+            // out-of-range values, rather than clipping. Allocate value to two
+            // closest bins using linear interpolation.
+            if (doHistogram)
+            {
+                const float binD = m_X[i];
+                if (binD > 0.0f && binD < (float)histBinsDisplayed) {
+                    const int binLeft = std::min(std::max((int)(xD - 0.5f), 0), histCols - 1);
+                    const int binRight = std::min(binLeft + 1, std::min(numBins, histCols) - 1);
+                    const int binLow = std::min(std::max((int)(binD - 0.5f), 0), histBinsDisplayed - 1);
+                    const int binHigh = std::min(binLow + 1, histBinsDisplayed - 1);
+                    const float wgtH = (xD - (float)binLeft) / 2.0f;
+                    const float wgtV = (binD - (float)binLow) / 2.0f;
+                    float *histLeft = histogram + binLeft * histBins;
+                    float *histRight = histogram + binRight * histBins;
+                    histLeft[binLow] += (1.0f - wgtV) * (1.0f - wgtH) * histWeight;
+                    histLeft[binHigh] += wgtV * (1.0f - wgtH) * histWeight;
+                    histRight[binLow] += (1.0f - wgtV) * wgtH * histWeight;
+                    histRight[binHigh] += wgtV * wgtH * histWeight;
+                }
+            }
+
+            // New (or last) pixel - output values
+            if (x != xprev || i == maxbin)
+            {
+                vmax = std::max(vmax, fmin);
+                m_wfMaxBuf[xprev] = vmax;
+
+                const float vavg = std::max((float)(vsum / (float)count), fmin);
+                m_wfAvgBuf[xprev] = vavg;
+
+                vmax = v;
+                vsum = v;
+                count = 1;
+                xprev = x;
+            }
+
+            else if (!first)
+            {
+                vmax = std::max(v, vmax);
+                vsum += v;
+                ++count;
+            }
+
+            first = false;
+        }
+
+        // Plot levels are computed per pixel as for reduced frames, so both
+        // show the same level: the linear max and average are converted to
+        // dB once per pixel and then go through the IIR.
+        const int npts = std::max(xmax - xmin, 0);
+        const bool resized = m_reducedMaxIIR.size() != (size_t)npts;
+        if (resized)
+        {
+            m_reducedMaxIIR.resize(npts);
+            m_reducedAvgIIR.resize(npts);
+        }
+        if (m_X.size() < (size_t)npts)
+            m_X.resize(npts);
+        if (job.newData || resized)
+        {
+            const float ar = resized ? 1.0f : a;
+            powerToDb(m_X.data(), m_wfMaxBuf + xmin, npts);
+            updateIirDb(m_reducedMaxIIR.data(), m_X.data(), npts, ar);
+            powerToDb(m_X.data(), m_wfAvgBuf + xmin, npts);
+            updateIirDb(m_reducedAvgIIR.data(), m_X.data(), npts, ar);
+        }
+
+        for (i = xmin; i < xmax; i++)
+        {
+            const int k = i - xmin;
+            const float vmaxIIR = m_reducedMaxIIR[k];
+            const float vavgIIR = m_reducedAvgIIR[k];
+            m_fftMaxBuf[i] = vmaxIIR;
+            m_fftAvgBuf[i] = vavgIIR;
+
+            // New peak hold value if greater, or reset
+            const float currentPeak = m_fftMaxHoldBuf[i];
+            const float newPeak = peakIsAverage ? vavgIIR : vmaxIIR;
+            m_fftMaxHoldBuf[i] = m_MaxHoldValid ? std::max(currentPeak, newPeak) : newPeak;
+
+            // New min hold value if less, or reset
+            const float currentMin = m_fftMinHoldBuf[i];
+            const float newMin = minIsAverage ? vavgIIR : vmaxIIR;
+            m_fftMinHoldBuf[i] = m_MinHoldValid ? std::min(currentMin, newMin) : newMin;
+        }
+
+        m_MaxHoldValid = true;
+        m_MinHoldValid = true;
+    }
+    // w > fftSize uses no averaging
+    else
+    {
+        for (i = xmin; i < xmax; i++)
+        {
+            j = qRound((float)i / (float)xScale + (float)startBinD);
+
+            const float v = m_renderFftData[j];
+            const float viir = m_fftIIR[j];
+
+            m_wfMaxBuf[i] = v;
+            m_wfAvgBuf[i] = v;
+            m_fftMaxBuf[i] = viir;
+            m_fftAvgBuf[i] = viir;
 
             // New peak hold value if greater, or reset
             const float currentPeak = m_fftMaxHoldBuf[i];
@@ -1358,15 +2252,16 @@ void CPlotter::draw(bool newData)
             // Histogram increments the appropriate bin for each value. Ignore
             // out-of-range values, rather than clipping. Allocate value to two
             // closest bins using linear interpolation.
-            if (doHistogram)
+            if (doHistogram && i < histCols)
             {
-                const float binD = histdBGainFactor * (m_PandMaxdB - 10.0f * log10f(v));
+                const float binD = m_X[j];
                 if (binD > 0.0f && binD < (float)histBinsDisplayed) {
                     const int binLow = std::min(std::max((int)(binD - 0.5f), 0), histBinsDisplayed - 1);
                     const int binHigh = std::min(binLow + 1, histBinsDisplayed - 1);
                     const float wgt = (binD - (float)binLow) / 2.0f;
-                    m_histogram[i][binLow] += (1.0f - wgt) * histWeight;
-                    m_histogram[i][binHigh] += wgt * histWeight;
+                    float *hist = histogram + i * histBins;
+                    hist[binLow] += (1.0f - wgt) * histWeight;
+                    hist[binHigh] += wgt * histWeight;
                 }
             }
         }
@@ -1378,13 +2273,13 @@ void CPlotter::draw(bool newData)
     {
         // Pick max or avg for waterfall
         float *dataSource;
-        if (m_WaterfallMode == WATERFALL_MODE_AVG)
+        if (job.wfMode == WATERFALL_MODE_AVG)
         {
             dataSource = m_wfAvgBuf;
         }
-        else if (m_WaterfallMode == WATERFALL_MODE_SYNC)
+        else if (job.wfMode == WATERFALL_MODE_SYNC)
         {
-            if (m_PlotMode == PLOT_MODE_MAX)
+            if (job.plotMode == PLOT_MODE_MAX)
             {
                 dataSource = m_fftMaxBuf;
             }
@@ -1398,45 +2293,32 @@ void CPlotter::draw(bool newData)
         }
 
         // if not in "auto" mode, store max waterfall data in accumulator
-        if (msec_per_wfline > 0)
+        if (job.useWfBuf)
         {
             // In avg mode, accumulate so average of frames can be shown
-            if (m_WaterfallMode != WATERFALL_MODE_MAX)
+            if (job.wfMode != WATERFALL_MODE_MAX)
             {
                 ++wf_avg_count;
-                for (i = 0; i < npts; ++i)
-                    m_wfbuf[i] += dataSource[i];
+                volk_32f_x2_add_32f(m_wfbuf + xmin, m_wfbuf + xmin, dataSource + xmin, npts);
             }
             // In max mode, track the max bin over time
             else
             {
-                for (i = 0; i < npts; ++i)
-                    m_wfbuf[i] = std::max(m_wfbuf[i], dataSource[i]);
+                volk_32f_x2_max_32f(m_wfbuf + xmin, m_wfbuf + xmin, dataSource + xmin, npts);
             }
         }
 
-        // is it time to update waterfall? msec_per_wfline is 0 in auto mode.
-        if (tnow_ms - wf_epoch > wf_count * msec_per_wfline)
+        if (job.wfLine && job.wfWidth > 0)
         {
-            ++wf_count;
+            // new line of fft data, no data where nothing will be drawn
+            wfLine.data.assign(job.wfWidth, 0);
+            wfLine.startHz = job.wfStartHz;
+            wfLine.hzPerPx = job.wfHzPerPx;
+            wfLine.time_ms = job.wfTime;
 
-            // cursor times are relative to last time drawn
-            tlast_wf_ms = tnow_ms;
-            if (wf_valid_since_ms == 0)
-                wf_valid_since_ms = tnow_ms;
-            tlast_wf_drawn_ms = tnow_ms;
-
-            // move the offset "up"
-            // this changes how the resulting waterfall is drawn
-            // it is more efficient than moving all of the image scan lines
-            m_WaterfallOffset--;
-            // draw new line of fft data at top of waterfall bitmap
-            // draw black areas where data will not be draw
-            memset(m_WaterfallImage.scanLine(m_WaterfallOffset), 0, m_WaterfallImage.bytesPerLine());
-
-            const bool useWfBuf = msec_per_wfline > 0;
+            const bool useWfBuf = job.useWfBuf;
             float _lineFactor;
-            if (useWfBuf && m_WaterfallMode != WATERFALL_MODE_MAX)
+            if (useWfBuf && job.wfMode != WATERFALL_MODE_MAX)
                 _lineFactor = 1.0f / (float)wf_avg_count;
             else
                 _lineFactor = 1.0f;
@@ -1444,22 +2326,24 @@ void CPlotter::draw(bool newData)
             wf_avg_count = 0;
 
             // Use buffer (max or average) if in manual mode, else current data
-            for (i = 0; i < npts; ++i)
-            {
-                const int ix = i + xmin;
-                const float v = useWfBuf ? m_wfbuf[ix] * lineFactor : dataSource[ix];
-                qint32 cidx = qRound((m_WfMaxdB - 10.0f * log10f(v)) * wfdBGainFactor);
-                cidx = std::max(std::min(cidx, 255), 0);
-                m_WaterfallImage.setPixel(ix, m_WaterfallOffset, m_ColorTbl[255 - cidx].rgb());
-            }
-            if(m_WaterfallOffset == 0)
+            const int xend = std::max(std::min(npts, job.wfWidth - xmin), 0);
+            const float *lineSource = dataSource + xmin;
+            if (useWfBuf)
             {
-                m_WaterfallOffset = m_WaterfallImage.height();
+                volk_32f_s32f_multiply_32f(m_wfLineBuf, m_wfbuf + xmin, lineFactor, xend);
+                lineSource = m_wfLineBuf;
             }
 
+            // Colors are applied on the GUI thread, which keeps the raw line.
+            // The sync mode shows the plot data, which is in dB.
+            if (job.wfMode == WATERFALL_MODE_SYNC)
+                dbToRaw(wfLine.data.data() + xmin, lineSource, xend);
+            else
+                powerToRaw(wfLine.data.data() + xmin, lineSource, xend, m_wfLineBuf);
+
             wf_avg_count = 0;
-            if (msec_per_wfline > 0)
-                clearWaterfallBuf();
+            if (useWfBuf)
+                clearWaterfallAccumulator();
         }
     }
 
@@ -1467,43 +2351,89 @@ void CPlotter::draw(bool newData)
     if (doHistogram)
     {
         const float gamma = 1.0f;
-        const float a = powf(1.0f - m_alpha, gamma);
-        // fast attack ... leaving alternative here in case it's useful
-        const float aAttack = 1.0f;
-        // const float aAttack = 1.0 - a * frameTime;
+        const float a = powf(1.0f - job.alpha, gamma);
         const float aDecay = 1.0f - powf(a, 4.0f * frameTime);
 
-        histMax = 0.0;
-        for (i = xmin; i < xmax; ++i) {
-            for (j = 0; j < histBinsDisplayed; ++j)
-            {
-                float histV;
-                const float histPrev = m_histIIR[i][j];
-                const float histNew = m_histogram[i][j];
-                // Fast response when invalid
-                if (!m_histIIRValid)
-                    histV = histNew;
-                else
-                    histV = histPrev + aAttack * histNew - aDecay * histPrev;
-                m_histIIR[i][j] = std::max(histV, 0.0f);
-                histMax = std::max(histMax, histV);
-            }
+        // Columns are stored one after the other, so the displayed columns
+        // are one contiguous block
+        const int histStart = std::min(xmin, histCols) * histBins;
+        const int histLen = (std::min(xmax, histCols) - std::min(xmin, histCols)) * histBins;
+        float *histIIR = m_histIIR.data() + histStart;
+        const float *histNew = histogram + histStart;
+
+        // Fast response when invalid
+        if (!m_histIIRValid)
+        {
+            memcpy(histIIR, histNew, histLen * sizeof(float));
+        }
+        else
+        {
+            // Fast attack and slow decay:
+            // histV = histPrev + histNew - aDecay * histPrev
+            // which can not be negative since histNew >= 0 and aDecay <= 1.
+            volk_32f_s32f_multiply_32f(histIIR, histIIR, 1.0f - aDecay, histLen);
+            volk_32f_x2_add_32f(histIIR, histIIR, histNew, histLen);
         }
         m_histIIRValid = true;
 
+        histMax = 0.0;
+        if (histLen > 0)
+        {
+            uint32_t maxIndex = 0;
+            volk_32f_index_max_32u(&maxIndex, histIIR, histLen);
+            histMax = histIIR[maxIndex];
+        }
+
         // 5 Hz time constant for colormap adjustment
         const float histMaxAlpha = std::min(5.0f * frameTime, 1.0f);
         m_histMaxIIR = m_histMaxIIR * (1.0f - histMaxAlpha) + histMax * histMaxAlpha;
     }
 
     // get/draw the 2D spectrum
-    if (drawPlotter)
+    if (drawPlotter && !job.overlay.isNull())
     {
-        tlast_plot_drawn_ms = tnow_ms;
-
         QColor bgColor = QColor::fromRgba(PLOTTER_BGD_COLOR);
-        m_2DPixmap.fill(bgColor);
-        QPainter painter2(&m_2DPixmap);
+        plot = QImage(job.overlay.size(), QImage::Format_ARGB32_Premultiplied);
+        plot.fill(bgColor);
+
+        const float binSizeY = (float)plotHeight / (float)histBinsDisplayed;
+
+        // Histogram is written straight into the image before anything is
+        // painted on top
+        const bool drawHistogram = job.plotMode == PLOT_MODE_HISTOGRAM && histCols > 0;
+        if (drawHistogram)
+        {
+            const float cidxScale = 255.0f * .7f / m_histMaxIIR;
+            const int imageWidth = plot.width();
+            const int imageHeight = plot.height();
+            const int bytesPerLine = plot.bytesPerLine();
+            uchar *bits = plot.bits();
+            const int xend = std::min(std::min(xmax, histCols), imageWidth);
+            const int nbins = std::min(histBinsDisplayed, histBins);
+            for (int ix = xmin; ix < xend; ix++)
+            {
+                const float *histData = m_histIIR.data() + ix * histBins;
+                float topBin = plotHeight;
+                for (j = 0; j < nbins; ++j)
+                {
+                    qint32 cidx = qRound(histData[j] * cidxScale);
+                    if (cidx > 0) {
+                        cidx += 65;  // 255 * 0.7 = 178, + 65 = 243
+                        // Histogram IIR can cause out-of-range cidx
+                        cidx = std::min(cidx, 255);
+                        const QRgb c = job.colorTbl[cidx];
+                        const float binY = binSizeY * j;
+                        topBin = std::min(topBin, binY);
+                        const int yEnd = std::min(qRound(binSizeY * (j + 1)), imageHeight);
+                        for (int y = qRound(binY); y < yEnd; ++y)
+                            reinterpret_cast<QRgb *>(bits + y * bytesPerLine)[ix] = c;
+                    }
+                }
+                m_histTop[ix] = topBin;
+            }
+        }
+
+        QPainter painter2(&plot);
         painter2.translate(QPointF(0.5, 0.5));
 
         // Diagonal fill for area between markers. Scale the pattern to DPR.
@@ -1512,69 +2442,45 @@ void CPlotter::draw(bool newData)
         QBrush abFillBrush = QBrush(abFillColor, Qt::BDiagPattern);
 
         QColor maxLineColor;
-        if (m_PlotMode == PLOT_MODE_FILLED)
-            maxLineColor = m_FilledModeMaxLineCol;
+        if (job.plotMode == PLOT_MODE_FILLED)
+            maxLineColor = job.filledModeMaxLineCol;
         else
-            maxLineColor = m_MainLineCol;
+            maxLineColor = job.mainLineCol;
 
         QPen maxLinePen = QPen(maxLineColor);
 
         // Same color as max in avg mode, different for filled mode
         QPen avgLinePen;
-        if (m_PlotMode == PLOT_MODE_AVG || m_PlotMode == PLOT_MODE_HISTOGRAM)
+        if (job.plotMode == PLOT_MODE_AVG || job.plotMode == PLOT_MODE_HISTOGRAM)
         {
-            avgLinePen = QPen(m_MainLineCol);
+            avgLinePen = QPen(job.mainLineCol);
         }
         else {
-            avgLinePen = QPen(m_FilledModeAvgLineCol);
+            avgLinePen = QPen(job.filledModeAvgLineCol);
         }
 
-        // The m_Marker{AB}X values are one cycle old, which makes for a laggy
-        // effect, so get fresh values here.
-        const int ax = xFromFreq(m_MarkerFreqA);
-        const int bx = xFromFreq(m_MarkerFreqB);
-        bool fillMarkers = (m_MarkersEnabled && m_MarkerFreqA != MARKER_OFF
-                                             && m_MarkerFreqB != MARKER_OFF);
-        const int minMarker = std::min(ax, bx);
-        const int maxMarker = std::max(ax, bx);
+        const int minMarker = std::min(job.markerAX, job.markerBX);
+        const int maxMarker = std::max(job.markerAX, job.markerBX);
+
+        // y coordinates of max and avg
+        if (doMaxLine)
+            dbToLevel(m_yMaxBuf, m_fftMaxBuf + xmin, npts, job.pandMaxdB, panddBGainFactor, (float)plotHeight);
+        if (job.plotMode != PLOT_MODE_MAX)
+            dbToLevel(m_yAvgBuf, m_fftAvgBuf + xmin, npts, job.pandMaxdB, panddBGainFactor, (float)plotHeight);
 
-        const float binSizeY = (float)plotHeight / (float)histBinsDisplayed;
         QPolygonF abPolygon;
         qreal yFillMax = 0;
         for (i = 0; i < npts; i++)
         {
             const int ix = i + xmin;
             const qreal ixPlot = (qreal)ix;
-            const qreal yMaxD = (qreal)std::max(std::min(
-                panddBGainFactor * (m_PandMaxdB - 10.0f * log10f(m_fftMaxBuf[ix])),
-                (float)plotHeight), 0.0f);
-            const qreal yAvgD = (qreal)std::max(std::min(
-                panddBGainFactor * (m_PandMaxdB - 10.0f * log10f(m_fftAvgBuf[ix])),
-                (float)plotHeight), 0.0f);
-
-            if (m_PlotMode == PLOT_MODE_HISTOGRAM)
-            {
-                const float *histData = m_histIIR[(ix)];
-                qreal topBin = plotHeight;
-                for (j = 0; j < histBinsDisplayed; ++j)
-                {
-                    qint32 cidx = qRound(histData[j] / m_histMaxIIR * 255.0f * .7f);
-                    if (cidx > 0) {
-                        cidx += 65;  // 255 * 0.7 = 178, + 65 = 243
-                        // Histogram IIR can cause out-of-range cidx
-                        cidx = std::max(std::min(cidx, 255), 0);
-                        QColor c = m_ColorTbl[cidx];
-                        // Paint rectangle
-                        const qreal binY = (qreal)binSizeY * j;
-                        topBin = std::min(topBin, binY);
-                        const qreal binH = (qreal)binSizeY * (j + 1) - binY;
-                        painter2.fillRect(QRectF(ixPlot, binY, 1.0, binH), c);
-                    }
-                }
-                // Highlight the top bin, if it isn't too crowded
-                if (topBin != plotHeight && showHistHighlights) {
-                    painter2.fillRect(QRectF(ixPlot, topBin, 1.0, (qreal)binSizeY), maxLineColor);
-                }
+            const qreal yMaxD = (qreal)m_yMaxBuf[i];
+            const qreal yAvgD = (qreal)m_yAvgBuf[i];
+
+            // Highlight the top histogram bin, if it isn't too crowded
+            if (drawHistogram && showHistHighlights && ix < histCols
+                && m_histTop[ix] != (float)plotHeight) {
+                painter2.fillRect(QRectF(ixPlot, m_histTop[ix], 1.0, (qreal)binSizeY), maxLineColor);
             }
 
             // Add max, average points if they will be drawn
@@ -1584,22 +2490,22 @@ void CPlotter::draw(bool newData)
                 m_avgLineBuf[i] = QPointF(ixPlot, yAvgD);
 
             // Fill area between markers, even if they are off screen
-            qreal yFill = m_PlotMode == PLOT_MODE_MAX ? yMaxD : yAvgD;
+            qreal yFill = job.plotMode == PLOT_MODE_MAX ? yMaxD : yAvgD;
             yFillMax = std::max(yFillMax, yFill);
-            if (fillMarkers && (ix) > minMarker && (ix) < maxMarker) {
+            if (job.fillMarkers && (ix) > minMarker && (ix) < maxMarker) {
                 abPolygon << QPointF(ixPlot, yFill);
             }
         }
 
-        if (m_FftFill && m_PlotMode != PLOT_MODE_HISTOGRAM)
+        if (job.fftFill && job.plotMode != PLOT_MODE_HISTOGRAM)
         {
             for (i = 0; i < npts; i++)
             {
-                const QPointF point = m_PlotMode == PLOT_MODE_MAX ? m_maxLineBuf[i] : m_avgLineBuf[i];
+                const QPointF point = job.plotMode == PLOT_MODE_MAX ? m_maxLineBuf[i] : m_avgLineBuf[i];
                 const qreal yFill = point.y();
-                painter2.fillRect(QRectF(point.x() - 1.0, yFill, 1.0, yFillMax - yFill), m_FftFillCol);
+                painter2.fillRect(QRectF(point.x() - 1.0, yFill, 1.0, yFillMax - yFill), job.fftFillCol);
             }
-            painter2.fillRect(QRectF(xmin, yFillMax, npts, plotHeight - yFillMax), m_FftFillCol);
+            painter2.fillRect(QRectF(xmin, yFillMax, npts, plotHeight - yFillMax), job.fftFillCol);
         }
 
         if (!abPolygon.isEmpty())
@@ -1611,52 +2517,40 @@ void CPlotter::draw(bool newData)
         }
 
         // Max hold
-        if (m_MaxHoldActive)
+        if (job.maxHold)
         {
             // Show max(max) except when showing only avg on screen
+            dbToLevel(m_yHoldBuf, m_fftMaxHoldBuf + xmin, npts, job.pandMaxdB, panddBGainFactor, (float)plotHeight);
             for (i = 0; i < npts; i++)
-            {
-                const int ix = i + xmin;
-                const qreal ixPlot = (qreal)ix;
-                const qreal yMaxHoldD = (qreal)std::max(std::min(
-                    panddBGainFactor * (m_PandMaxdB - 10.0f * log10f(m_fftMaxHoldBuf[ix])),
-                    (float)plotHeight), 0.0f);
-                m_holdLineBuf[i] = QPointF(ixPlot, yMaxHoldD);
-            }
+                m_holdLineBuf[i] = QPointF((qreal)(i + xmin), (qreal)m_yHoldBuf[i]);
             // NOT scaling to DPR due to performance
-            painter2.setPen(m_HoldLineCol);
+            painter2.setPen(job.holdLineCol);
             painter2.drawPolyline(m_holdLineBuf, npts);
 
             m_MaxHoldValid = true;
         }
 
         // Min hold
-        if (m_MinHoldActive)
+        if (job.minHold)
         {
             // Show min(avg) except when showing only max on screen
+            dbToLevel(m_yHoldBuf, m_fftMinHoldBuf + xmin, npts, job.pandMaxdB, panddBGainFactor, (float)plotHeight);
             for (i = 0; i < npts; i++)
-            {
-                const int ix = i + xmin;
-                const qreal ixPlot = (qreal)ix;
-                const qreal yMinHoldD = (qreal)std::max(std::min(
-                    panddBGainFactor * (m_PandMaxdB - 10.0f * log10f(m_fftMinHoldBuf[ix])),
-                    (float)plotHeight), 0.0f);
-                m_holdLineBuf[i] = QPointF(ixPlot, yMinHoldD);
-            }
+                m_holdLineBuf[i] = QPointF((qreal)(i + xmin), (qreal)m_yHoldBuf[i]);
             // NOT scaling to DPR due to performance
-            painter2.setPen(m_HoldLineCol);
+            painter2.setPen(job.holdLineCol);
             painter2.drawPolyline(m_holdLineBuf, npts);
 
             m_MinHoldValid = true;
         }
 
-        if (m_PlotMode == PLOT_MODE_FILLED)
+        if (job.plotMode == PLOT_MODE_FILLED)
         {
             for (i = 0; i < npts; i++)
             {
                 const QPointF maxPoint = m_maxLineBuf[i];
                 const qreal yMax = maxPoint.y();
-                painter2.fillRect(QRectF(maxPoint.x() - 1.0, yMax, 1.0, m_avgLineBuf[i].y() - yMax), m_FilledModeFillCol);
+                painter2.fillRect(QRectF(maxPoint.x() - 1.0, yMax, 1.0, m_avgLineBuf[i].y() - yMax), job.filledModeFillCol);
             }
         }
 
@@ -1674,25 +2568,23 @@ void CPlotter::draw(bool newData)
         }
 
         // Peak detection
-        if (m_PeakDetectActive)
+        if (job.peakDetect)
         {
             const int pw = PEAK_WINDOW_HALF_WIDTH;
 
             // Use data source appropriate for current display mode
             float *_detectSource;
-            if (m_MaxHoldActive)
+            if (job.maxHold)
                 _detectSource = m_fftMaxHoldBuf;
-            else if (m_PlotMode == PLOT_MODE_AVG)
+            else if (job.plotMode == PLOT_MODE_AVG)
                 _detectSource = m_fftAvgBuf;
             else
                 _detectSource = m_fftMaxBuf;
             const float *detectSource = _detectSource;
 
-            // Run peak detection periodically. If overlay will be redrawn, run
-            // peak detection since zoom/pan may have changed.
-            if (tnow_ms > tlast_peaks_ms + PEAK_UPDATE_PERIOD || m_DrawOverlay) {
-                tlast_peaks_ms = tnow_ms;
-                m_Peaks.clear();
+            // Run peak detection when requested by the GUI thread
+            if (job.updatePeaks) {
+                m_renderPeaks.clear();
 
                 // Narrow peaks
                 for (i = pw; i < npts - pw; ++i) {
@@ -1700,7 +2592,7 @@ void CPlotter::draw(bool newData)
                     const float vi = detectSource[ix];
                     float sumV = 0;
                     float minV = vi;
-                    float maxV = 0;
+                    float maxV = vi;
                     for (j = -pw; j <= pw; ++j) {
                         const float vj = detectSource[ix + j];
                         minV = std::min(minV, vj);
@@ -1709,12 +2601,13 @@ void CPlotter::draw(bool newData)
                     }
                     const float avgV = sumV / (float)(pw * 2 + 1);
                     m_peakSmoothBuf[ix] = avgV;
-                    if (vi == maxV && (vi > 2.0f * avgV) && (vi > 4.0f * minV))
+                    // 3 dB above average and 6 dB above minimum
+                    if (vi == maxV && (vi > avgV + DB_PER_LOG2) && (vi > minV + 2.0f * DB_PER_LOG2))
                     {
                         const qreal y = (qreal)std::max(std::min(
-                            panddBGainFactor * (m_PandMaxdB - 10.0f * log10f(vi)),
+                            panddBGainFactor * (job.pandMaxdB - vi),
                             (float)plotHeight - 0.0f), 0.0f);
-                        m_Peaks[ix] = y;
+                        m_renderPeaks[ix] = y;
                     }
                 }
 
@@ -1725,7 +2618,7 @@ void CPlotter::draw(bool newData)
                     const float vi = m_peakSmoothBuf[ix];
                     float sumV = 0;
                     float minV = vi;
-                    float maxV = 0;
+                    float maxV = vi;
                     for (j = -pw2; j <= pw2; ++j) {
                         const float vj = m_peakSmoothBuf[ix + j];
                         minV = std::min(minV, vj);
@@ -1733,41 +2626,41 @@ void CPlotter::draw(bool newData)
                         sumV += vj;
                     }
                     const float avgV = sumV / (float)(pw2 * 2);
-                    if (vi == maxV && (vi > 2.0f * avgV) && (vi > 4.0f * minV))
+                    if (vi == maxV && (vi > avgV + DB_PER_LOG2) && (vi > minV + 2.0f * DB_PER_LOG2))
                     {
                         const qreal y = (qreal)std::max(std::min(
-                            panddBGainFactor * (m_PandMaxdB - 10.0f * log10f(vi)),
+                            panddBGainFactor * (job.pandMaxdB - vi),
                             (float)plotHeight - 0.0f), 0.0f);
 
                         // Show the wider peak only if there is no very close narrow peak
                         bool found = false;
                         for (j = -pw; j <= pw; ++j) {
-                            auto it = m_Peaks.find(ix + j);
-                            if (it != m_Peaks.end()) {
+                            auto it = m_renderPeaks.find(ix + j);
+                            if (it != m_renderPeaks.end()) {
                                 found = true;
                                 break;
                             }
                         }
                         if (!found) {
-                            m_Peaks[ix] = y;
+                            m_renderPeaks[ix] = y;
                         }
                     }
                 }
             }
 
             // Paint peaks with shadow
-            if (m_PeakPixmap.isNull())
+            if (m_PeakImage.isNull())
             {
-                const qreal radius = 5.0 * m_DPR;
+                const qreal radius = 5.0 * job.dpr;
                 const qreal diameter = radius * 2;
-                const int half = qRound(radius + m_DPR * 2);
+                const int half = qRound(radius + job.dpr * 2);
                 const int full = half * 2;
-                m_PeakPixmap = QPixmap(full, full);
-                m_PeakPixmap.fill(Qt::transparent);
-                QPainter peakPainter(&m_PeakPixmap);
+                m_PeakImage = QImage(full, full, QImage::Format_ARGB32_Premultiplied);
+                m_PeakImage.fill(Qt::transparent);
+                QPainter peakPainter(&m_PeakImage);
                 peakPainter.translate(half, half);
-                QPen peakPen(m_MainLineCol, m_DPR);
-                QPen peakShadowPen(Qt::black, m_DPR);
+                QPen peakPen(job.mainLineCol, job.dpr);
+                QPen peakShadowPen(Qt::black, job.dpr);
                 peakPainter.setPen(peakShadowPen);
                 peakPainter.drawEllipse(
                     QRectF(shadowOffset - radius,
@@ -1779,28 +2672,18 @@ void CPlotter::draw(bool newData)
                            -radius,
                            diameter, diameter));
             }
-            const int peakPixmapOffset = m_PeakPixmap.width() / 2 + 1;
-            for(auto peakx : m_Peaks.keys()) {
+            const int peakImageOffset = m_PeakImage.width() / 2 + 1;
+            for(auto peakx : m_renderPeaks.keys()) {
                 const qreal peakxPlot = (qreal)peakx;
-                const qreal peakv = m_Peaks.value(peakx);
-                painter2.drawPixmap(QPointF(peakxPlot - peakPixmapOffset, peakv - peakPixmapOffset), m_PeakPixmap);
+                const qreal peakv = m_renderPeaks.value(peakx);
+                painter2.drawImage(QPointF(peakxPlot - peakImageOffset, peakv - peakImageOffset), m_PeakImage);
             }
         }
 
-        // Update the overlay if needed
-        if (m_DrawOverlay)
-        {
-            drawOverlay();
-            m_DrawOverlay = false;
-        }
-
         // Draw overlay over plot
         painter2.setCompositionMode(QPainter::CompositionMode_SourceOver);
-        painter2.drawPixmap(QPointF(0.0, 0.0), m_OverlayPixmap);
+        painter2.drawImage(QPointF(0.0, 0.0), job.overlay);
     }
-
-    // trigger a new paintEvent
-    update();
 }
 
 void CPlotter::setRunningState(bool running)
@@ -1811,12 +2694,7 @@ void CPlotter::setRunningState(bool running)
         setWaterfallSpan(wf_span);
 
         // Invalidate any existing data
-        m_MaxHoldValid = false;
-        m_MinHoldValid = false;
-        m_IIRValid = false;
-        m_histIIRValid = false;
-        m_histMaxIIR = std::numeric_limits<float>::min();
-
+        m_renderResets |= RESET_MAXHOLD | RESET_MINHOLD | RESET_IIR | RESET_HIST | RESET_HISTMAX;
     }
 
     m_Running = running;
@@ -1836,81 +2714,171 @@ void CPlotter::setNewFftData(const float *fftData, int size)
     const float fmin = 1e-20;
 
     if (size != m_fftDataSize)
+        setFftDataSize(size);
+    m_fftReduced = false;
+
+    reuseRenderBuffer(m_fftData, m_spareFftData);
+    m_fftData.resize(size);
+
+    const float pwr_scale = powerScale(size);
+    for (int i = 0; i < size; ++i)
+        m_fftData[i] = std::max(fftData[i] * pwr_scale, fmin);
+
+    draw(true);
+}
+
+/**
+ * Get the pixel geometry for FFT data reduced to screen resolution.
+ * @param fftSize The FFT size of the next frame.
+ * @param startBin Shifted FFT bin at the center of the first point (output).
+ * @param binsPerPoint Number of FFT bins per point (output).
+ * @param npts Number of points expected by setNewReducedFftData() (output).
+ * @return false if the frame should be delivered in full via setNewFftData().
+ *
+ * Reduction is only possible when several bins map to each pixel column and
+ * per-bin statistics are not needed, i.e. not in histogram mode.
+ */
+bool CPlotter::getReducedFftGeometry(int fftSize, double *startBin,
+                                     double *binsPerPoint, int *npts)
+{
+    const qreal w = m_Size.width() * m_DPR;
+
+    if (fftSize <= 0 || w <= 0.0 || m_PlotMode == PLOT_MODE_HISTOGRAM)
+        return false;
+
+    // Same geometry as used by draw()
+    const double fftSizeD = fftSize;
+    const double binsPerHz = fftSizeD / (double)m_SampleFreq;
+    const double startFreq = (double)m_FftCenter - (double)m_Span / 2.0;
+    const double xScale = (double)m_SampleFreq * w / fftSizeD / (double)m_Span;
+    const double startBinD = startFreq * binsPerHz + fftSizeD / 2.0;
+    const qint32 startBinI = std::min(qRound(startBinD), fftSize - 1);
+    const qint32 numBins = (qint32)ceil((double)m_Span * binsPerHz);
+
+    if ((qreal)numBins < w)
+        return false;
+
+    const qint32 minbin = std::max(startBinI, 1);
+    const qint32 maxbin = std::min(startBinI + numBins + 1, fftSize - 1);
+    const qint32 xmin = qRound((double)(minbin - startBinI) * xScale);
+    const qint32 xmax = std::min(qRound((double)(maxbin - startBinI) * xScale), qRound(w));
+
+    if (xmax <= xmin || xmax > MAX_SCREENSIZE)
+        return false;
+
+    m_reducedReqXmin = xmin;
+    m_reducedReqNpts = xmax - xmin;
+    m_reducedReqBinsPerPoint = 1.0 / xScale;
+    m_reducedReqStartBin = (double)startBinI + (double)xmin * m_reducedReqBinsPerPoint;
+
+    *startBin = m_reducedReqStartBin;
+    *binsPerPoint = m_reducedReqBinsPerPoint;
+    *npts = m_reducedReqNpts;
+
+    return true;
+}
+
+
+/**
+ * Set new FFT data already reduced to one max and one average value per
+ * pixel column, using the geometry from the last getReducedFftGeometry().
+ */
+void CPlotter::setNewReducedFftData(const float *maxData, const float *avgData,
+                                    int npts, int fftSize)
+{
+    // Make sure zeros don't get through to log calcs
+    const float fmin = 1e-20;
+
+    if (npts != m_reducedReqNpts || npts <= 0)
+        return;
+
+    if (fftSize != m_fftDataSize)
+        setFftDataSize(fftSize);
+
+    // Full resolution buffers are not needed while frames arrive reduced
+    if (!m_fftData.empty())
+        std::vector<float>().swap(m_fftData);
+
+    // IIR state is per pixel, so it is only valid for unchanged geometry
+    if (!m_fftReduced
+        || npts != m_reducedNpts
+        || m_reducedReqXmin != m_reducedXmin
+        || m_reducedReqStartBin != m_reducedStartBin
+        || m_reducedReqBinsPerPoint != m_reducedBinsPerPoint)
+    {
+        m_renderResets |= RESET_IIR;
+    }
+    m_fftReduced = true;
+    m_reducedXmin = m_reducedReqXmin;
+    m_reducedNpts = npts;
+    m_reducedStartBin = m_reducedReqStartBin;
+    m_reducedBinsPerPoint = m_reducedReqBinsPerPoint;
+
+    reuseRenderBuffer(m_reducedMax, m_spareReducedMax);
+    reuseRenderBuffer(m_reducedAvg, m_spareReducedAvg);
+    m_reducedMax.resize(npts);
+    m_reducedAvg.resize(npts);
+
+    const float pwr_scale = powerScale(fftSize);
+    for (int i = 0; i < npts; ++i)
     {
-        // Reallocate and invalidate IIRs
-        m_fftData.resize(size);
-        m_fftIIR.resize(size);
-        m_X.resize(size);
+        m_reducedMax[i] = std::max(maxData[i] * pwr_scale, fmin);
+        m_reducedAvg[i] = std::max(avgData[i] * pwr_scale, fmin);
+    }
 
-        m_MaxHoldValid = false;
-        m_MinHoldValid = false;
-        m_IIRValid = false;
+    draw(true);
+}
 
-        m_histIIRValid = false;
-        m_histMaxIIR = std::numeric_limits<float>::min();
+// Called when the FFT size changes
+void CPlotter::setFftDataSize(int size)
+{
+    // Invalidate IIRs
+    m_renderResets |= RESET_MAXHOLD | RESET_MINHOLD | RESET_IIR | RESET_HIST | RESET_HISTMAX;
 
-        m_fftDataSize = size;
+    m_fftDataSize = size;
 
-        // Zoom out if needed to keep about 4 points on the screen
-        double currentZoom = (double)m_SampleFreq / (double)m_Span;
-        double maxZoom = (double)m_fftDataSize / 4.0;
-        if (currentZoom > maxZoom)
-            zoomStepX(currentZoom / maxZoom, qRound((qreal)m_Size.width() * m_DPR / 2.0));
-    }
+    // Zoom out if needed to keep about 4 points on the screen
+    double currentZoom = (double)m_SampleFreq / (double)m_Span;
+    double maxZoom = (double)m_fftDataSize / 4.0;
+    if (currentZoom > maxZoom)
+        zoomStepX(currentZoom / maxZoom, qRound((qreal)m_Size.width() * m_DPR / 2.0));
+}
 
+// Scale factor from FFT power to the selected plot scale
+float CPlotter::powerScale(int size) const
+{
     // For dBFS, define full scale as peak (not RMS). A 1.0 FS peak sine wave
     // is 0 dBFS.
-    float _pwr_scale = 1.0f / ((float)size * (float)size);
+    float pwr_scale = 1.0f / ((float)size * (float)size);
 
     // For V, convert peak to RMS (/2). 1V peak corresponds to -3.01 dBV (RMS
     // value is 0.707 * peak).
     if (m_PlotScale == PLOT_SCALE_DBV)
-        _pwr_scale *= 1.0f / 2.0f;
+        pwr_scale *= 1.0f / 2.0f;
 
     // For dBm, the scale is interpreted as V. A 1V peak sine corresponds to
     // 10mW, or 10 dBm. The factor of 2 converts Vpeak to Vrms.
     else if (m_PlotScale == PLOT_SCALE_DBMW50)
-        _pwr_scale *= 1000.0f / (2.0f * 50.0f);
+        pwr_scale *= 1000.0f / (2.0f * 50.0f);
 
     // For units of /Hz, rescale by 1/RBW. For V, this results in /sqrt(Hz), and is
     // used for noise spectral density.
     if (m_PlotPerHz && m_PlotScale != PLOT_SCALE_DBFS)
-        _pwr_scale *= (float)size / (float)m_SampleFreq;
-
-    const float pwr_scale = _pwr_scale;
-    for (int i = 0; i < size; ++i)
-        m_fftData[i] = std::max(fftData[i] * pwr_scale, fmin);
+        pwr_scale *= (float)size / (float)m_SampleFreq;
 
-    // Update IIR. If IIR is invalid, set alpha to use latest value. Since the
-    // IIR is linear data and users would like to see symmetric attack/decay on
-    // the logarithmic y-axis, IIR is in terms of multiplication rather than
-    // addition.
+    return pwr_scale;
+}
 
+// Exponent used by the multiplicative spectrum IIR
+float CPlotter::iirCoefficient() const
+{
     // Time constant, taking update rate into account. Attack and decay rate of
     // change in dB/sec should not visibly change with FFT rate.
-    const float _a = powf((float)fft_rate, -1.75f * (1.0f - m_alpha));
+    const float a = powf((float)fft_rate, -1.75f * (1.0f - m_alpha));
 
     // Make the slider vs alpha nonlinear
     const float gamma = 0.7;
-    const float a = powf(_a, gamma);
-
-    // Shortcut expensive pow() if not needed
-    const bool needIIR = m_IIRValid                         // Initializing
-                      && a != 1.0f;                         // IIR is NOP
-
-    if (needIIR) {
-        volk_32f_x2_divide_32f(m_X.data(), m_fftData.data(), m_fftIIR.data(), size);
-        volk_32f_s32f_power_32f(m_X.data(), m_X.data(), a, size);
-        volk_32f_x2_multiply_32f(m_fftIIR.data(), m_fftIIR.data(), m_X.data(), size);
-    }
-    else
-    {
-        memcpy(m_fftIIR.data(), m_fftData.data(), size * sizeof(float));
-    }
-
-    m_IIRValid = true;
-
-    draw(true);
+    return powf(a, gamma);
 }
 
 void CPlotter::setFftAvg(float avg)
@@ -1931,8 +2899,8 @@ void CPlotter::setPandapterRange(float min, float max)
 
     m_PandMindB = min;
     m_PandMaxdB = max;
-    m_histIIRValid = false;
-    updateOverlay();
+    m_renderResets |= RESET_HIST;
+    updateOverlay(OVERLAY_GRID);
 }
 
 void CPlotter::setWaterfallRange(float min, float max)
@@ -1942,188 +2910,294 @@ void CPlotter::setWaterfallRange(float min, float max)
 
     m_WfMindB = min;
     m_WfMaxdB = max;
+    m_wfLutValid = false;
     // no overlay change is necessary
+    update();
+}
+
+/**
+ * Get a layer image of the overlay size, cleared to transparent.
+ * @param layer The layer image, reallocated if the size has changed.
+ */
+void CPlotter::prepareOverlayLayer(QImage &layer)
+{
+    if (layer.size() != m_OverlayImage.size())
+        layer = QImage(m_OverlayImage.size(), QImage::Format_ARGB32_Premultiplied);
+    layer.fill(Qt::transparent);
 }
 
 // Called to draw an overlay bitmap containing grid and text that
-// does not need to be recreated every fft data update.
+// does not need to be recreated every fft data update. Only the layers
+// invalidated by updateOverlay() are drawn again.
 void CPlotter::drawOverlay()
 {
-    if (m_OverlayPixmap.isNull())
+    const int dirty = m_OverlayDirty;
+    m_OverlayDirty = 0;
+
+    if (m_OverlayImage.isNull())
         return;
 
-    int     x;
-    qreal   pixperdiv;
-    qreal   adjoffset;
-    qreal   dbstepsize;
-    qreal   mindbadj;
-    QFontMetricsF metrics(m_Font);
-    const qreal shadowOffset = metrics.height() / 20.0;
-    qreal   w = m_OverlayPixmap.width();
-    qreal   h = m_OverlayPixmap.height();
+    if (m_BookmarksEnabled || m_DXCSpotsEnabled)
+    {
+        if ((dirty & OVERLAY_TAGS) || m_TagsLayer.size() != m_OverlayImage.size())
+            drawTagsLayer();
+    }
+    else if (!m_TagsLayer.isNull())
+    {
+        m_TagsLayer = QImage();
+        m_Taglist.clear();
+    }
+
+    if (m_BandPlanEnabled)
+    {
+        if ((dirty & OVERLAY_BANDPLAN) || m_BandPlanLayer.size() != m_OverlayImage.size())
+            drawBandPlanLayer();
+    }
+    else if (!m_BandPlanLayer.isNull())
+    {
+        m_BandPlanLayer = QImage();
+    }
+
+    if ((dirty & OVERLAY_GRID) || m_GridLayer.size() != m_OverlayImage.size())
+        drawGridLayer();
+
+    const qreal w = m_OverlayImage.width();
+    const qreal h = m_OverlayImage.height();
+
+    m_OverlayImage.fill(Qt::transparent);
+    QPainter painter(&m_OverlayImage);
+    if (!m_TagsLayer.isNull())
+        painter.drawImage(QPointF(0.0, 0.0), m_TagsLayer);
+    if (!m_BandPlanLayer.isNull())
+        painter.drawImage(QPointF(0.0, 0.0), m_BandPlanLayer);
+    painter.drawImage(QPointF(0.0, 0.0), m_GridLayer);
 
-    m_OverlayPixmap.fill(Qt::transparent);
-    QPainter painter(&m_OverlayPixmap);
+    // Markers and filter box change often and are cheap to draw
     painter.translate(QPointF(-0.5, -0.5));
-    // painter.setRenderHint(QPainter::Antialiasing);
     painter.setFont(m_Font);
+    drawMarkers(painter);
 
-    QList<BookmarkInfo> tags;
+    // Draw a black line at the bottom of the plotter to separate it from the
+    // waterfall
+    painter.resetTransform();
+    painter.fillRect(QRectF(0.0, h - 1.0 * m_DPR, w, 1.0 * m_DPR), Qt::black);
 
-    // X and Y axis areas
-    m_YAxisWidth = metrics.boundingRect("-120").width() + 2 * HOR_MARGIN;
-    m_XAxisYCenter = h - metrics.height()/2;
-    qreal xAxisHeight = metrics.height() + 2 * VER_MARGIN;
-    qreal xAxisTop = h - xAxisHeight;
-    qreal fLabelTop = xAxisTop + VER_MARGIN;
+    painter.end();
+}
 
-    if (m_BookmarksEnabled || m_DXCSpotsEnabled)
+/**
+ * Get the cached layout of a tag label.
+ * @param name The label text.
+ *
+ * Measuring and laying out text is the most expensive part of drawing the
+ * overlay with many bookmarks, so labels are kept between overlay updates.
+ */
+const CPlotter::TagLabel &CPlotter::tagLabel(const QString &name, const QFontMetricsF &fm)
+{
+    auto it = m_TagLabelCache.constFind(name);
+    if (it != m_TagLabelCache.constEnd())
+        return it.value();
+
+    if (m_TagLabelCache.size() >= TAG_LABEL_CACHE_MAX)
+        m_TagLabelCache.clear();
+
+    TagLabel label;
+    label.text.setText(name);
+    label.text.setTextFormat(Qt::PlainText);
+    label.text.setPerformanceHint(QStaticText::AggressiveCaching);
+    label.text.prepare(QTransform(), m_Font);
+    label.width = fm.boundingRect(name).width();
+    return m_TagLabelCache.insert(name, label).value();
+}
+
+/**
+ * Get bookmarks and DX spots in the visible range.
+ *
+ * The lookup covers one span on each side of the visible range, so that
+ * panning and zooming out a little do not need a new lookup. The result is
+ * reused until it no longer covers the view or updateTags() is called.
+ */
+const QList<BookmarkInfo> &CPlotter::visibleTags()
+{
+    const qint64 low = m_CenterFreq + m_FftCenter - m_Span / 2;
+    const qint64 high = m_CenterFreq + m_FftCenter + m_Span / 2;
+
+    if (m_TagCacheValid && low >= m_TagCacheLow && high <= m_TagCacheHigh
+        && m_Span >= m_TagCacheSpan / 4)
+        return m_TagCache;
+
+    m_TagCacheLow = low - m_Span;
+    m_TagCacheHigh = high + m_Span;
+    m_TagCacheSpan = m_Span;
+    m_TagCacheValid = true;
+
+    if (m_BookmarksEnabled)
+        m_TagCache = Bookmarks::Get().getBookmarksInRange(m_TagCacheLow, m_TagCacheHigh);
+    else
+        m_TagCache.clear();
+
+    if (m_DXCSpotsEnabled)
     {
-        m_Taglist.clear();
-        static const QFontMetricsF fm(painter.font());
-        static const qreal fontHeight = fm.ascent() + 1;
-        static const qreal slant = 5;
-        static const qreal levelHeight = fontHeight + 5;
-        static const qreal nLevels = h / (levelHeight + slant);
-        if (m_BookmarksEnabled)
-        {
-            tags = Bookmarks::Get().getBookmarksInRange(m_CenterFreq + m_FftCenter - m_Span / 2,
-                                                        m_CenterFreq + m_FftCenter + m_Span / 2);
-        }
-        else
+        QList<DXCSpotInfo> dxcspots = DXCSpots::Get().getDXCSpotsInRange(m_TagCacheLow, m_TagCacheHigh);
+        QListIterator<DXCSpotInfo> iter(dxcspots);
+        while(iter.hasNext())
         {
-            tags.clear();
-        }
-        if (m_DXCSpotsEnabled)
-        {
-            QList<DXCSpotInfo> dxcspots = DXCSpots::Get().getDXCSpotsInRange(m_CenterFreq + m_FftCenter - m_Span / 2,
-                                                                             m_CenterFreq + m_FftCenter + m_Span / 2);
-            QListIterator<DXCSpotInfo> iter(dxcspots);
-            while(iter.hasNext())
-            {
-                BookmarkInfo tempDXCSpot;
-                DXCSpotInfo IterDXCSpot = iter.next();
-                tempDXCSpot.name = IterDXCSpot.name;
-                tempDXCSpot.frequency = IterDXCSpot.frequency;
-                tags.append(tempDXCSpot);
-            }
-            std::stable_sort(tags.begin(),tags.end());
+            BookmarkInfo tempDXCSpot;
+            DXCSpotInfo IterDXCSpot = iter.next();
+            tempDXCSpot.name = IterDXCSpot.name;
+            tempDXCSpot.frequency = IterDXCSpot.frequency;
+            m_TagCache.append(tempDXCSpot);
         }
-        QVector<int> tagEnd(nLevels + 1);
-        for (auto & tag : tags)
-        {
-            x = xFromFreq(tag.frequency);
-            qreal nameWidth = fm.boundingRect(tag.name).width();
+        std::stable_sort(m_TagCache.begin(), m_TagCache.end());
+    }
 
-            int level = 0;
-            while(level < nLevels && tagEnd[level] > x)
-                level++;
+    return m_TagCache;
+}
 
-            if(level >= nLevels)
-            {
-                level = 0;
-                if (tagEnd[level] > x)
-                    continue; // no overwrite at level 0
-            }
+// Draw bookmarks and DX spots
+void CPlotter::drawTagsLayer()
+{
+    prepareOverlayLayer(m_TagsLayer);
+    m_Taglist.clear();
 
-            tagEnd[level] = x + nameWidth + slant - 1;
+    QFontMetricsF metrics(m_Font);
+    qreal   h = m_TagsLayer.height();
+    qreal   xAxisTop = h - (metrics.height() + 2 * VER_MARGIN);
 
-            const auto levelNHeight = level * levelHeight;
-            const auto levelNHeightBottom = levelNHeight + fontHeight;
-            const auto levelNHeightBottomSlant = levelNHeightBottom + slant;
+    QPainter painter(&m_TagsLayer);
+    painter.translate(QPointF(-0.5, -0.5));
+    painter.setFont(m_Font);
 
-            m_Taglist.append(qMakePair(QRectF(x, levelNHeight, nameWidth + slant, fontHeight), tag.frequency));
+    static const QFontMetricsF fm(painter.font());
+    static const qreal fontHeight = fm.ascent() + 1;
+    static const qreal slant = 5;
+    static const qreal levelHeight = fontHeight + 5;
+    static const qreal nLevels = h / (levelHeight + slant);
 
-            QColor color = QColor(tag.GetColor());
-            color.setAlpha(100);
-            // Vertical line
-            painter.setPen(QPen(color, m_DPR, Qt::DashLine));
-            painter.drawLine(QPointF(x, levelNHeightBottomSlant), QPointF(x, xAxisTop));
+    const qint64 low = m_CenterFreq + m_FftCenter - m_Span / 2;
+    const qint64 high = m_CenterFreq + m_FftCenter + m_Span / 2;
+    const QList<BookmarkInfo> &tags = visibleTags();
 
-            // Horizontal line
-            painter.setPen(QPen(color, m_DPR, Qt::SolidLine));
-            painter.drawLine(QPointF(x + slant, levelNHeightBottom),
-                             QPointF(x + nameWidth + slant - 1,
-                             levelNHeightBottom));
-            // Diagonal line
-            painter.drawLine(QPointF(x + 1, levelNHeightBottomSlant - 1),
-                             QPointF(x + slant - 1, levelNHeightBottom + 1));
+    QVector<int> tagEnd(nLevels + 1);
+    for (auto & tag : tags)
+    {
+        if (tag.frequency < low)
+            continue;
+        if (tag.frequency > high)
+            break;
 
-            color.setAlpha(255);
-            painter.setPen(QPen(color, 2.0 * m_DPR, Qt::SolidLine));
-            painter.drawText(x + slant, levelNHeight, nameWidth,
-                             fontHeight, Qt::AlignVCenter | Qt::AlignHCenter,
-                             tag.name);
-        }
-    }
+        int x = xFromFreq(tag.frequency);
+        const TagLabel &label = tagLabel(tag.name, fm);
+        qreal nameWidth = label.width;
 
-    if (m_BandPlanEnabled)
-    {
-        QList<BandInfo> bands = BandPlan::Get().getBandsInRange(m_CenterFreq + m_FftCenter - m_Span / 2,
-                                                                m_CenterFreq + m_FftCenter + m_Span / 2);
+        int level = 0;
+        while(level < nLevels && tagEnd[level] > x)
+            level++;
 
-        m_BandPlanHeight = metrics.height() + VER_MARGIN;
-        for (auto & band : bands)
+        if(level >= nLevels)
         {
-            int band_left = std::max(xFromFreq(band.minFrequency), 0);
-            int band_right = std::min(xFromFreq(band.maxFrequency), (int)w);
-            int band_width = band_right - band_left;
-            QRectF rect(band_left, xAxisTop - m_BandPlanHeight, band_width, m_BandPlanHeight);
-            painter.fillRect(rect, band.color);
-            QString band_label = metrics.elidedText(band.name + " (" + band.modulation + ")", Qt::ElideRight, band_width - 10);
-            QRectF textRect(band_left, xAxisTop - m_BandPlanHeight, band_width, metrics.height());
-            painter.setPen(QPen(QColor::fromRgba(PLOTTER_TEXT_COLOR), m_DPR));
-            painter.drawText(textRect, Qt::AlignCenter, band_label);
+            level = 0;
+            if (tagEnd[level] > x)
+                continue; // no overwrite at level 0
         }
+
+        tagEnd[level] = x + nameWidth + slant - 1;
+
+        const auto levelNHeight = level * levelHeight;
+        const auto levelNHeightBottom = levelNHeight + fontHeight;
+        const auto levelNHeightBottomSlant = levelNHeightBottom + slant;
+
+        m_Taglist.append(qMakePair(QRectF(x, levelNHeight, nameWidth + slant, fontHeight), tag.frequency));
+
+        QColor color = QColor(tag.GetColor());
+        color.setAlpha(100);
+        // Vertical line
+        painter.setPen(QPen(color, m_DPR, Qt::DashLine));
+        painter.drawLine(QPointF(x, levelNHeightBottomSlant), QPointF(x, xAxisTop));
+
+        // Horizontal line
+        painter.setPen(QPen(color, m_DPR, Qt::SolidLine));
+        painter.drawLine(QPointF(x + slant, levelNHeightBottom),
+                         QPointF(x + nameWidth + slant - 1,
+                         levelNHeightBottom));
+        // Diagonal line
+        painter.drawLine(QPointF(x + 1, levelNHeightBottomSlant - 1),
+                         QPointF(x + slant - 1, levelNHeightBottom + 1));
+
+        // Label centered in the same box as before
+        const QSizeF textSize = label.text.size();
+        color.setAlpha(255);
+        painter.setPen(QPen(color, 2.0 * m_DPR, Qt::SolidLine));
+        painter.drawStaticText(QPointF(x + slant + (nameWidth - textSize.width()) / 2.0,
+                                       levelNHeight + (fontHeight - textSize.height()) / 2.0),
+                               label.text);
     }
+}
 
-    if (m_CenterLineEnabled)
+void CPlotter::drawBandPlanLayer()
+{
+    prepareOverlayLayer(m_BandPlanLayer);
+
+    QFontMetricsF metrics(m_Font);
+    qreal   w = m_BandPlanLayer.width();
+    qreal   h = m_BandPlanLayer.height();
+    qreal   xAxisTop = h - (metrics.height() + 2 * VER_MARGIN);
+
+    QPainter painter(&m_BandPlanLayer);
+    painter.translate(QPointF(-0.5, -0.5));
+    painter.setFont(m_Font);
+
+    QList<BandInfo> bands = BandPlan::Get().getBandsInRange(m_CenterFreq + m_FftCenter - m_Span / 2,
+                                                            m_CenterFreq + m_FftCenter + m_Span / 2);
+
+    m_BandPlanHeight = metrics.height() + VER_MARGIN;
+    for (auto & band : bands)
     {
-        x = xFromFreq(m_CenterFreq);
-        painter.setPen(QPen(QColor::fromRgba(PLOTTER_CENTER_LINE_COLOR), m_DPR));
-        painter.drawLine(QPointF(x, 0), QPointF(x, xAxisTop));
+        int band_left = std::max(xFromFreq(band.minFrequency), 0);
+        int band_right = std::min(xFromFreq(band.maxFrequency), (int)w);
+        int band_width = band_right - band_left;
+        QRectF rect(band_left, xAxisTop - m_BandPlanHeight, band_width, m_BandPlanHeight);
+        painter.fillRect(rect, band.color);
+        QString band_label = metrics.elidedText(band.name + " (" + band.modulation + ")", Qt::ElideRight, band_width - 10);
+        QRectF textRect(band_left, xAxisTop - m_BandPlanHeight, band_width, metrics.height());
+        painter.setPen(QPen(QColor::fromRgba(PLOTTER_TEXT_COLOR), m_DPR));
+        painter.drawText(textRect, Qt::AlignCenter, band_label);
     }
+}
 
-    if (m_MarkersEnabled)
-    {
-        QBrush brush;
-        brush.setColor(QColor::fromRgba(PLOTTER_MARKER_COLOR));
-        brush.setStyle(Qt::SolidPattern);
-        painter.setPen(QPen(QColor::fromRgba(PLOTTER_MARKER_COLOR), m_DPR));
+// Draw center line, frequency and level grids and axes
+void CPlotter::drawGridLayer()
+{
+    prepareOverlayLayer(m_GridLayer);
 
-        qreal markerSize = metrics.height() / 2;
+    int     x;
+    qreal   pixperdiv;
+    qreal   adjoffset;
+    qreal   dbstepsize;
+    qreal   mindbadj;
+    QFontMetricsF metrics(m_Font);
+    const qreal shadowOffset = metrics.height() / 20.0;
+    qreal   w = m_GridLayer.width();
+    qreal   h = m_GridLayer.height();
 
-        if (m_MarkerFreqA != MARKER_OFF) {
-            x = xFromFreq(m_MarkerFreqA);
-            m_MarkerAX = x;
-            QPolygon poly;
-            QPainterPath path;
-            poly << QPoint(x - markerSize/2, 0)
-                    << QPoint(x + markerSize/2, 0)
-                    << QPoint(x, markerSize);
-            path.addPolygon(poly);
-            painter.drawPolygon(poly);
-            painter.fillPath(path, brush);
-            painter.drawLine(x, markerSize, x, xAxisTop);
-            painter.drawStaticText(QPointF(x + markerSize/2, 0), QStaticText("A"));
-        }
+    QPainter painter(&m_GridLayer);
+    painter.translate(QPointF(-0.5, -0.5));
+    // painter.setRenderHint(QPainter::Antialiasing);
+    painter.setFont(m_Font);
 
-        if (m_MarkerFreqB != MARKER_OFF) {
-            x = xFromFreq(m_MarkerFreqB);
-            m_MarkerBX = x;
-            QPolygon poly;
-            QPainterPath path;
-            poly << QPoint(x - markerSize/2, 0)
-                    << QPoint(x + markerSize/2, 0)
-                    << QPoint(x, markerSize);
-            path.addPolygon(poly);
-            painter.drawPolygon(poly);
-            painter.fillPath(path, brush);
-            painter.drawLine(x, markerSize, x, xAxisTop);
-            painter.drawStaticText(QPointF(x + markerSize/2, 0), QStaticText("B"));
-        }
-    }
+    // X and Y axis areas
+    m_YAxisWidth = metrics.boundingRect("-120").width() + 2 * HOR_MARGIN;
+    m_XAxisYCenter = h - metrics.height()/2;
+    qreal xAxisHeight = metrics.height() + 2 * VER_MARGIN;
+    qreal xAxisTop = h - xAxisHeight;
+    qreal fLabelTop = xAxisTop + VER_MARGIN;
 
+    if (m_CenterLineEnabled)
+    {
+        x = xFromFreq(m_CenterFreq);
+        painter.setPen(QPen(QColor::fromRgba(PLOTTER_CENTER_LINE_COLOR), m_DPR));
+        painter.drawLine(QPointF(x, 0), QPointF(x, xAxisTop));
+    }
     // Frequency grid
     qint64  StartFreq = m_CenterFreq + m_FftCenter - m_Span / 2;
     QString label;
@@ -2213,6 +3287,55 @@ void CPlotter::drawOverlay()
             painter.drawText(textRect, Qt::AlignRight|Qt::AlignVCenter, QString::number(dB));
         }
     }
+}
+
+// Draw markers and the demodulator filter box
+void CPlotter::drawMarkers(QPainter &painter)
+{
+    int     x;
+    QFontMetricsF metrics(m_Font);
+    qreal   h = m_OverlayImage.height();
+    qreal   xAxisTop = h - (metrics.height() + 2 * VER_MARGIN);
+
+    if (m_MarkersEnabled)
+    {
+        QBrush brush;
+        brush.setColor(QColor::fromRgba(PLOTTER_MARKER_COLOR));
+        brush.setStyle(Qt::SolidPattern);
+        painter.setPen(QPen(QColor::fromRgba(PLOTTER_MARKER_COLOR), m_DPR));
+
+        qreal markerSize = metrics.height() / 2;
+
+        if (m_MarkerFreqA != MARKER_OFF) {
+            x = xFromFreq(m_MarkerFreqA);
+            m_MarkerAX = x;
+            QPolygon poly;
+            QPainterPath path;
+            poly << QPoint(x - markerSize/2, 0)
+                    << QPoint(x + markerSize/2, 0)
+                    << QPoint(x, markerSize);
+            path.addPolygon(poly);
+            painter.drawPolygon(poly);
+            painter.fillPath(path, brush);
+            painter.drawLine(x, markerSize, x, xAxisTop);
+            painter.drawStaticText(QPointF(x + markerSize/2, 0), QStaticText("A"));
+        }
+
+        if (m_MarkerFreqB != MARKER_OFF) {
+            x = xFromFreq(m_MarkerFreqB);
+            m_MarkerBX = x;
+            QPolygon poly;
+            QPainterPath path;
+            poly << QPoint(x - markerSize/2, 0)
+                    << QPoint(x + markerSize/2, 0)
+                    << QPoint(x, markerSize);
+            path.addPolygon(poly);
+            painter.drawPolygon(poly);
+            painter.fillPath(path, brush);
+            painter.drawLine(x, markerSize, x, xAxisTop);
+            painter.drawStaticText(QPointF(x + markerSize/2, 0), QStaticText("B"));
+        }
+    }
 
     // Draw demod filter box
     if (m_FilterBoxEnabled)
@@ -2229,12 +3352,6 @@ void CPlotter::drawOverlay()
         painter.setPen(QPen(QColor::fromRgba(PLOTTER_FILTER_LINE_COLOR), m_DPR));
         painter.drawLine(m_DemodFreqX, 0, m_DemodFreqX, h);
     }
-
-    // Draw a black line at the bottom of the plotter to separate it from the
-    // waterfall
-    painter.fillRect(QRectF(0.0, h - 1.0 * m_DPR, w, 1.0 * m_DPR), Qt::black);
-
-    painter.end();
 }
 
 // Create frequency division strings based on start frequency, span frequency,
@@ -2317,7 +3434,7 @@ qint64 CPlotter::freqFromX(int x)
 /** Calculate time offset of a given line on the waterfall */
 quint64 CPlotter::msecFromY(int y)
 {
-    int h = m_OverlayPixmap.height();
+    int h = m_OverlayImage.height();
 
     // ensure we are in the waterfall region
     if (y < h)
@@ -2325,6 +3442,10 @@ quint64 CPlotter::msecFromY(int y)
 
     qreal dy = (qreal)y - (qreal)h;
 
+    const size_t idx = (size_t)(m_wfScroll + (int)dy);
+    if (idx < m_wfHistory.size())
+        return m_wfHistory[idx].time_ms;
+
     if (msec_per_wfline > 0)
         return tlast_wf_drawn_ms - dy * msec_per_wfline;
     else
@@ -2366,7 +3487,7 @@ void CPlotter::setDemodRanges(int FLowCmin, int FLowCmax,
     m_FHiCmax=FHiCmax;
     m_symetric=symetric;
     clampDemodParameters();
-    updateOverlay();
+    updateOverlay(OVERLAY_MARKERS);
 }
 
 void CPlotter::setCenterFreq(quint64 f)
@@ -2379,30 +3500,35 @@ void CPlotter::setCenterFreq(quint64 f)
     m_CenterFreq = f;
     m_DemodCenterFreq = m_CenterFreq - offset;
 
-    m_MaxHoldValid = false;
-    m_MinHoldValid = false;
-    m_histIIRValid = false;
-    m_IIRValid = false;
+    m_renderResets |= RESET_MAXHOLD | RESET_MINHOLD | RESET_HIST | RESET_IIR;
 
     updateOverlay();
 }
 
-// Invalidate overlay. If not running, force a redraw.
-void CPlotter::updateOverlay()
+/**
+ * Invalidate overlay. If not running, force a redraw.
+ * @param layers The OVERLAY_* layers that have changed.
+ */
+void CPlotter::updateOverlay(int layers)
 {
-    m_DrawOverlay = true;
+    m_OverlayDirty |= layers;
     draw(false);
 }
 
+/** Bookmarks or DX spots have changed. */
+void CPlotter::updateTags()
+{
+    m_TagCacheValid = false;
+    updateOverlay(OVERLAY_TAGS);
+}
+
 /** Reset horizontal zoom to 100% and centered around 0. */
 void CPlotter::resetHorizontalZoom(void)
 {
     setFftCenterFreq(0);
     setSpanFreq((qint32)m_SampleFreq);
     emit newZoomLevel(1.0);
-    m_MaxHoldValid = false;
-    m_MinHoldValid = false;
-    m_histIIRValid = false;
+    m_renderResets |= RESET_MAXHOLD | RESET_MINHOLD | RESET_HIST;
     updateOverlay();
 }
 
@@ -2410,9 +3536,7 @@ void CPlotter::resetHorizontalZoom(void)
 void CPlotter::moveToCenterFreq()
 {
     setFftCenterFreq(0);
-    m_MaxHoldValid = false;
-    m_MinHoldValid = false;
-    m_histIIRValid = false;
+    m_renderResets |= RESET_MAXHOLD | RESET_MINHOLD | RESET_HIST;
     updateOverlay();
 }
 
@@ -2420,16 +3544,14 @@ void CPlotter::moveToCenterFreq()
 void CPlotter::moveToDemodFreq()
 {
     setFftCenterFreq(m_DemodCenterFreq-m_CenterFreq);
-    m_MaxHoldValid = false;
-    m_MinHoldValid = false;
-    m_histIIRValid = false;
+    m_renderResets |= RESET_MAXHOLD | RESET_MINHOLD | RESET_HIST;
     updateOverlay();
 }
 
 /** Set FFT plot color. */
 void CPlotter::setFftPlotColor(const QColor& color)
 {
-    m_PeakPixmap = QPixmap();
+    m_renderResets |= RESET_PEAKS;
     QColor bgColor = QColor::fromRgba(PLOTTER_BGD_COLOR);
     m_FftFillCol = blend(bgColor, color, 26);
     m_MainLineCol = color;
@@ -2449,14 +3571,14 @@ void CPlotter::enableFftFill(bool enabled)
 void CPlotter::enableMaxHold(bool enabled)
 {
     m_MaxHoldActive = enabled;
-    m_MaxHoldValid = false;
+    m_renderResets |= RESET_MAXHOLD;
 }
 
 /** Set min hold on or off. */
 void CPlotter::enableMinHold(bool enabled)
 {
     m_MinHoldActive = enabled;
-    m_MinHoldValid = false;
+    m_renderResets |= RESET_MINHOLD;
 }
 
 /**
@@ -2472,7 +3594,7 @@ void CPlotter::enablePeakDetect(bool enabled)
 void CPlotter::enableBandPlan(bool enabled)
 {
     m_BandPlanEnabled = enabled;
-    updateOverlay();
+    updateOverlay(OVERLAY_BANDPLAN);
 }
 
 void CPlotter::enableMarkers(bool enabled)
@@ -2489,14 +3611,22 @@ void CPlotter::setMarkers(qint64 a, qint64 b)
     m_MarkerFreqA = a;
     m_MarkerFreqB = b;
 
-    updateOverlay();
+    updateOverlay(OVERLAY_MARKERS);
 }
 
 void CPlotter::clearWaterfall()
 {
+    m_wfHistory.clear();
+    m_wfScroll = 0;
     if (!m_WaterfallImage.isNull()) {
         m_WaterfallImage.fill(Qt::black);
     }
+#ifdef WITH_OPENGL_WATERFALL
+    if (m_wfGL) {
+        m_wfGL->setTextureSize(m_WaterfallSize.width(), m_WaterfallSize.height());
+        m_WaterfallOffset = m_WaterfallSize.height();
+    }
+#endif
 }
 
 void CPlotter::calcDivSize (qint64 low, qint64 high, int divswanted, qint64 &adjlow, qint64 &step, int& divs)
@@ -2929,33 +4059,33 @@ void CPlotter::setWfColormap(const QString &cmap)
         {
             // level 0: black background
             if (i < 20)
-                m_ColorTbl[i].setRgb(0, 0, 0);
+                m_ColorTbl[i] = qRgb(0, 0, 0);
                 // level 1: black -> blue
             else if ((i >= 20) && (i < 70))
-                m_ColorTbl[i].setRgb(0, 0, 140*(i-20)/50);
+                m_ColorTbl[i] = qRgb(0, 0, 140*(i-20)/50);
                 // level 2: blue -> light-blue / greenish
             else if ((i >= 70) && (i < 100))
-                m_ColorTbl[i].setRgb(60*(i-70)/30, 125*(i-70)/30, 115*(i-70)/30 + 140);
+                m_ColorTbl[i] = qRgb(60*(i-70)/30, 125*(i-70)/30, 115*(i-70)/30 + 140);
                 // level 3: light blue -> yellow
             else if ((i >= 100) && (i < 150))
-                m_ColorTbl[i].setRgb(195*(i-100)/50 + 60, 130*(i-100)/50 + 125, 255-(255*(i-100)/50));
+                m_ColorTbl[i] = qRgb(195*(i-100)/50 + 60, 130*(i-100)/50 + 125, 255-(255*(i-100)/50));
                 // level 4: yellow -> red
             else if ((i >= 150) && (i < 250))
-                m_ColorTbl[i].setRgb(255, 255-255*(i-150)/100, 0);
+                m_ColorTbl[i] = qRgb(255, 255-255*(i-150)/100, 0);
                 // level 5: red -> white
             else if (i >= 250)
-                m_ColorTbl[i].setRgb(255, 255*(i-250)/5, 255*(i-250)/5);
+                m_ColorTbl[i] = qRgb(255, 255*(i-250)/5, 255*(i-250)/5);
         }
     }
     else if (cmap.compare("turbo", Qt::CaseInsensitive) == 0)
     {
         for (i = 0; i < 256; i++)
-            m_ColorTbl[i].setRgb(turbo[i][0], turbo[i][1], turbo[i][2]);
+            m_ColorTbl[i] = qRgb(turbo[i][0], turbo[i][1], turbo[i][2]);
     }
     else if (cmap.compare("plasma",Qt::CaseInsensitive) == 0)
     {
         for (i = 0; i < 256; i++)
-            m_ColorTbl[i].setRgb(plasma[i][0], plasma[i][1], plasma[i][2]);
+            m_ColorTbl[i] = qRgb(plasma[i][0], plasma[i][1], plasma[i][2]);
     }
     else if (cmap.compare("whitehotcompressed",Qt::CaseInsensitive) == 0)
     {
@@ -2966,27 +4096,30 @@ void CPlotter::setWfColormap(const QString &cmap)
         {
             if (i < 64)
             {
-                m_ColorTbl[i].setRgb(i*4, i*4, i*4);
+                m_ColorTbl[i] = qRgb(i*4, i*4, i*4);
             }
             else
             {
-                m_ColorTbl[i].setRgb(255, 255, 255);
+                m_ColorTbl[i] = qRgb(255, 255, 255);
             }
         }
     }
     else if (cmap.compare("whitehot",Qt::CaseInsensitive) == 0)
     {
         for (i = 0; i < 256; i++)
-            m_ColorTbl[i].setRgb(i, i, i);
+            m_ColorTbl[i] = qRgb(i, i, i);
     }
     else if (cmap.compare("blackhot",Qt::CaseInsensitive) == 0)
     {
         for (i = 0; i < 256; i++)
-            m_ColorTbl[i].setRgb(255-i, 255-i, 255-i);
+            m_ColorTbl[i] = qRgb(255-i, 255-i, 255-i);
     }
     else if (cmap.compare("viridis",Qt::CaseInsensitive) == 0)
     {
         for (i = 0; i < 256; i++)
-            m_ColorTbl[i].setRgb(viridis[i][0] * 256, viridis[i][1] * 256, viridis[i][2] * 256);
+            m_ColorTbl[i] = qRgb(viridis[i][0] * 256, viridis[i][1] * 256, viridis[i][2] * 256);
     }
+
+    m_wfLutValid = false;
+    update();
 }
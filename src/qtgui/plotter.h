@@ -6,8 +6,16 @@
 #include <QFont>
 #include <QFrame>
 #include <QImage>
+#include <QVector>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include <vector>
+#include <QHash>
 #include <QMap>
+#include <QStaticText>
+#include "bookmarks.h"
 
 #define HORZ_DIVS_MAX 12    //50
 #define VERT_DIVS_MIN 5
@@ -19,9 +27,15 @@
 #define PEAK_WINDOW_HALF_WIDTH    10
 #define PEAK_UPDATE_PERIOD       100 // msec
 #define PLOTTER_UPDATE_LIMIT_MS   16 // 16ms = 62.5 Hz
+#define TAG_LABEL_CACHE_MAX     8192 // cached bookmark and DX spot labels
 
 #define MARKER_OFF std::numeric_limits<qint64>::min()
 
+#ifdef WITH_OPENGL_WATERFALL
+class CWaterfallGL;
+#endif
+class CWaterfallRecorder;
+
 class CPlotter : public QFrame
 {
     Q_OBJECT
@@ -41,11 +55,15 @@ public:
     void setFilterBoxEnabled(bool enabled) { m_FilterBoxEnabled = enabled; }
     void setCenterLineEnabled(bool enabled) { m_CenterLineEnabled = enabled; }
     void setTooltipsEnabled(bool enabled) { m_TooltipsEnabled = enabled; }
-    void setBookmarksEnabled(bool enabled) { m_BookmarksEnabled = enabled; }
+    void setBookmarksEnabled(bool enabled) { m_BookmarksEnabled = enabled; m_TagCacheValid = false; }
     void setInvertScrolling(bool enabled) { m_InvertScrolling = enabled; }
-    void setDXCSpotsEnabled(bool enabled) { m_DXCSpotsEnabled = enabled; }
+    void setDXCSpotsEnabled(bool enabled) { m_DXCSpotsEnabled = enabled; m_TagCacheValid = false; }
 
     void setNewFftData(const float *fftData, int size);
+    bool getReducedFftGeometry(int fftSize, double *startBin,
+                               double *binsPerPoint, int *npts);
+    void setNewReducedFftData(const float *maxData, const float *avgData,
+                              int npts, int fftSize);
 
     void setCenterFreq(quint64 f);
     void setFreqUnits(qint32 unit) { m_FreqUnits = unit; }
@@ -56,7 +74,7 @@ public:
     void setFilterOffset(qint64 freq_hz)
     {
         m_DemodCenterFreq = m_CenterFreq + freq_hz;
-        updateOverlay();
+        updateOverlay(OVERLAY_MARKERS);
     }
     qint64 getFilterOffset() const
     {
@@ -72,7 +90,7 @@ public:
     {
         m_DemodLowCutFreq = LowCut;
         m_DemodHiCutFreq = HiCut;
-        updateOverlay();
+        updateOverlay(OVERLAY_MARKERS);
     }
 
     void getHiLowCutFrequencies(int *LowCut, int *HiCut) const
@@ -123,9 +141,15 @@ public:
 
     int     getNearestPeak(QPoint pt);
     void    setWaterfallSpan(quint64 span_ms);
+    bool    hasWaterfall() const { return !m_WaterfallSize.isEmpty(); }
     quint64 getWfTimeRes() const;
     void    setFftRate(int rate_hz);
+    /*! \brief Average time in ms the render thread spends on a frame. */
+    float   getRenderCost() const { return m_renderCost; }
+    /*! \brief Average time in ms the GUI thread spends showing a frame. */
+    float   getPaintCost() const { return m_paintCost; }
     void    clearWaterfallBuf();
+    void    setWaterfallRecorder(CWaterfallRecorder *recorder);
 
     enum ePlotMode {
         PLOT_MODE_MAX = 0,
@@ -146,6 +170,15 @@ public:
         WATERFALL_MODE_SYNC = 2
     };
 
+    /*! \brief Overlay layers, invalidated independently. */
+    enum eOverlayLayer {
+        OVERLAY_GRID = 0x01,        /*!< Grid, axes and center line. */
+        OVERLAY_BANDPLAN = 0x02,
+        OVERLAY_TAGS = 0x04,        /*!< Bookmarks and DX spots. */
+        OVERLAY_MARKERS = 0x08,     /*!< Markers and filter box. */
+        OVERLAY_ALL = 0x0f
+    };
+
 signals:
     void newDemodFreq(qint64 freq, qint64 delta); /* delta is the offset from the center */
     void newLowCutFreq(int f);
@@ -182,7 +215,8 @@ public slots:
     void enableMarkers(bool enabled);
     void setMarkers(qint64 a, qint64 b);
     void clearWaterfall();
-    void updateOverlay();
+    void updateOverlay(int layers = OVERLAY_ALL);
+    void updateTags();
 
     void setPercent2DScreen(int percent)
     {
@@ -191,6 +225,12 @@ public slots:
         resizeEvent(nullptr);
     }
 
+private slots:
+    void renderDone();
+#ifdef WITH_OPENGL_WATERFALL
+    void openGLWaterfallFailed();
+#endif
+
 protected:
     //re-implemented widget event handlers
     void paintEvent(QPaintEvent *event) override;
@@ -201,6 +241,79 @@ protected:
     void wheelEvent( QWheelEvent * event ) override;
 
 private:
+    /* Invalidations requested by the GUI thread, applied by the render thread */
+    enum {
+        RESET_MAXHOLD = 0x01,
+        RESET_MINHOLD = 0x02,
+        RESET_IIR     = 0x04,
+        RESET_HIST    = 0x08,
+        RESET_HISTMAX = 0x10,
+        RESET_WFBUF   = 0x20,
+        RESET_PEAKS   = 0x40
+    };
+
+    /*! \brief One waterfall line before color mapping.
+     *
+     * Levels are kept at 1/256 dB resolution so that the line can be colored
+     * again for a new range, colormap or zoom.
+     */
+    struct WaterfallLine {
+        std::vector<quint16> data;      /*!< Level per pixel, 0 for no data. */
+        double      startHz{};          /*!< Frequency of the first pixel. */
+        double      hzPerPx{};          /*!< Frequency step per pixel. */
+        quint64     time_ms{};          /*!< Time of the line. */
+    };
+
+    /*! \brief Data and settings for one frame rendered on the render thread. */
+    struct RenderJob {
+        bool        newData{};
+        bool        reduced{};          /*!< Data is reduced to screen resolution. */
+        std::vector<float> fftData;     /*!< Scaled full resolution spectrum. */
+        std::vector<float> reducedMax;  /*!< Scaled reduced spectrum. */
+        std::vector<float> reducedAvg;
+        int         fftSize{};
+        int         reducedXmin{};
+        int         reducedNpts{};
+        float       iirCoeff{};
+        int         resets{};           /*!< RESET_* flags. */
+
+        bool        plotVisible{};
+        bool        drawPlot{};
+        bool        updatePeaks{};
+        bool        doWaterfall{};      /*!< Accumulate waterfall data. */
+        bool        wfLine{};           /*!< Output a new waterfall line. */
+        bool        useWfBuf{};
+        int         wfWidth{};
+        quint64     wfTime{};           /*!< Time of the waterfall line in ms. */
+        double      wfStartHz{};        /*!< Frequency of the first waterfall pixel. */
+        double      wfHzPerPx{};
+
+        qreal       w{};
+        qreal       plotHeight{};
+        qreal       dpr{};
+        qreal       shadowOffset{};
+        double      sampleFreq{};
+        double      fftCenter{};
+        double      span{};
+        float       pandMindB{};
+        float       pandMaxdB{};
+        float       alpha{};
+        int         fftRate{};
+        ePlotMode   plotMode{};
+        eWaterfallMode wfMode{};
+        bool        fftFill{};
+        bool        maxHold{};
+        bool        minHold{};
+        bool        peakDetect{};
+        bool        fillMarkers{};
+        int         markerAX{};
+        int         markerBX{};
+        QVector<QRgb> colorTbl;
+        QColor      fftFillCol, filledModeFillCol, filledModeMaxLineCol,
+                    filledModeAvgLineCol, mainLineCol, holdLineCol;
+        QImage      overlay;
+    };
+
     enum eCapturetype {
         NOCAP,
         LEFT,
@@ -213,7 +326,20 @@ private:
         MARKER_B
     };
 
+    /*! \brief Cached layout of a bookmark or DX spot label. */
+    struct TagLabel {
+        QStaticText text;
+        qreal       width{};
+    };
+
     void        drawOverlay();
+    void        prepareOverlayLayer(QImage &layer);
+    void        drawTagsLayer();
+    void        drawBandPlanLayer();
+    void        drawGridLayer();
+    void        drawMarkers(QPainter &painter);
+    const TagLabel &tagLabel(const QString &name, const QFontMetricsF &fm);
+    const QList<BookmarkInfo> &visibleTags();
     void        makeFrequencyStrs();
     int         xFromFreq(qint64 freq);
     qint64      freqFromX(int x);
@@ -235,50 +361,143 @@ private:
     }
 
     static void calcDivSize (qint64 low, qint64 high, int divswanted, qint64 &adjlow, qint64 &step, int& divs);
+    void        setFftDataSize(int size);
+    float       powerScale(int size) const;
+    float       iirCoefficient() const;
     void        showToolTip(QMouseEvent* event, QString toolTipText);
 
+    void        postRenderJob(RenderJob &job);
+    void        recycleRenderBuffers(RenderJob &job);
+    void        reuseRenderBuffer(std::vector<float> &buf, std::vector<float> &spare);
+    void        renderThread();
+    void        renderFrame(RenderJob &job, QImage &plot, WaterfallLine &wfLine);
+    void        clearWaterfallAccumulator();
+    void        resizeHistogram(int cols, int bins);
+    void        addWaterfallLine(WaterfallLine &line);
+    void        colorWaterfallLine(const WaterfallLine &line, int row);
+    void        clearWaterfallRow(int row);
+    const quint16 *resampleWaterfallLine(const WaterfallLine &line);
+    void        renderWaterfall();
+    void        updateWaterfallLut();
+
     bool        m_MaxHoldActive;
-    bool        m_MaxHoldValid;
     bool        m_MinHoldActive;
-    bool        m_MinHoldValid;
     bool        m_PeakDetectActive;
+
+    // Render thread. The members from m_MaxHoldValid to m_reducedAvgIIR are
+    // owned by the render thread once it has started. The GUI thread requests
+    // changes using m_renderResets.
+    std::thread             m_renderThread;
+    std::mutex              m_renderMutex;      // job and results
+    std::mutex              m_renderStateMutex; // held while rendering
+    std::condition_variable m_renderCond;
+    bool        m_renderStop;
+    bool        m_renderJobPending;
+    RenderJob   m_renderJob;
+    bool        m_renderResultPending;
+    QImage      m_renderedPlot;
+    std::vector<WaterfallLine> m_renderedWfLines;
+    QMap<int,qreal> m_renderedPeaks;
+    bool        m_renderedPeaksValid;
+    std::vector<float> m_spareFftData;
+    std::vector<float> m_spareReducedMax;
+    std::vector<float> m_spareReducedAvg;
+    int         m_renderResets;     // RESET_* flags for the next job
+    float       m_renderedCost;     // average render time, ms
+    float       m_renderCost;       // copy of m_renderedCost for the GUI thread
+    float       m_renderDoneCost;   // renderDone() time since the last paint, ms
+    float       m_paintCost;        // average renderDone() plus paint time, ms
+
+    bool        m_MaxHoldValid;
+    bool        m_MinHoldValid;
     bool        m_IIRValid;
     bool        m_histIIRValid;
-    float       m_fftMaxBuf[MAX_SCREENSIZE]{};
+    float       m_fftMaxBuf[MAX_SCREENSIZE]{};     // plot data, dB
     float       m_fftAvgBuf[MAX_SCREENSIZE]{};
     float       m_wfMaxBuf[MAX_SCREENSIZE]{};
     float       m_wfAvgBuf[MAX_SCREENSIZE]{};
-    float       m_histogram[MAX_SCREENSIZE][MAX_HISTOGRAM_SIZE]{};
-    float       m_histIIR[MAX_SCREENSIZE][MAX_HISTOGRAM_SIZE]{};
+    std::vector<float> m_histogram;    // histogram mode only, m_histCols x m_histBins
+    std::vector<float> m_histIIR;
+    std::vector<float> m_histTop;      // y of top bin per column
+    int         m_histCols{};
+    int         m_histBins{};
     QPointF     m_avgLineBuf[MAX_SCREENSIZE]{};
     QPointF     m_maxLineBuf[MAX_SCREENSIZE]{};
     QPointF     m_holdLineBuf[MAX_SCREENSIZE]{};
     float       m_histMaxIIR;
-    std::vector<float> m_fftIIR;
-    std::vector<float> m_fftData;
+    std::vector<float> m_fftIIR;           // dB
+    std::vector<float> m_renderFftData;    // full resolution data being rendered
+    std::vector<float> m_renderFftDb;      // m_renderFftData in dB
     std::vector<float> m_X;                // scratch array of matching size for local calculation
     float      m_wfbuf[MAX_SCREENSIZE]{}; // used for accumulating waterfall data at high time spans
-    float       m_fftMaxHoldBuf[MAX_SCREENSIZE]{};
+    quint64     wf_avg_count;       // number of frames averaged into wf buf
+    float       m_fftMaxHoldBuf[MAX_SCREENSIZE]{}; // dB
     float       m_fftMinHoldBuf[MAX_SCREENSIZE]{};
     float       m_peakSmoothBuf[MAX_SCREENSIZE]{}; // used in peak detection
-    float      *m_wfData{};
+    float       m_yMaxBuf[MAX_SCREENSIZE]{};   // plot y coordinates
+    float       m_yAvgBuf[MAX_SCREENSIZE]{};
+    float       m_yHoldBuf[MAX_SCREENSIZE]{};
+    float       m_wfLineBuf[MAX_SCREENSIZE]{}; // waterfall line scratch
+    QMap<int,qreal> m_renderPeaks;
+    QImage      m_PeakImage;
+    std::vector<float> m_renderReducedMax;
+    std::vector<float> m_renderReducedAvg;
+    std::vector<float> m_reducedMaxIIR;    // per pixel, dB, also when averaging full frames
+    std::vector<float> m_reducedAvgIIR;
+
+    std::vector<float> m_fftData;          // new data for the next job
     int         m_fftDataSize{};
 
+    // Spectrum reduced to screen resolution by the DSP (max/avg per pixel)
+    bool        m_fftReduced{};          // last frame was pre-reduced
+    int         m_reducedXmin{};         // first pixel of current reduced frame
+    int         m_reducedNpts{};         // number of points in current reduced frame
+    double      m_reducedStartBin{};     // bin geometry of current reduced frame
+    double      m_reducedBinsPerPoint{};
+    int         m_reducedReqXmin{};      // geometry handed out by getReducedFftGeometry()
+    int         m_reducedReqNpts{};
+    double      m_reducedReqStartBin{};
+    double      m_reducedReqBinsPerPoint{};
+    std::vector<float> m_reducedMax;
+    std::vector<float> m_reducedAvg;
+
     qreal       m_XAxisYCenter{};
     qreal       m_YAxisWidth{};
 
     eCapturetype    m_CursorCaptured;
-    QPixmap     m_2DPixmap;         // Composite of everything displayed in the 2D plotter area
-    QPixmap     m_OverlayPixmap;    // Grid, axes ... things that need to be drawn infrequently
-    QPixmap     m_PeakPixmap;
+    QImage      m_2DImage;          // Composite of everything displayed in the 2D plotter area
+    QImage      m_OverlayImage;     // Grid, axes ... things that need to be drawn infrequently
     QImage      m_WaterfallImage;
     int         m_WaterfallOffset;
-    QColor      m_ColorTbl[256];
+    std::deque<WaterfallLine> m_wfHistory;  // raw waterfall lines, newest first
+    int         m_wfScroll{};       // lines scrolled back into history
+    bool        m_wfRerender{};     // color the waterfall again from history
+    double      m_wfViewStartHz{};  // frequency range the waterfall is colored for
+    double      m_wfViewHzPerPx{};
+    QVector<QRgb> m_wfLut;          // raw level to color
+    bool        m_wfLutValid{};
+    std::vector<quint16> m_wfRowBuf; // resampled waterfall line
+    QSize       m_WaterfallSize;    // waterfall size in pixels, empty if none
+#ifdef WITH_OPENGL_WATERFALL
+    CWaterfallGL *m_wfGL{};         // draws the waterfall when not null
+    bool        m_wfGLFailed{};
+#endif
+    CWaterfallRecorder *m_wfRecorder{}; // gets new waterfall lines when not null
+    QVector<QRgb> m_ColorTbl = QVector<QRgb>(256);
     QSize       m_Size;
     qreal       m_DPR{};
     QString     m_HDivText[HORZ_DIVS_MAX+1];
     bool        m_Running;
-    bool        m_DrawOverlay;
+    int         m_OverlayDirty;     // OVERLAY_* layers to draw again
+    QImage      m_GridLayer;
+    QImage      m_BandPlanLayer;    // null when the band plan is off
+    QImage      m_TagsLayer;        // null when bookmarks and DX spots are off
+    QHash<QString, TagLabel> m_TagLabelCache;
+    QList<BookmarkInfo> m_TagCache; // bookmarks and DX spots around the view
+    bool        m_TagCacheValid{};
+    qint64      m_TagCacheLow{};
+    qint64      m_TagCacheHigh{};
+    qint64      m_TagCacheSpan{};
     qint64      m_CenterFreq;       // The HW frequency
     qint64      m_FftCenter;        // Center freq in the -span ... +span range
     qint64      m_DemodCenterFreq;
@@ -355,8 +574,7 @@ private:
     quint64     wf_valid_since_ms;  // last time before action that invalidates time line
     double      msec_per_wfline{};  // milliseconds between waterfall updates
     quint64     wf_epoch;           // msec time of last waterfal rate change
-    quint64     wf_count;           // waterfall lines drawn since last rate change
-    quint64     wf_avg_count;       // number of frames averaged into wf buf
+    quint64     wf_count;           // waterfall line periods used since last rate change
     quint64     tlast_peaks_ms;     // last time peaks were updated
     quint64     wf_span;            // waterfall span in milliseconds (0 = auto)
     int         fft_rate;           // expected FFT rate (needed when WF span is auto)
@@ -0,0 +1,327 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <QDebug>
+#include <QtEndian>
+#include "waterfall_gl.h"
+
+// Full screen quad as a triangle strip
+static const GLfloat quadVertices[] = {
+    -1.0f, -1.0f,
+     1.0f, -1.0f,
+    -1.0f,  1.0f,
+     1.0f,  1.0f
+};
+
+static const char *vertexShaderSrc =
+    "attribute vec2 a_pos;\n"
+    "varying vec2 v_tex;\n"
+    "void main()\n"
+    "{\n"
+    "    v_tex = vec2((a_pos.x + 1.0) * 0.5, (1.0 - a_pos.y) * 0.5);\n"
+    "    gl_Position = vec4(a_pos, 0.0, 1.0);\n"
+    "}\n";
+
+// Levels are stored as two bytes in a luminance/alpha texture, since 16 bit
+// textures are not available in OpenGL ES 2.0. Level 0 means no data.
+static const char *fragmentShaderSrc =
+    "#ifdef GL_ES\n"
+    "precision highp float;\n"
+    "#endif\n"
+    "uniform sampler2D u_data;\n"
+    "uniform sampler2D u_lut;\n"
+    "uniform float u_offset;\n"
+    "uniform float u_rawMax;\n"
+    "uniform float u_gain;\n"
+    "varying vec2 v_tex;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 t = texture2D(u_data, vec2(v_tex.x, fract(v_tex.y + u_offset)));\n"
+    "    float q = floor(t.r * 255.0 + 0.5) + 256.0 * floor(t.a * 255.0 + 0.5);\n"
+    "    if (q < 0.5)\n"
+    "    {\n"
+    "        gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);\n"
+    "        return;\n"
+    "    }\n"
+    "    float v = clamp(u_gain * (u_rawMax - q), 0.0, 255.0);\n"
+    "    float idx = 255.0 - floor(v + 0.5);\n"
+    "    gl_FragColor = vec4(texture2D(u_lut, vec2((idx + 0.5) / 256.0, 0.5)).rgb, 1.0);\n"
+    "}\n";
+
+CWaterfallGL::CWaterfallGL(QWidget *parent)
+    : QOpenGLWidget(parent),
+      m_program(nullptr),
+      m_dataTexture(0),
+      m_lutTexture(0),
+      m_texWidth(0),
+      m_texHeight(0),
+      m_failed(false),
+      m_width(0),
+      m_height(0),
+      m_offset(0),
+      m_allDirty(true),
+      m_lut(256 * 4, 0),
+      m_lutDirty(true),
+      m_rawMax(0.0f),
+      m_gain(1.0f)
+{
+    // Mouse events belong to the plotter underneath
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+}
+
+CWaterfallGL::~CWaterfallGL()
+{
+    makeCurrent();
+    releaseTextures();
+    delete m_program;
+    doneCurrent();
+}
+
+/**
+ * Set the size of the waterfall in pixels.
+ * @param width Number of columns.
+ * @param height Number of rows.
+ *
+ * All rows are cleared.
+ */
+void CWaterfallGL::setTextureSize(int width, int height)
+{
+    m_width = std::max(width, 0);
+    m_height = std::max(height, 0);
+    m_rows.assign((size_t)m_width * m_height, 0);
+    m_dirtyRows.assign(m_height, false);
+    m_allDirty = true;
+    m_offset = m_height;
+    update();
+}
+
+/**
+ * Set one row of the waterfall.
+ * @param row The row in the ring buffer.
+ * @param data Raw levels, one per column.
+ */
+void CWaterfallGL::setRow(int row, const quint16 *data)
+{
+    if (row < 0 || row >= m_height)
+        return;
+
+    quint16 *out = m_rows.data() + (size_t)row * m_width;
+    for (int x = 0; x < m_width; ++x)
+        out[x] = qToLittleEndian(data[x]);
+    m_dirtyRows[row] = true;
+}
+
+void CWaterfallGL::clearRow(int row)
+{
+    if (row < 0 || row >= m_height)
+        return;
+
+    std::fill_n(m_rows.begin() + (size_t)row * m_width, m_width, 0);
+    m_dirtyRows[row] = true;
+}
+
+/**
+ * Set the ring buffer row shown at the top.
+ * @param offset Row offset, same meaning as in CPlotter.
+ */
+void CWaterfallGL::setOffset(int offset)
+{
+    m_offset = offset;
+    update();
+}
+
+void CWaterfallGL::setColorTable(const QVector<QRgb> &colors)
+{
+    const int n = std::min((int)colors.size(), 256);
+    for (int i = 0; i < n; ++i)
+    {
+        m_lut[4 * i + 0] = qRed(colors[i]);
+        m_lut[4 * i + 1] = qGreen(colors[i]);
+        m_lut[4 * i + 2] = qBlue(colors[i]);
+        m_lut[4 * i + 3] = 255;
+    }
+    m_lutDirty = true;
+    update();
+}
+
+/**
+ * Set the mapping from raw levels to colormap index.
+ * @param rawMax Raw level shown with the last color.
+ * @param gain Colormap steps per raw level.
+ */
+void CWaterfallGL::setLevels(float rawMax, float gain)
+{
+    m_rawMax = rawMax;
+    m_gain = gain;
+    update();
+}
+
+void CWaterfallGL::initializeGL()
+{
+    initializeOpenGLFunctions();
+
+    delete m_program;
+    m_program = new QOpenGLShaderProgram(this);
+    if (!m_program->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexShaderSrc) ||
+        !m_program->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShaderSrc))
+    {
+        fail(m_program->log());
+        return;
+    }
+    m_program->bindAttributeLocation("a_pos", 0);
+    if (!m_program->link())
+    {
+        fail(m_program->log());
+        return;
+    }
+
+    glGenTextures(1, &m_lutTexture);
+    glBindTexture(GL_TEXTURE_2D, m_lutTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    m_lutDirty = true;
+
+    // Textures were lost with the old context, if any
+    m_dataTexture = 0;
+    m_texWidth = 0;
+    m_texHeight = 0;
+    m_allDirty = true;
+}
+
+void CWaterfallGL::paintGL()
+{
+    if (m_failed)
+        return;
+
+    if (m_width <= 0 || m_height <= 0)
+    {
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        return;
+    }
+
+    // Rows are 2 bytes per column, which need not be a multiple of 4
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+
+    if (m_width != m_texWidth || m_height != m_texHeight)
+    {
+        GLint maxSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+        if (m_width > maxSize || m_height > maxSize)
+        {
+            fail(QString("waterfall size %1x%2 exceeds maximum texture size %3")
+                 .arg(m_width).arg(m_height).arg(maxSize));
+            return;
+        }
+
+        if (m_dataTexture == 0)
+        {
+            glGenTextures(1, &m_dataTexture);
+            glBindTexture(GL_TEXTURE_2D, m_dataTexture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        m_texWidth = m_width;
+        m_texHeight = m_height;
+        m_allDirty = true;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, m_dataTexture);
+    if (m_allDirty)
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE_ALPHA, m_texWidth, m_texHeight, 0,
+                     GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, m_rows.data());
+        std::fill(m_dirtyRows.begin(), m_dirtyRows.end(), false);
+        m_allDirty = false;
+    }
+    else
+    {
+        // Upload runs of new rows, normally just one or two per frame
+        int row = 0;
+        while (row < m_height)
+        {
+            if (!m_dirtyRows[row])
+            {
+                row++;
+                continue;
+            }
+            int end = row;
+            while (end < m_height && m_dirtyRows[end])
+                m_dirtyRows[end++] = false;
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, m_texWidth, end - row,
+                            GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE,
+                            m_rows.data() + (size_t)row * m_width);
+            row = end;
+        }
+    }
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, m_lutTexture);
+    if (m_lutDirty)
+    {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 256, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, m_lut.data());
+        m_lutDirty = false;
+    }
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_dataTexture);
+
+    m_program->bind();
+    m_program->setUniformValue("u_data", 0);
+    m_program->setUniformValue("u_lut", 1);
+    m_program->setUniformValue("u_offset", (GLfloat)(m_offset % m_height) / (GLfloat)m_height);
+    m_program->setUniformValue("u_rawMax", m_rawMax);
+    m_program->setUniformValue("u_gain", m_gain);
+
+    m_program->enableAttributeArray(0);
+    m_program->setAttributeArray(0, GL_FLOAT, quadVertices, 2);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    m_program->disableAttributeArray(0);
+    m_program->release();
+}
+
+void CWaterfallGL::fail(const QString &reason)
+{
+    qWarning() << "OpenGL waterfall disabled:" << reason;
+    m_failed = true;
+    releaseTextures();
+    emit failed();
+}
+
+// Must be called with the context current
+void CWaterfallGL::releaseTextures()
+{
+    if (!context())
+        return;
+
+    if (m_dataTexture)
+        glDeleteTextures(1, &m_dataTexture);
+    if (m_lutTexture)
+        glDeleteTextures(1, &m_lutTexture);
+    m_dataTexture = 0;
+    m_lutTexture = 0;
+    m_texWidth = 0;
+    m_texHeight = 0;
+}
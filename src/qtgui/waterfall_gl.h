@@ -0,0 +1,90 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef WATERFALL_GL_H
+#define WATERFALL_GL_H
+
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLWidget>
+#include <QVector>
+#include <QtGui>
+#include <vector>
+
+/*! \brief OpenGL renderer for the plotter waterfall.
+ *
+ * The waterfall is kept in a texture of raw 16 bit levels, used as a ring
+ * buffer. Only new rows are uploaded, scrolling is a texture offset and
+ * levels are mapped to colors in the fragment shader, so changing the range
+ * or colormap does not touch the texture.
+ *
+ * Only OpenGL 2.0 / OpenGL ES 2.0 features are used, which keeps it working
+ * with software renderers such as llvmpipe.
+ */
+class CWaterfallGL : public QOpenGLWidget, protected QOpenGLFunctions
+{
+    Q_OBJECT
+
+public:
+    explicit CWaterfallGL(QWidget *parent = nullptr);
+    ~CWaterfallGL() override;
+
+    void setTextureSize(int width, int height);
+    void setRow(int row, const quint16 *data);
+    void clearRow(int row);
+    void setOffset(int offset);
+    void setColorTable(const QVector<QRgb> &colors);
+    void setLevels(float rawMax, float gain);
+
+    bool isFailed() const { return m_failed; }
+
+signals:
+    /*! \brief OpenGL could not be initialized, the waterfall must be drawn otherwise. */
+    void failed();
+
+protected:
+    void initializeGL() override;
+    void paintGL() override;
+
+private:
+    void fail(const QString &reason);
+    void releaseTextures();
+
+    QOpenGLShaderProgram *m_program;
+    GLuint      m_dataTexture;
+    GLuint      m_lutTexture;
+    int         m_texWidth;         // size of the allocated texture
+    int         m_texHeight;
+    bool        m_failed;
+
+    // Staging area, uploaded in paintGL() when the context is current
+    int         m_width;
+    int         m_height;
+    int         m_offset;
+    std::vector<quint16> m_rows;    // little endian levels, m_height x m_width
+    std::vector<bool> m_dirtyRows;
+    bool        m_allDirty;
+    std::vector<quint8> m_lut;      // RGBA, 256 entries
+    bool        m_lutDirty;
+    float       m_rawMax;
+    float       m_gain;
+};
+
+#endif // WATERFALL_GL_H
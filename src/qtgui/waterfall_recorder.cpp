@@ -0,0 +1,336 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QStringList>
+#include "waterfall_recorder.h"
+
+/* Lines waiting to be written before new lines are dropped */
+#define MAX_QUEUED_LINES    4096
+
+CWaterfallRecorder::CWaterfallRecorder()
+    : m_running(false),
+      m_colors(false),
+      m_stop(false),
+      m_dropping(false),
+      m_scale(std::make_shared<Scale>(Scale{-200.0f, 256.0f, QVector<QRgb>(256, qRgb(0, 0, 0)),
+                                            -120.0f, -20.0f})),
+      m_tileLines(0),
+      m_tileCount(0),
+      m_tileStartHz(0.0),
+      m_tileHzPerPx(0.0)
+{
+}
+
+CWaterfallRecorder::~CWaterfallRecorder()
+{
+    stop();
+}
+
+/**
+ * Start recording.
+ * @param dir Directory in which a new directory for the tiles is created.
+ * @param colors Write colored tiles instead of raw levels.
+ * @returns True if the recording could be started.
+ *
+ * A recording in progress is stopped first.
+ */
+bool CWaterfallRecorder::start(const QString &dir, bool colors)
+{
+    stop();
+
+    QDir base(dir);
+    const QString name = QDateTime::currentDateTimeUtc().toString("'gqrx_wf_'yyyyMMdd_HHmmss");
+    if (!base.mkpath(name))
+    {
+        qWarning() << "Can not create waterfall recording directory in" << dir;
+        return false;
+    }
+    m_path = base.filePath(name);
+
+    m_index.setFileName(QDir(m_path).filePath("index.csv"));
+    if (!m_index.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        qWarning() << "Can not create" << m_index.fileName() << m_index.errorString();
+        return false;
+    }
+    m_index.write("file,first_ms,last_ms,lines,width,start_hz,hz_per_px\n");
+    m_index.flush();
+
+    m_colors = colors;
+    m_tileLines = 0;
+    m_tileCount = 0;
+    m_queue.clear();
+    m_stop = false;
+    m_dropping = false;
+    m_lutScale.reset();
+    m_running = true;
+    m_thread = std::thread(&CWaterfallRecorder::writerThread, this);
+
+    qDebug() << "Recording waterfall to" << m_path;
+    return true;
+}
+
+/** Stop recording after writing all queued lines. */
+void CWaterfallRecorder::stop()
+{
+    if (!m_running)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_one();
+    m_thread.join();
+
+    m_index.close();
+    m_running = false;
+}
+
+/**
+ * Set the meaning of raw levels.
+ * @param minDb Level in dB of raw value 0.
+ * @param stepsPerDb Raw steps per dB.
+ */
+void CWaterfallRecorder::setRawScale(float minDb, float stepsPerDb)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (minDb == m_scale->rawMinDb && stepsPerDb == m_scale->rawStepsPerDb)
+        return;
+
+    auto scale = std::make_shared<Scale>(*m_scale);
+    scale->rawMinDb = minDb;
+    scale->rawStepsPerDb = stepsPerDb;
+    m_scale = scale;
+}
+
+/**
+ * Set the colors used for colored tiles.
+ * @param colorTbl The waterfall color map, 256 entries.
+ * @param mindB Level shown with the first color.
+ * @param maxdB Level shown with the last color.
+ */
+void CWaterfallRecorder::setColors(const QVector<QRgb> &colorTbl, float mindB, float maxdB)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (colorTbl == m_scale->colorTbl && mindB == m_scale->mindB && maxdB == m_scale->maxdB)
+        return;
+
+    auto scale = std::make_shared<Scale>(*m_scale);
+    scale->colorTbl = colorTbl;
+    scale->mindB = mindB;
+    scale->maxdB = maxdB;
+    m_scale = scale;
+}
+
+/**
+ * Queue a waterfall line for writing.
+ * @param data Raw level per pixel, 0 for no data.
+ * @param startHz Frequency of the first pixel.
+ * @param hzPerPx Frequency step per pixel.
+ * @param time_ms Time of the line.
+ */
+void CWaterfallRecorder::addLine(const std::vector<quint16> &data, double startHz,
+                                 double hzPerPx, quint64 time_ms)
+{
+    if (!m_running || data.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_queue.size() >= MAX_QUEUED_LINES)
+        {
+            if (!m_dropping)
+                qWarning() << "Waterfall recorder can not keep up, dropping lines";
+            m_dropping = true;
+            return;
+        }
+        m_dropping = false;
+        m_queue.push_back(Line{data, startHz, hzPerPx, time_ms, m_scale});
+    }
+    m_cond.notify_one();
+}
+
+void CWaterfallRecorder::writerThread()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true)
+    {
+        m_cond.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+
+        // Stop only when everything has been written
+        if (m_queue.empty())
+            break;
+
+        Line line = std::move(m_queue.front());
+        m_queue.pop_front();
+
+        lock.unlock();
+        appendLine(line);
+        lock.lock();
+    }
+
+    lock.unlock();
+    writeTile();
+}
+
+// Called on the writer thread
+void CWaterfallRecorder::appendLine(const Line &line)
+{
+    const int width = (int)line.data.size();
+
+    if (m_tileLines > 0
+        && (width != m_tile.width()
+            || line.startHz != m_tileStartHz
+            || line.hzPerPx != m_tileHzPerPx
+            || !sameScale(*line.scale, *m_tileScale)))
+    {
+        writeTile();
+    }
+
+    if (m_colors && line.scale != m_lutScale)
+        updateLut(line.scale);
+
+    if (m_tileLines == 0)
+    {
+        QImage::Format format = QImage::Format_RGB32;
+        if (!m_colors)
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+            format = QImage::Format_Grayscale16;
+#else
+            format = QImage::Format_Grayscale8;
+#endif
+        m_tile = QImage(width, TILE_LINES, format);
+        m_tileStartHz = line.startHz;
+        m_tileHzPerPx = line.hzPerPx;
+        m_tileScale = line.scale;
+        m_tileTimes.clear();
+    }
+
+    uchar *row = m_tile.scanLine(m_tileLines);
+    if (m_colors)
+    {
+        QRgb *out = reinterpret_cast<QRgb *>(row);
+        for (int x = 0; x < width; ++x)
+            out[x] = m_lut[line.data[x]];
+    }
+    else if (m_tile.format() == QImage::Format_Grayscale8)
+    {
+        for (int x = 0; x < width; ++x)
+            row[x] = (uchar)(line.data[x] >> 8);
+    }
+    else
+    {
+        memcpy(row, line.data.data(), width * sizeof(quint16));
+    }
+
+    m_tileTimes.push_back(line.time_ms);
+    if (++m_tileLines == TILE_LINES)
+        writeTile();
+}
+
+// Write the current tile, called on the writer thread
+void CWaterfallRecorder::writeTile()
+{
+    if (m_tileLines == 0)
+        return;
+
+    QImage tile = m_tileLines < TILE_LINES ? m_tile.copy(0, 0, m_tile.width(), m_tileLines)
+                                           : m_tile;
+
+    QStringList times;
+    for (auto t : m_tileTimes)
+        times << QString::number(t);
+
+    tile.setText("Software", "Gqrx");
+    tile.setText("StartHz", QString::number(m_tileStartHz, 'f', 3));
+    tile.setText("HzPerPx", QString::number(m_tileHzPerPx, 'g', 12));
+    tile.setText("Times", times.join(' '));
+    if (m_colors)
+    {
+        tile.setText("Format", "color");
+        tile.setText("MinDb", QString::number(m_tileScale->mindB));
+        tile.setText("MaxDb", QString::number(m_tileScale->maxdB));
+    }
+    else
+    {
+        // 0 means no data
+        const float rawSteps = m_tileScale->rawStepsPerDb;
+        const float steps = tile.format() == QImage::Format_Grayscale8 ? rawSteps / 256.0f
+                                                                       : rawSteps;
+        tile.setText("Format", "raw");
+        tile.setText("RawMinDb", QString::number(m_tileScale->rawMinDb));
+        tile.setText("RawStepsPerDb", QString::number(steps));
+    }
+
+    const QString file = QString("wf_%1.png").arg(m_tileCount, 6, 10, QChar('0'));
+    if (tile.save(QDir(m_path).filePath(file), "PNG"))
+    {
+        m_index.write(QString("%1,%2,%3,%4,%5,%6,%7\n")
+                      .arg(file)
+                      .arg(m_tileTimes.front())
+                      .arg(m_tileTimes.back())
+                      .arg(m_tileLines)
+                      .arg(tile.width())
+                      .arg(m_tileStartHz, 0, 'f', 3)
+                      .arg(m_tileHzPerPx, 0, 'g', 12)
+                      .toUtf8());
+        m_index.flush();
+    }
+    else
+    {
+        qWarning() << "Can not write waterfall tile" << file;
+    }
+
+    m_tileCount++;
+    m_tileLines = 0;
+    m_tile = QImage();
+}
+
+// Whether lines with these scales can share a tile, called on the writer thread
+bool CWaterfallRecorder::sameScale(const Scale &a, const Scale &b) const
+{
+    if (a.rawMinDb != b.rawMinDb || a.rawStepsPerDb != b.rawStepsPerDb)
+        return false;
+    return !m_colors || (a.colorTbl == b.colorTbl && a.mindB == b.mindB && a.maxdB == b.maxdB);
+}
+
+// Called on the writer thread
+void CWaterfallRecorder::updateLut(const std::shared_ptr<const Scale> &scale)
+{
+    const float gain = 256.0f / std::fabs(scale->maxdB - scale->mindB);
+
+    m_lut.resize(65536);
+    m_lut[0] = qRgb(0, 0, 0);
+    for (int q = 1; q < 65536; ++q)
+    {
+        const float dB = scale->rawMinDb + (float)q / scale->rawStepsPerDb;
+        const float v = std::min(std::max(gain * (scale->maxdB - dB), 0.0f), 255.0f);
+        m_lut[q] = scale->colorTbl[255 - (int)(v + 0.5f)];
+    }
+    m_lutScale = scale;
+}
@@ -0,0 +1,114 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef WATERFALL_RECORDER_H
+#define WATERFALL_RECORDER_H
+
+#include <QFile>
+#include <QImage>
+#include <QString>
+#include <QVector>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*! \brief Records waterfall lines to a directory of PNG tiles.
+ *
+ * Each tile holds up to TILE_LINES lines, oldest at the top. A new tile is
+ * started when the frequency range, width or scale of the lines changes.
+ * Tiles are either raw levels in 16 bit grayscale, or colored like the
+ * waterfall.
+ *
+ * The frequency range, dB scale and the time of each line are stored as
+ * PNG text in each tile, and one line per tile is appended to index.csv.
+ * Lines are queued by addLine() and written on a background thread.
+ */
+class CWaterfallRecorder
+{
+public:
+    static const int TILE_LINES = 256;
+
+    CWaterfallRecorder();
+    ~CWaterfallRecorder();
+
+    bool start(const QString &dir, bool colors);
+    void stop();
+    bool isRunning() const { return m_running; }
+    const QString &path() const { return m_path; }
+
+    void setRawScale(float minDb, float stepsPerDb);
+    void setColors(const QVector<QRgb> &colorTbl, float mindB, float maxdB);
+    void addLine(const std::vector<quint16> &data, double startHz,
+                 double hzPerPx, quint64 time_ms);
+
+private:
+    // Meaning of the raw levels and colors, shared by the lines queued
+    // between two changes
+    struct Scale {
+        float       rawMinDb;
+        float       rawStepsPerDb;
+        QVector<QRgb> colorTbl;
+        float       mindB;
+        float       maxdB;
+    };
+
+    struct Line {
+        std::vector<quint16> data;
+        double      startHz;
+        double      hzPerPx;
+        quint64     time_ms;
+        std::shared_ptr<const Scale> scale;
+    };
+
+    void writerThread();
+    void appendLine(const Line &line);
+    void writeTile();
+    bool sameScale(const Scale &a, const Scale &b) const;
+    void updateLut(const std::shared_ptr<const Scale> &scale);
+
+    bool        m_running;
+    bool        m_colors;
+    QString     m_path;
+
+    std::thread             m_thread;
+    std::mutex              m_mutex;    // queue and settings
+    std::condition_variable m_cond;
+    bool        m_stop;
+    std::deque<Line> m_queue;
+    bool        m_dropping;
+    std::shared_ptr<const Scale> m_scale;  // for new lines
+
+    // Owned by the writer thread
+    std::vector<QRgb> m_lut;        // raw level to color
+    std::shared_ptr<const Scale> m_lutScale;
+    std::shared_ptr<const Scale> m_tileScale;
+    QImage      m_tile;
+    int         m_tileLines;
+    int         m_tileCount;
+    double      m_tileStartHz;
+    double      m_tileHzPerPx;
+    std::vector<quint64> m_tileTimes;
+    QFile       m_index;
+};
+
+#endif // WATERFALL_RECORDER_H
@@ -159,6 +159,11 @@ void nbrx::set_sql_alpha(double alpha)
     sql->set_alpha(alpha);
 }
 
+bool nbrx::is_sql_open()
+{
+    return sql->unmuted();
+}
+
 void nbrx::set_agc_on(bool agc_on)
 {
     agc->set_agc_on(agc_on);
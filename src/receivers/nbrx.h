@@ -89,6 +89,7 @@ public:
     bool has_sql() { return true; }
     void set_sql_level(double level_db);
     void set_sql_alpha(double alpha);
+    bool is_sql_open();
 
     /* AGC */
     bool has_agc() { return true; }
@@ -74,6 +74,11 @@ void receiver_base_cf::set_sql_alpha(double alpha)
     (void) alpha;
 }
 
+bool receiver_base_cf::is_sql_open()
+{
+    return true;
+}
+
 bool receiver_base_cf::has_agc()
 {
     return false;
@@ -75,6 +75,7 @@ public:
     virtual bool has_sql();
     virtual void set_sql_level(double level_db);
     virtual void set_sql_alpha(double alpha);
+    virtual bool is_sql_open();
 
     /* AGC */
     virtual bool has_agc();
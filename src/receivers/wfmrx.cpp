@@ -136,6 +136,11 @@ void wfmrx::set_sql_alpha(double alpha)
     sql->set_alpha(alpha);
 }
 
+bool wfmrx::is_sql_open()
+{
+    return sql->unmuted();
+}
+
 /*
 void nbrx::set_agc_on(bool agc_on)
 {